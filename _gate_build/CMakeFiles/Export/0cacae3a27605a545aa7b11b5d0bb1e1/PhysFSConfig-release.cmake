@@ -0,0 +1,38 @@
+#----------------------------------------------------------------
+# Generated CMake target import file for configuration "Release".
+#----------------------------------------------------------------
+
+# Commands may need to know the format version.
+set(CMAKE_IMPORT_FILE_VERSION 1)
+
+# Import target "physfs-static" for configuration "Release"
+set_property(TARGET physfs-static APPEND PROPERTY IMPORTED_CONFIGURATIONS RELEASE)
+set_target_properties(physfs-static PROPERTIES
+  IMPORTED_LINK_INTERFACE_LANGUAGES_RELEASE "C"
+  IMPORTED_LOCATION_RELEASE "${_IMPORT_PREFIX}/lib/libphysfs.a"
+  )
+
+list(APPEND _cmake_import_check_targets physfs-static )
+list(APPEND _cmake_import_check_files_for_physfs-static "${_IMPORT_PREFIX}/lib/libphysfs.a" )
+
+# Import target "physfs" for configuration "Release"
+set_property(TARGET physfs APPEND PROPERTY IMPORTED_CONFIGURATIONS RELEASE)
+set_target_properties(physfs PROPERTIES
+  IMPORTED_LOCATION_RELEASE "${_IMPORT_PREFIX}/lib/libphysfs.so.3.1.0"
+  IMPORTED_SONAME_RELEASE "libphysfs.so.1"
+  )
+
+list(APPEND _cmake_import_check_targets physfs )
+list(APPEND _cmake_import_check_files_for_physfs "${_IMPORT_PREFIX}/lib/libphysfs.so.3.1.0" )
+
+# Import target "test_physfs" for configuration "Release"
+set_property(TARGET test_physfs APPEND PROPERTY IMPORTED_CONFIGURATIONS RELEASE)
+set_target_properties(test_physfs PROPERTIES
+  IMPORTED_LOCATION_RELEASE "${_IMPORT_PREFIX}/bin/test_physfs"
+  )
+
+list(APPEND _cmake_import_check_targets test_physfs )
+list(APPEND _cmake_import_check_files_for_test_physfs "${_IMPORT_PREFIX}/bin/test_physfs" )
+
+# Commands beyond this point should not need to know the version.
+set(CMAKE_IMPORT_FILE_VERSION)
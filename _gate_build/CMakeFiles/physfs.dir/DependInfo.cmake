@@ -0,0 +1,47 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/physfs.c" "CMakeFiles/physfs.dir/src/physfs.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs.c.o.d"
+  "/root/repo/src/physfs_archiver_7z.c" "CMakeFiles/physfs.dir/src/physfs_archiver_7z.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_7z.c.o.d"
+  "/root/repo/src/physfs_archiver_dir.c" "CMakeFiles/physfs.dir/src/physfs_archiver_dir.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_dir.c.o.d"
+  "/root/repo/src/physfs_archiver_grp.c" "CMakeFiles/physfs.dir/src/physfs_archiver_grp.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_grp.c.o.d"
+  "/root/repo/src/physfs_archiver_hog.c" "CMakeFiles/physfs.dir/src/physfs_archiver_hog.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_hog.c.o.d"
+  "/root/repo/src/physfs_archiver_iso9660.c" "CMakeFiles/physfs.dir/src/physfs_archiver_iso9660.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_iso9660.c.o.d"
+  "/root/repo/src/physfs_archiver_mvl.c" "CMakeFiles/physfs.dir/src/physfs_archiver_mvl.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_mvl.c.o.d"
+  "/root/repo/src/physfs_archiver_qpak.c" "CMakeFiles/physfs.dir/src/physfs_archiver_qpak.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_qpak.c.o.d"
+  "/root/repo/src/physfs_archiver_slb.c" "CMakeFiles/physfs.dir/src/physfs_archiver_slb.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_slb.c.o.d"
+  "/root/repo/src/physfs_archiver_unpacked.c" "CMakeFiles/physfs.dir/src/physfs_archiver_unpacked.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_unpacked.c.o.d"
+  "/root/repo/src/physfs_archiver_vdf.c" "CMakeFiles/physfs.dir/src/physfs_archiver_vdf.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_vdf.c.o.d"
+  "/root/repo/src/physfs_archiver_wad.c" "CMakeFiles/physfs.dir/src/physfs_archiver_wad.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_wad.c.o.d"
+  "/root/repo/src/physfs_archiver_zip.c" "CMakeFiles/physfs.dir/src/physfs_archiver_zip.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_archiver_zip.c.o.d"
+  "/root/repo/src/physfs_byteorder.c" "CMakeFiles/physfs.dir/src/physfs_byteorder.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_byteorder.c.o.d"
+  "/root/repo/src/physfs_crc32.c" "CMakeFiles/physfs.dir/src/physfs_crc32.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_crc32.c.o.d"
+  "/root/repo/src/physfs_platform_android.c" "CMakeFiles/physfs.dir/src/physfs_platform_android.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_platform_android.c.o.d"
+  "/root/repo/src/physfs_platform_os2.c" "CMakeFiles/physfs.dir/src/physfs_platform_os2.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_platform_os2.c.o.d"
+  "/root/repo/src/physfs_platform_posix.c" "CMakeFiles/physfs.dir/src/physfs_platform_posix.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_platform_posix.c.o.d"
+  "/root/repo/src/physfs_platform_qnx.c" "CMakeFiles/physfs.dir/src/physfs_platform_qnx.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_platform_qnx.c.o.d"
+  "/root/repo/src/physfs_platform_unix.c" "CMakeFiles/physfs.dir/src/physfs_platform_unix.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_platform_unix.c.o.d"
+  "/root/repo/src/physfs_platform_windows.c" "CMakeFiles/physfs.dir/src/physfs_platform_windows.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_platform_windows.c.o.d"
+  "/root/repo/src/physfs_unicode.c" "CMakeFiles/physfs.dir/src/physfs_unicode.c.o" "gcc" "CMakeFiles/physfs.dir/src/physfs_unicode.c.o.d"
+  )
+
+# Pairs of files generated by the same build rule.
+set(CMAKE_MULTIPLE_OUTPUT_PAIRS
+  "/root/repo/_gate_build/libphysfs.so" "/root/repo/_gate_build/libphysfs.so.3.1.0"
+  "/root/repo/_gate_build/libphysfs.so.1" "/root/repo/_gate_build/libphysfs.so.3.1.0"
+  )
+
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,55 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/physfs.dir/src/physfs.c.o"
+  "CMakeFiles/physfs.dir/src/physfs.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_7z.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_7z.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_dir.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_dir.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_grp.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_grp.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_hog.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_hog.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_iso9660.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_iso9660.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_mvl.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_mvl.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_qpak.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_qpak.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_slb.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_slb.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_unpacked.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_unpacked.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_vdf.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_vdf.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_wad.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_wad.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_zip.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_archiver_zip.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_byteorder.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_byteorder.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_crc32.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_crc32.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_platform_android.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_platform_android.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_platform_os2.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_platform_os2.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_platform_posix.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_platform_posix.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_platform_qnx.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_platform_qnx.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_platform_unix.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_platform_unix.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_platform_windows.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_platform_windows.c.o.d"
+  "CMakeFiles/physfs.dir/src/physfs_unicode.c.o"
+  "CMakeFiles/physfs.dir/src/physfs_unicode.c.o.d"
+  "libphysfs.pdb"
+  "libphysfs.so"
+  "libphysfs.so.1"
+  "libphysfs.so.3.1.0"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/physfs.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
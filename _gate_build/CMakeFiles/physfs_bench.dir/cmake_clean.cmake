@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/physfs_bench.dir/test/physfs_bench.c.o"
+  "CMakeFiles/physfs_bench.dir/test/physfs_bench.c.o.d"
+  "physfs_bench"
+  "physfs_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/physfs_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
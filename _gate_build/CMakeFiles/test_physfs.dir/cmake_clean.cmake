@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_physfs.dir/test/test_physfs.c.o"
+  "CMakeFiles/test_physfs.dir/test/test_physfs.c.o.d"
+  "test_physfs"
+  "test_physfs.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/test_physfs.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -49,38 +49,106 @@ typedef struct __PHYSFS_DIRHANDLE__
     char *root;  /* subdirectory of archiver to use as root of archive (NULL for actual root) */
     size_t rootlen;  /* subdirectory of archiver to use as root of archive (NULL for actual root) */
     const PHYSFS_Archiver *funcs;  /* Ptr to archiver info for this handle. */
+    PHYSFS_uint64 statOpens;  /* PHYSFS_getMountStats: opens served here. */
+    PHYSFS_uint64 statProbes;  /* PHYSFS_getMountStats: lookups asked here. */
+    PHYSFS_uint64 statBytesRead;  /* PHYSFS_getMountStats: bytes delivered. */
+    struct __PHYSFS_FILEHANDLE__ *openHandles; /* files open on this mount. */
+    void *handleLock;  /* guards (openHandles), and nothing else.          */
     struct __PHYSFS_DIRHANDLE__ *next;  /* linked list stuff. */
 } DirHandle;
 
 
+/*
+ * A full write buffer detached from its handle, waiting for a worker
+ *  thread to push it to the archiver. (completion), if set, is moved to
+ *  the async completed list once this buffer has been written, which is
+ *  how PHYSFS_flushAsync() delivers its callback.
+ */
+typedef struct WriteBehindBuf
+{
+    PHYSFS_uint8 *buffer;
+    size_t len;
+    struct AsyncReadRequest *completion;
+    struct WriteBehindBuf *next;
+} WriteBehindBuf;
+
 typedef struct __PHYSFS_FILEHANDLE__
 {
     PHYSFS_Io *io;  /* Instance data unique to the archiver for this file. */
     PHYSFS_uint8 forReading; /* Non-zero if reading, zero if write/append */
-    const DirHandle *dirHandle;  /* Archiver instance that created this */
+    DirHandle *dirHandle;  /* Archiver instance that created this */
     PHYSFS_uint8 *buffer;  /* Buffer, if set (NULL otherwise). Don't touch! */
     size_t bufsize;  /* Bufsize, if set (0 otherwise). Don't touch! */
     size_t buffill;  /* Buffer fill size. Don't touch! */
     size_t bufpos;  /* Buffer position. Don't touch! */
-    struct __PHYSFS_FILEHANDLE__ *next;  /* linked list stuff. */
+    size_t bufwindow;  /* Current readahead window (>= bufsize). Don't touch! */
+    size_t bufalloc;  /* Actual allocation size of buffer. Don't touch! */
+    int bufstreak;  /* Consecutive sequential refills. Don't touch! */
+    int writeBehind;  /* PHYSFS_setWriteBehind() enabled? Don't touch! */
+    WriteBehindBuf *wbqueue;  /* detached buffers awaiting write. */
+    WriteBehindBuf *wbqueueTail;  /* last item in (wbqueue). */
+    PHYSFS_sint64 wbTell;  /* logical end of queued data, for tell(). */
+    int wbDraining;  /* nonzero while a worker is writing our queue. */
+    void *wbWaitSem;  /* posted each time a drain finishes, if not NULL. */
+    PHYSFS_ErrorCode wbErrcode;  /* first background write error, sticky. */
+    struct __PHYSFS_FILEHANDLE__ *next;  /* dirHandle's open handle list. */
+    struct __PHYSFS_FILEHANDLE__ *prev;  /* ...doubly linked, for O(1) close. */
 } FileHandle;
 
+/*
+ * Buffered reads adapt to the access pattern, the way OS page caches do:
+ *  every refill in doBufferedRead() picks up exactly where the last one
+ *  ended, so a second consecutive refill means the app streamed through a
+ *  whole window and will likely keep going. We double the readahead window
+ *  each time that happens, up to this cap, and snap back to the app's
+ *  PHYSFS_setBuffer() size when a seek lands outside the buffered range.
+ *  The app-requested size is always the floor, so a cap smaller than the
+ *  buffer just disables the growth.
+ */
+#define PHYSFS_READAHEAD_MAX (256 * 1024)
+
 
 typedef struct __PHYSFS_ERRSTATETYPE__
 {
     void *tid;
     PHYSFS_ErrorCode code;
+    int readLockDepth;  /* how many shared state locks this thread holds. */
     struct __PHYSFS_ERRSTATETYPE__ *next;
 } ErrState;
 
 
+/*
+ * Use real thread-local storage for the per-thread error state wherever the
+ *  compiler offers it, which makes error set/get lock-free; the BAIL macros
+ *  set error codes on every hot path, and taking errorLock to walk a global
+ *  list for each one is measurable contention with many threads. The linked
+ *  list is still maintained so doDeinit() can free every thread's state; the
+ *  generation counter keeps a thread from touching its stale pointer after a
+ *  deinit/reinit cycle frees the state behind it. Define
+ *  PHYSFS_NO_THREAD_LOCAL to force the portable list-walking fallback.
+ */
+#ifndef PHYSFS_NO_THREAD_LOCAL
+    #if defined(_MSC_VER)
+        #define PHYSFS_THREAD_LOCAL __declspec(thread)
+    #elif defined(__GNUC__) || defined(__clang__)
+        #define PHYSFS_THREAD_LOCAL __thread
+    #elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && \
+          !defined(__STDC_NO_THREADS__)
+        #define PHYSFS_THREAD_LOCAL _Thread_local
+    #endif
+#endif
+
 /* General PhysicsFS state ... */
 static int initialized = 0;
 static ErrState *errorStates = NULL;
+
+#ifdef PHYSFS_THREAD_LOCAL
+static volatile int errStateGeneration = 0;
+static PHYSFS_THREAD_LOCAL ErrState *tlsErrState = NULL;
+static PHYSFS_THREAD_LOCAL int tlsErrStateGeneration = 0;
+#endif
 static DirHandle *searchPath = NULL;
 static DirHandle *writeDir = NULL;
-static FileHandle *openWriteList = NULL;
-static FileHandle *openReadList = NULL;
 static char *baseDir = NULL;
 static char *userDir = NULL;
 static char *prefDir = NULL;
@@ -93,20 +161,121 @@ static size_t longest_root = 0;
 /* mutexes ... */
 static void *errorLock = NULL;     /* protects error message list.        */
 static void *stateLock = NULL;     /* protects other PhysFS static state. */
+static void *readCountLock = NULL; /* protects stateReaders counter.      */
+static void *negCacheLock = NULL;  /* protects the negative lookup cache. */
+static void *contentCacheLock = NULL;  /* protects the content cache.     */
+static void *asyncLock = NULL;     /* protects the async read queues.     */
+
+/*
+ * The search path is read-mostly after startup, so read-only operations
+ *  (open for read, stat, exists, enumerate) take a shared "read lock" that
+ *  lets them run in parallel, while anything that mutates the search path
+ *  (mount, unmount, setWriteDir, etc) takes (stateLock) exclusively and
+ *  waits for in-flight readers to drain.
+ *
+ * Readers touch (stateLock) only for the instant it takes to bump
+ *  (stateReaders), so an idle writer can't starve and a held writer blocks
+ *  new readers at the mutex. Only a thread's _first_ shared lock touches
+ *  (stateLock) and (stateReaders) at all: re-entry--stat or open from
+ *  inside an enumeration callback is legal API usage--just bumps the depth
+ *  count in the thread's ErrState, so a nested reader can never block on
+ *  (stateLock) behind a writer while its own outer lock keeps the reader
+ *  count nonzero. That depth count also keeps a reader that mounts
+ *  something from a callback (hi, PHYSFS_setSaneConfig!) from deadlocking
+ *  against its own shared locks. A writer that finds readers in flight
+ *  sleeps on (writerDrainSem) and the last reader out posts it; spurious
+ *  wakeups just recheck the count.
+ */
+static volatile int stateReaders = 0;
+static volatile int writerWaiting = 0;  /* guarded by (readCountLock).     */
+static void *writerDrainSem = NULL;     /* writer sleeps out the drain.    */
+
+/* asynchronous reads ... */
+
+/*
+ * Worker threads pull these off (asyncQueue), do the read, and move them
+ *  to (asyncCompleted), where PHYSFS_pollAsyncReads() runs the callbacks.
+ *  (asyncPending) counts requests whose callback hasn't fired yet, so it
+ *  covers all three stages: queued, in a worker's hands, and completed.
+ */
+typedef struct AsyncReadRequest
+{
+    FileHandle *file;
+    void *buffer;
+    PHYSFS_uint64 len;
+    PHYSFS_AsyncReadCallback callback;
+    void *userdata;
+    PHYSFS_sint64 result;
+    PHYSFS_ErrorCode errcode;
+    int isFlush;  /* nonzero: drain (file)'s write-behind queue instead. */
+    PHYSFS_AsyncFlushCallback flushcb;  /* only when (isFlush). May be NULL. */
+    struct AsyncReadRequest *next;
+} AsyncReadRequest;
+
+#ifndef PHYSFS_ASYNC_READ_THREADS
+#define PHYSFS_ASYNC_READ_THREADS 4
+#endif
+
+static AsyncReadRequest *asyncQueue = NULL;
+static AsyncReadRequest *asyncQueueTail = NULL;
+static AsyncReadRequest *asyncCompleted = NULL;
+static AsyncReadRequest *asyncCompletedTail = NULL;
+static void *asyncWorkSem = NULL;
+static void *asyncDoneSem = NULL;
+static void *asyncThreads[PHYSFS_ASYNC_READ_THREADS];
+static int asyncThreadCount = 0;
+static int asyncThreadsFailed = 0;  /* no threads here; reads go inline. */
+static volatile int asyncPending = 0;
+static volatile int asyncShutdown = 0;
+
+/* write-behind plumbing lives with the rest of the async machinery, far
+   below, but the buffered write path needs to reach it. */
+static void startAsyncReadThreads(void);
+static int queueWriteBehind(FileHandle *fh, AsyncReadRequest *completion);
+static void drainWriteBehind(FileHandle *fh);
+static int drainWriteBehindSync(FileHandle *fh);
 
 /* allocator ... */
 static int externalAllocator = 0;
 PHYSFS_Allocator allocator;
 
+/* performance counters and tracing ... */
+
+#ifndef PHYSFS_NO_STATS
+PHYSFS_Stats __PHYSFS_stats;
+
+void __PHYSFS_statsAdd(PHYSFS_uint64 *counter, const PHYSFS_uint64 n)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __sync_fetch_and_add(counter, n);
+#else
+    *counter += n;  /* best effort; may drop counts under contention. */
+#endif
+} /* __PHYSFS_statsAdd */
+#endif
+
+static PHYSFS_TraceCallback traceHook = NULL;
+static void *traceHookData = NULL;
+
+static void traceOperation(const char *op, const char *detail,
+                           const int result)
+{
+    if (traceHook != NULL)
+        traceHook(traceHookData, op, detail, result);
+} /* traceOperation */
+
 
 #ifdef PHYSFS_NEED_ATOMIC_OP_FALLBACK
 static inline int __PHYSFS_atomicAdd(int *ptrval, const int val)
 {
+    /* this uses errorLock and not stateLock, since a writer can sit on
+       stateLock while it waits for readers to drain. Returns the updated
+       value, like the compiler-intrinsic versions. */
     int retval;
-    __PHYSFS_platformGrabMutex(stateLock);
-    retval = *ptrval;
-    *ptrval = retval + val;
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformGrabMutex(errorLock);
+    retval = *ptrval + val;
+    *ptrval = retval;
+    __PHYSFS_platformReleaseMutex(errorLock);
     return retval;
 } /* __PHYSFS_atomicAdd */
 
@@ -125,62 +294,188 @@ int __PHYSFS_ATOMIC_DECR(int *ptrval)
 
 /* PHYSFS_Io implementation for i/o to physical filesystem... */
 
-/* !!! FIXME: maybe refcount the paths in a string pool? */
+/*
+ * Duplicates of a read-mode native Io share one platform file handle
+ *  instead of reopening the file: every PHYSFS_openRead() of an archive
+ *  member duplicates the archive's Io, so opening a few thousand files
+ *  out of one zip used to cost a few thousand open() calls and that many
+ *  fd-table slots. Sharing works because read-mode Ios track their own
+ *  position and read through __PHYSFS_platformReadAt(), which doesn't
+ *  move the handle's file pointer. Write-mode Ios still reopen on
+ *  duplicate--positional writes can't share a file pointer--but those
+ *  are rare.
+ */
+typedef struct __PHYSFS_NativeSharedHandle
+{
+    void *handle;         /* platform file handle, opened once.        */
+    const char *path;     /* for duplicates of write-mode handles.     */
+    int refcount;         /* Ios referencing this; guarded by (mutex). */
+    void *mutex;
+} NativeSharedHandle;
+
 typedef struct __PHYSFS_NativeIoInfo
 {
-    void *handle;
-    const char *path;
+    NativeSharedHandle *shared;  /* the (refcounted) platform handle. */
+    PHYSFS_uint64 pos;    /* this Io's logical position, if mode 'r'.  */
     int mode;   /* 'r', 'w', or 'a' */
+    void *maphandle;      /* platform mapping handle, if mapped. */
+    const void *mapaddr;  /* mapped address, if mapped.          */
+    PHYSFS_uint64 maplen; /* mapped length, if mapped.           */
 } NativeIoInfo;
 
+static PHYSFS_sint64 nativeIo_readAt(PHYSFS_Io *io, void *buf,
+                                     PHYSFS_uint64 len, PHYSFS_uint64 offset)
+{
+    NativeIoInfo *info = (NativeIoInfo *) io->opaque;
+#ifdef PHYSFS_PLATFORM_OS2
+    /* no positioned read there; __PHYSFS_platformReadAt moves the file
+       pointer, so duplicates sharing the handle take turns. */
+    PHYSFS_sint64 rc;
+    __PHYSFS_platformGrabMutex(info->shared->mutex);
+    rc = __PHYSFS_platformReadAt(info->shared->handle, buf, len, offset);
+    __PHYSFS_platformReleaseMutex(info->shared->mutex);
+    return rc;
+#else
+    return __PHYSFS_platformReadAt(info->shared->handle, buf, len, offset);
+#endif
+} /* nativeIo_readAt */
+
 static PHYSFS_sint64 nativeIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    return __PHYSFS_platformRead(info->handle, buf, len);
+    PHYSFS_sint64 rc;
+
+    if (info->mode != 'r')
+        return __PHYSFS_platformRead(info->shared->handle, buf, len);
+
+    /* positionless read, so duplicates sharing the handle don't fight
+       over one file pointer. */
+    rc = nativeIo_readAt(io, buf, len, info->pos);
+    if (rc > 0)
+        info->pos += (PHYSFS_uint64) rc;
+    return rc;
 } /* nativeIo_read */
 
 static PHYSFS_sint64 nativeIo_write(PHYSFS_Io *io, const void *buffer,
                                     PHYSFS_uint64 len)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    return __PHYSFS_platformWrite(info->handle, buffer, len);
+    return __PHYSFS_platformWrite(info->shared->handle, buffer, len);
 } /* nativeIo_write */
 
 static int nativeIo_seek(PHYSFS_Io *io, PHYSFS_uint64 offset)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    return __PHYSFS_platformSeek(info->handle, offset);
+    if (info->mode == 'r')
+    {
+        info->pos = offset;  /* reads past EOF just return 0 bytes. */
+        return 1;
+    } /* if */
+    return __PHYSFS_platformSeek(info->shared->handle, offset);
 } /* nativeIo_seek */
 
 static PHYSFS_sint64 nativeIo_tell(PHYSFS_Io *io)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    return __PHYSFS_platformTell(info->handle);
+    if (info->mode == 'r')
+        return (PHYSFS_sint64) info->pos;
+    return __PHYSFS_platformTell(info->shared->handle);
 } /* nativeIo_tell */
 
 static PHYSFS_sint64 nativeIo_length(PHYSFS_Io *io)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    return __PHYSFS_platformFileLength(info->handle);
+    return __PHYSFS_platformFileLength(info->shared->handle);
 } /* nativeIo_length */
 
+static const void *nativeIo_map(PHYSFS_Io *io, PHYSFS_uint64 *len)
+{
+    NativeIoInfo *info = (NativeIoInfo *) io->opaque;
+    PHYSFS_sint64 filelen;
+
+    if (info->mapaddr != NULL)  /* already mapped? Reuse it. */
+    {
+        *len = info->maplen;
+        return info->mapaddr;
+    } /* if */
+
+    BAIL_IF(info->mode != 'r', PHYSFS_ERR_OPEN_FOR_WRITING, NULL);
+
+    filelen = __PHYSFS_platformFileLength(info->shared->handle);
+    BAIL_IF_ERRPASS(filelen == -1, NULL);
+    BAIL_IF(filelen == 0, PHYSFS_ERR_UNSUPPORTED, NULL);
+
+    info->maphandle = __PHYSFS_platformMapFile(info->shared->handle,
+                                               (PHYSFS_uint64) filelen,
+                                               &info->mapaddr);
+    BAIL_IF_ERRPASS(!info->maphandle, NULL);
+
+    info->maplen = (PHYSFS_uint64) filelen;
+    *len = info->maplen;
+    return info->mapaddr;
+} /* nativeIo_map */
+
 static PHYSFS_Io *nativeIo_duplicate(PHYSFS_Io *io)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    return __PHYSFS_createNativeIo(info->path, info->mode);
+    NativeSharedHandle *shared = info->shared;
+    NativeIoInfo *newinfo = NULL;
+    PHYSFS_Io *retval = NULL;
+
+    if (info->mode != 'r')  /* one file pointer for writes; reopen. */
+        return __PHYSFS_createNativeIo(shared->path, info->mode);
+
+    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
+    BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    newinfo = (NativeIoInfo *) allocator.Malloc(sizeof (NativeIoInfo));
+    if (!newinfo)
+    {
+        allocator.Free(retval);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    } /* if */
+
+    __PHYSFS_platformGrabMutex(shared->mutex);
+    shared->refcount++;
+    __PHYSFS_platformReleaseMutex(shared->mutex);
+
+    memset(newinfo, '\0', sizeof (*newinfo));
+    newinfo->shared = shared;
+    newinfo->pos = 0;  /* duplicates start at the beginning, as ever. */
+    newinfo->mode = 'r';
+
+    memcpy(retval, io, sizeof (*retval));
+    retval->opaque = newinfo;
+    return retval;
 } /* nativeIo_duplicate */
 
 static int nativeIo_flush(PHYSFS_Io *io)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    return __PHYSFS_platformFlush(info->handle);
+    return __PHYSFS_platformFlush(info->shared->handle);
 } /* nativeIo_flush */
 
 static void nativeIo_destroy(PHYSFS_Io *io)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
-    __PHYSFS_platformClose(info->handle);
-    allocator.Free((void *) info->path);
+    NativeSharedHandle *shared = info->shared;
+    int gone;
+
+    if (info->mapaddr != NULL)
+        __PHYSFS_platformUnmapFile(info->maphandle, info->mapaddr,
+                                   info->maplen);
+
+    __PHYSFS_platformGrabMutex(shared->mutex);
+    gone = (--shared->refcount == 0);
+    __PHYSFS_platformReleaseMutex(shared->mutex);
+
+    if (gone)  /* last Io out closes the file. */
+    {
+        __PHYSFS_platformClose(shared->handle);
+        __PHYSFS_platformDestroyMutex(shared->mutex);
+        allocator.Free((void *) shared->path);
+        allocator.Free(shared);
+    } /* if */
+
     allocator.Free(info);
     allocator.Free(io);
 } /* nativeIo_destroy */
@@ -195,14 +490,18 @@ static const PHYSFS_Io __PHYSFS_nativeIoInterface =
     nativeIo_length,
     nativeIo_duplicate,
     nativeIo_flush,
-    nativeIo_destroy
+    nativeIo_destroy,
+    nativeIo_readAt,
+    nativeIo_map
 };
 
 PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
 {
     PHYSFS_Io *io = NULL;
     NativeIoInfo *info = NULL;
+    NativeSharedHandle *shared = NULL;
     void *handle = NULL;
+    void *mutex = NULL;
     char *pathdup = NULL;
 
     assert((mode == 'r') || (mode == 'w') || (mode == 'a'));
@@ -211,8 +510,12 @@ PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
     GOTO_IF(!io, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
     info = (NativeIoInfo *) allocator.Malloc(sizeof (NativeIoInfo));
     GOTO_IF(!info, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
+    shared = (NativeSharedHandle *) allocator.Malloc(sizeof (*shared));
+    GOTO_IF(!shared, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
     pathdup = (char *) allocator.Malloc(strlen(path) + 1);
     GOTO_IF(!pathdup, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
+    mutex = __PHYSFS_platformCreateMutex();
+    GOTO_IF_ERRPASS(!mutex, createNativeIo_failed);
 
     if (mode == 'r')
         handle = __PHYSFS_platformOpenRead(path);
@@ -224,16 +527,25 @@ PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
     GOTO_IF_ERRPASS(!handle, createNativeIo_failed);
 
     strcpy(pathdup, path);
-    info->handle = handle;
-    info->path = pathdup;
+    shared->handle = handle;
+    shared->path = pathdup;
+    shared->refcount = 1;
+    shared->mutex = mutex;
+    info->shared = shared;
+    info->pos = 0;
     info->mode = mode;
+    info->maphandle = NULL;
+    info->mapaddr = NULL;
+    info->maplen = 0;
     memcpy(io, &__PHYSFS_nativeIoInterface, sizeof (*io));
     io->opaque = info;
     return io;
 
 createNativeIo_failed:
     if (handle != NULL) __PHYSFS_platformClose(handle);
+    if (mutex != NULL) __PHYSFS_platformDestroyMutex(mutex);
     if (pathdup != NULL) allocator.Free(pathdup);
+    if (shared != NULL) allocator.Free(shared);
     if (info != NULL) allocator.Free(info);
     if (io != NULL) allocator.Free(io);
     return NULL;
@@ -269,6 +581,29 @@ static PHYSFS_sint64 memoryIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
     return len;
 } /* memoryIo_read */
 
+static PHYSFS_sint64 memoryIo_readAt(PHYSFS_Io *io, void *buf,
+                                     PHYSFS_uint64 len, PHYSFS_uint64 offset)
+{
+    const MemoryIoInfo *info = (const MemoryIoInfo *) io->opaque;
+    const PHYSFS_uint64 avail = (offset > info->len) ? 0 : info->len - offset;
+
+    if (len > avail)
+        len = avail;
+
+    if (len > 0)
+        memcpy(buf, info->buf + offset, (size_t) len);
+
+    return len;
+} /* memoryIo_readAt */
+
+static const void *memoryIo_map(PHYSFS_Io *io, PHYSFS_uint64 *len)
+{
+    const MemoryIoInfo *info = (const MemoryIoInfo *) io->opaque;
+    BAIL_IF(!info->buf, PHYSFS_ERR_UNSUPPORTED, NULL);
+    *len = info->len;
+    return info->buf;  /* it's already in memory; just hand it over. */
+} /* memoryIo_map */
+
 static PHYSFS_sint64 memoryIo_write(PHYSFS_Io *io, const void *buffer,
                                     PHYSFS_uint64 len)
 {
@@ -380,7 +715,9 @@ static const PHYSFS_Io __PHYSFS_memoryIoInterface =
     memoryIo_length,
     memoryIo_duplicate,
     memoryIo_flush,
-    memoryIo_destroy
+    memoryIo_destroy,
+    memoryIo_readAt,
+    memoryIo_map
 };
 
 PHYSFS_Io *__PHYSFS_createMemoryIo(const void *buf, PHYSFS_uint64 len,
@@ -413,6 +750,39 @@ createMemoryIo_failed:
 } /* __PHYSFS_createMemoryIo */
 
 
+/*
+ * Open file handles hang off their DirHandle, not a global list, so two
+ *  threads opening and closing files on different mounts never touch the
+ *  same lock, and closing a handle is an O(1) unlink instead of a walk of
+ *  every open file in the process. Each list is guarded by its mount's
+ *  (handleLock); the lists are only walked wholesale when a mount goes
+ *  away (freeDirHandle/doDeinit), which happens under the exclusive
+ *  state lock anyhow.
+ */
+static void openListAdd(DirHandle *dh, FileHandle *fh)
+{
+    __PHYSFS_platformGrabMutex(dh->handleLock);
+    fh->prev = NULL;
+    fh->next = dh->openHandles;
+    if (dh->openHandles != NULL)
+        dh->openHandles->prev = fh;
+    dh->openHandles = fh;
+    __PHYSFS_platformReleaseMutex(dh->handleLock);
+} /* openListAdd */
+
+static void openListRemove(DirHandle *dh, FileHandle *fh)
+{
+    __PHYSFS_platformGrabMutex(dh->handleLock);
+    if (fh->prev != NULL)
+        fh->prev->next = fh->next;
+    else
+        dh->openHandles = fh->next;
+    if (fh->next != NULL)
+        fh->next->prev = fh->prev;
+    __PHYSFS_platformReleaseMutex(dh->handleLock);
+} /* openListRemove */
+
+
 /* PHYSFS_Io implementation for i/o to a PHYSFS_File... */
 
 static PHYSFS_sint64 handleIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
@@ -473,18 +843,7 @@ static PHYSFS_Io *handleIo_duplicate(PHYSFS_Io *io)
     newfh->forReading = origfh->forReading;
     newfh->dirHandle = origfh->dirHandle;
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    if (newfh->forReading)
-    {
-        newfh->next = openReadList;
-        openReadList = newfh;
-    } /* if */
-    else
-    {
-        newfh->next = openWriteList;
-        openWriteList = newfh;
-    } /* else */
-    __PHYSFS_platformReleaseMutex(stateLock);
+    openListAdd(newfh->dirHandle, newfh);
 
     memcpy(retval, io, sizeof (PHYSFS_Io));
     retval->opaque = newfh;
@@ -523,7 +882,9 @@ static const PHYSFS_Io __PHYSFS_handleIoInterface =
     handleIo_length,
     handleIo_duplicate,
     handleIo_flush,
-    handleIo_destroy
+    handleIo_destroy,
+    NULL,  /* no readAt: the wrapped file has buffering and one position. */
+    NULL   /* no map */
 };
 
 static PHYSFS_Io *__PHYSFS_createHandleIo(PHYSFS_File *f)
@@ -667,6 +1028,12 @@ void __PHYSFS_sort(void *entries, size_t max,
 
 static ErrState *findErrorForCurrentThread(void)
 {
+#ifdef PHYSFS_THREAD_LOCAL
+    /* don't trust the cached pointer if the state behind it was freed. */
+    if ((tlsErrState != NULL) && (tlsErrStateGeneration == errStateGeneration))
+        return tlsErrState;
+    return NULL;   /* no error available. */
+#else
     ErrState *i;
     void *tid;
 
@@ -692,9 +1059,117 @@ static ErrState *findErrorForCurrentThread(void)
         __PHYSFS_platformReleaseMutex(errorLock);
 
     return NULL;   /* no error available. */
+#endif
 } /* findErrorForCurrentThread */
 
 
+/* Find (or create) the ErrState for the current thread. Returns NULL if
+   allocation fails; callers must cope. */
+static ErrState *findOrCreateErrState(void)
+{
+    ErrState *err = findErrorForCurrentThread();
+    if (err == NULL)
+    {
+        err = (ErrState *) allocator.Malloc(sizeof (ErrState));
+        if (err == NULL)
+            return NULL;   /* uhh...? */
+
+        memset(err, '\0', sizeof (ErrState));
+        err->tid = __PHYSFS_platformGetThreadID();
+
+        if (errorLock != NULL)
+            __PHYSFS_platformGrabMutex(errorLock);
+
+        err->next = errorStates;
+        errorStates = err;
+
+        if (errorLock != NULL)
+            __PHYSFS_platformReleaseMutex(errorLock);
+
+        #ifdef PHYSFS_THREAD_LOCAL
+        tlsErrState = err;
+        tlsErrStateGeneration = errStateGeneration;
+        #endif
+    } /* if */
+
+    return err;
+} /* findOrCreateErrState */
+
+
+/* Take the state lock in shared (read-only) mode. */
+static void grabStateReadLock(void)
+{
+    ErrState *ts = findOrCreateErrState();
+
+    if ((ts != NULL) && (ts->readLockDepth > 0))
+    {
+        /* nested: we're already counted in (stateReaders), and we must not
+           touch (stateLock)--a writer may hold it while waiting for us. */
+        ts->readLockDepth++;
+        return;
+    } /* if */
+
+    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabMutex(readCountLock);
+    stateReaders++;
+    __PHYSFS_platformReleaseMutex(readCountLock);
+    __PHYSFS_platformReleaseMutex(stateLock);
+    if (ts != NULL)
+        ts->readLockDepth = 1;
+} /* grabStateReadLock */
+
+static void releaseStateReadLock(void)
+{
+    ErrState *ts = findErrorForCurrentThread();
+
+    if ((ts != NULL) && (ts->readLockDepth > 1))
+    {
+        ts->readLockDepth--;  /* nested; the outer lock still counts us. */
+        return;
+    } /* if */
+
+    if (ts != NULL)
+        ts->readLockDepth--;
+
+    __PHYSFS_platformGrabMutex(readCountLock);
+    stateReaders--;
+    if (writerWaiting)
+        __PHYSFS_platformPostSemaphore(writerDrainSem);
+    __PHYSFS_platformReleaseMutex(readCountLock);
+} /* releaseStateReadLock */
+
+/*
+ * Take the state lock exclusively. Releasing it is just
+ *  __PHYSFS_platformReleaseMutex(stateLock), so the BAIL_*MUTEX* macros
+ *  keep working for the write side.
+ */
+static void grabStateWriteLock(void)
+{
+    const ErrState *ts = findOrCreateErrState();
+    const int selfReaders = ((ts != NULL) && (ts->readLockDepth > 0)) ? 1 : 0;
+    __PHYSFS_platformGrabMutex(stateLock);
+    while (1)
+    {
+        int drained;
+        __PHYSFS_platformGrabMutex(readCountLock);
+        drained = ((stateReaders - selfReaders) <= 0);
+        writerWaiting = !drained;
+        __PHYSFS_platformReleaseMutex(readCountLock);
+        if (drained)
+            break;
+        /* the last reader out posts this; a stale post from an earlier
+           drain just makes one lap of the recheck loop. */
+        __PHYSFS_platformWaitSemaphore(writerDrainSem);
+    } /* while */
+} /* grabStateWriteLock */
+
+/* BAIL_*MUTEX* equivalents for sections under the shared state lock. */
+#define BAIL_READLOCK(e, r) do { if (e) PHYSFS_setErrorCode(e); releaseStateReadLock(); return r; } while (0)
+#define BAIL_READLOCK_ERRPASS(r) do { releaseStateReadLock(); return r; } while (0)
+#define BAIL_IF_READLOCK(c, e, r) do { if (c) { if (e) PHYSFS_setErrorCode(e); releaseStateReadLock(); return r; } } while (0)
+#define BAIL_IF_READLOCK_ERRPASS(c, r) do { if (c) { releaseStateReadLock(); return r; } } while (0)
+
+
 /* this doesn't reset the error state. */
 static inline PHYSFS_ErrorCode currentErrorCode(void)
 {
@@ -760,25 +1235,9 @@ void PHYSFS_setErrorCode(PHYSFS_ErrorCode errcode)
     if (!errcode)
         return;
 
-    err = findErrorForCurrentThread();
+    err = findOrCreateErrState();
     if (err == NULL)
-    {
-        err = (ErrState *) allocator.Malloc(sizeof (ErrState));
-        if (err == NULL)
-            return;   /* uhh...? */
-
-        memset(err, '\0', sizeof (ErrState));
-        err->tid = __PHYSFS_platformGetThreadID();
-
-        if (errorLock != NULL)
-            __PHYSFS_platformGrabMutex(errorLock);
-
-        err->next = errorStates;
-        errorStates = err;
-
-        if (errorLock != NULL)
-            __PHYSFS_platformReleaseMutex(errorLock);
-    } /* if */
+        return;   /* uhh...? */
 
     err->code = errcode;
 } /* PHYSFS_setErrorCode */
@@ -804,6 +1263,12 @@ static void freeErrorStates(void)
     } /* for */
 
     errorStates = NULL;
+
+    #ifdef PHYSFS_THREAD_LOCAL
+    /* invalidate every thread's cached pointer; they'll reallocate lazily. */
+    errStateGeneration++;
+    tlsErrState = NULL;
+    #endif
 } /* freeErrorStates */
 
 
@@ -1032,1983 +1497,5077 @@ static int partOfMountPoint(DirHandle *h, char *fname)
 } /* partOfMountPoint */
 
 
-static DirHandle *createDirHandle(PHYSFS_Io *io, const char *newDir,
-                                  const char *mountPoint, int forWriting)
+/*
+ * The path index is a single hash table over every file in every mounted
+ *  archive, mapping a virtual path to the DirHandle that wins the search
+ *  path for it. With hundreds of archives mounted, openRead/stat/exists
+ *  would otherwise probe every archive for every lookup (and a miss on a
+ *  path probes _all_ of them); the index resolves either in one probe.
+ *
+ * Only archivers built on __PHYSFS_DirTree can be indexed; those all use
+ *  __PHYSFS_DirTreeEnumerate and keep the tree at the front of their opaque
+ *  data, so the core can walk their complete entry lists directly. The dir
+ *  archiver can't be indexed--the real filesystem can change behind our
+ *  back at any time--so if anything unindexable is mounted, we drop the
+ *  index and everyone takes the slow path until it's unmounted again.
+ */
+typedef struct PathIndexEntry
 {
-    DirHandle *dirHandle = NULL;
-    char *tmpmntpnt = NULL;
+    char *path;
+    DirHandle *dirHandle;
+    struct PathIndexEntry *next;
+} PathIndexEntry;
 
-    assert(newDir != NULL);  /* should have caught this higher up. */
+static PathIndexEntry **pathIndex = NULL;
+static size_t pathIndexBuckets = 0;
+static size_t pathIndexCount = 0;
+static int pathIndexAuthoritative = 0;
 
-    if (mountPoint != NULL)
-    {
-        const size_t len = strlen(mountPoint) + 1;
-        tmpmntpnt = (char *) __PHYSFS_smallAlloc(len);
-        GOTO_IF(!tmpmntpnt, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
-        if (!sanitizePlatformIndependentPath(mountPoint, tmpmntpnt))
-            goto badDirHandle;
-        mountPoint = tmpmntpnt;  /* sanitized version. */
-    } /* if */
 
-    dirHandle = openDirectory(io, newDir, forWriting);
-    GOTO_IF_ERRPASS(!dirHandle, badDirHandle);
+static __PHYSFS_DirTree *dirHandleDirTree(DirHandle *dh)
+{
+    return (dh->funcs->enumerate == __PHYSFS_DirTreeEnumerate) ?
+            (__PHYSFS_DirTree *) dh->opaque : NULL;
+} /* dirHandleDirTree */
 
-    dirHandle->dirName = (char *) allocator.Malloc(strlen(newDir) + 1);
-    GOTO_IF(!dirHandle->dirName, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
-    strcpy(dirHandle->dirName, newDir);
 
-    if ((mountPoint != NULL) && (*mountPoint != '\0'))
+/* MAKE SURE you hold stateLock exclusively before calling this! */
+static void pathIndexClear(void)
+{
+    if (pathIndex != NULL)
     {
-        dirHandle->mountPoint = (char *)allocator.Malloc(strlen(mountPoint)+2);
-        if (!dirHandle->mountPoint)
-            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
-        strcpy(dirHandle->mountPoint, mountPoint);
-        strcat(dirHandle->mountPoint, "/");
+        size_t b;
+        for (b = 0; b < pathIndexBuckets; b++)
+        {
+            PathIndexEntry *entry = pathIndex[b];
+            while (entry != NULL)
+            {
+                PathIndexEntry *next = entry->next;
+                allocator.Free(entry->path);
+                allocator.Free(entry);
+                entry = next;
+            } /* while */
+        } /* for */
+
+        allocator.Free(pathIndex);
+        pathIndex = NULL;
     } /* if */
 
-    __PHYSFS_smallFree(tmpmntpnt);
-    return dirHandle;
+    pathIndexBuckets = pathIndexCount = 0;
+    pathIndexAuthoritative = 0;
+} /* pathIndexClear */
 
-badDirHandle:
-    if (dirHandle != NULL)
+
+/* MAKE SURE you hold stateLock exclusively before calling this! */
+static int pathIndexInsert(const char *path, DirHandle *dh, const int replace)
+{
+    PHYSFS_uint32 hashval;
+    PathIndexEntry *entry;
+
+    if (pathIndexCount >= (pathIndexBuckets * 2))  /* grow the table. */
     {
-        dirHandle->funcs->closeArchive(dirHandle->opaque);
-        allocator.Free(dirHandle->dirName);
-        allocator.Free(dirHandle->mountPoint);
-        allocator.Free(dirHandle);
-    } /* if */
+        const size_t newbuckets = pathIndexBuckets ? pathIndexBuckets * 2 : 256;
+        const size_t alloclen = newbuckets * sizeof (PathIndexEntry *);
+        PathIndexEntry **newhash = (PathIndexEntry **) allocator.Malloc(alloclen);
+        size_t b;
 
-    __PHYSFS_smallFree(tmpmntpnt);
-    return NULL;
-} /* createDirHandle */
+        BAIL_IF(!newhash, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        memset(newhash, '\0', alloclen);
 
+        for (b = 0; b < pathIndexBuckets; b++)
+        {
+            entry = pathIndex[b];
+            while (entry != NULL)
+            {
+                PathIndexEntry *next = entry->next;
+                const PHYSFS_uint32 rehash = __PHYSFS_hashString(entry->path,
+                                    strlen(entry->path)) % newbuckets;
+                entry->next = newhash[rehash];
+                newhash[rehash] = entry;
+                entry = next;
+            } /* while */
+        } /* for */
 
-/* MAKE SURE you've got the stateLock held before calling this! */
-static int freeDirHandle(DirHandle *dh, FileHandle *openList)
-{
-    FileHandle *i;
+        allocator.Free(pathIndex);
+        pathIndex = newhash;
+        pathIndexBuckets = newbuckets;
+    } /* if */
 
-    if (dh == NULL)
-        return 1;
+    hashval = __PHYSFS_hashString(path, strlen(path)) % pathIndexBuckets;
+    for (entry = pathIndex[hashval]; entry != NULL; entry = entry->next)
+    {
+        if (strcmp(entry->path, path) == 0)
+        {
+            if (replace)
+                entry->dirHandle = dh;
+            return 1;  /* already indexed; the earliest mount won. */
+        } /* if */
+    } /* for */
 
-    for (i = openList; i != NULL; i = i->next)
-        BAIL_IF(i->dirHandle == dh, PHYSFS_ERR_FILES_STILL_OPEN, 0);
+    entry = (PathIndexEntry *) allocator.Malloc(sizeof (PathIndexEntry));
+    BAIL_IF(!entry, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    entry->path = __PHYSFS_strdup(path);
+    if (!entry->path)
+    {
+        allocator.Free(entry);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
 
-    dh->funcs->closeArchive(dh->opaque);
-    allocator.Free(dh->dirName);
-    allocator.Free(dh->mountPoint);
-    allocator.Free(dh);
+    entry->dirHandle = dh;
+    entry->next = pathIndex[hashval];
+    pathIndex[hashval] = entry;
+    pathIndexCount++;
     return 1;
-} /* freeDirHandle */
+} /* pathIndexInsert */
 
 
-static char *calculateBaseDir(const char *argv0)
+/* MAKE SURE you hold stateLock exclusively before calling this! */
+static int pathIndexAddDirHandle(DirHandle *dh, const int replace)
 {
-    const char dirsep = __PHYSFS_platformDirSeparator;
-    char *retval = NULL;
-    char *ptr = NULL;
-
-    /* Give the platform layer first shot at this. */
-    retval = __PHYSFS_platformCalcBaseDir(argv0);
-    if (retval != NULL)
-        return retval;
+    __PHYSFS_DirTree *tree = dirHandleDirTree(dh);
+    const size_t mntlen = dh->mountPoint ? strlen(dh->mountPoint) : 0;
+    size_t b;
 
-    /* We need argv0 to go on. */
-    BAIL_IF(argv0 == NULL, PHYSFS_ERR_ARGV0_IS_NULL, NULL);
+    if (tree == NULL)
+        return 0;  /* not indexable. */
 
-    ptr = strrchr(argv0, dirsep);
-    if (ptr != NULL)
+    /* the mount point's virtual ancestor dirs resolve to this handle too. */
+    if (mntlen > 0)
     {
-        const size_t size = ((size_t) (ptr - argv0)) + 1;
-        retval = (char *) allocator.Malloc(size + 1);
-        BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
-        memcpy(retval, argv0, size);
-        retval[size] = '\0';
-        return retval;
+        char *ptr;
+        char *mntpnt = (char *) __PHYSFS_smallAlloc(mntlen + 1);
+        BAIL_IF(!mntpnt, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        strcpy(mntpnt, dh->mountPoint);
+        for (ptr = strchr(mntpnt, '/'); ptr; ptr = strchr(ptr + 1, '/'))
+        {
+            *ptr = '\0';
+            if (!pathIndexInsert(mntpnt, dh, replace))
+            {
+                __PHYSFS_smallFree(mntpnt);
+                return 0;
+            } /* if */
+            *ptr = '/';
+        } /* for */
+        __PHYSFS_smallFree(mntpnt);
     } /* if */
 
-    /* argv0 wasn't helpful. */
-    BAIL(PHYSFS_ERR_INVALID_ARGUMENT, NULL);
-} /* calculateBaseDir */
-
+    for (b = 0; b < tree->hashBuckets; b++)
+    {
+        const __PHYSFS_DirTreeEntry *e = tree->hash[b].entry;
+        const char *name;
+        int inserted;
 
-static int initializeMutexes(void)
-{
-    errorLock = __PHYSFS_platformCreateMutex();
-    if (errorLock == NULL)
-        goto initializeMutexes_failed;
+        if (e == NULL)
+            continue;  /* empty slot. */
 
-    stateLock = __PHYSFS_platformCreateMutex();
-    if (stateLock == NULL)
-        goto initializeMutexes_failed;
+        name = e->name;
 
-    return 1;  /* success. */
+        if (dh->root)  /* only paths under the root are visible. */
+        {
+            const size_t rootlen = dh->rootlen - 1;
+            if (strncmp(name, dh->root, rootlen) != 0)
+                continue;
+            else if ((name[rootlen] != '/') && (name[rootlen] != '\0'))
+                continue;
+            name += rootlen;
+            if (*name == '/')
+                name++;
+        } /* if */
 
-initializeMutexes_failed:
-    if (errorLock != NULL)
-        __PHYSFS_platformDestroyMutex(errorLock);
+        if (*name == '\0')
+            continue;
 
-    if (stateLock != NULL)
-        __PHYSFS_platformDestroyMutex(stateLock);
+        if (mntlen > 0)
+        {
+            const size_t len = mntlen + strlen(name) + 1;
+            char *vpath = (char *) __PHYSFS_smallAlloc(len);
+            BAIL_IF(!vpath, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+            snprintf(vpath, len, "%s%s", dh->mountPoint, name);
+            inserted = pathIndexInsert(vpath, dh, replace);
+            __PHYSFS_smallFree(vpath);
+        } /* if */
+        else
+        {
+            inserted = pathIndexInsert(name, dh, replace);
+        } /* else */
 
-    errorLock = stateLock = NULL;
-    return 0;  /* failed. */
-} /* initializeMutexes */
+        if (!inserted)
+            return 0;
+    } /* for */
 
+    return 1;
+} /* pathIndexAddDirHandle */
 
-static int doRegisterArchiver(const PHYSFS_Archiver *_archiver);
 
-static int initStaticArchivers(void)
+/* MAKE SURE you hold stateLock exclusively before calling this! */
+static void pathIndexRebuild(void)
 {
-    #define REGISTER_STATIC_ARCHIVER(arc) { \
-        if (!doRegisterArchiver(&__PHYSFS_Archiver_##arc)) { \
-            return 0; \
-        } \
-    }
-
-    #if PHYSFS_SUPPORTS_ZIP
-        REGISTER_STATIC_ARCHIVER(ZIP);
-    #endif
-    #if PHYSFS_SUPPORTS_7Z
-        SZIP_global_init();
-        REGISTER_STATIC_ARCHIVER(7Z);
-    #endif
-    #if PHYSFS_SUPPORTS_GRP
-        REGISTER_STATIC_ARCHIVER(GRP);
-    #endif
-    #if PHYSFS_SUPPORTS_QPAK
-        REGISTER_STATIC_ARCHIVER(QPAK);
-    #endif
-    #if PHYSFS_SUPPORTS_HOG
-        REGISTER_STATIC_ARCHIVER(HOG);
-    #endif
-    #if PHYSFS_SUPPORTS_MVL
-        REGISTER_STATIC_ARCHIVER(MVL);
-    #endif
-    #if PHYSFS_SUPPORTS_WAD
-        REGISTER_STATIC_ARCHIVER(WAD);
-    #endif
-    #if PHYSFS_SUPPORTS_SLB
-        REGISTER_STATIC_ARCHIVER(SLB);
-    #endif
-    #if PHYSFS_SUPPORTS_ISO9660
-        REGISTER_STATIC_ARCHIVER(ISO9660);
-    #endif
-    #if PHYSFS_SUPPORTS_VDF
-        REGISTER_STATIC_ARCHIVER(VDF)
-    #endif
-
-    #undef REGISTER_STATIC_ARCHIVER
+    DirHandle *i;
 
-    return 1;
-} /* initStaticArchivers */
+    pathIndexClear();
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if (!pathIndexAddDirHandle(i, 0))
+        {
+            pathIndexClear();
+            return;  /* something isn't indexable; use the slow path. */
+        } /* if */
+    } /* for */
 
+    pathIndexAuthoritative = 1;
+} /* pathIndexRebuild */
 
-static void setDefaultAllocator(void);
-static int doDeinit(void);
 
-int PHYSFS_init(const char *argv0)
+/* MAKE SURE you hold stateLock exclusively before calling this! */
+static void pathIndexMountAdded(DirHandle *dh, const int replace)
 {
-    BAIL_IF(initialized, PHYSFS_ERR_IS_INITIALIZED, 0);
+    if ((searchPath == dh) && (dh->next == NULL))  /* the only mount? */
+        pathIndexRebuild();
+    else if (pathIndexAuthoritative && !pathIndexAddDirHandle(dh, replace))
+        pathIndexClear();
+} /* pathIndexMountAdded */
 
-    if (!externalAllocator)
-        setDefaultAllocator();
 
-    if ((allocator.Init != NULL) && (!allocator.Init())) return 0;
+/*
+ * Look up the first DirHandle that can satisfy (fname). Returns 1 if the
+ *  index had a definitive answer--in which case (*dh) is the winning
+ *  handle, or NULL if the path is in no mounted archive--or 0 if the
+ *  caller has to walk the search path itself.
+ */
+static int pathIndexLookup(const char *fname, DirHandle **dh)
+{
+    const PathIndexEntry *entry;
+    PHYSFS_uint32 hashval;
 
-    if (!__PHYSFS_platformInit())
-    {
-        if (allocator.Deinit != NULL) allocator.Deinit();
+    *dh = NULL;
+    if (!pathIndexAuthoritative)
         return 0;
-    } /* if */
-
-    /* everything below here can be cleaned up safely by doDeinit(). */
+    else if (pathIndexBuckets == 0)
+        return 1;  /* nothing is mounted. */
 
-    if (!initializeMutexes()) goto initFailed;
+    hashval = __PHYSFS_hashString(fname, strlen(fname)) % pathIndexBuckets;
+    for (entry = pathIndex[hashval]; entry != NULL; entry = entry->next)
+    {
+        if (strcmp(entry->path, fname) == 0)
+        {
+            *dh = entry->dirHandle;
+            return 1;
+        } /* if */
+    } /* for */
 
-    baseDir = calculateBaseDir(argv0);
-    if (!baseDir) goto initFailed;
+    return 1;  /* definitely not mounted anywhere. */
+} /* pathIndexLookup */
 
-    userDir = __PHYSFS_platformCalcUserDir();
-    if (!userDir) goto initFailed;
 
-    /* Platform layer is required to append a dirsep. */
-    #ifndef __ANDROID__  /* it's an APK file, not a directory, on Android. */
-    assert(baseDir[strlen(baseDir) - 1] == __PHYSFS_platformDirSeparator);
-    #endif
-    assert(userDir[strlen(userDir) - 1] == __PHYSFS_platformDirSeparator);
+/*
+ * The negative cache remembers paths that recently failed to resolve, so
+ *  apps that keep probing for optional files that don't exist skip the
+ *  search path walk on repeat lookups. It's a small direct-mapped table of
+ *  strings--new misses evict whatever hashed to the same slot--and it's
+ *  flushed outright whenever the interpolated tree can change. Off unless
+ *  the app opts in with PHYSFS_setNegativeCache().
+ */
+#define NEGATIVE_CACHE_SLOTS 256
+static char **negativeCache = NULL;  /* NULL when disabled. */
 
-    if (!initStaticArchivers()) goto initFailed;
+static void negativeCacheFlush(void)
+{
+    __PHYSFS_platformGrabMutex(negCacheLock);
+    if (negativeCache != NULL)
+    {
+        size_t i;
+        for (i = 0; i < NEGATIVE_CACHE_SLOTS; i++)
+        {
+            allocator.Free(negativeCache[i]);
+            negativeCache[i] = NULL;
+        } /* for */
+    } /* if */
+    __PHYSFS_platformReleaseMutex(negCacheLock);
+} /* negativeCacheFlush */
 
-    initialized = 1;
 
-    /* This makes sure that the error subsystem is initialized. */
-    PHYSFS_setErrorCode(PHYSFS_getLastErrorCode());
+/* Is (fname) known to be missing from every mount? */
+static int negativeCacheCheck(const char *fname)
+{
+    int retval = 0;
+    __PHYSFS_platformGrabMutex(negCacheLock);
+    if (negativeCache != NULL)
+    {
+        const PHYSFS_uint32 slot = __PHYSFS_hashString(fname,
+                                strlen(fname)) % NEGATIVE_CACHE_SLOTS;
+        const char *cached = negativeCache[slot];
+        retval = (cached != NULL) && (strcmp(cached, fname) == 0);
+    } /* if */
+    __PHYSFS_platformReleaseMutex(negCacheLock);
+    return retval;
+} /* negativeCacheCheck */
 
-    return 1;
 
-initFailed:
-    doDeinit();
-    return 0;
-} /* PHYSFS_init */
+static void negativeCacheAdd(const char *fname)
+{
+    __PHYSFS_platformGrabMutex(negCacheLock);
+    if (negativeCache != NULL)
+    {
+        const PHYSFS_uint32 slot = __PHYSFS_hashString(fname,
+                                strlen(fname)) % NEGATIVE_CACHE_SLOTS;
+        char *str = __PHYSFS_strdup(fname);
+        if (str != NULL)  /* just don't cache on OOM. */
+        {
+            allocator.Free(negativeCache[slot]);
+            negativeCache[slot] = str;
+        } /* if */
+    } /* if */
+    __PHYSFS_platformReleaseMutex(negCacheLock);
+} /* negativeCacheAdd */
 
 
-/* MAKE SURE you hold stateLock before calling this! */
-static int closeFileHandleList(FileHandle **list)
+int PHYSFS_setNegativeCache(int enable)
 {
-    FileHandle *i;
-    FileHandle *next = NULL;
+    int retval = 1;
 
-    for (i = *list; i != NULL; i = next)
-    {
-        PHYSFS_Io *io = i->io;
-        next = i->next;
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
 
-        if (io->flush && !io->flush(io))
+    __PHYSFS_platformGrabMutex(negCacheLock);
+    if (enable && (negativeCache == NULL))
+    {
+        const size_t alloclen = NEGATIVE_CACHE_SLOTS * sizeof (char *);
+        negativeCache = (char **) allocator.Malloc(alloclen);
+        if (negativeCache == NULL)
         {
-            *list = i;
-            return 0;
+            PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+            retval = 0;
         } /* if */
+        else
+        {
+            memset(negativeCache, '\0', alloclen);
+        } /* else */
+    } /* if */
+    else if (!enable && (negativeCache != NULL))
+    {
+        size_t i;
+        for (i = 0; i < NEGATIVE_CACHE_SLOTS; i++)
+            allocator.Free(negativeCache[i]);
+        allocator.Free(negativeCache);
+        negativeCache = NULL;
+    } /* else if */
+    __PHYSFS_platformReleaseMutex(negCacheLock);
 
-        io->destroy(io);
-        allocator.Free(i);
-    } /* for */
-
-    *list = NULL;
-    return 1;
-} /* closeFileHandleList */
+    return retval;
+} /* PHYSFS_setNegativeCache */
 
 
-/* MAKE SURE you hold the stateLock before calling this! */
-static void freeSearchPath(void)
+/*
+ * The content cache keeps whole decompressed files in memory, so small
+ *  config/script files that get opened dozens of times per session aren't
+ *  re-inflated from scratch on every PHYSFS_openRead(). It's keyed by
+ *  (DirHandle, path-within-archive) and bounded by a byte budget the app
+ *  sets with PHYSFS_setCacheSize(); least-recently-opened contents are
+ *  evicted when the budget overflows. Off (budget zero) unless the app
+ *  opts in. Cache hits hand back a memory PHYSFS_Io over the cached
+ *  buffer; an entry that's evicted while such an io is still open lingers
+ *  on a zombie list until the last reader closes.
+ */
+typedef struct ContentCacheEntry
 {
-    DirHandle *i;
-    DirHandle *next = NULL;
+    DirHandle *dirHandle;
+    char *fname;
+    PHYSFS_uint32 hash;
+    PHYSFS_uint8 *data;
+    PHYSFS_uint64 len;
+    int opens;    /* memory ios currently reading (data). */
+    struct ContentCacheEntry *prev;  /* LRU list, most recent first. */
+    struct ContentCacheEntry *next;
+} ContentCacheEntry;
+
+static ContentCacheEntry *contentCache = NULL;  /* LRU head. */
+static ContentCacheEntry *contentCacheTail = NULL;
+static ContentCacheEntry *contentCacheZombies = NULL;  /* evicted, still open. */
+static PHYSFS_uint64 contentCacheBudget = 0;  /* zero: cache disabled. */
+static PHYSFS_uint64 contentCacheUsed = 0;
+
+/* MAKE SURE you hold contentCacheLock before calling this! */
+static void contentCacheEvict(ContentCacheEntry *entry)
+{
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        contentCache = entry->next;
+
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        contentCacheTail = entry->prev;
 
-    closeFileHandleList(&openReadList);
+    contentCacheUsed -= entry->len;
 
-    if (searchPath != NULL)
+    if (entry->opens > 0)  /* someone's still reading; zombie it. */
     {
-        for (i = searchPath; i != NULL; i = next)
-        {
-            next = i->next;
-            freeDirHandle(i, openReadList);
-        } /* for */
-        searchPath = NULL;
+        entry->prev = NULL;
+        entry->next = contentCacheZombies;
+        contentCacheZombies = entry;
     } /* if */
-} /* freeSearchPath */
+    else
+    {
+        allocator.Free(entry->fname);
+        allocator.Free(entry->data);
+        allocator.Free(entry);
+    } /* else */
+} /* contentCacheEvict */
 
 
-/* MAKE SURE you hold stateLock before calling this! */
-static int archiverInUse(const PHYSFS_Archiver *arc, const DirHandle *list)
+/* Drop every cached file served by (dh), or everything if (dh) is NULL. */
+static void contentCachePurge(DirHandle *dh)
 {
-    const DirHandle *i;
-    for (i = list; i != NULL; i = i->next)
+    ContentCacheEntry *entry;
+    ContentCacheEntry *next;
+    __PHYSFS_platformGrabMutex(contentCacheLock);
+    for (entry = contentCache; entry != NULL; entry = next)
     {
-        if (i->funcs == arc)
-            return 1;
+        next = entry->next;
+        if ((dh == NULL) || (entry->dirHandle == dh))
+            contentCacheEvict(entry);
     } /* for */
-
-    return 0;  /* not in use */
-} /* archiverInUse */
+    __PHYSFS_platformReleaseMutex(contentCacheLock);
+} /* contentCachePurge */
 
 
-/* MAKE SURE you hold stateLock before calling this! */
-static int doDeregisterArchiver(const size_t idx)
+/* memory io destructor: the last reader of a cached buffer closed. */
+static void contentCacheIoDestruct(void *buf)
 {
-    const size_t len = (numArchivers - idx) * sizeof (void *);
-    PHYSFS_ArchiveInfo *info = archiveInfo[idx];
-    PHYSFS_Archiver *arc = archivers[idx];
-
-    /* make sure nothing is still using this archiver */
-    if (archiverInUse(arc, searchPath) || archiverInUse(arc, writeDir))
-        BAIL(PHYSFS_ERR_FILES_STILL_OPEN, 0);
+    ContentCacheEntry *entry;
+    ContentCacheEntry *prev = NULL;
 
-    allocator.Free((void *) info->extension);
-    allocator.Free((void *) info->description);
-    allocator.Free((void *) info->author);
-    allocator.Free((void *) info->url);
-    allocator.Free((void *) arc);
+    __PHYSFS_platformGrabMutex(contentCacheLock);
 
-    memmove(&archiveInfo[idx], &archiveInfo[idx+1], len);
-    memmove(&archivers[idx], &archivers[idx+1], len);
+    for (entry = contentCache; entry != NULL; entry = entry->next)
+    {
+        if (entry->data == buf)
+        {
+            entry->opens--;
+            __PHYSFS_platformReleaseMutex(contentCacheLock);
+            return;
+        } /* if */
+    } /* for */
 
-    assert(numArchivers > 0);
-    numArchivers--;
+    for (entry = contentCacheZombies; entry != NULL; entry = entry->next)
+    {
+        if (entry->data == buf)
+        {
+            if (--entry->opens == 0)
+            {
+                if (prev != NULL)
+                    prev->next = entry->next;
+                else
+                    contentCacheZombies = entry->next;
+                allocator.Free(entry->fname);
+                allocator.Free(entry->data);
+                allocator.Free(entry);
+            } /* if */
+            break;
+        } /* if */
+        prev = entry;
+    } /* for */
 
-    return 1;
-} /* doDeregisterArchiver */
+    __PHYSFS_platformReleaseMutex(contentCacheLock);
+} /* contentCacheIoDestruct */
 
 
-/* Does NOT hold the state lock; we're shutting down. */
-static void freeArchivers(void)
+/* Serve (fname) in (dh) from the cache, or return NULL on a miss. */
+static PHYSFS_Io *contentCacheOpen(DirHandle *dh, const char *fname)
 {
-    while (numArchivers > 0)
-    {
-        if (!doDeregisterArchiver(numArchivers - 1))
-            assert(!"nothing should be mounted during shutdown.");
-    } /* while */
-
-    allocator.Free(archivers);
-    allocator.Free(archiveInfo);
-    archivers = NULL;
-    archiveInfo = NULL;
-} /* freeArchivers */
-
+    PHYSFS_Io *retval = NULL;
+    ContentCacheEntry *entry;
+    PHYSFS_uint32 hash;
 
-static int doDeinit(void)
-{
-    closeFileHandleList(&openWriteList);
-    BAIL_IF(!PHYSFS_setWriteDir(NULL), PHYSFS_ERR_FILES_STILL_OPEN, 0);
+    if (contentCacheLock == NULL)
+        return NULL;
 
-    freeSearchPath();
-    freeArchivers();
-    freeErrorStates();
+    hash = __PHYSFS_hashString(fname, strlen(fname));
 
-    if (baseDir != NULL)
+    __PHYSFS_platformGrabMutex(contentCacheLock);
+    for (entry = contentCache; entry != NULL; entry = entry->next)
     {
-        allocator.Free(baseDir);
-        baseDir = NULL;
-    } /* if */
+        if ((entry->dirHandle == dh) && (entry->hash == hash) &&
+            (strcmp(entry->fname, fname) == 0))
+        {
+            if (entry != contentCache)  /* bump to the front of the LRU. */
+            {
+                entry->prev->next = entry->next;
+                if (entry->next != NULL)
+                    entry->next->prev = entry->prev;
+                else
+                    contentCacheTail = entry->prev;
+                entry->prev = NULL;
+                entry->next = contentCache;
+                contentCache->prev = entry;
+                contentCache = entry;
+            } /* if */
+            entry->opens++;
+            break;
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(contentCacheLock);
 
-    if (userDir != NULL)
+    if (entry != NULL)
     {
-        allocator.Free(userDir);
-        userDir = NULL;
+        retval = __PHYSFS_createMemoryIo(entry->data, entry->len,
+                                         contentCacheIoDestruct);
+        if (retval == NULL)  /* oh well; count the reader back out. */
+        {
+            __PHYSFS_platformGrabMutex(contentCacheLock);
+            entry->opens--;
+            __PHYSFS_platformReleaseMutex(contentCacheLock);
+        } /* if */
     } /* if */
 
-    if (prefDir != NULL)
-    {
-        allocator.Free(prefDir);
-        prefDir = NULL;
-    } /* if */
+    return retval;
+} /* contentCacheOpen */
 
-    if (archiveInfo != NULL)
-    {
-        allocator.Free(archiveInfo);
-        archiveInfo = NULL;
-    } /* if */
 
-    if (archivers != NULL)
-    {
-        allocator.Free(archivers);
-        archivers = NULL;
-    } /* if */
+/*
+ * Try to cache the contents behind a freshly-opened (io). Returns the io
+ *  the caller should hand to the app: a memory io over the now-cached
+ *  contents on success, or (io) untouched if we declined to cache. Only
+ *  returns NULL if (io) became unusable in the attempt.
+ */
+static PHYSFS_Io *contentCacheAdd(DirHandle *dh, const char *fname,
+                                  PHYSFS_Io *io)
+{
+    PHYSFS_uint64 budget;
+    PHYSFS_sint64 len;
+    PHYSFS_uint8 *data = NULL;
+    ContentCacheEntry *entry = NULL;
+    PHYSFS_Io *memio = NULL;
 
-    longest_root = 0;
-    allowSymLinks = 0;
-    initialized = 0;
+    __PHYSFS_platformGrabMutex(contentCacheLock);
+    budget = contentCacheBudget;
+    __PHYSFS_platformReleaseMutex(contentCacheLock);
 
-    if (errorLock) __PHYSFS_platformDestroyMutex(errorLock);
-    if (stateLock) __PHYSFS_platformDestroyMutex(stateLock);
+    if (budget == 0)
+        return io;  /* cache is disabled. */
 
-    if (allocator.Deinit != NULL)
-        allocator.Deinit();
+    len = io->length(io);
+    if ((len <= 0) || (((PHYSFS_uint64) len) > (budget / 4)))
+        return io;  /* unknown size, empty, or too big to be worth it. */
 
-    errorLock = stateLock = NULL;
+    data = (PHYSFS_uint8 *) allocator.Malloc((size_t) len);
+    if (data == NULL)
+        return io;  /* just don't cache on OOM. */
 
-    __PHYSFS_platformDeinit();
+    entry = (ContentCacheEntry *) allocator.Malloc(sizeof (ContentCacheEntry));
+    if (entry == NULL)
+    {
+        allocator.Free(data);
+        return io;
+    } /* if */
 
-    return 1;
-} /* doDeinit */
+    memset(entry, '\0', sizeof (ContentCacheEntry));
+    entry->fname = __PHYSFS_strdup(fname);
+    if (entry->fname == NULL)
+        goto contentCacheAdd_failed;
 
+    if (!__PHYSFS_readAll(io, data, (PHYSFS_uint64) len))
+        goto contentCacheAdd_failed;
 
-int PHYSFS_deinit(void)
-{
-    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-    return doDeinit();
-} /* PHYSFS_deinit */
+    memio = __PHYSFS_createMemoryIo(data, (PHYSFS_uint64) len,
+                                    contentCacheIoDestruct);
+    if (memio == NULL)
+        goto contentCacheAdd_failed;
 
+    entry->dirHandle = dh;
+    entry->hash = __PHYSFS_hashString(fname, strlen(fname));
+    entry->data = data;
+    entry->len = (PHYSFS_uint64) len;
+    entry->opens = 1;
 
-int PHYSFS_isInit(void)
-{
-    return initialized;
-} /* PHYSFS_isInit */
+    __PHYSFS_platformGrabMutex(contentCacheLock);
 
+    /* make room; evict least-recently-opened contents first. */
+    while ((contentCacheTail != NULL) &&
+           (contentCacheUsed + entry->len > contentCacheBudget))
+        contentCacheEvict(contentCacheTail);
 
-char *__PHYSFS_strdup(const char *str)
-{
-    char *retval = (char *) allocator.Malloc(strlen(str) + 1);
-    if (retval)
-        strcpy(retval, str);
-    return retval;
-} /* __PHYSFS_strdup */
+    if (entry->len <= contentCacheBudget)  /* budget might have shrunk. */
+    {
+        entry->next = contentCache;
+        if (contentCache != NULL)
+            contentCache->prev = entry;
+        contentCache = entry;
+        if (contentCacheTail == NULL)
+            contentCacheTail = entry;
+        contentCacheUsed += entry->len;
+    } /* if */
+    else  /* no longer fits at all; let the destructor reap it. */
+    {
+        entry->next = contentCacheZombies;
+        contentCacheZombies = entry;
+    } /* else */
 
+    __PHYSFS_platformReleaseMutex(contentCacheLock);
 
-PHYSFS_uint32 __PHYSFS_hashString(const char *str, size_t len)
-{
-    PHYSFS_uint32 hash = 5381;
-    while (len--)
-        hash = ((hash << 5) + hash) ^ *(str++);
-    return hash;
-} /* __PHYSFS_hashString */
+    io->destroy(io);  /* readers use the cached copy from here on. */
+    return memio;
 
+contentCacheAdd_failed:
+    allocator.Free(entry->fname);
+    allocator.Free(entry);
+    allocator.Free(data);
+    if (!io->seek(io, 0))  /* rewind so the caller gets a fresh io. */
+    {
+        io->destroy(io);
+        return NULL;
+    } /* if */
+    return io;
+} /* contentCacheAdd */
 
-/* MAKE SURE you hold stateLock before calling this! */
-static int doRegisterArchiver(const PHYSFS_Archiver *_archiver)
+
+int PHYSFS_setCacheSize(PHYSFS_uint64 cachesize)
 {
-    const PHYSFS_uint32 maxver = CURRENT_PHYSFS_ARCHIVER_API_VERSION;
-    const size_t len = (numArchivers + 2) * sizeof (void *);
-    PHYSFS_Archiver *archiver = NULL;
-    PHYSFS_ArchiveInfo *info = NULL;
-    const char *ext = NULL;
-    void *ptr = NULL;
-    size_t i;
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
 
-    BAIL_IF(!_archiver, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(_archiver->version > maxver, PHYSFS_ERR_UNSUPPORTED, 0);
-    BAIL_IF(!_archiver->info.extension, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->info.description, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->info.author, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->info.url, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->openArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->enumerate, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->openRead, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->openWrite, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->openAppend, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->remove, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->mkdir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->closeArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!_archiver->stat, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    __PHYSFS_platformGrabMutex(contentCacheLock);
+    contentCacheBudget = cachesize;
+    while ((contentCacheUsed > contentCacheBudget) &&
+           (contentCacheTail != NULL))
+        contentCacheEvict(contentCacheTail);
+    __PHYSFS_platformReleaseMutex(contentCacheLock);
 
-    ext = _archiver->info.extension;
-    for (i = 0; i < numArchivers; i++)
-    {
-        if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
-            BAIL(PHYSFS_ERR_DUPLICATE, 0);
-    } /* for */
+    return 1;
+} /* PHYSFS_setCacheSize */
 
-    /* make a copy of the data. */
-    archiver = (PHYSFS_Archiver *) allocator.Malloc(sizeof (*archiver));
-    GOTO_IF(!archiver, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
 
-    /* Must copy sizeof (OLD_VERSION_OF_STRUCT) when version changes! */
-    memcpy(archiver, _archiver, sizeof (*archiver));
+static DirHandle *createDirHandle(PHYSFS_Io *io, const char *newDir,
+                                  const char *mountPoint, int forWriting)
+{
+    DirHandle *dirHandle = NULL;
+    char *tmpmntpnt = NULL;
 
-    info = (PHYSFS_ArchiveInfo *) &archiver->info;
-    memset(info, '\0', sizeof (*info));  /* NULL in case an alloc fails. */
-    #define CPYSTR(item) \
-        info->item = __PHYSFS_strdup(_archiver->info.item); \
-        GOTO_IF(!info->item, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
-    CPYSTR(extension);
-    CPYSTR(description);
-    CPYSTR(author);
-    CPYSTR(url);
-    info->supportsSymlinks = _archiver->info.supportsSymlinks;
-    #undef CPYSTR
+    assert(newDir != NULL);  /* should have caught this higher up. */
 
-    ptr = allocator.Realloc(archiveInfo, len);
-    GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
-    archiveInfo = (PHYSFS_ArchiveInfo **) ptr;
+    if (mountPoint != NULL)
+    {
+        const size_t len = strlen(mountPoint) + 1;
+        tmpmntpnt = (char *) __PHYSFS_smallAlloc(len);
+        GOTO_IF(!tmpmntpnt, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
+        if (!sanitizePlatformIndependentPath(mountPoint, tmpmntpnt))
+            goto badDirHandle;
+        mountPoint = tmpmntpnt;  /* sanitized version. */
+    } /* if */
 
-    ptr = allocator.Realloc(archivers, len);
-    GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
-    archivers = (PHYSFS_Archiver **) ptr;
+    dirHandle = openDirectory(io, newDir, forWriting);
+    GOTO_IF_ERRPASS(!dirHandle, badDirHandle);
 
-    archiveInfo[numArchivers] = info;
-    archiveInfo[numArchivers + 1] = NULL;
+    dirHandle->handleLock = __PHYSFS_platformCreateMutex();
+    GOTO_IF_ERRPASS(!dirHandle->handleLock, badDirHandle);
 
-    archivers[numArchivers] = archiver;
-    archivers[numArchivers + 1] = NULL;
+    dirHandle->dirName = (char *) allocator.Malloc(strlen(newDir) + 1);
+    GOTO_IF(!dirHandle->dirName, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
+    strcpy(dirHandle->dirName, newDir);
 
-    numArchivers++;
+    if ((mountPoint != NULL) && (*mountPoint != '\0'))
+    {
+        dirHandle->mountPoint = (char *)allocator.Malloc(strlen(mountPoint)+2);
+        if (!dirHandle->mountPoint)
+            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
+        strcpy(dirHandle->mountPoint, mountPoint);
+        strcat(dirHandle->mountPoint, "/");
+    } /* if */
 
-    return 1;
+    __PHYSFS_smallFree(tmpmntpnt);
+    return dirHandle;
 
-regfailed:
-    if (info != NULL)
+badDirHandle:
+    if (dirHandle != NULL)
     {
-        allocator.Free((void *) info->extension);
-        allocator.Free((void *) info->description);
-        allocator.Free((void *) info->author);
-        allocator.Free((void *) info->url);
+        dirHandle->funcs->closeArchive(dirHandle->opaque);
+        if (dirHandle->handleLock != NULL)
+            __PHYSFS_platformDestroyMutex(dirHandle->handleLock);
+        allocator.Free(dirHandle->dirName);
+        allocator.Free(dirHandle->mountPoint);
+        allocator.Free(dirHandle);
     } /* if */
-    allocator.Free(archiver);
 
-    return 0;
-} /* doRegisterArchiver */
+    __PHYSFS_smallFree(tmpmntpnt);
+    return NULL;
+} /* createDirHandle */
 
 
-int PHYSFS_registerArchiver(const PHYSFS_Archiver *archiver)
+/* MAKE SURE you've got the stateLock held before calling this! */
+static int freeDirHandle(DirHandle *dh)
 {
-    int retval;
-    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-    __PHYSFS_platformGrabMutex(stateLock);
-    retval = doRegisterArchiver(archiver);
-    __PHYSFS_platformReleaseMutex(stateLock);
-    return retval;
-} /* PHYSFS_registerArchiver */
-
+    int stillOpen;
 
-int PHYSFS_deregisterArchiver(const char *ext)
-{
-    size_t i;
+    if (dh == NULL)
+        return 1;
 
-    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-    BAIL_IF(!ext, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    __PHYSFS_platformGrabMutex(dh->handleLock);
+    stillOpen = (dh->openHandles != NULL);
+    __PHYSFS_platformReleaseMutex(dh->handleLock);
+    BAIL_IF(stillOpen, PHYSFS_ERR_FILES_STILL_OPEN, 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    for (i = 0; i < numArchivers; i++)
-    {
-        if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
-        {
-            const int retval = doDeregisterArchiver(i);
-            __PHYSFS_platformReleaseMutex(stateLock);
-            return retval;
-        } /* if */
-    } /* for */
-    __PHYSFS_platformReleaseMutex(stateLock);
+    contentCachePurge(dh);  /* drop any contents cached from this mount. */
 
-    BAIL(PHYSFS_ERR_NOT_FOUND, 0);
-} /* PHYSFS_deregisterArchiver */
+    dh->funcs->closeArchive(dh->opaque);
+    __PHYSFS_platformDestroyMutex(dh->handleLock);
+    allocator.Free(dh->dirName);
+    allocator.Free(dh->mountPoint);
+    allocator.Free(dh);
+    return 1;
+} /* freeDirHandle */
 
 
-const PHYSFS_ArchiveInfo **PHYSFS_supportedArchiveTypes(void)
+static char *calculateBaseDir(const char *argv0)
 {
-    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, NULL);
-    return (const PHYSFS_ArchiveInfo **) archiveInfo;
-} /* PHYSFS_supportedArchiveTypes */
+    const char dirsep = __PHYSFS_platformDirSeparator;
+    char *retval = NULL;
+    char *ptr = NULL;
 
+    /* Give the platform layer first shot at this. */
+    retval = __PHYSFS_platformCalcBaseDir(argv0);
+    if (retval != NULL)
+        return retval;
 
-void PHYSFS_freeList(void *list)
-{
-    void **i;
-    if (list != NULL)
-    {
-        for (i = (void **) list; *i != NULL; i++)
-            allocator.Free(*i);
+    /* We need argv0 to go on. */
+    BAIL_IF(argv0 == NULL, PHYSFS_ERR_ARGV0_IS_NULL, NULL);
 
-        allocator.Free(list);
+    ptr = strrchr(argv0, dirsep);
+    if (ptr != NULL)
+    {
+        const size_t size = ((size_t) (ptr - argv0)) + 1;
+        retval = (char *) allocator.Malloc(size + 1);
+        BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        memcpy(retval, argv0, size);
+        retval[size] = '\0';
+        return retval;
     } /* if */
-} /* PHYSFS_freeList */
 
-
-const char *PHYSFS_getDirSeparator(void)
-{
-    static char retval[2] = { __PHYSFS_platformDirSeparator, '\0' };
-    return retval;
-} /* PHYSFS_getDirSeparator */
+    /* argv0 wasn't helpful. */
+    BAIL(PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+} /* calculateBaseDir */
 
 
-char **PHYSFS_getCdRomDirs(void)
+static int initializeMutexes(void)
 {
-    return doEnumStringList(__PHYSFS_platformDetectAvailableCDs);
-} /* PHYSFS_getCdRomDirs */
+    errorLock = __PHYSFS_platformCreateMutex();
+    if (errorLock == NULL)
+        goto initializeMutexes_failed;
 
+    stateLock = __PHYSFS_platformCreateMutex();
+    if (stateLock == NULL)
+        goto initializeMutexes_failed;
 
-void PHYSFS_getCdRomDirsCallback(PHYSFS_StringCallback callback, void *data)
-{
-    __PHYSFS_platformDetectAvailableCDs(callback, data);
-} /* PHYSFS_getCdRomDirsCallback */
+    readCountLock = __PHYSFS_platformCreateMutex();
+    if (readCountLock == NULL)
+        goto initializeMutexes_failed;
 
+    writerDrainSem = __PHYSFS_platformCreateSemaphore();
+    if (writerDrainSem == NULL)
+        goto initializeMutexes_failed;
 
-const char *PHYSFS_getPrefDir(const char *org, const char *app)
-{
-    const char dirsep = __PHYSFS_platformDirSeparator;
-    PHYSFS_Stat statbuf;
-    char *ptr = NULL;
-    char *endstr = NULL;
+    negCacheLock = __PHYSFS_platformCreateMutex();
+    if (negCacheLock == NULL)
+        goto initializeMutexes_failed;
 
-    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-    BAIL_IF(!org, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
-    BAIL_IF(*org == '\0', PHYSFS_ERR_INVALID_ARGUMENT, NULL);
-    BAIL_IF(!app, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
-    BAIL_IF(*app == '\0', PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    contentCacheLock = __PHYSFS_platformCreateMutex();
+    if (contentCacheLock == NULL)
+        goto initializeMutexes_failed;
 
-    allocator.Free(prefDir);
-    prefDir = __PHYSFS_platformCalcPrefDir(org, app);
-    BAIL_IF_ERRPASS(!prefDir, NULL);
+    asyncLock = __PHYSFS_platformCreateMutex();
+    if (asyncLock == NULL)
+        goto initializeMutexes_failed;
 
-    assert(strlen(prefDir) > 0);
-    endstr = prefDir + (strlen(prefDir) - 1);
-    assert(*endstr == dirsep);
-    *endstr = '\0';  /* mask out the final dirsep for now. */
+    return 1;  /* success. */
 
-    if (!__PHYSFS_platformStat(prefDir, &statbuf, 1))
-    {
-        for (ptr = strchr(prefDir, dirsep); ptr; ptr = strchr(ptr+1, dirsep))
-        {
-            *ptr = '\0';
-            __PHYSFS_platformMkDir(prefDir);
-            *ptr = dirsep;
-        } /* for */
+initializeMutexes_failed:
+    if (errorLock != NULL)
+        __PHYSFS_platformDestroyMutex(errorLock);
 
-        if (!__PHYSFS_platformMkDir(prefDir))
-        {
-            allocator.Free(prefDir);
-            prefDir = NULL;
-        } /* if */
-    } /* if */
+    if (stateLock != NULL)
+        __PHYSFS_platformDestroyMutex(stateLock);
 
-    *endstr = dirsep;  /* readd the final dirsep. */
+    if (readCountLock != NULL)
+        __PHYSFS_platformDestroyMutex(readCountLock);
 
-    return prefDir;
-} /* PHYSFS_getPrefDir */
+    if (writerDrainSem != NULL)
+        __PHYSFS_platformDestroySemaphore(writerDrainSem);
 
+    if (negCacheLock != NULL)
+        __PHYSFS_platformDestroyMutex(negCacheLock);
 
-const char *PHYSFS_getBaseDir(void)
-{
-    return baseDir;   /* this is calculated in PHYSFS_init()... */
-} /* PHYSFS_getBaseDir */
+    if (contentCacheLock != NULL)
+        __PHYSFS_platformDestroyMutex(contentCacheLock);
 
+    if (asyncLock != NULL)
+        __PHYSFS_platformDestroyMutex(asyncLock);
 
-const char *__PHYSFS_getUserDir(void)  /* not deprecated internal version. */
-{
-    return userDir;   /* this is calculated in PHYSFS_init()... */
-} /* __PHYSFS_getUserDir */
+    errorLock = stateLock = readCountLock = negCacheLock = NULL;
+    contentCacheLock = asyncLock = writerDrainSem = NULL;
+    return 0;  /* failed. */
+} /* initializeMutexes */
 
 
-const char *PHYSFS_getUserDir(void)
+static int doRegisterArchiver(const PHYSFS_Archiver *_archiver);
+
+static int initStaticArchivers(void)
 {
-    return __PHYSFS_getUserDir();
-} /* PHYSFS_getUserDir */
+    #define REGISTER_STATIC_ARCHIVER(arc) { \
+        if (!doRegisterArchiver(&__PHYSFS_Archiver_##arc)) { \
+            return 0; \
+        } \
+    }
 
+    #if PHYSFS_SUPPORTS_ZIP
+        REGISTER_STATIC_ARCHIVER(ZIP);
+    #endif
+    #if PHYSFS_SUPPORTS_7Z
+        SZIP_global_init();
+        REGISTER_STATIC_ARCHIVER(7Z);
+    #endif
+    #if PHYSFS_SUPPORTS_GRP
+        REGISTER_STATIC_ARCHIVER(GRP);
+    #endif
+    #if PHYSFS_SUPPORTS_QPAK
+        REGISTER_STATIC_ARCHIVER(QPAK);
+    #endif
+    #if PHYSFS_SUPPORTS_HOG
+        REGISTER_STATIC_ARCHIVER(HOG);
+    #endif
+    #if PHYSFS_SUPPORTS_MVL
+        REGISTER_STATIC_ARCHIVER(MVL);
+    #endif
+    #if PHYSFS_SUPPORTS_WAD
+        REGISTER_STATIC_ARCHIVER(WAD);
+    #endif
+    #if PHYSFS_SUPPORTS_SLB
+        REGISTER_STATIC_ARCHIVER(SLB);
+    #endif
+    #if PHYSFS_SUPPORTS_ISO9660
+        REGISTER_STATIC_ARCHIVER(ISO9660);
+    #endif
+    #if PHYSFS_SUPPORTS_VDF
+        REGISTER_STATIC_ARCHIVER(VDF)
+    #endif
 
-const char *PHYSFS_getWriteDir(void)
-{
-    const char *retval = NULL;
+    #undef REGISTER_STATIC_ARCHIVER
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    if (writeDir != NULL)
-        retval = writeDir->dirName;
-    __PHYSFS_platformReleaseMutex(stateLock);
+    return 1;
+} /* initStaticArchivers */
 
-    return retval;
-} /* PHYSFS_getWriteDir */
 
+static void setDefaultAllocator(void);
+static int doDeinit(void);
 
-int PHYSFS_setWriteDir(const char *newDir)
+int PHYSFS_init(const char *argv0)
 {
-    int retval = 1;
+    BAIL_IF(initialized, PHYSFS_ERR_IS_INITIALIZED, 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    if (!externalAllocator)
+        setDefaultAllocator();
 
-    if (writeDir != NULL)
-    {
-        BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(writeDir, openWriteList),
-                            stateLock, 0);
-        writeDir = NULL;
-    } /* if */
+    if ((allocator.Init != NULL) && (!allocator.Init())) return 0;
 
-    if (newDir != NULL)
+    if (!__PHYSFS_platformInit())
     {
-        writeDir = createDirHandle(NULL, newDir, NULL, 1);
-        retval = (writeDir != NULL);
+        if (allocator.Deinit != NULL) allocator.Deinit();
+        return 0;
     } /* if */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+    /* everything below here can be cleaned up safely by doDeinit(). */
 
-    return retval;
-} /* PHYSFS_setWriteDir */
+    if (!initializeMutexes()) goto initFailed;
 
+    baseDir = calculateBaseDir(argv0);
+    if (!baseDir) goto initFailed;
 
-int PHYSFS_setRoot(const char *archive, const char *subdir)
-{
-    DirHandle *i;
+    userDir = __PHYSFS_platformCalcUserDir();
+    if (!userDir) goto initFailed;
 
-    BAIL_IF(!archive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    /* Platform layer is required to append a dirsep. */
+    #ifndef __ANDROID__  /* it's an APK file, not a directory, on Android. */
+    assert(baseDir[strlen(baseDir) - 1] == __PHYSFS_platformDirSeparator);
+    #endif
+    assert(userDir[strlen(userDir) - 1] == __PHYSFS_platformDirSeparator);
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_crc32Init();
 
-    for (i = searchPath; i != NULL; i = i->next)
-    {
-        if ((i->dirName != NULL) && (strcmp(archive, i->dirName) == 0))
-        {
-            if (!subdir || (strcmp(subdir, "/") == 0))
-            {
-                if (i->root)
-                    allocator.Free(i->root);
-                i->root = NULL;
-                i->rootlen = 0;
-            } /* if */
-            else
-            {
-                const size_t len = strlen(subdir) + 1;
-                char *ptr = (char *) allocator.Malloc(len);
-                BAIL_IF_MUTEX(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-                if (!sanitizePlatformIndependentPath(subdir, ptr))
-                {
-                    allocator.Free(ptr);
-                    BAIL_MUTEX_ERRPASS(stateLock, 0);
-                } /* if */
+    if (!initStaticArchivers()) goto initFailed;
 
-                if (i->root)
-                    allocator.Free(i->root);
-                i->root = ptr;
-                i->rootlen = len;
+#ifndef PHYSFS_NO_STATS
+    memset(&__PHYSFS_stats, '\0', sizeof (__PHYSFS_stats));
+#endif
 
-                if (longest_root < len)
-                    longest_root = len;
-            } /* else */
+    initialized = 1;
 
-            break;
-        } /* if */
-    } /* for */
+    /* This makes sure that the error subsystem is initialized. */
+    PHYSFS_setErrorCode(PHYSFS_getLastErrorCode());
 
-    __PHYSFS_platformReleaseMutex(stateLock);
     return 1;
-} /* PHYSFS_setRoot */
 
+initFailed:
+    doDeinit();
+    return 0;
+} /* PHYSFS_init */
 
-static int doMount(PHYSFS_Io *io, const char *fname,
-                   const char *mountPoint, int appendToPath)
-{
-    DirHandle *dh;
-    DirHandle *prev = NULL;
-    DirHandle *i;
-
-    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    if (mountPoint == NULL)
-        mountPoint = "/";
+/* Force-close anything still open on (dh). MAKE SURE you hold stateLock
+   before calling this! */
+static int closeFileHandleList(DirHandle *dh)
+{
+    FileHandle *i;
+    FileHandle *next = NULL;
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    if (dh == NULL)
+        return 1;
 
-    for (i = searchPath; i != NULL; i = i->next)
+    for (i = dh->openHandles; i != NULL; i = next)
     {
-        /* already in search path? */
-        if ((i->dirName != NULL) && (strcmp(fname, i->dirName) == 0))
-            BAIL_MUTEX_ERRPASS(stateLock, 1);
-        prev = i;
-    } /* for */
-
-    dh = createDirHandle(io, fname, mountPoint, 0);
-    BAIL_IF_MUTEX_ERRPASS(!dh, stateLock, 0);
+        PHYSFS_Io *io = i->io;
+        next = i->next;
 
-    if (appendToPath)
-    {
-        if (prev == NULL)
-            searchPath = dh;
-        else
-            prev->next = dh;
-    } /* if */
-    else
-    {
-        dh->next = searchPath;
-        searchPath = dh;
-    } /* else */
+        if (io->flush && !io->flush(io))
+        {
+            dh->openHandles = i;
+            i->prev = NULL;
+            return 0;
+        } /* if */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+        io->destroy(io);
+        allocator.Free(i);
+    } /* for */
+
+    dh->openHandles = NULL;
     return 1;
-} /* doMount */
+} /* closeFileHandleList */
 
 
-int PHYSFS_mountIo(PHYSFS_Io *io, const char *fname,
-                   const char *mountPoint, int appendToPath)
+/* MAKE SURE you hold the stateLock before calling this! */
+static void freeSearchPath(void)
 {
-    BAIL_IF(!io, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(io->version != 0, PHYSFS_ERR_UNSUPPORTED, 0);
-    return doMount(io, fname, mountPoint, appendToPath);
-} /* PHYSFS_mountIo */
+    DirHandle *i;
+    DirHandle *next = NULL;
 
+    pathIndexClear();
 
-int PHYSFS_mountMemory(const void *buf, PHYSFS_uint64 len, void (*del)(void *),
-                       const char *fname, const char *mountPoint,
-                       int appendToPath)
-{
-    int retval = 0;
-    PHYSFS_Io *io = NULL;
+    if (searchPath != NULL)
+    {
+        for (i = searchPath; i != NULL; i = next)
+        {
+            next = i->next;
+            closeFileHandleList(i);
+            freeDirHandle(i);
+        } /* for */
+        searchPath = NULL;
+    } /* if */
+} /* freeSearchPath */
 
-    BAIL_IF(!buf, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    io = __PHYSFS_createMemoryIo(buf, len, del);
-    BAIL_IF_ERRPASS(!io, 0);
-    retval = doMount(io, fname, mountPoint, appendToPath);
-    if (!retval)
+/* MAKE SURE you hold stateLock before calling this! */
+static int archiverInUse(const PHYSFS_Archiver *arc, const DirHandle *list)
+{
+    const DirHandle *i;
+    for (i = list; i != NULL; i = i->next)
     {
-        /* docs say not to call (del) in case of failure, so cheat. */
-        MemoryIoInfo *info = (MemoryIoInfo *) io->opaque;
-        info->destruct = NULL;
-        io->destroy(io);
-    } /* if */
+        if (i->funcs == arc)
+            return 1;
+    } /* for */
 
-    return retval;
-} /* PHYSFS_mountMemory */
+    return 0;  /* not in use */
+} /* archiverInUse */
 
 
-int PHYSFS_mountHandle(PHYSFS_File *file, const char *fname,
-                       const char *mountPoint, int appendToPath)
+/* MAKE SURE you hold stateLock before calling this! */
+static int doDeregisterArchiver(const size_t idx)
 {
-    int retval = 0;
-    PHYSFS_Io *io = NULL;
+    const size_t len = (numArchivers - idx) * sizeof (void *);
+    PHYSFS_ArchiveInfo *info = archiveInfo[idx];
+    PHYSFS_Archiver *arc = archivers[idx];
 
-    BAIL_IF(!file, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    /* make sure nothing is still using this archiver */
+    if (archiverInUse(arc, searchPath) || archiverInUse(arc, writeDir))
+        BAIL(PHYSFS_ERR_FILES_STILL_OPEN, 0);
 
-    io = __PHYSFS_createHandleIo(file);
-    BAIL_IF_ERRPASS(!io, 0);
-    retval = doMount(io, fname, mountPoint, appendToPath);
-    if (!retval)
-    {
-        /* docs say not to destruct in case of failure, so cheat. */
-        io->opaque = NULL;
-        io->destroy(io);
-    } /* if */
+    allocator.Free((void *) info->extension);
+    allocator.Free((void *) info->description);
+    allocator.Free((void *) info->author);
+    allocator.Free((void *) info->url);
+    allocator.Free((void *) arc);
 
-    return retval;
-} /* PHYSFS_mountHandle */
+    memmove(&archiveInfo[idx], &archiveInfo[idx+1], len);
+    memmove(&archivers[idx], &archivers[idx+1], len);
 
+    assert(numArchivers > 0);
+    numArchivers--;
 
-int PHYSFS_mount(const char *newDir, const char *mountPoint, int appendToPath)
-{
-    BAIL_IF(!newDir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    return doMount(NULL, newDir, mountPoint, appendToPath);
-} /* PHYSFS_mount */
+    return 1;
+} /* doDeregisterArchiver */
 
 
-int PHYSFS_addToSearchPath(const char *newDir, int appendToPath)
+/* Does NOT hold the state lock; we're shutting down. */
+static void freeArchivers(void)
 {
-    return PHYSFS_mount(newDir, NULL, appendToPath);
-} /* PHYSFS_addToSearchPath */
+    while (numArchivers > 0)
+    {
+        if (!doDeregisterArchiver(numArchivers - 1))
+            assert(!"nothing should be mounted during shutdown.");
+    } /* while */
 
+    allocator.Free(archivers);
+    allocator.Free(archiveInfo);
+    archivers = NULL;
+    archiveInfo = NULL;
+} /* freeArchivers */
 
-int PHYSFS_removeFromSearchPath(const char *oldDir)
-{
-    return PHYSFS_unmount(oldDir);
-} /* PHYSFS_removeFromSearchPath */
 
+static void shutdownAsyncReads(void);
 
-int PHYSFS_unmount(const char *oldDir)
+static int doDeinit(void)
 {
-    DirHandle *i;
-    DirHandle *prev = NULL;
-    DirHandle *next = NULL;
+    shutdownAsyncReads();  /* must happen before file handles close. */
 
-    BAIL_IF(oldDir == NULL, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    closeFileHandleList(writeDir);
+    BAIL_IF(!PHYSFS_setWriteDir(NULL), PHYSFS_ERR_FILES_STILL_OPEN, 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    for (i = searchPath; i != NULL; i = i->next)
+    freeSearchPath();
+    freeArchivers();
+    freeErrorStates();
+
+    if (baseDir != NULL)
     {
-        if (strcmp(i->dirName, oldDir) == 0)
-        {
-            next = i->next;
-            BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(i, openReadList),
-                                stateLock, 0);
+        allocator.Free(baseDir);
+        baseDir = NULL;
+    } /* if */
 
-            if (prev == NULL)
-                searchPath = next;
-            else
-                prev->next = next;
+    if (userDir != NULL)
+    {
+        allocator.Free(userDir);
+        userDir = NULL;
+    } /* if */
 
-            BAIL_MUTEX_ERRPASS(stateLock, 1);
-        } /* if */
-        prev = i;
-    } /* for */
+    if (prefDir != NULL)
+    {
+        allocator.Free(prefDir);
+        prefDir = NULL;
+    } /* if */
 
-    BAIL_MUTEX(PHYSFS_ERR_NOT_MOUNTED, stateLock, 0);
-} /* PHYSFS_unmount */
+    if (archiveInfo != NULL)
+    {
+        allocator.Free(archiveInfo);
+        archiveInfo = NULL;
+    } /* if */
 
+    if (archivers != NULL)
+    {
+        allocator.Free(archivers);
+        archivers = NULL;
+    } /* if */
 
-char **PHYSFS_getSearchPath(void)
-{
-    return doEnumStringList(PHYSFS_getSearchPathCallback);
-} /* PHYSFS_getSearchPath */
+    if (negativeCache != NULL)
+    {
+        size_t i;
+        for (i = 0; i < NEGATIVE_CACHE_SLOTS; i++)
+            allocator.Free(negativeCache[i]);
+        allocator.Free(negativeCache);
+        negativeCache = NULL;
+    } /* if */
 
+    /* handles are closed by now, so there are no zombies to wait out. */
+    contentCachePurge(NULL);
+    assert(contentCacheZombies == NULL);
+    contentCacheBudget = 0;
+    contentCacheUsed = 0;
 
-const char *PHYSFS_getMountPoint(const char *dir)
-{
-    DirHandle *i;
-    __PHYSFS_platformGrabMutex(stateLock);
-    for (i = searchPath; i != NULL; i = i->next)
-    {
-        if (strcmp(i->dirName, dir) == 0)
-        {
-            const char *retval = ((i->mountPoint) ? i->mountPoint : "/");
-            __PHYSFS_platformReleaseMutex(stateLock);
-            return retval;
-        } /* if */
-    } /* for */
-    __PHYSFS_platformReleaseMutex(stateLock);
+    longest_root = 0;
+    allowSymLinks = 0;
+    initialized = 0;
 
-    BAIL(PHYSFS_ERR_NOT_MOUNTED, NULL);
-} /* PHYSFS_getMountPoint */
+    if (errorLock) __PHYSFS_platformDestroyMutex(errorLock);
+    if (stateLock) __PHYSFS_platformDestroyMutex(stateLock);
+    if (readCountLock) __PHYSFS_platformDestroyMutex(readCountLock);
+    if (negCacheLock) __PHYSFS_platformDestroyMutex(negCacheLock);
+    if (contentCacheLock) __PHYSFS_platformDestroyMutex(contentCacheLock);
+    if (asyncLock) __PHYSFS_platformDestroyMutex(asyncLock);
+    if (writerDrainSem) __PHYSFS_platformDestroySemaphore(writerDrainSem);
+
+    if (allocator.Deinit != NULL)
+        allocator.Deinit();
 
+    errorLock = stateLock = readCountLock = negCacheLock = NULL;
+    contentCacheLock = asyncLock = writerDrainSem = NULL;
+    writerWaiting = 0;
+    stateReaders = 0;
 
-void PHYSFS_getSearchPathCallback(PHYSFS_StringCallback callback, void *data)
-{
-    DirHandle *i;
+    __PHYSFS_platformDeinit();
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    return 1;
+} /* doDeinit */
 
-    for (i = searchPath; i != NULL; i = i->next)
-        callback(data, i->dirName);
 
-    __PHYSFS_platformReleaseMutex(stateLock);
-} /* PHYSFS_getSearchPathCallback */
+int PHYSFS_deinit(void)
+{
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    return doDeinit();
+} /* PHYSFS_deinit */
 
 
-typedef struct setSaneCfgEnumData
+int PHYSFS_isInit(void)
 {
-    const char *archiveExt;
-    size_t archiveExtLen;
-    int archivesFirst;
-    PHYSFS_ErrorCode errcode;
-} setSaneCfgEnumData;
+    return initialized;
+} /* PHYSFS_isInit */
 
-static PHYSFS_EnumerateCallbackResult setSaneCfgEnumCallback(void *_data,
-                                                const char *dir, const char *f)
+
+char *__PHYSFS_strdup(const char *str)
 {
-    setSaneCfgEnumData *data = (setSaneCfgEnumData *) _data;
-    const size_t extlen = data->archiveExtLen;
-    const size_t l = strlen(f);
-    const char *ext;
+    char *retval = (char *) allocator.Malloc(strlen(str) + 1);
+    if (retval)
+        strcpy(retval, str);
+    return retval;
+} /* __PHYSFS_strdup */
 
-    if ((l > extlen) && (f[l - extlen - 1] == '.'))
-    {
-        ext = f + (l - extlen);
-        if (PHYSFS_utf8stricmp(ext, data->archiveExt) == 0)
-        {
-            const char dirsep = __PHYSFS_platformDirSeparator;
-            const char *d = PHYSFS_getRealDir(f);
-            const size_t allocsize = strlen(d) + l + 2;
+
+PHYSFS_uint32 __PHYSFS_hashString(const char *str, size_t len)
+{
+    PHYSFS_uint32 hash = 5381;
+    while (len--)
+        hash = ((hash << 5) + hash) ^ *(str++);
+    return hash;
+} /* __PHYSFS_hashString */
+
+
+/* MAKE SURE you hold stateLock before calling this! */
+static int doRegisterArchiver(const PHYSFS_Archiver *_archiver)
+{
+    const PHYSFS_uint32 maxver = CURRENT_PHYSFS_ARCHIVER_API_VERSION;
+    const size_t len = (numArchivers + 2) * sizeof (void *);
+    PHYSFS_Archiver *archiver = NULL;
+    PHYSFS_ArchiveInfo *info = NULL;
+    const char *ext = NULL;
+    void *ptr = NULL;
+    size_t i;
+
+    BAIL_IF(!_archiver, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(_archiver->version > maxver, PHYSFS_ERR_UNSUPPORTED, 0);
+    BAIL_IF(!_archiver->info.extension, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->info.description, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->info.author, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->info.url, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->openArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->enumerate, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->openRead, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->openWrite, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->openAppend, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->remove, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->mkdir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->closeArchive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!_archiver->stat, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    ext = _archiver->info.extension;
+    for (i = 0; i < numArchivers; i++)
+    {
+        if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
+            BAIL(PHYSFS_ERR_DUPLICATE, 0);
+    } /* for */
+
+    /* make a copy of the data. */
+    archiver = (PHYSFS_Archiver *) allocator.Malloc(sizeof (*archiver));
+    GOTO_IF(!archiver, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
+
+    /* Must copy sizeof (OLD_VERSION_OF_STRUCT) when version changes! */
+    memset(archiver, '\0', sizeof (*archiver));
+    if (_archiver->version == 0)  /* no optional fields yet. */
+        memcpy(archiver, _archiver,
+               sizeof (*archiver) - sizeof (archiver->enumerateWithStat)
+                                  - sizeof (archiver->correctCase));
+    else if (_archiver->version == 1)  /* no correctCase field yet. */
+        memcpy(archiver, _archiver,
+               sizeof (*archiver) - sizeof (archiver->correctCase));
+    else
+        memcpy(archiver, _archiver, sizeof (*archiver));
+
+    info = (PHYSFS_ArchiveInfo *) &archiver->info;
+    memset(info, '\0', sizeof (*info));  /* NULL in case an alloc fails. */
+    #define CPYSTR(item) \
+        info->item = __PHYSFS_strdup(_archiver->info.item); \
+        GOTO_IF(!info->item, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
+    CPYSTR(extension);
+    CPYSTR(description);
+    CPYSTR(author);
+    CPYSTR(url);
+    info->supportsSymlinks = _archiver->info.supportsSymlinks;
+    #undef CPYSTR
+
+    ptr = allocator.Realloc(archiveInfo, len);
+    GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
+    archiveInfo = (PHYSFS_ArchiveInfo **) ptr;
+
+    ptr = allocator.Realloc(archivers, len);
+    GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, regfailed);
+    archivers = (PHYSFS_Archiver **) ptr;
+
+    archiveInfo[numArchivers] = info;
+    archiveInfo[numArchivers + 1] = NULL;
+
+    archivers[numArchivers] = archiver;
+    archivers[numArchivers + 1] = NULL;
+
+    numArchivers++;
+
+    return 1;
+
+regfailed:
+    if (info != NULL)
+    {
+        allocator.Free((void *) info->extension);
+        allocator.Free((void *) info->description);
+        allocator.Free((void *) info->author);
+        allocator.Free((void *) info->url);
+    } /* if */
+    allocator.Free(archiver);
+
+    return 0;
+} /* doRegisterArchiver */
+
+
+int PHYSFS_registerArchiver(const PHYSFS_Archiver *archiver)
+{
+    int retval;
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    grabStateWriteLock();
+    retval = doRegisterArchiver(archiver);
+    __PHYSFS_platformReleaseMutex(stateLock);
+    return retval;
+} /* PHYSFS_registerArchiver */
+
+
+int PHYSFS_deregisterArchiver(const char *ext)
+{
+    size_t i;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    BAIL_IF(!ext, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateWriteLock();
+    for (i = 0; i < numArchivers; i++)
+    {
+        if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
+        {
+            const int retval = doDeregisterArchiver(i);
+            __PHYSFS_platformReleaseMutex(stateLock);
+            return retval;
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(stateLock);
+
+    BAIL(PHYSFS_ERR_NOT_FOUND, 0);
+} /* PHYSFS_deregisterArchiver */
+
+
+const PHYSFS_ArchiveInfo **PHYSFS_supportedArchiveTypes(void)
+{
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, NULL);
+    return (const PHYSFS_ArchiveInfo **) archiveInfo;
+} /* PHYSFS_supportedArchiveTypes */
+
+
+void PHYSFS_freeList(void *list)
+{
+    void **i;
+    if (list != NULL)
+    {
+        for (i = (void **) list; *i != NULL; i++)
+            allocator.Free(*i);
+
+        allocator.Free(list);
+    } /* if */
+} /* PHYSFS_freeList */
+
+
+const char *PHYSFS_getDirSeparator(void)
+{
+    static char retval[2] = { __PHYSFS_platformDirSeparator, '\0' };
+    return retval;
+} /* PHYSFS_getDirSeparator */
+
+
+char **PHYSFS_getCdRomDirs(void)
+{
+    return doEnumStringList(__PHYSFS_platformDetectAvailableCDs);
+} /* PHYSFS_getCdRomDirs */
+
+
+void PHYSFS_getCdRomDirsCallback(PHYSFS_StringCallback callback, void *data)
+{
+    __PHYSFS_platformDetectAvailableCDs(callback, data);
+} /* PHYSFS_getCdRomDirsCallback */
+
+
+const char *PHYSFS_getPrefDir(const char *org, const char *app)
+{
+    const char dirsep = __PHYSFS_platformDirSeparator;
+    PHYSFS_Stat statbuf;
+    char *ptr = NULL;
+    char *endstr = NULL;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    BAIL_IF(!org, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF(*org == '\0', PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF(!app, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF(*app == '\0', PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+
+    allocator.Free(prefDir);
+    prefDir = __PHYSFS_platformCalcPrefDir(org, app);
+    BAIL_IF_ERRPASS(!prefDir, NULL);
+
+    assert(strlen(prefDir) > 0);
+    endstr = prefDir + (strlen(prefDir) - 1);
+    assert(*endstr == dirsep);
+    *endstr = '\0';  /* mask out the final dirsep for now. */
+
+    if (!__PHYSFS_platformStat(prefDir, &statbuf, 1))
+    {
+        for (ptr = strchr(prefDir, dirsep); ptr; ptr = strchr(ptr+1, dirsep))
+        {
+            *ptr = '\0';
+            __PHYSFS_platformMkDir(prefDir);
+            *ptr = dirsep;
+        } /* for */
+
+        if (!__PHYSFS_platformMkDir(prefDir))
+        {
+            allocator.Free(prefDir);
+            prefDir = NULL;
+        } /* if */
+    } /* if */
+
+    *endstr = dirsep;  /* readd the final dirsep. */
+
+    return prefDir;
+} /* PHYSFS_getPrefDir */
+
+
+const char *PHYSFS_getBaseDir(void)
+{
+    return baseDir;   /* this is calculated in PHYSFS_init()... */
+} /* PHYSFS_getBaseDir */
+
+
+const char *__PHYSFS_getUserDir(void)  /* not deprecated internal version. */
+{
+    return userDir;   /* this is calculated in PHYSFS_init()... */
+} /* __PHYSFS_getUserDir */
+
+
+const char *PHYSFS_getUserDir(void)
+{
+    return __PHYSFS_getUserDir();
+} /* PHYSFS_getUserDir */
+
+
+const char *PHYSFS_getWriteDir(void)
+{
+    const char *retval = NULL;
+
+    grabStateReadLock();
+    if (writeDir != NULL)
+        retval = writeDir->dirName;
+    releaseStateReadLock();
+
+    return retval;
+} /* PHYSFS_getWriteDir */
+
+
+int PHYSFS_setWriteDir(const char *newDir)
+{
+    int retval = 1;
+
+    grabStateWriteLock();
+
+    if (writeDir != NULL)
+    {
+        BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(writeDir), stateLock, 0);
+        writeDir = NULL;
+    } /* if */
+
+    if (newDir != NULL)
+    {
+        writeDir = createDirHandle(NULL, newDir, NULL, 1);
+        retval = (writeDir != NULL);
+    } /* if */
+
+    negativeCacheFlush();
+
+    __PHYSFS_platformReleaseMutex(stateLock);
+
+    return retval;
+} /* PHYSFS_setWriteDir */
+
+
+int PHYSFS_setRoot(const char *archive, const char *subdir)
+{
+    DirHandle *i;
+
+    BAIL_IF(!archive, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateWriteLock();
+
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if ((i->dirName != NULL) && (strcmp(archive, i->dirName) == 0))
+        {
+            if (!subdir || (strcmp(subdir, "/") == 0))
+            {
+                if (i->root)
+                    allocator.Free(i->root);
+                i->root = NULL;
+                i->rootlen = 0;
+            } /* if */
+            else
+            {
+                const size_t len = strlen(subdir) + 1;
+                char *ptr = (char *) allocator.Malloc(len);
+                BAIL_IF_MUTEX(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+                if (!sanitizePlatformIndependentPath(subdir, ptr))
+                {
+                    allocator.Free(ptr);
+                    BAIL_MUTEX_ERRPASS(stateLock, 0);
+                } /* if */
+
+                if (i->root)
+                    allocator.Free(i->root);
+                i->root = ptr;
+                i->rootlen = len;
+
+                if (longest_root < len)
+                    longest_root = len;
+            } /* else */
+
+            pathIndexRebuild();
+            negativeCacheFlush();
+            break;
+        } /* if */
+    } /* for */
+
+    __PHYSFS_platformReleaseMutex(stateLock);
+    return 1;
+} /* PHYSFS_setRoot */
+
+
+static int doMount(PHYSFS_Io *io, const char *fname,
+                   const char *mountPoint, int appendToPath)
+{
+    DirHandle *dh;
+    DirHandle *prev = NULL;
+    DirHandle *i;
+
+    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    if (mountPoint == NULL)
+        mountPoint = "/";
+
+    grabStateWriteLock();
+
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        /* already in search path? */
+        if ((i->dirName != NULL) && (strcmp(fname, i->dirName) == 0))
+            BAIL_MUTEX_ERRPASS(stateLock, 1);
+        prev = i;
+    } /* for */
+
+    dh = createDirHandle(io, fname, mountPoint, 0);
+    if (!dh)
+    {
+        traceOperation("mount", fname, 0);
+        BAIL_MUTEX_ERRPASS(stateLock, 0);
+    } /* if */
+
+    if (appendToPath)
+    {
+        if (prev == NULL)
+            searchPath = dh;
+        else
+            prev->next = dh;
+    } /* if */
+    else
+    {
+        dh->next = searchPath;
+        searchPath = dh;
+    } /* else */
+
+    pathIndexMountAdded(dh, !appendToPath);
+    negativeCacheFlush();
+
+    traceOperation("mount", fname, 1);
+
+    __PHYSFS_platformReleaseMutex(stateLock);
+    return 1;
+} /* doMount */
+
+
+int PHYSFS_mountIo(PHYSFS_Io *io, const char *fname,
+                   const char *mountPoint, int appendToPath)
+{
+    BAIL_IF(!io, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(io->version > CURRENT_PHYSFS_IO_API_VERSION,
+            PHYSFS_ERR_UNSUPPORTED, 0);
+    return doMount(io, fname, mountPoint, appendToPath);
+} /* PHYSFS_mountIo */
+
+
+int PHYSFS_mountMemory(const void *buf, PHYSFS_uint64 len, void (*del)(void *),
+                       const char *fname, const char *mountPoint,
+                       int appendToPath)
+{
+    int retval = 0;
+    PHYSFS_Io *io = NULL;
+
+    BAIL_IF(!buf, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    io = __PHYSFS_createMemoryIo(buf, len, del);
+    BAIL_IF_ERRPASS(!io, 0);
+    retval = doMount(io, fname, mountPoint, appendToPath);
+    if (!retval)
+    {
+        /* docs say not to call (del) in case of failure, so cheat. */
+        MemoryIoInfo *info = (MemoryIoInfo *) io->opaque;
+        info->destruct = NULL;
+        io->destroy(io);
+    } /* if */
+
+    return retval;
+} /* PHYSFS_mountMemory */
+
+
+int PHYSFS_mountHandle(PHYSFS_File *file, const char *fname,
+                       const char *mountPoint, int appendToPath)
+{
+    int retval = 0;
+    PHYSFS_Io *io = NULL;
+
+    BAIL_IF(!file, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    io = __PHYSFS_createHandleIo(file);
+    BAIL_IF_ERRPASS(!io, 0);
+    retval = doMount(io, fname, mountPoint, appendToPath);
+    if (!retval)
+    {
+        /* docs say not to destruct in case of failure, so cheat. */
+        io->opaque = NULL;
+        io->destroy(io);
+    } /* if */
+
+    return retval;
+} /* PHYSFS_mountHandle */
+
+
+int PHYSFS_mount(const char *newDir, const char *mountPoint, int appendToPath)
+{
+    BAIL_IF(!newDir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    return doMount(NULL, newDir, mountPoint, appendToPath);
+} /* PHYSFS_mount */
+
+
+/* how many worker threads a PHYSFS_mountBatch() spins up, at most. The
+   calling thread works through jobs too, so zero workers still functions. */
+#ifndef PHYSFS_MOUNT_BATCH_THREADS
+#define PHYSFS_MOUNT_BATCH_THREADS 4
+#endif
+
+typedef struct MountBatchJob
+{
+    DirHandle *dh;  /* opened handle, not yet in the search path. */
+    PHYSFS_ErrorCode errcode;  /* why (dh) is NULL, if it is. */
+    int skip;  /* already mounted (or a dupe within the batch); a no-op. */
+} MountBatchJob;
+
+typedef struct MountBatchState
+{
+    const PHYSFS_MountSpec *specs;
+    MountBatchJob *jobs;
+    PHYSFS_uint32 count;
+    PHYSFS_uint32 nextjob;
+    void *joblock;
+} MountBatchState;
+
+static void mountBatchWorker(void *arg)
+{
+    MountBatchState *state = (MountBatchState *) arg;
+
+    while (1)
+    {
+        const PHYSFS_MountSpec *spec;
+        MountBatchJob *job;
+        PHYSFS_uint32 jobidx;
+
+        __PHYSFS_platformGrabMutex(state->joblock);
+        jobidx = state->nextjob++;
+        __PHYSFS_platformReleaseMutex(state->joblock);
+        if (jobidx >= state->count)
+            return;
+
+        spec = &state->specs[jobidx];
+        job = &state->jobs[jobidx];
+        if (job->skip)
+            continue;
+
+        job->dh = createDirHandle(NULL, spec->newDir,
+                                  spec->mountPoint ? spec->mountPoint : "/",
+                                  0);
+        if (job->dh == NULL)
+            job->errcode = currentErrorCode();
+    } /* while */
+} /* mountBatchWorker */
+
+int PHYSFS_mountBatch(const PHYSFS_MountSpec *specs, PHYSFS_uint32 count)
+{
+    void *threads[PHYSFS_MOUNT_BATCH_THREADS];
+    PHYSFS_ErrorCode firsterr = PHYSFS_ERR_OK;
+    MountBatchState state;
+    MountBatchJob *jobs;
+    DirHandle *tail = NULL;
+    DirHandle *i;
+    int threadcount = 0;
+    int retval = 0;
+    PHYSFS_uint32 n;
+
+    BAIL_IF(!specs && (count > 0), PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    for (n = 0; n < count; n++)
+        BAIL_IF(!specs[n].newDir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF_ERRPASS(count == 0, 0);
+
+    jobs = (MountBatchJob *) allocator.Malloc(count * sizeof (*jobs));
+    BAIL_IF(!jobs, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    memset(jobs, '\0', count * sizeof (*jobs));
+
+    grabStateWriteLock();
+
+    /* mounting something already in the search path is a successful no-op,
+       like PHYSFS_mount; so is listing the same archive twice in a batch. */
+    for (n = 0; n < count; n++)
+    {
+        PHYSFS_uint32 j;
+        for (i = searchPath; i != NULL; i = i->next)
+        {
+            if ((i->dirName != NULL) &&
+                (strcmp(specs[n].newDir, i->dirName) == 0))
+                jobs[n].skip = 1;
+        } /* for */
+        for (j = 0; j < n; j++)
+        {
+            if (strcmp(specs[n].newDir, specs[j].newDir) == 0)
+                jobs[n].skip = 1;
+        } /* for */
+    } /* for */
+
+    /* the openArchive phase of each spec is independent i/o + parsing and
+       never touches shared state, so fan it out; we keep the write lock so
+       the archiver list and search path hold still underneath the workers.
+       The calling thread chews through jobs too, which also covers
+       platforms where thread creation fails: everything just runs here. */
+    state.specs = specs;
+    state.jobs = jobs;
+    state.count = count;
+    state.nextjob = 0;
+    state.joblock = __PHYSFS_platformCreateMutex();
+    if (state.joblock != NULL)
+    {
+        const int maxthreads = (count < PHYSFS_MOUNT_BATCH_THREADS) ?
+                               ((int) count) : PHYSFS_MOUNT_BATCH_THREADS;
+        while (threadcount < maxthreads)
+        {
+            void *t = __PHYSFS_platformCreateThread(mountBatchWorker, &state);
+            if (t == NULL)
+                break;  /* take what we could get. */
+            threads[threadcount++] = t;
+        } /* while */
+
+        mountBatchWorker(&state);
+
+        for (n = 0; n < ((PHYSFS_uint32) threadcount); n++)
+            __PHYSFS_platformJoinThread(threads[n]);
+        __PHYSFS_platformDestroyMutex(state.joblock);
+    } /* if */
+    else  /* no mutex? No parallelism; run the whole batch right here. */
+    {
+        for (n = 0; n < count; n++)
+        {
+            MountBatchJob *job = &jobs[n];
+            if (job->skip)
+                continue;
+            job->dh = createDirHandle(NULL, specs[n].newDir,
+                                      specs[n].mountPoint ?
+                                      specs[n].mountPoint : "/", 0);
+            if (job->dh == NULL)
+                job->errcode = currentErrorCode();
+        } /* for */
+    } /* else */
+
+    /* splice the finished handles in, in spec order, so the search path
+       ends up exactly as the equivalent serial PHYSFS_mount calls would
+       leave it. */
+    for (i = searchPath; i != NULL; i = i->next)
+        tail = i;
+
+    for (n = 0; n < count; n++)
+    {
+        DirHandle *dh = jobs[n].dh;
+        if (jobs[n].skip)
+        {
+            retval++;
+            continue;
+        } /* if */
+
+        if (dh == NULL)
+        {
+            if (firsterr == PHYSFS_ERR_OK)
+                firsterr = jobs[n].errcode;
+            continue;
+        } /* if */
+
+        if (specs[n].appendToPath)
+        {
+            if (tail == NULL)
+                searchPath = dh;
+            else
+                tail->next = dh;
+            tail = dh;
+        } /* if */
+        else
+        {
+            dh->next = searchPath;
+            searchPath = dh;
+            if (tail == NULL)
+                tail = dh;
+        } /* else */
+
+        pathIndexMountAdded(dh, !specs[n].appendToPath);
+        retval++;
+    } /* for */
+
+    negativeCacheFlush();
+    __PHYSFS_platformReleaseMutex(stateLock);
+
+    allocator.Free(jobs);
+    if (firsterr != PHYSFS_ERR_OK)
+        PHYSFS_setErrorCode(firsterr);
+    return retval;
+} /* PHYSFS_mountBatch */
+
+
+#if PHYSFS_SUPPORTS_ZIP
+/*
+ * The registered archiver that drives zips. doRegisterArchiver() keeps a
+ *  copy of __PHYSFS_Archiver_ZIP, so mounted handles point at the copy,
+ *  not the static template. Hold a state lock when calling this!
+ */
+static const PHYSFS_Archiver *findZipArchiver(void)
+{
+    size_t i;
+    for (i = 0; i < numArchivers; i++)
+    {
+        if (archivers[i]->openArchive == __PHYSFS_Archiver_ZIP.openArchive)
+            return archivers[i];
+    } /* for */
+    return NULL;
+} /* findZipArchiver */
+#endif
+
+
+int PHYSFS_writeMountManifest(const char *dir, const char *file)
+{
+#if PHYSFS_SUPPORTS_ZIP
+    int retval = 0;
+    DirHandle *i;
+    PHYSFS_Stat statbuf;
+    PHYSFS_Io *mio = NULL;
+
+    BAIL_IF(!dir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!file, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateReadLock();
+
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if ((i->dirName != NULL) && (strcmp(i->dirName, dir) == 0))
+            break;
+    } /* for */
+
+    BAIL_IF_READLOCK(!i, PHYSFS_ERR_NOT_FOUND, 0);
+    BAIL_IF_READLOCK(i->funcs != findZipArchiver(),
+                     PHYSFS_ERR_UNSUPPORTED, 0);
+
+    /* the archive's current size/mtime go into the manifest, so a remount
+       can tell whether it still describes the file on disk. No native
+       file (PHYSFS_mountIo, etc)? Then there's nothing to validate with. */
+    if (__PHYSFS_platformStat(dir, &statbuf, 1))
+    {
+        mio = __PHYSFS_createNativeIo(file, 'w');
+        if (mio != NULL)
+        {
+            retval = __PHYSFS_zipSaveManifest(i->opaque, mio,
+                                              statbuf.filesize,
+                                              statbuf.modtime);
+            mio->destroy(mio);
+            if (!retval)
+            {
+                /* don't leave a truncated manifest behind. */
+                const PHYSFS_ErrorCode errcode = currentErrorCode();
+                __PHYSFS_platformDelete(file);
+                PHYSFS_setErrorCode(errcode);
+            } /* if */
+        } /* if */
+    } /* if */
+
+    releaseStateReadLock();
+    return retval;
+#else
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+#endif
+} /* PHYSFS_writeMountManifest */
+
+
+int PHYSFS_mountManifest(const char *newDir, const char *manifestFile,
+                         const char *mountPoint, int appendToPath)
+{
+#if PHYSFS_SUPPORTS_ZIP
+    DirHandle *dh = NULL;
+    DirHandle *prev = NULL;
+    DirHandle *i;
+    const PHYSFS_Archiver *zipfuncs;
+    PHYSFS_Stat statbuf;
+    PHYSFS_Io *io = NULL;
+    PHYSFS_Io *mio = NULL;
+    void *opaque = NULL;
+    char *tmpmntpnt = NULL;
+
+    BAIL_IF(!newDir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!manifestFile, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    if (mountPoint == NULL)
+        mountPoint = "/";
+
+    BAIL_IF_ERRPASS(!__PHYSFS_platformStat(newDir, &statbuf, 1), 0);
+
+    grabStateWriteLock();
+
+    zipfuncs = findZipArchiver();
+    BAIL_IF_MUTEX(!zipfuncs, PHYSFS_ERR_UNSUPPORTED, stateLock, 0);
+
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        /* already in search path? */
+        if ((i->dirName != NULL) && (strcmp(newDir, i->dirName) == 0))
+            BAIL_MUTEX_ERRPASS(stateLock, 1);
+        prev = i;
+    } /* for */
+
+    io = __PHYSFS_createNativeIo(newDir, 'r');
+    GOTO_IF_ERRPASS(!io, mountManifest_failed);
+    mio = __PHYSFS_createNativeIo(manifestFile, 'r');
+    GOTO_IF_ERRPASS(!mio, mountManifest_failed);
+
+    opaque = __PHYSFS_zipLoadManifest(io, mio, statbuf.filesize,
+                                      statbuf.modtime);
+    GOTO_IF_ERRPASS(!opaque, mountManifest_failed);
+    mio->destroy(mio);
+    mio = NULL;
+    io = NULL;  /* owned by (opaque) now. */
+
+    /* like createDirHandle, but the archiver opaque is already in hand. */
+    {
+        const size_t len = strlen(mountPoint) + 1;
+        tmpmntpnt = (char *) __PHYSFS_smallAlloc(len);
+        GOTO_IF(!tmpmntpnt, PHYSFS_ERR_OUT_OF_MEMORY, mountManifest_failed);
+        if (!sanitizePlatformIndependentPath(mountPoint, tmpmntpnt))
+            goto mountManifest_failed;
+    } /* scope */
+
+    dh = (DirHandle *) allocator.Malloc(sizeof (DirHandle));
+    GOTO_IF(!dh, PHYSFS_ERR_OUT_OF_MEMORY, mountManifest_failed);
+    memset(dh, '\0', sizeof (DirHandle));
+    dh->funcs = zipfuncs;
+    dh->opaque = opaque;
+    opaque = NULL;  /* owned by (dh) now. */
+
+    dh->handleLock = __PHYSFS_platformCreateMutex();
+    GOTO_IF_ERRPASS(!dh->handleLock, mountManifest_failed);
+
+    dh->dirName = (char *) allocator.Malloc(strlen(newDir) + 1);
+    GOTO_IF(!dh->dirName, PHYSFS_ERR_OUT_OF_MEMORY, mountManifest_failed);
+    strcpy(dh->dirName, newDir);
+
+    if (*tmpmntpnt != '\0')
+    {
+        dh->mountPoint = (char *) allocator.Malloc(strlen(tmpmntpnt) + 2);
+        GOTO_IF(!dh->mountPoint, PHYSFS_ERR_OUT_OF_MEMORY,
+                mountManifest_failed);
+        strcpy(dh->mountPoint, tmpmntpnt);
+        strcat(dh->mountPoint, "/");
+    } /* if */
+
+    __PHYSFS_smallFree(tmpmntpnt);
+
+    if (appendToPath)
+    {
+        if (prev == NULL)
+            searchPath = dh;
+        else
+            prev->next = dh;
+    } /* if */
+    else
+    {
+        dh->next = searchPath;
+        searchPath = dh;
+    } /* else */
+
+    pathIndexMountAdded(dh, !appendToPath);
+    negativeCacheFlush();
+
+    __PHYSFS_platformReleaseMutex(stateLock);
+    return 1;
+
+mountManifest_failed:
+    if (dh != NULL)
+    {
+        dh->funcs->closeArchive(dh->opaque);
+        if (dh->handleLock != NULL)
+            __PHYSFS_platformDestroyMutex(dh->handleLock);
+        allocator.Free(dh->dirName);
+        allocator.Free(dh->mountPoint);
+        allocator.Free(dh);
+    } /* if */
+    else if (opaque != NULL)
+        __PHYSFS_Archiver_ZIP.closeArchive(opaque);
+    if (mio != NULL)
+        mio->destroy(mio);
+    if (io != NULL)  /* NULL once (opaque) takes ownership. */
+        io->destroy(io);
+    __PHYSFS_smallFree(tmpmntpnt);
+    __PHYSFS_platformReleaseMutex(stateLock);
+    return 0;
+#else
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+#endif
+} /* PHYSFS_mountManifest */
+
+
+int PHYSFS_addToSearchPath(const char *newDir, int appendToPath)
+{
+    return PHYSFS_mount(newDir, NULL, appendToPath);
+} /* PHYSFS_addToSearchPath */
+
+
+int PHYSFS_removeFromSearchPath(const char *oldDir)
+{
+    return PHYSFS_unmount(oldDir);
+} /* PHYSFS_removeFromSearchPath */
+
+
+int PHYSFS_unmount(const char *oldDir)
+{
+    DirHandle *i;
+    DirHandle *prev = NULL;
+    DirHandle *next = NULL;
+
+    BAIL_IF(oldDir == NULL, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateWriteLock();
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if (strcmp(i->dirName, oldDir) == 0)
+        {
+            next = i->next;
+            BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(i), stateLock, 0);
+
+            if (prev == NULL)
+                searchPath = next;
+            else
+                prev->next = next;
+
+            pathIndexRebuild();
+            negativeCacheFlush();
+
+            traceOperation("unmount", oldDir, 1);
+            BAIL_MUTEX_ERRPASS(stateLock, 1);
+        } /* if */
+        prev = i;
+    } /* for */
+
+    traceOperation("unmount", oldDir, 0);
+    BAIL_MUTEX(PHYSFS_ERR_NOT_MOUNTED, stateLock, 0);
+} /* PHYSFS_unmount */
+
+
+char **PHYSFS_getSearchPath(void)
+{
+    return doEnumStringList(PHYSFS_getSearchPathCallback);
+} /* PHYSFS_getSearchPath */
+
+
+const char *PHYSFS_getMountPoint(const char *dir)
+{
+    DirHandle *i;
+    grabStateReadLock();
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if (strcmp(i->dirName, dir) == 0)
+        {
+            const char *retval = ((i->mountPoint) ? i->mountPoint : "/");
+            releaseStateReadLock();
+            return retval;
+        } /* if */
+    } /* for */
+    releaseStateReadLock();
+
+    BAIL(PHYSFS_ERR_NOT_MOUNTED, NULL);
+} /* PHYSFS_getMountPoint */
+
+
+int PHYSFS_getStats(PHYSFS_Stats *stats)
+{
+    BAIL_IF(!stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+#ifdef PHYSFS_NO_STATS
+    memset(stats, '\0', sizeof (*stats));
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+#else
+    /* not a consistent snapshot, but each counter is at worst stale. */
+    memcpy(stats, &__PHYSFS_stats, sizeof (*stats));
+    return 1;
+#endif
+} /* PHYSFS_getStats */
+
+
+int PHYSFS_getMountStats(const char *dir, PHYSFS_Stats *stats)
+{
+    DirHandle *i;
+
+    BAIL_IF(!dir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    memset(stats, '\0', sizeof (*stats));
+
+#ifdef PHYSFS_NO_STATS
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+#else
+    grabStateReadLock();
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if (strcmp(i->dirName, dir) == 0)
+        {
+            stats->opens = i->statOpens;
+            stats->searchPathProbes = i->statProbes;
+            stats->bytesRead = i->statBytesRead;
+            releaseStateReadLock();
+            return 1;
+        } /* if */
+    } /* for */
+    releaseStateReadLock();
+
+    BAIL(PHYSFS_ERR_NOT_MOUNTED, 0);
+#endif
+} /* PHYSFS_getMountStats */
+
+
+void PHYSFS_setTraceHook(PHYSFS_TraceCallback callback, void *userdata)
+{
+    /* set the data first, so a hook that fires mid-update sees a sane pair
+       in at least the common install/remove cases. */
+    traceHookData = userdata;
+    traceHook = callback;
+} /* PHYSFS_setTraceHook */
+
+
+void PHYSFS_getSearchPathCallback(PHYSFS_StringCallback callback, void *data)
+{
+    DirHandle *i;
+
+    grabStateReadLock();
+
+    for (i = searchPath; i != NULL; i = i->next)
+        callback(data, i->dirName);
+
+    releaseStateReadLock();
+} /* PHYSFS_getSearchPathCallback */
+
+
+typedef struct setSaneCfgEnumData
+{
+    const char *archiveExt;
+    size_t archiveExtLen;
+    int archivesFirst;
+    PHYSFS_ErrorCode errcode;
+} setSaneCfgEnumData;
+
+static PHYSFS_EnumerateCallbackResult setSaneCfgEnumCallback(void *_data,
+                                                const char *dir, const char *f)
+{
+    setSaneCfgEnumData *data = (setSaneCfgEnumData *) _data;
+    const size_t extlen = data->archiveExtLen;
+    const size_t l = strlen(f);
+    const char *ext;
+
+    if ((l > extlen) && (f[l - extlen - 1] == '.'))
+    {
+        ext = f + (l - extlen);
+        if (PHYSFS_utf8stricmp(ext, data->archiveExt) == 0)
+        {
+            const char dirsep = __PHYSFS_platformDirSeparator;
+            const char *d = PHYSFS_getRealDir(f);
+            const size_t allocsize = strlen(d) + l + 2;
             char *str = (char *) __PHYSFS_smallAlloc(allocsize);
             if (str == NULL)
                 data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
             else
             {
-                snprintf(str, allocsize, "%s%c%s", d, dirsep, f);
-                if (!PHYSFS_mount(str, NULL, data->archivesFirst == 0))
-                    data->errcode = currentErrorCode();
-                __PHYSFS_smallFree(str);
+                snprintf(str, allocsize, "%s%c%s", d, dirsep, f);
+                if (!PHYSFS_mount(str, NULL, data->archivesFirst == 0))
+                    data->errcode = currentErrorCode();
+                __PHYSFS_smallFree(str);
+            } /* else */
+        } /* if */
+    } /* if */
+
+    /* !!! FIXME: if we want to abort on errors... */
+    /*return (data->errcode != PHYSFS_ERR_OK) ? PHYSFS_ENUM_ERROR : PHYSFS_ENUM_OK;*/
+
+    return PHYSFS_ENUM_OK;  /* keep going */
+} /* setSaneCfgEnumCallback */
+
+
+int PHYSFS_setSaneConfig(const char *organization, const char *appName,
+                         const char *archiveExt, int includeCdRoms,
+                         int archivesFirst)
+{
+    const char *basedir;
+    const char *prefdir;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    prefdir = PHYSFS_getPrefDir(organization, appName);
+    BAIL_IF_ERRPASS(!prefdir, 0);
+
+    basedir = PHYSFS_getBaseDir();
+    BAIL_IF_ERRPASS(!basedir, 0);
+
+    BAIL_IF(!PHYSFS_setWriteDir(prefdir), PHYSFS_ERR_NO_WRITE_DIR, 0);
+
+    /* !!! FIXME: these can fail and we should report that... */
+
+    /* Put write dir first in search path... */
+    PHYSFS_mount(prefdir, NULL, 0);
+
+    /* Put base path on search path... */
+    PHYSFS_mount(basedir, NULL, 1);
+
+    /* handle CD-ROMs... */
+    if (includeCdRoms)
+    {
+        char **cds = PHYSFS_getCdRomDirs();
+        char **i;
+        for (i = cds; *i != NULL; i++)
+            PHYSFS_mount(*i, NULL, 1);
+        PHYSFS_freeList(cds);
+    } /* if */
+
+    /* Root out archives, and add them to search path... */
+    if (archiveExt != NULL)
+    {
+        setSaneCfgEnumData data;
+        memset(&data, '\0', sizeof (data));
+        data.archiveExt = archiveExt;
+        data.archiveExtLen = strlen(archiveExt);
+        data.archivesFirst = archivesFirst;
+        data.errcode = PHYSFS_ERR_OK;
+        if (!PHYSFS_enumerate("/", setSaneCfgEnumCallback, &data))
+        {
+            /* !!! FIXME: use this if we're reporting errors.
+            PHYSFS_ErrorCode errcode = currentErrorCode();
+            if (errcode == PHYSFS_ERR_APP_CALLBACK)
+                errcode = data->errcode; */
+        } /* if */
+    } /* if */
+
+    return 1;
+} /* PHYSFS_setSaneConfig */
+
+
+void PHYSFS_permitSymbolicLinks(int allow)
+{
+    const int changed = (!allowSymLinks != !allow);
+    allowSymLinks = allow;
+
+    /* this toggles which paths resolve: links that missed while forbidden
+       can hit now, and a link can shadow what a cached lookup found. The
+       locks don't exist before init, but neither do the caches. */
+    if (changed && initialized)
+    {
+        negativeCacheFlush();
+        contentCachePurge(NULL);
+    } /* if */
+} /* PHYSFS_permitSymbolicLinks */
+
+
+int PHYSFS_symbolicLinksPermitted(void)
+{
+    return allowSymLinks;
+} /* PHYSFS_symbolicLinksPermitted */
+
+
+/*
+ * Verify that (fname) (in platform-independent notation), in relation
+ *  to (h) is secure. That means that each element of fname is checked
+ *  for symlinks (if they aren't permitted). This also allows for quick
+ *  rejection of files that exist outside an archive's mountpoint.
+ *
+ * With some exceptions (like PHYSFS_mkdir(), which builds multiple subdirs
+ *  at a time), you should always pass zero for "allowMissing" for efficiency.
+ *
+ * (fname) must point to an output from sanitizePlatformIndependentPath(),
+ *  since it will make sure that path names are in the right format for
+ *  passing certain checks. It will also do checks for "insecure" pathnames
+ *  like ".." which should be done once instead of once per archive. This also
+ *  gives us license to treat (fname) as scratch space in this function.
+ *
+ * (fname)'s buffer must have enough space available before it for this
+ *  function to prepend any root directory for this DirHandle.
+ *
+ * Returns non-zero if string is safe, zero if there's a security issue.
+ *  PHYSFS_getLastError() will specify what was wrong. (*fname) will be
+ *  updated to point past any mount point elements so it is prepared to
+ *  be used with the archiver directly.
+ */
+/* stat each element of (fname), an archive-relative path, rejecting any
+   that turns out to be a symlink. Only call when (allowSymLinks) is off. */
+static int verifyPathSecurity(DirHandle *h, char *fname,
+                              const int allowMissing)
+{
+    int retval = 1;
+    char *start = fname;
+    char *end;
+
+    while (1)
+    {
+        PHYSFS_Stat statbuf;
+        int rc = 0;
+        end = strchr(start, '/');
+
+        if (end != NULL) *end = '\0';
+        rc = h->funcs->stat(h->opaque, fname, &statbuf);
+        if (rc)
+            rc = (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
+        else if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
+            retval = 0;
+
+        if (end != NULL) *end = '/';
+
+        /* insecure path (has a disallowed symlink in it)? */
+        BAIL_IF(rc, PHYSFS_ERR_SYMLINK_FORBIDDEN, 0);
+
+        /* break out early if path element is missing. */
+        if (!retval)
+        {
+            /*
+             * We need to clear it if it's the last element of the path,
+             *  since this might be a non-existant file we're opening
+             *  for writing...
+             */
+            if ((end == NULL) || (allowMissing))
+                retval = 1;
+            break;
+        } /* if */
+
+        if (end == NULL)
+            break;
+
+        start = end + 1;
+    } /* while */
+
+    return retval;
+} /* verifyPathSecurity */
+
+
+static int verifyPath(DirHandle *h, char **_fname, int allowMissing)
+{
+    char *fname = *_fname;
+    int retval = 1;
+
+    if ((*fname == '\0') && (!h->root))  /* quick rejection. */
+        return 1;
+
+    /* !!! FIXME: This codeblock sucks. */
+    if (h->mountPoint != NULL)  /* NULL mountpoint means "/". */
+    {
+        size_t mntpntlen = strlen(h->mountPoint);
+        size_t len = strlen(fname);
+        assert(mntpntlen > 1); /* root mount points should be NULL. */
+        /* not under the mountpoint, so skip this archive. */
+        BAIL_IF(len < mntpntlen-1, PHYSFS_ERR_NOT_FOUND, 0);
+        /* !!! FIXME: Case insensitive? */
+        retval = strncmp(h->mountPoint, fname, mntpntlen-1);
+        BAIL_IF(retval != 0, PHYSFS_ERR_NOT_FOUND, 0);
+        if (len > mntpntlen-1)  /* corner case... */
+            BAIL_IF(fname[mntpntlen-1]!='/', PHYSFS_ERR_NOT_FOUND, 0);
+        fname += mntpntlen-1;  /* move to start of actual archive path. */
+        if (*fname == '/')
+            fname++;
+        *_fname = fname;  /* skip mountpoint for later use. */
+        retval = 1;  /* may be reset, below. */
+    } /* if */
+
+    /* prepend the root directory, if any. */
+    if (h->root)
+    {
+        const int isempty = (*fname == '\0');
+        fname -= h->rootlen - 1;
+        strcpy(fname, h->root);
+        if (!isempty)
+            fname[h->rootlen - 2] = '/';
+        *_fname = fname;
+    } /* if */
+
+    if (!allowSymLinks)
+        retval = verifyPathSecurity(h, fname, allowMissing);
+
+    return retval;
+} /* verifyPath */
+
+
+/* This must hold the stateLock before calling. */
+static int doMkdir(const char *_dname, char *dname)
+{
+    DirHandle *h = writeDir;
+    char *start;
+    char *end;
+    int retval = 0;
+    int exists = 1;  /* force existance check on first path element. */
+
+    assert(h != NULL);
+
+    BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _dname, dname), 0);
+    BAIL_IF_ERRPASS(!verifyPath(h, &dname, 1), 0);
+
+    start = dname;
+    while (1)
+    {
+        end = strchr(start, '/');
+        if (end != NULL)
+            *end = '\0';
+
+        /* only check for existance if all parent dirs existed, too... */
+        if (exists)
+        {
+            PHYSFS_Stat statbuf;
+            const int rc = h->funcs->stat(h->opaque, dname, &statbuf);
+            if ((!rc) && (currentErrorCode() == PHYSFS_ERR_NOT_FOUND))
+                exists = 0;
+            retval = ((rc) && (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY));
+        } /* if */
+
+        if (!exists)
+            retval = h->funcs->mkdir(h->opaque, dname);
+
+        if (!retval)
+            break;
+
+        if (end == NULL)
+            break;
+
+        *end = '/';
+        start = end + 1;
+    } /* while */
+
+    return retval;
+} /* doMkdir */
+
+
+int PHYSFS_mkdir(const char *_dname)
+{
+    int retval = 0;
+    char *dname;
+    size_t len;
+
+    BAIL_IF(!_dname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateWriteLock();
+    BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
+    len = strlen(_dname) + dirHandleRootLen(writeDir) + 1;
+    dname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF_MUTEX(!dname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+    retval = doMkdir(_dname, dname);
+    if (retval)
+        negativeCacheFlush();
+    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_smallFree(dname);
+    return retval;
+} /* PHYSFS_mkdir */
+
+
+/* This must hold the stateLock before calling. */
+static int doDelete(const char *_fname, char *fname)
+{
+    DirHandle *h = writeDir;
+    BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _fname, fname), 0);
+    BAIL_IF_ERRPASS(!verifyPath(h, &fname, 0), 0);
+    return h->funcs->remove(h->opaque, fname);
+} /* doDelete */
+
+
+int PHYSFS_delete(const char *_fname)
+{
+    int retval;
+    char *fname;
+    size_t len;
+
+    grabStateWriteLock();
+    BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
+    len = strlen(_fname) + dirHandleRootLen(writeDir) + 1;
+    fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+    retval = doDelete(_fname, fname);
+    if (retval)
+        contentCachePurge(NULL);  /* cached copies may go stale. */
+    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_smallFree(fname);
+    return retval;
+} /* PHYSFS_delete */
+
+
+static DirHandle *getRealDirHandle(const char *_fname)
+{
+    DirHandle *retval = NULL;
+    char *allocated_fname = NULL;
+    char *fname = NULL;
+    size_t len;
+
+    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+
+    grabStateReadLock();
+    len = strlen(_fname) + longest_root + 1;
+    allocated_fname = __PHYSFS_smallAlloc(len);
+    BAIL_IF_READLOCK(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    fname = allocated_fname + longest_root;
+    if (sanitizePlatformIndependentPath(_fname, fname))
+    {
+        DirHandle *i;
+        const int knownMissing = negativeCacheCheck(fname);
+
+        if (knownMissing)
+        {
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+            i = NULL;
+        } /* if */
+        else if (!pathIndexLookup(fname, &i))
+            i = searchPath;  /* no index; walk the whole search path. */
+        else if (i == NULL)
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+
+        for (; i != NULL; i = i->next)
+        {
+            char *arcfname = fname;
+            if (partOfMountPoint(i, arcfname))
+            {
+                retval = i;
+                break;
+            } /* if */
+            else if (verifyPath(i, &arcfname, 0))
+            {
+                PHYSFS_Stat statbuf;
+                if (i->funcs->stat(i->opaque, arcfname, &statbuf))
+                {
+                    retval = i;
+                    break;
+                } /* if */
+            } /* if */
+        } /* for */
+
+        if ((retval == NULL) && (!knownMissing))
+            negativeCacheAdd(fname);
+    } /* if */
+
+    releaseStateReadLock();
+    __PHYSFS_smallFree(allocated_fname);
+    return retval;
+} /* getRealDirHandle */
+
+const char *PHYSFS_getRealDir(const char *fname)
+{
+    DirHandle *dh = getRealDirHandle(fname);
+    return dh ? dh->dirName : NULL;
+} /* PHYSFS_getRealDir */
+
+
+static int locateInStringList(const char *str,
+                              char **list,
+                              PHYSFS_uint32 *pos)
+{
+    PHYSFS_uint32 len = *pos;
+    PHYSFS_uint32 half_len;
+    PHYSFS_uint32 lo = 0;
+    PHYSFS_uint32 middle;
+    int cmp;
+
+    while (len > 0)
+    {
+        half_len = len >> 1;
+        middle = lo + half_len;
+        cmp = strcmp(list[middle], str);
+
+        if (cmp == 0)  /* it's in the list already. */
+            return 1;
+        else if (cmp > 0)
+            len = half_len;
+        else
+        {
+            lo = middle + 1;
+            len -= half_len + 1;
+        } /* else */
+    } /* while */
+
+    *pos = lo;
+    return 0;
+} /* locateInStringList */
+
+
+static PHYSFS_EnumerateCallbackResult enumFilesCallback(void *data,
+                                        const char *origdir, const char *str)
+{
+    PHYSFS_uint32 pos;
+    void *ptr;
+    char *newstr;
+    EnumStringListCallbackData *pecd = (EnumStringListCallbackData *) data;
+
+    /*
+     * See if file is in the list already, and if not, insert it in there
+     *  alphabetically...
+     */
+    pos = pecd->size;
+    if (locateInStringList(str, pecd->list, &pos))
+        return PHYSFS_ENUM_OK;  /* already in the list, but keep going. */
+
+    ptr = allocator.Realloc(pecd->list, (pecd->size + 2) * sizeof (char *));
+    newstr = (char *) allocator.Malloc(strlen(str) + 1);
+    if (ptr != NULL)
+        pecd->list = (char **) ptr;
+
+    if ((ptr == NULL) || (newstr == NULL))
+    {
+        if (newstr)
+            allocator.Free(newstr);
+
+        pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;  /* better luck next time. */
+    } /* if */
+
+    strcpy(newstr, str);
+
+    if (pos != pecd->size)
+    {
+        memmove(&pecd->list[pos+1], &pecd->list[pos],
+                 sizeof (char *) * ((pecd->size) - pos));
+    } /* if */
+
+    pecd->list[pos] = newstr;
+    pecd->size++;
+
+    return PHYSFS_ENUM_OK;
+} /* enumFilesCallback */
+
+
+char **PHYSFS_enumerateFiles(const char *path)
+{
+    EnumStringListCallbackData ecd;
+    memset(&ecd, '\0', sizeof (ecd));
+    ecd.list = (char **) allocator.Malloc(sizeof (char *));
+    BAIL_IF(!ecd.list, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    if (!PHYSFS_enumerate(path, enumFilesCallback, &ecd))
+    {
+        const PHYSFS_ErrorCode errcode = currentErrorCode();
+        PHYSFS_uint32 i;
+        for (i = 0; i < ecd.size; i++)
+            allocator.Free(ecd.list[i]);
+        allocator.Free(ecd.list);
+        BAIL_IF(errcode == PHYSFS_ERR_APP_CALLBACK, ecd.errcode, NULL);
+        return NULL;
+    } /* if */
+
+    ecd.list[ecd.size] = NULL;
+    return ecd.list;
+} /* PHYSFS_enumerateFiles */
+
+
+/*
+ * The arena-backed variant builds the same sorted, deduplicated pointer
+ *  table, but inside caller memory: pointers grow from the arena's front
+ *  and name strings pack from its back, failing cleanly if they meet.
+ */
+typedef struct
+{
+    char **list;    /* pointer table at the front of the arena. */
+    char *strings;  /* strings pack downward from the arena's end. */
+    PHYSFS_uint32 size;  /* names collected so far. */
+    PHYSFS_ErrorCode errcode;
+} EnumArenaCallbackData;
+
+static PHYSFS_EnumerateCallbackResult enumFilesArenaCallback(void *data,
+                                        const char *origdir, const char *str)
+{
+    EnumArenaCallbackData *pecd = (EnumArenaCallbackData *) data;
+    const size_t len = strlen(str) + 1;
+    PHYSFS_uint32 pos;
+    char *newstr;
+
+    pos = pecd->size;
+    if (locateInStringList(str, pecd->list, &pos))
+        return PHYSFS_ENUM_OK;  /* already in the list, but keep going. */
+
+    /* the new string plus a table slot (and the terminating NULL slot)
+       must fit between the two growing ends. */
+    newstr = pecd->strings - len;
+    if (newstr < ((char *) &pecd->list[pecd->size + 2]))
+    {
+        pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;  /* arena too small. */
+    } /* if */
+
+    memcpy(newstr, str, len);
+    pecd->strings = newstr;
+
+    if (pos != pecd->size)
+    {
+        memmove(&pecd->list[pos+1], &pecd->list[pos],
+                 sizeof (char *) * ((pecd->size) - pos));
+    } /* if */
+
+    pecd->list[pos] = newstr;
+    pecd->size++;
+
+    return PHYSFS_ENUM_OK;
+} /* enumFilesArenaCallback */
+
+
+char **PHYSFS_enumerateFilesArena(const char *dir, void *arena,
+                                  PHYSFS_uint64 arenaSize)
+{
+    EnumArenaCallbackData ecd;
+    size_t slack;
+
+    BAIL_IF(arena == NULL, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+
+    /* the front of the arena holds the pointer table; line it up. */
+    slack = ((size_t) arena) % sizeof (char *);
+    if (slack != 0)
+        slack = sizeof (char *) - slack;
+    BAIL_IF(arenaSize < (slack + sizeof (char *)),
+            PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    memset(&ecd, '\0', sizeof (ecd));
+    ecd.list = (char **) (((char *) arena) + slack);
+    ecd.strings = ((char *) arena) + arenaSize;
+
+    if (!PHYSFS_enumerate(dir, enumFilesArenaCallback, &ecd))
+    {
+        const PHYSFS_ErrorCode errcode = currentErrorCode();
+        BAIL_IF(errcode == PHYSFS_ERR_APP_CALLBACK, ecd.errcode, NULL);
+        return NULL;
+    } /* if */
+
+    ecd.list[ecd.size] = NULL;
+    return ecd.list;
+} /* PHYSFS_enumerateFilesArena */
+
+
+/*
+ * Broke out to seperate function so we can use stack allocation gratuitously.
+ */
+static PHYSFS_EnumerateCallbackResult enumerateFromMountPoint(DirHandle *i,
+                                    const char *arcfname,
+                                    PHYSFS_EnumerateCallback callback,
+                                    const char *_fname, void *data)
+{
+    PHYSFS_EnumerateCallbackResult retval;
+    const size_t len = strlen(arcfname);
+    char *ptr = NULL;
+    char *end = NULL;
+    const size_t slen = strlen(i->mountPoint) + 1;
+    char *mountPoint = (char *) __PHYSFS_smallAlloc(slen);
+
+    BAIL_IF(!mountPoint, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+
+    strcpy(mountPoint, i->mountPoint);
+    ptr = mountPoint + ((len) ? len + 1 : 0);
+    end = strchr(ptr, '/');
+    assert(end);  /* should always find a terminating '/'. */
+    *end = '\0';
+    retval = callback(data, _fname, ptr);
+    __PHYSFS_smallFree(mountPoint);
+
+    BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
+    return retval;
+} /* enumerateFromMountPoint */
+
+
+typedef struct SymlinkFilterData
+{
+    PHYSFS_EnumerateCallback callback;
+    void *callbackData;
+    DirHandle *dirhandle;
+    const char *arcfname;
+    PHYSFS_ErrorCode errcode;
+} SymlinkFilterData;
+
+static PHYSFS_EnumerateCallbackResult enumCallbackFilterSymLinks(void *_data,
+                                    const char *origdir, const char *fname)
+{
+    SymlinkFilterData *data = (SymlinkFilterData *) _data;
+    const DirHandle *dh = data->dirhandle;
+    const char *arcfname = data->arcfname;
+    PHYSFS_Stat statbuf;
+    const char *trimmedDir = (*arcfname == '/') ? (arcfname + 1) : arcfname;
+    const size_t slen = strlen(trimmedDir) + strlen(fname) + 2;
+    char *path = (char *) __PHYSFS_smallAlloc(slen);
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+
+    if (path == NULL)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    snprintf(path, slen, "%s%s%s", trimmedDir, *trimmedDir ? "/" : "", fname);
+
+    if (!dh->funcs->stat(dh->opaque, path, &statbuf))
+    {
+        data->errcode = currentErrorCode();
+        retval = PHYSFS_ENUM_ERROR;
+    } /* if */
+    else
+    {
+        /* Pass it on to the application if it's not a symlink. */
+        if (statbuf.filetype != PHYSFS_FILETYPE_SYMLINK)
+        {
+            retval = data->callback(data->callbackData, origdir, fname);
+            if (retval == PHYSFS_ENUM_ERROR)
+                data->errcode = PHYSFS_ERR_APP_CALLBACK;
+        } /* if */
+    } /* else */
+
+    __PHYSFS_smallFree(path);
+
+    return retval;
+} /* enumCallbackFilterSymLinks */
+
+
+int PHYSFS_enumerate(const char *_fn, PHYSFS_EnumerateCallback cb, void *data)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    size_t len;
+    char *allocated_fname;
+    char *fname;
+
+    BAIL_IF(!_fn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!cb, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateReadLock();
+
+    len = strlen(_fn) + longest_root + 1;
+    allocated_fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF_READLOCK(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    fname = allocated_fname + longest_root;
+    if (!sanitizePlatformIndependentPath(_fn, fname))
+        retval = PHYSFS_ENUM_STOP;
+    else
+    {
+        DirHandle *i;
+        SymlinkFilterData filterdata;
+
+        if (!allowSymLinks)
+        {
+            memset(&filterdata, '\0', sizeof (filterdata));
+            filterdata.callback = cb;
+            filterdata.callbackData = data;
+        } /* if */
+
+        for (i = searchPath; (retval == PHYSFS_ENUM_OK) && i; i = i->next)
+        {
+            char *arcfname = fname;
+
+            if (partOfMountPoint(i, arcfname))
+                retval = enumerateFromMountPoint(i, arcfname, cb, _fn, data);
+
+            else if (verifyPath(i, &arcfname, 0))
+            {
+                PHYSFS_Stat statbuf;
+                if (!i->funcs->stat(i->opaque, arcfname, &statbuf))
+                {
+                    if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
+                        continue;  /* no such dir in this archive, skip it. */
+                } /* if */
+
+                if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
+                    continue;  /* not a directory in this archive, skip it. */
+
+                else if ((!allowSymLinks) && (i->funcs->info.supportsSymlinks))
+                {
+                    filterdata.dirhandle = i;
+                    filterdata.arcfname = arcfname;
+                    filterdata.errcode = PHYSFS_ERR_OK;
+                    retval = i->funcs->enumerate(i->opaque, arcfname,
+                                                 enumCallbackFilterSymLinks,
+                                                 _fn, &filterdata);
+                    if (retval == PHYSFS_ENUM_ERROR)
+                    {
+                        if (currentErrorCode() == PHYSFS_ERR_APP_CALLBACK)
+                            PHYSFS_setErrorCode(filterdata.errcode);
+                    } /* if */
+                } /* else if */
+                else
+                {
+                    retval = i->funcs->enumerate(i->opaque, arcfname,
+                                                 cb, _fn, data);
+                } /* else */
+            } /* else if */
+        } /* for */
+
+    } /* if */
+
+    releaseStateReadLock();
+
+    __PHYSFS_smallFree(allocated_fname);
+
+    return (retval == PHYSFS_ENUM_ERROR) ? 0 : 1;
+} /* PHYSFS_enumerate */
+
+
+typedef struct EnumStatFilterData
+{
+    PHYSFS_EnumerateWithStatCallback callback;
+    void *callbackData;
+    DirHandle *dirhandle;
+    const char *arcfname;
+    int skipSymLinks;
+    PHYSFS_ErrorCode errcode;
+} EnumStatFilterData;
+
+/* wraps an archiver's enumerateWithStat, just to filter out symlinks. */
+static PHYSFS_EnumerateCallbackResult enumStatCallbackFilterSymLinks(
+                                    void *_data, const char *origdir,
+                                    const char *fname, const PHYSFS_Stat *st)
+{
+    EnumStatFilterData *data = (EnumStatFilterData *) _data;
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+
+    if (st->filetype != PHYSFS_FILETYPE_SYMLINK)
+    {
+        retval = data->callback(data->callbackData, origdir, fname, st);
+        if (retval == PHYSFS_ENUM_ERROR)
+            data->errcode = PHYSFS_ERR_APP_CALLBACK;
+    } /* if */
+
+    return retval;
+} /* enumStatCallbackFilterSymLinks */
+
+
+/* for archivers without enumerateWithStat: stat each item as it arrives.
+   Still beats the app doing it, since this skips the search path walk and
+   path sanitizing that a full PHYSFS_stat() would repeat per file. */
+static PHYSFS_EnumerateCallbackResult enumStatCallbackFallback(void *_data,
+                                    const char *origdir, const char *fname)
+{
+    EnumStatFilterData *data = (EnumStatFilterData *) _data;
+    const DirHandle *dh = data->dirhandle;
+    const char *arcfname = data->arcfname;
+    PHYSFS_Stat statbuf;
+    const char *trimmedDir = (*arcfname == '/') ? (arcfname + 1) : arcfname;
+    const size_t slen = strlen(trimmedDir) + strlen(fname) + 2;
+    char *path = (char *) __PHYSFS_smallAlloc(slen);
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+
+    if (path == NULL)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    snprintf(path, slen, "%s%s%s", trimmedDir, *trimmedDir ? "/" : "", fname);
+
+    if (!dh->funcs->stat(dh->opaque, path, &statbuf))
+    {
+        data->errcode = currentErrorCode();
+        retval = PHYSFS_ENUM_ERROR;
+    } /* if */
+    else if ((!data->skipSymLinks) ||
+             (statbuf.filetype != PHYSFS_FILETYPE_SYMLINK))
+    {
+        retval = data->callback(data->callbackData, origdir, fname, &statbuf);
+        if (retval == PHYSFS_ENUM_ERROR)
+            data->errcode = PHYSFS_ERR_APP_CALLBACK;
+    } /* else if */
+
+    __PHYSFS_smallFree(path);
+
+    return retval;
+} /* enumStatCallbackFallback */
+
+
+/*
+ * The guts of PHYSFS_stat(): (fname) must already be sanitized and the
+ *  state read lock must be held. Shared with the enumerate-with-stat
+ *  mount point path, which has to report the same answer PHYSFS_stat()
+ *  would for the piece it synthesizes.
+ */
+static int doStatLocked(char *fname, PHYSFS_Stat *stat)
+{
+    int retval = 0;
+
+    /* set some sane defaults... */
+    stat->filesize = -1;
+    stat->modtime = -1;
+    stat->createtime = -1;
+    stat->accesstime = -1;
+    stat->filetype = PHYSFS_FILETYPE_OTHER;
+    stat->readonly = 1;
+
+    if (*fname == '\0')
+    {
+        stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
+        stat->readonly = !writeDir; /* Writeable if we have a writeDir */
+        retval = 1;
+    } /* if */
+    else
+    {
+        DirHandle *i;
+        int exists = 0;
+        const int knownMissing = negativeCacheCheck(fname);
+
+        if (knownMissing)
+        {
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+            i = NULL;
+        } /* if */
+        else if (!pathIndexLookup(fname, &i))
+            i = searchPath;  /* no index; walk the whole search path. */
+        else if (i == NULL)
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+
+        for (; ((i != NULL) && (!exists)); i = i->next)
+        {
+            char *arcfname = fname;
+            exists = partOfMountPoint(i, arcfname);
+            if (exists)
+            {
+                stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
+                stat->readonly = 1;
+                retval = 1;
+            } /* if */
+            else if (verifyPath(i, &arcfname, 0))
+            {
+                retval = i->funcs->stat(i->opaque, arcfname, stat);
+                if ((retval) || (currentErrorCode() != PHYSFS_ERR_NOT_FOUND))
+                    exists = 1;
+            } /* else if */
+        } /* for */
+
+        if ((!exists) && (!knownMissing))
+            negativeCacheAdd(fname);
+    } /* else */
+
+    return retval;
+} /* doStatLocked */
+
+
+static PHYSFS_EnumerateCallbackResult enumerateWithStatFromMountPoint(
+                                    DirHandle *i, const char *arcfname,
+                                    PHYSFS_EnumerateWithStatCallback callback,
+                                    const char *_fname, void *data)
+{
+    PHYSFS_EnumerateCallbackResult retval;
+    const size_t len = strlen(arcfname);
+    char *ptr = NULL;
+    char *end = NULL;
+    const size_t slen = strlen(i->mountPoint) + 1;
+    char *mountPoint = (char *) __PHYSFS_smallAlloc(slen);
+    char *full = NULL;
+    PHYSFS_Stat statbuf;
+
+    BAIL_IF(!mountPoint, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+
+    strcpy(mountPoint, i->mountPoint);
+    ptr = mountPoint + ((len) ? len + 1 : 0);
+    end = strchr(ptr, '/');
+    assert(end);  /* should always find a terminating '/'. */
+    *end = '\0';
+
+    /* a synthesized piece of a mount point may still be a real entry in
+       some archive (the last piece is the mounted archive's root), so stat
+       its full path; the caller should see what PHYSFS_stat() would say. */
+    full = (char *) __PHYSFS_smallAlloc(len + strlen(ptr) + 2);
+    if (!full)
+    {
+        __PHYSFS_smallFree(mountPoint);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+    } /* if */
+    snprintf(full, len + strlen(ptr) + 2, "%s%s%s",
+             arcfname, len ? "/" : "", ptr);
+    doStatLocked(full, &statbuf);
+    __PHYSFS_smallFree(full);
+
+    retval = callback(data, _fname, ptr, &statbuf);
+    __PHYSFS_smallFree(mountPoint);
+
+    BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
+    return retval;
+} /* enumerateWithStatFromMountPoint */
+
+
+int PHYSFS_enumerateWithStat(const char *_fn,
+                             PHYSFS_EnumerateWithStatCallback cb, void *data)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    size_t len;
+    char *allocated_fname;
+    char *fname;
+
+    BAIL_IF(!_fn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!cb, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateReadLock();
+
+    len = strlen(_fn) + longest_root + 1;
+    allocated_fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF_READLOCK(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    fname = allocated_fname + longest_root;
+    if (!sanitizePlatformIndependentPath(_fn, fname))
+        retval = PHYSFS_ENUM_STOP;
+    else
+    {
+        DirHandle *i;
+        EnumStatFilterData filterdata;
+
+        for (i = searchPath; (retval == PHYSFS_ENUM_OK) && i; i = i->next)
+        {
+            char *arcfname = fname;
+
+            if (partOfMountPoint(i, arcfname))
+                retval = enumerateWithStatFromMountPoint(i, arcfname, cb,
+                                                         _fn, data);
+
+            else if (verifyPath(i, &arcfname, 0))
+            {
+                PHYSFS_Stat statbuf;
+                const int filterSymLinks = (!allowSymLinks) &&
+                                       (i->funcs->info.supportsSymlinks);
+
+                if (!i->funcs->stat(i->opaque, arcfname, &statbuf))
+                {
+                    if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
+                        continue;  /* no such dir in this archive, skip it. */
+                } /* if */
+
+                if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
+                    continue;  /* not a directory in this archive, skip it. */
+
+                memset(&filterdata, '\0', sizeof (filterdata));
+                filterdata.callback = cb;
+                filterdata.callbackData = data;
+                filterdata.dirhandle = i;
+                filterdata.arcfname = arcfname;
+                filterdata.skipSymLinks = filterSymLinks;
+                filterdata.errcode = PHYSFS_ERR_OK;
+
+                if (__PHYSFS_archiverHasEnumerateWithStat(i->funcs))
+                {
+                    if (filterSymLinks)
+                        retval = i->funcs->enumerateWithStat(i->opaque,
+                                            arcfname,
+                                            enumStatCallbackFilterSymLinks,
+                                            _fn, &filterdata);
+                    else
+                        retval = i->funcs->enumerateWithStat(i->opaque,
+                                            arcfname, cb, _fn, data);
+                } /* if */
+                else
+                {
+                    retval = i->funcs->enumerate(i->opaque, arcfname,
+                                                 enumStatCallbackFallback,
+                                                 _fn, &filterdata);
+                } /* else */
+
+                if (retval == PHYSFS_ENUM_ERROR)
+                {
+                    if ((currentErrorCode() == PHYSFS_ERR_APP_CALLBACK) &&
+                        (filterdata.errcode != PHYSFS_ERR_OK))
+                        PHYSFS_setErrorCode(filterdata.errcode);
+                } /* if */
+            } /* else if */
+        } /* for */
+
+    } /* if */
+
+    releaseStateReadLock();
+
+    __PHYSFS_smallFree(allocated_fname);
+
+    return (retval == PHYSFS_ENUM_ERROR) ? 0 : 1;
+} /* PHYSFS_enumerateWithStat */
+
+
+/* compiled glob machinery (PHYSFS_globCompile and friends)... */
+
+typedef enum GlobPatternType
+{
+    GLOBPAT_LITERAL,   /* no wildcards at all; one string compare.      */
+    GLOBPAT_PREFIX,    /* "literal*"; compare the front of the name.    */
+    GLOBPAT_SUFFIX,    /* "*literal"; compare the back of the name.     */
+    GLOBPAT_GENERAL    /* anything else; run the backtracking matcher.  */
+} GlobPatternType;
+
+typedef struct GlobPattern
+{
+    char *pattern;          /* for PREFIX/SUFFIX, just the literal part. */
+    size_t len;             /* strlen of (pattern).                      */
+    GlobPatternType type;
+} GlobPattern;
+
+/* seen-tree entries remember each reported file's modtime, so
+   PHYSFS_globChanges() can skip anything that hasn't moved since. */
+typedef struct GlobSeenEntry
+{
+    __PHYSFS_DirTreeEntry tree;
+    PHYSFS_sint64 modtime;
+} GlobSeenEntry;
+
+struct PHYSFS_Glob
+{
+    GlobPattern *patterns;
+    PHYSFS_uint32 count;
+    int caseSensitive;
+    __PHYSFS_DirTree seen;  /* path -> modtime state for globChanges.   */
+};
+
+
+static inline char globFoldChar(const char ch, const int casesensitive)
+{
+    if ((!casesensitive) && (ch >= 'A') && (ch <= 'Z'))
+        return ch + ('a' - 'A');
+    return ch;
+} /* globFoldChar */
+
+
+static int globStrEq(const char *a, const char *b, size_t len, const int cs)
+{
+    while (len--)
+    {
+        if (globFoldChar(*(a++), cs) != globFoldChar(*(b++), cs))
+            return 0;
+    } /* while */
+    return 1;
+} /* globStrEq */
+
+
+/* Backtracking matcher for patterns the fast paths can't take: '?' is any
+   one char but '/', '*' is any run without '/', and a run of two or more
+   stars crosses directory separators too. */
+static int globMatchGeneral(const char *name, const char *pat, const int cs)
+{
+    while (*pat)
+    {
+        if (*pat == '*')
+        {
+            int crossdirs = 0;
+            pat++;
+            while (*pat == '*')
+            {
+                crossdirs = 1;  /* "**" (or more) spans directories. */
+                pat++;
+            } /* while */
+
+            while (1)
+            {
+                if (globMatchGeneral(name, pat, cs))
+                    return 1;
+                else if (*name == '\0')
+                    return 0;
+                else if ((!crossdirs) && (*name == '/'))
+                    return 0;
+                name++;
+            } /* while */
+        } /* if */
+
+        else if (*pat == '?')
+        {
+            if ((*name == '\0') || (*name == '/'))
+                return 0;
+            name++;
+            pat++;
+        } /* else if */
+
+        else
+        {
+            if (globFoldChar(*name, cs) != globFoldChar(*pat, cs))
+                return 0;
+            name++;
+            pat++;
+        } /* else */
+    } /* while */
+
+    return (*name == '\0');
+} /* globMatchGeneral */
+
+
+static int globMatchName(const PHYSFS_Glob *glob, const char *name)
+{
+    const size_t namelen = strlen(name);
+    const int cs = glob->caseSensitive;
+    PHYSFS_uint32 i;
+
+    for (i = 0; i < glob->count; i++)
+    {
+        const GlobPattern *pat = &glob->patterns[i];
+        switch (pat->type)
+        {
+            case GLOBPAT_LITERAL:
+                if ((namelen == pat->len) &&
+                    (globStrEq(name, pat->pattern, namelen, cs)))
+                    return 1;
+                break;
+
+            case GLOBPAT_PREFIX:
+                /* the '*' that followed the literal doesn't cross '/'. */
+                if ((namelen >= pat->len) &&
+                    (globStrEq(name, pat->pattern, pat->len, cs)) &&
+                    (memchr(name + pat->len, '/', namelen - pat->len) == NULL))
+                    return 1;
+                break;
+
+            case GLOBPAT_SUFFIX:
+                /* the '*' that preceded the literal doesn't cross '/'. */
+                if ((namelen >= pat->len) &&
+                    (globStrEq(name + (namelen - pat->len), pat->pattern,
+                               pat->len, cs)) &&
+                    (memchr(name, '/', namelen - pat->len) == NULL))
+                    return 1;
+                break;
+
+            case GLOBPAT_GENERAL:
+                if (globMatchGeneral(name, pat->pattern, cs))
+                    return 1;
+                break;
+        } /* switch */
+    } /* for */
+
+    return 0;
+} /* globMatchName */
+
+
+PHYSFS_Glob *PHYSFS_globCompile(const char * const *patterns,
+                                PHYSFS_uint32 count, int caseSensitive)
+{
+    PHYSFS_Glob *glob = NULL;
+    PHYSFS_uint32 i;
+
+    BAIL_IF(!patterns, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF(count == 0, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+
+    glob = (PHYSFS_Glob *) allocator.Malloc(sizeof (PHYSFS_Glob));
+    BAIL_IF(!glob, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(glob, '\0', sizeof (*glob));
+    glob->caseSensitive = caseSensitive;
+
+    glob->patterns = (GlobPattern *) allocator.Malloc(
+                                            count * sizeof (GlobPattern));
+    GOTO_IF(!glob->patterns, PHYSFS_ERR_OUT_OF_MEMORY, globCompileFailed);
+    memset(glob->patterns, '\0', count * sizeof (GlobPattern));
+    glob->count = count;
+
+    for (i = 0; i < count; i++)
+    {
+        GlobPattern *pat = &glob->patterns[i];
+        const char *src = patterns[i];
+        size_t stars = 0, quests = 0, len;
+
+        GOTO_IF(!src, PHYSFS_ERR_INVALID_ARGUMENT, globCompileFailed);
+
+        len = strlen(src);
+        pat->pattern = __PHYSFS_strdup(src);
+        GOTO_IF(!pat->pattern, PHYSFS_ERR_OUT_OF_MEMORY, globCompileFailed);
+
+        for (src = pat->pattern; *src; src++)
+        {
+            if (*src == '*')
+                stars++;
+            else if (*src == '?')
+                quests++;
+        } /* for */
+
+        if ((stars == 0) && (quests == 0))
+        {
+            pat->type = GLOBPAT_LITERAL;
+            pat->len = len;
+        } /* if */
+        else if ((stars == 1) && (quests == 0) &&
+                 (pat->pattern[len-1] == '*'))
+        {
+            pat->type = GLOBPAT_PREFIX;
+            pat->pattern[len-1] = '\0';
+            pat->len = len - 1;
+        } /* else if */
+        else if ((stars == 1) && (quests == 0) && (pat->pattern[0] == '*'))
+        {
+            pat->type = GLOBPAT_SUFFIX;
+            memmove(pat->pattern, pat->pattern + 1, len);  /* keeps '\0'. */
+            pat->len = len - 1;
+        } /* else if */
+        else
+        {
+            pat->type = GLOBPAT_GENERAL;
+            pat->len = len;
+        } /* else */
+    } /* for */
+
+    GOTO_IF_ERRPASS(!__PHYSFS_DirTreeInit(&glob->seen,
+                                          sizeof (GlobSeenEntry)),
+                    globCompileFailed);
+
+    return glob;
+
+globCompileFailed:
+    PHYSFS_globFree(glob);
+    return NULL;
+} /* PHYSFS_globCompile */
+
+
+void PHYSFS_globFree(PHYSFS_Glob *glob)
+{
+    if (glob == NULL)
+        return;
+
+    if (glob->patterns != NULL)
+    {
+        PHYSFS_uint32 i;
+        for (i = 0; i < glob->count; i++)
+            allocator.Free(glob->patterns[i].pattern);
+        allocator.Free(glob->patterns);
+    } /* if */
+
+    __PHYSFS_DirTreeDeinit(&glob->seen);
+    allocator.Free(glob);
+} /* PHYSFS_globFree */
+
+
+typedef struct GlobEnumData
+{
+    PHYSFS_Glob *glob;
+    size_t baselen;                 /* strlen of the dir the scan began in. */
+    int recursive;
+    int changesOnly;
+    EnumStringListCallbackData ecd; /* collects the result list. */
+} GlobEnumData;
+
+static PHYSFS_EnumerateCallbackResult globEnumCb(void *d, const char *origdir,
+                                                 const char *fname,
+                                                 const PHYSFS_Stat *st)
+{
+    GlobEnumData *data = (GlobEnumData *) d;
+    const int isdir = (st->filetype == PHYSFS_FILETYPE_DIRECTORY);
+    const size_t fulllen = strlen(origdir) + strlen(fname) + 2;
+    const char *rel;
+    char *full;
+    int matched;
+
+    full = (char *) __PHYSFS_smallAlloc(fulllen);
+    if (full == NULL)
+    {
+        data->ecd.errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        data->ecd.list[data->ecd.size] = NULL;
+        PHYSFS_freeList(data->ecd.list);
+        data->ecd.list = NULL;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    if ((origdir[0] == '\0') || (strcmp(origdir, "/") == 0))
+        snprintf(full, fulllen, "/%s", fname);
+    else
+        snprintf(full, fulllen, "%s/%s", origdir, fname);
+
+    /* name relative to where the scan started, for matching. */
+    rel = full + data->baselen;
+    while (*rel == '/')
+        rel++;
+
+    matched = globMatchName(data->glob, rel);
+
+    if (matched && data->changesOnly)
+    {
+        /* seen tree keys never have the leading '/'. */
+        char *key = full + 1;
+        GlobSeenEntry *entry = (GlobSeenEntry *)
+                        __PHYSFS_DirTreeFind(&data->glob->seen, key);
+        if (entry == NULL)
+        {
+            entry = (GlobSeenEntry *)
+                    __PHYSFS_DirTreeAdd(&data->glob->seen, key, isdir);
+            if (entry == NULL)
+            {
+                __PHYSFS_smallFree(full);
+                data->ecd.errcode = currentErrorCode();
+                data->ecd.list[data->ecd.size] = NULL;
+                PHYSFS_freeList(data->ecd.list);
+                data->ecd.list = NULL;
+                return PHYSFS_ENUM_ERROR;
+            } /* if */
+            entry->modtime = st->modtime;
+        } /* if */
+        else if (entry->modtime != st->modtime)
+            entry->modtime = st->modtime;
+        else
+            matched = 0;  /* unchanged since last scan; don't report. */
+    } /* if */
+
+    if (matched)
+    {
+        enumStringListCallback(&data->ecd, rel);
+        if (data->ecd.errcode)
+        {
+            __PHYSFS_smallFree(full);
+            data->ecd.list = NULL;  /* the callback already freed it. */
+            return PHYSFS_ENUM_ERROR;
+        } /* if */
+    } /* if */
+
+    if (data->recursive && isdir)
+    {
+        PHYSFS_enumerateWithStat(full, globEnumCb, data);
+        if (data->ecd.errcode)
+        {
+            __PHYSFS_smallFree(full);
+            return PHYSFS_ENUM_ERROR;
+        } /* if */
+    } /* if */
+
+    __PHYSFS_smallFree(full);
+    return PHYSFS_ENUM_OK;
+} /* globEnumCb */
+
+
+static char **doGlobScan(PHYSFS_Glob *glob, const char *dir,
+                         const int recursive, const int changesOnly)
+{
+    GlobEnumData data;
+    int rc;
+
+    BAIL_IF(!glob, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF(!dir, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+
+    memset(&data, '\0', sizeof (data));
+    data.glob = glob;
+    data.baselen = strlen(dir);
+    data.recursive = recursive;
+    data.changesOnly = changesOnly;
+    data.ecd.list = (char **) allocator.Malloc(sizeof (char *));
+    BAIL_IF(!data.ecd.list, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    rc = PHYSFS_enumerateWithStat(dir, globEnumCb, &data);
+
+    if (data.ecd.errcode)
+    {
+        PHYSFS_setErrorCode(data.ecd.errcode);
+        return NULL;  /* list was already freed at the error site. */
+    } /* if */
+    else if (!rc)
+    {
+        data.ecd.list[data.ecd.size] = NULL;
+        PHYSFS_freeList(data.ecd.list);
+        return NULL;  /* error state set by the enumerator. */
+    } /* else if */
+
+    data.ecd.list[data.ecd.size] = NULL;
+    return data.ecd.list;
+} /* doGlobScan */
+
+
+char **PHYSFS_globMatch(PHYSFS_Glob *glob, const char *dir, int recursive)
+{
+    return doGlobScan(glob, dir, recursive, 0);
+} /* PHYSFS_globMatch */
+
+
+char **PHYSFS_globChanges(PHYSFS_Glob *glob, const char *dir, int recursive)
+{
+    return doGlobScan(glob, dir, recursive, 1);
+} /* PHYSFS_globChanges */
+
+
+typedef struct
+{
+    PHYSFS_EnumFilesCallback callback;
+    void *data;
+} LegacyEnumFilesCallbackData;
+
+static PHYSFS_EnumerateCallbackResult enumFilesCallbackAlwaysSucceed(void *d,
+                                    const char *origdir, const char *fname)
+{
+    LegacyEnumFilesCallbackData *cbdata = (LegacyEnumFilesCallbackData *) d;
+    cbdata->callback(cbdata->data, origdir, fname);
+    return PHYSFS_ENUM_OK;
+} /* enumFilesCallbackAlwaysSucceed */
+
+void PHYSFS_enumerateFilesCallback(const char *fname,
+                                   PHYSFS_EnumFilesCallback callback,
+                                   void *data)
+{
+    LegacyEnumFilesCallbackData cbdata;
+    cbdata.callback = callback;
+    cbdata.data = data;
+    (void) PHYSFS_enumerate(fname, enumFilesCallbackAlwaysSucceed, &cbdata);
+} /* PHYSFS_enumerateFilesCallback */
+
+
+int PHYSFS_exists(const char *fname)
+{
+    return (getRealDirHandle(fname) != NULL);
+} /* PHYSFS_exists */
+
+
+PHYSFS_sint64 PHYSFS_getLastModTime(const char *fname)
+{
+    PHYSFS_Stat statbuf;
+    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), -1);
+    return statbuf.modtime;
+} /* PHYSFS_getLastModTime */
+
+
+int PHYSFS_isDirectory(const char *fname)
+{
+    PHYSFS_Stat statbuf;
+    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
+    return (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
+} /* PHYSFS_isDirectory */
+
+
+int PHYSFS_isSymbolicLink(const char *fname)
+{
+    PHYSFS_Stat statbuf;
+    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
+    return (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
+} /* PHYSFS_isSymbolicLink */
+
+
+static PHYSFS_File *doOpenWrite(const char *_fname, const int appending)
+{
+    FileHandle *fh = NULL;
+    DirHandle *h;
+    size_t len;
+    char *fname;
+
+    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateWriteLock();
+
+    h = writeDir;
+    BAIL_IF_MUTEX(!h, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
+
+    len = strlen(_fname) + dirHandleRootLen(h) + 1;
+    fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+
+    if (sanitizePlatformIndependentPathWithRoot(h, _fname, fname))
+    {
+        PHYSFS_Io *io = NULL;
+        char *arcfname = fname;
+        if (verifyPath(h, &arcfname, 0))
+        {
+            const PHYSFS_Archiver *f = h->funcs;
+            if (appending)
+                io = f->openAppend(h->opaque, arcfname);
+            else
+                io = f->openWrite(h->opaque, arcfname);
+
+            if (io)
+            {
+                fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
+                if (fh == NULL)
+                {
+                    io->destroy(io);
+                    PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+                } /* if */
+                else
+                {
+                    memset(fh, '\0', sizeof (FileHandle));
+                    fh->io = io;
+                    fh->dirHandle = h;
+                    openListAdd(h, fh);
+                    negativeCacheFlush();  /* might be a brand new file. */
+                    contentCachePurge(NULL);  /* cached copies may go stale. */
+                } /* else */
+            } /* if */
+        } /* if */
+    } /* if */
+
+    __PHYSFS_platformReleaseMutex(stateLock);
+
+    __PHYSFS_smallFree(fname);
+    return ((PHYSFS_File *) fh);
+} /* doOpenWrite */
+
+
+PHYSFS_File *PHYSFS_openWrite(const char *filename)
+{
+    return doOpenWrite(filename, 0);
+} /* PHYSFS_openWrite */
+
+
+PHYSFS_File *PHYSFS_openAppend(const char *filename)
+{
+    return doOpenWrite(filename, 1);
+} /* PHYSFS_openAppend */
+
+
+PHYSFS_File *PHYSFS_openRead(const char *_fname)
+{
+    FileHandle *fh = NULL;
+    char *allocated_fname;
+    char *fname;
+    size_t len;
+
+    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    grabStateReadLock();
+
+    BAIL_IF_READLOCK(!searchPath, PHYSFS_ERR_NOT_FOUND, 0);
+
+    len = strlen(_fname) + longest_root + 1;
+    allocated_fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF_READLOCK(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    fname = allocated_fname + longest_root;
+
+    if (sanitizePlatformIndependentPath(_fname, fname))
+    {
+        PHYSFS_Io *io = NULL;
+        DirHandle *i;
+        const int knownMissing = negativeCacheCheck(fname);
+
+        if (knownMissing)
+        {
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+            i = NULL;
+        } /* if */
+        else if (!pathIndexLookup(fname, &i))
+            i = searchPath;  /* no index; walk the whole search path. */
+        else if (i == NULL)
+            PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+
+        __PHYSFS_STATS_INCR(__PHYSFS_stats.opens);
+
+        for (; i != NULL; i = i->next)
+        {
+            char *arcfname = fname;
+            __PHYSFS_STATS_INCR(__PHYSFS_stats.searchPathProbes);
+            __PHYSFS_STATS_INCR(i->statProbes);
+            if (verifyPath(i, &arcfname, 0))
+            {
+                io = contentCacheOpen(i, arcfname);
+                if (!io)
+                {
+                    io = i->funcs->openRead(i->opaque, arcfname);
+                    if (io)
+                        io = contentCacheAdd(i, arcfname, io);
+                } /* if */
+                if (io)
+                    break;
+            } /* if */
+        } /* for */
+
+        if ((!io) && (!knownMissing) &&
+            (currentErrorCode() == PHYSFS_ERR_NOT_FOUND))
+            negativeCacheAdd(fname);
+
+        if (io)
+        {
+            fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
+            if (fh == NULL)
+            {
+                io->destroy(io);
+                PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+            } /* if */
+            else
+            {
+                memset(fh, '\0', sizeof (FileHandle));
+                fh->io = io;
+                fh->forReading = 1;
+                fh->dirHandle = i;
+                __PHYSFS_STATS_INCR(i->statOpens);
+                openListAdd(i, fh);
             } /* else */
         } /* if */
     } /* if */
 
-    /* !!! FIXME: if we want to abort on errors... */
-    /*return (data->errcode != PHYSFS_ERR_OK) ? PHYSFS_ENUM_ERROR : PHYSFS_ENUM_OK;*/
+    if (fh == NULL)
+        __PHYSFS_STATS_INCR(__PHYSFS_stats.openFailures);
 
-    return PHYSFS_ENUM_OK;  /* keep going */
-} /* setSaneCfgEnumCallback */
+    traceOperation("openRead", _fname, fh != NULL);
 
+    releaseStateReadLock();
+    __PHYSFS_smallFree(allocated_fname);
+    return ((PHYSFS_File *) fh);
+} /* PHYSFS_openRead */
 
-int PHYSFS_setSaneConfig(const char *organization, const char *appName,
-                         const char *archiveExt, int includeCdRoms,
-                         int archivesFirst)
+
+PHYSFS_File *PHYSFS_openReadIgnoreCase(const char *_fname)
 {
-    const char *basedir;
-    const char *prefdir;
+    FileHandle *fh = NULL;
+    char *allocated_fname;
+    char *fname;
+    size_t len;
 
-    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    prefdir = PHYSFS_getPrefDir(organization, appName);
-    BAIL_IF_ERRPASS(!prefdir, 0);
+    grabStateReadLock();
 
-    basedir = PHYSFS_getBaseDir();
-    BAIL_IF_ERRPASS(!basedir, 0);
+    BAIL_IF_READLOCK(!searchPath, PHYSFS_ERR_NOT_FOUND, 0);
 
-    BAIL_IF(!PHYSFS_setWriteDir(prefdir), PHYSFS_ERR_NO_WRITE_DIR, 0);
+    len = strlen(_fname) + longest_root + 1;
+    allocated_fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF_READLOCK(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    fname = allocated_fname + longest_root;
 
-    /* !!! FIXME: these can fail and we should report that... */
+    if (sanitizePlatformIndependentPath(_fname, fname))
+    {
+        PHYSFS_Io *io = NULL;
+        DirHandle *i;
 
-    /* Put write dir first in search path... */
-    PHYSFS_mount(prefdir, NULL, 0);
+        /* the negative cache and path index are keyed on exact names, so
+           a case-insensitive open always walks the whole search path. */
+        __PHYSFS_STATS_INCR(__PHYSFS_stats.opens);
 
-    /* Put base path on search path... */
-    PHYSFS_mount(basedir, NULL, 1);
+        for (i = searchPath; i != NULL; i = i->next)
+        {
+            char *arcfname = fname;
+            __PHYSFS_STATS_INCR(__PHYSFS_stats.searchPathProbes);
+            __PHYSFS_STATS_INCR(i->statProbes);
 
-    /* handle CD-ROMs... */
-    if (includeCdRoms)
-    {
-        char **cds = PHYSFS_getCdRomDirs();
-        char **i;
-        for (i = cds; *i != NULL; i++)
-            PHYSFS_mount(*i, NULL, 1);
-        PHYSFS_freeList(cds);
-    } /* if */
+            /* allowMissing here: a wrong-case component looks "missing" to
+               the exact-name symlink checks, and would otherwise reject
+               the archive before case correction gets a chance. */
+            if (verifyPath(i, &arcfname, 1))
+            {
+                const char *real = arcfname;
 
-    /* Root out archives, and add them to search path... */
-    if (archiveExt != NULL)
-    {
-        setSaneCfgEnumData data;
-        memset(&data, '\0', sizeof (data));
-        data.archiveExt = archiveExt;
-        data.archiveExtLen = strlen(archiveExt);
-        data.archivesFirst = archivesFirst;
-        data.errcode = PHYSFS_ERR_OK;
-        if (!PHYSFS_enumerate("/", setSaneCfgEnumCallback, &data))
+                io = contentCacheOpen(i, arcfname);
+                if (!io)
+                {
+                    io = i->funcs->openRead(i->opaque, arcfname);
+                    if ((!io) && __PHYSFS_archiverHasCorrectCase(i->funcs))
+                    {
+                        real = i->funcs->correctCase(i->opaque, arcfname);
+
+                        /* the corrected path dodged the symlink checks
+                           above; redo them on the real name. */
+                        if ((real != NULL) && (!allowSymLinks))
+                        {
+                            const size_t reallen = strlen(real) + 1;
+                            char *cpy = (char *) __PHYSFS_smallAlloc(reallen);
+                            if (cpy == NULL)
+                                real = NULL;
+                            else
+                            {
+                                strcpy(cpy, real);
+                                if (!verifyPathSecurity(i, cpy, 0))
+                                    real = NULL;
+                                __PHYSFS_smallFree(cpy);
+                            } /* else */
+                        } /* if */
+
+                        if (real != NULL)
+                        {
+                            io = contentCacheOpen(i, real);
+                            if (!io)
+                                io = i->funcs->openRead(i->opaque, real);
+                        } /* if */
+                    } /* if */
+
+                    if (io)
+                        io = contentCacheAdd(i, real, io);
+                } /* if */
+                if (io)
+                    break;
+            } /* if */
+        } /* for */
+
+        if (io)
         {
-            /* !!! FIXME: use this if we're reporting errors.
-            PHYSFS_ErrorCode errcode = currentErrorCode();
-            if (errcode == PHYSFS_ERR_APP_CALLBACK)
-                errcode = data->errcode; */
+            fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
+            if (fh == NULL)
+            {
+                io->destroy(io);
+                PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+            } /* if */
+            else
+            {
+                memset(fh, '\0', sizeof (FileHandle));
+                fh->io = io;
+                fh->forReading = 1;
+                fh->dirHandle = i;
+                __PHYSFS_STATS_INCR(i->statOpens);
+                openListAdd(i, fh);
+            } /* else */
         } /* if */
     } /* if */
 
-    return 1;
-} /* PHYSFS_setSaneConfig */
+    if (fh == NULL)
+        __PHYSFS_STATS_INCR(__PHYSFS_stats.openFailures);
 
+    traceOperation("openReadIgnoreCase", _fname, fh != NULL);
 
-void PHYSFS_permitSymbolicLinks(int allow)
-{
-    allowSymLinks = allow;
-} /* PHYSFS_permitSymbolicLinks */
+    releaseStateReadLock();
+    __PHYSFS_smallFree(allocated_fname);
+    return ((PHYSFS_File *) fh);
+} /* PHYSFS_openReadIgnoreCase */
 
 
-int PHYSFS_symbolicLinksPermitted(void)
+int PHYSFS_close(PHYSFS_File *_handle)
 {
-    return allowSymLinks;
-} /* PHYSFS_symbolicLinksPermitted */
+    FileHandle *handle = (FileHandle *) _handle;
+    PHYSFS_Io *io = handle->io;
+    PHYSFS_uint8 *tmp = handle->buffer;
 
+    /* send our buffer to io... */
+    if (!handle->forReading)
+    {
+        BAIL_IF_ERRPASS(!PHYSFS_flush(_handle), 0);
 
-/*
- * Verify that (fname) (in platform-independent notation), in relation
- *  to (h) is secure. That means that each element of fname is checked
- *  for symlinks (if they aren't permitted). This also allows for quick
- *  rejection of files that exist outside an archive's mountpoint.
- *
- * With some exceptions (like PHYSFS_mkdir(), which builds multiple subdirs
- *  at a time), you should always pass zero for "allowMissing" for efficiency.
- *
- * (fname) must point to an output from sanitizePlatformIndependentPath(),
- *  since it will make sure that path names are in the right format for
- *  passing certain checks. It will also do checks for "insecure" pathnames
- *  like ".." which should be done once instead of once per archive. This also
- *  gives us license to treat (fname) as scratch space in this function.
- *
- * (fname)'s buffer must have enough space available before it for this
- *  function to prepend any root directory for this DirHandle.
- *
- * Returns non-zero if string is safe, zero if there's a security issue.
- *  PHYSFS_getLastError() will specify what was wrong. (*fname) will be
- *  updated to point past any mount point elements so it is prepared to
- *  be used with the archiver directly.
- */
-static int verifyPath(DirHandle *h, char **_fname, int allowMissing)
-{
-    char *fname = *_fname;
-    int retval = 1;
-    char *start;
-    char *end;
+        /* ...then have io send it to the disk... */
+        if (io->flush)
+            BAIL_IF_ERRPASS(!io->flush(io), 0);
+    } /* if */
 
-    if ((*fname == '\0') && (!h->root))  /* quick rejection. */
-        return 1;
+    /* ...then close the underlying file. */
+    io->destroy(io);
 
-    /* !!! FIXME: This codeblock sucks. */
-    if (h->mountPoint != NULL)  /* NULL mountpoint means "/". */
-    {
-        size_t mntpntlen = strlen(h->mountPoint);
-        size_t len = strlen(fname);
-        assert(mntpntlen > 1); /* root mount points should be NULL. */
-        /* not under the mountpoint, so skip this archive. */
-        BAIL_IF(len < mntpntlen-1, PHYSFS_ERR_NOT_FOUND, 0);
-        /* !!! FIXME: Case insensitive? */
-        retval = strncmp(h->mountPoint, fname, mntpntlen-1);
-        BAIL_IF(retval != 0, PHYSFS_ERR_NOT_FOUND, 0);
-        if (len > mntpntlen-1)  /* corner case... */
-            BAIL_IF(fname[mntpntlen-1]!='/', PHYSFS_ERR_NOT_FOUND, 0);
-        fname += mntpntlen-1;  /* move to start of actual archive path. */
-        if (*fname == '/')
-            fname++;
-        *_fname = fname;  /* skip mountpoint for later use. */
-        retval = 1;  /* may be reset, below. */
-    } /* if */
+    if (tmp != NULL)  /* free any associated buffer. */
+        allocator.Free(tmp);
 
-    /* prepend the root directory, if any. */
-    if (h->root)
-    {
-        const int isempty = (*fname == '\0');
-        fname -= h->rootlen - 1;
-        strcpy(fname, h->root);
-        if (!isempty)
-            fname[h->rootlen - 2] = '/';
-        *_fname = fname;
-    } /* if */
+    if (handle->wbWaitSem != NULL)  /* write-behind leftovers. */
+        __PHYSFS_platformDestroySemaphore(handle->wbWaitSem);
 
-    start = fname;
-    if (!allowSymLinks)
+    openListRemove(handle->dirHandle, handle);
+    allocator.Free(handle);
+    return 1;
+} /* PHYSFS_close */
+
+
+static PHYSFS_sint64 doBufferedRefill(FileHandle *fh)
+{
+    PHYSFS_Io *io = fh->io;
+    PHYSFS_sint64 rc;
+
+    /* each refill here continues exactly where the last one ended,
+       so a streak of them means the app is streaming sequentially;
+       widen the readahead window. A failed realloc isn't an error,
+       we just keep reading at the current window size. */
+    if (fh->bufstreak < 2)
+        fh->bufstreak++;
+    else if (fh->bufwindow < PHYSFS_READAHEAD_MAX)
     {
-        while (1)
+        size_t newwin = fh->bufwindow * 2;
+        if (newwin > PHYSFS_READAHEAD_MAX)
+            newwin = PHYSFS_READAHEAD_MAX;
+        if (newwin <= fh->bufalloc)
+            fh->bufwindow = newwin;
+        else
         {
-            PHYSFS_Stat statbuf;
-            int rc = 0;
-            end = strchr(start, '/');
+            PHYSFS_uint8 *newbuf = (PHYSFS_uint8 *)
+                           allocator.Realloc(fh->buffer, newwin);
+            if (newbuf != NULL)
+            {
+                fh->buffer = newbuf;
+                fh->bufalloc = newwin;
+                fh->bufwindow = newwin;
+            } /* if */
+        } /* else */
+    } /* else if */
+
+    __PHYSFS_STATS_INCR(__PHYSFS_stats.bufferMisses);
+
+    rc = io->read(io, fh->buffer, fh->bufwindow);
+    fh->bufpos = 0;
+    fh->buffill = (rc > 0) ? ((size_t) rc) : 0;
+    return rc;
+} /* doBufferedRefill */
 
-            if (end != NULL) *end = '\0';
-            rc = h->funcs->stat(h->opaque, fname, &statbuf);
-            if (rc)
-                rc = (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
-            else if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
-                retval = 0;
 
-            if (end != NULL) *end = '/';
+static PHYSFS_sint64 doBufferedRead(FileHandle *fh, void *_buffer, size_t len)
+{
+    PHYSFS_uint8 *buffer = (PHYSFS_uint8 *) _buffer;
+    PHYSFS_sint64 retval = 0;
 
-            /* insecure path (has a disallowed symlink in it)? */
-            BAIL_IF(rc, PHYSFS_ERR_SYMLINK_FORBIDDEN, 0);
+    while (len > 0)
+    {
+        const size_t avail = fh->buffill - fh->bufpos;
+        if (avail > 0)  /* data available in the buffer. */
+        {
+            const size_t cpy = (len < avail) ? len : avail;
+            __PHYSFS_STATS_INCR(__PHYSFS_stats.bufferHits);
+            memcpy(buffer, fh->buffer + fh->bufpos, cpy);
+            assert(len >= cpy);
+            buffer += cpy;
+            len -= cpy;
+            fh->bufpos += cpy;
+            retval += cpy;
+        } /* if */
 
-            /* break out early if path element is missing. */
-            if (!retval)
+        else   /* buffer is empty, refill it. */
+        {
+            const PHYSFS_sint64 rc = doBufferedRefill(fh);
+            if (rc <= 0)
             {
-                /*
-                 * We need to clear it if it's the last element of the path,
-                 *  since this might be a non-existant file we're opening
-                 *  for writing...
-                 */
-                if ((end == NULL) || (allowMissing))
-                    retval = 1;
+                if (retval == 0)  /* report already-read data, or failure. */
+                    retval = rc;
                 break;
             } /* if */
+        } /* else */
+    } /* while */
 
-            if (end == NULL)
-                break;
+    return retval;
+} /* doBufferedRead */
 
-            start = end + 1;
-        } /* while */
-    } /* if */
 
-    return retval;
-} /* verifyPath */
+PHYSFS_sint64 PHYSFS_read(PHYSFS_File *handle, void *buffer,
+                          PHYSFS_uint32 size, PHYSFS_uint32 count)
+{
+    const PHYSFS_uint64 len = ((PHYSFS_uint64) size) * ((PHYSFS_uint64) count);
+    const PHYSFS_sint64 retval = PHYSFS_readBytes(handle, buffer, len);
+    return ( (retval <= 0) ? retval : (retval / ((PHYSFS_sint64) size)) );
+} /* PHYSFS_read */
 
 
-/* This must hold the stateLock before calling. */
-static int doMkdir(const char *_dname, char *dname)
+PHYSFS_sint64 PHYSFS_readBytes(PHYSFS_File *handle, void *buffer,
+                               PHYSFS_uint64 _len)
 {
-    DirHandle *h = writeDir;
-    char *start;
-    char *end;
-    int retval = 0;
-    int exists = 1;  /* force existance check on first path element. */
+    const size_t len = (size_t) _len;
+    FileHandle *fh = (FileHandle *) handle;
+    PHYSFS_sint64 rc;
 
-    assert(h != NULL);
+#ifdef PHYSFS_NO_64BIT_SUPPORT
+    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFF);
+#else
+    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFFFFFFFFFF);
+#endif
 
-    BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _dname, dname), 0);
-    BAIL_IF_ERRPASS(!verifyPath(h, &dname, 1), 0);
+    if (!__PHYSFS_ui64FitsAddressSpace(_len))
+        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
 
-    start = dname;
-    while (1)
-    {
-        end = strchr(start, '/');
-        if (end != NULL)
-            *end = '\0';
+    BAIL_IF(_len > maxlen, PHYSFS_ERR_INVALID_ARGUMENT, -1);
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, -1);
+    BAIL_IF_ERRPASS(len == 0, 0);
 
-        /* only check for existance if all parent dirs existed, too... */
-        if (exists)
-        {
-            PHYSFS_Stat statbuf;
-            const int rc = h->funcs->stat(h->opaque, dname, &statbuf);
-            if ((!rc) && (currentErrorCode() == PHYSFS_ERR_NOT_FOUND))
-                exists = 0;
-            retval = ((rc) && (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY));
-        } /* if */
+    if (fh->buffer)
+        rc = doBufferedRead(fh, buffer, len);
+    else
+        rc = fh->io->read(fh->io, buffer, len);
 
-        if (!exists)
-            retval = h->funcs->mkdir(h->opaque, dname);
+#ifndef PHYSFS_NO_STATS
+    if (rc > 0)
+    {
+        __PHYSFS_STATS_ADD(__PHYSFS_stats.bytesRead, (PHYSFS_uint64) rc);
+        if (fh->dirHandle != NULL)
+            __PHYSFS_STATS_ADD(fh->dirHandle->statBytesRead,
+                               (PHYSFS_uint64) rc);
+    } /* if */
+#endif
 
-        if (!retval)
-            break;
+    return rc;
+} /* PHYSFS_readBytes */
 
-        if (end == NULL)
-            break;
 
-        *end = '/';
-        start = end + 1;
-    } /* while */
+int PHYSFS_borrowBuffer(PHYSFS_File *handle, const void **ptr,
+                        PHYSFS_uint64 *avail)
+{
+    FileHandle *fh = (FileHandle *) handle;
 
-    return retval;
-} /* doMkdir */
+    BAIL_IF(!ptr, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!avail, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
+    *ptr = NULL;
+    *avail = 0;
 
-int PHYSFS_mkdir(const char *_dname)
-{
-    int retval = 0;
-    char *dname;
-    size_t len;
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, 0);
+    BAIL_IF(!fh->buffer, PHYSFS_ERR_UNSUPPORTED, 0);
 
-    BAIL_IF(!_dname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    if (fh->bufpos == fh->buffill)  /* nothing buffered? Refill first. */
+    {
+        const PHYSFS_sint64 rc = doBufferedRefill(fh);
+        BAIL_IF_ERRPASS(rc < 0, 0);
+    } /* if */
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
-    len = strlen(_dname) + dirHandleRootLen(writeDir) + 1;
-    dname = (char *) __PHYSFS_smallAlloc(len);
-    BAIL_IF_MUTEX(!dname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-    retval = doMkdir(_dname, dname);
-    __PHYSFS_platformReleaseMutex(stateLock);
-    __PHYSFS_smallFree(dname);
-    return retval;
-} /* PHYSFS_mkdir */
+    *ptr = fh->buffer + fh->bufpos;
+    *avail = (PHYSFS_uint64) (fh->buffill - fh->bufpos);
+    return 1;
+} /* PHYSFS_borrowBuffer */
 
 
-/* This must hold the stateLock before calling. */
-static int doDelete(const char *_fname, char *fname)
+int PHYSFS_consumeBuffer(PHYSFS_File *handle, PHYSFS_uint64 len)
 {
-    DirHandle *h = writeDir;
-    BAIL_IF_ERRPASS(!sanitizePlatformIndependentPathWithRoot(h, _fname, fname), 0);
-    BAIL_IF_ERRPASS(!verifyPath(h, &fname, 0), 0);
-    return h->funcs->remove(h->opaque, fname);
-} /* doDelete */
+    FileHandle *fh = (FileHandle *) handle;
 
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, 0);
+    BAIL_IF(!fh->buffer, PHYSFS_ERR_UNSUPPORTED, 0);
+    BAIL_IF(len > ((PHYSFS_uint64) (fh->buffill - fh->bufpos)),
+            PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-int PHYSFS_delete(const char *_fname)
-{
-    int retval;
-    char *fname;
-    size_t len;
+    fh->bufpos += (size_t) len;
+    return 1;
+} /* PHYSFS_consumeBuffer */
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
-    len = strlen(_fname) + dirHandleRootLen(writeDir) + 1;
-    fname = (char *) __PHYSFS_smallAlloc(len);
-    BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-    retval = doDelete(_fname, fname);
-    __PHYSFS_platformReleaseMutex(stateLock);
-    __PHYSFS_smallFree(fname);
-    return retval;
-} /* PHYSFS_delete */
 
+static int readvCmp(void *_a, size_t x, size_t y)
+{
+    const PHYSFS_ReadVec **vecs = (const PHYSFS_ReadVec **) _a;
+    const PHYSFS_uint64 ox = vecs[x]->offset;
+    const PHYSFS_uint64 oy = vecs[y]->offset;
+    return (ox < oy) ? -1 : ((ox > oy) ? 1 : 0);
+} /* readvCmp */
 
-static DirHandle *getRealDirHandle(const char *_fname)
+static void readvSwap(void *_a, size_t x, size_t y)
 {
-    DirHandle *retval = NULL;
-    char *allocated_fname = NULL;
-    char *fname = NULL;
-    size_t len;
+    const PHYSFS_ReadVec **vecs = (const PHYSFS_ReadVec **) _a;
+    const PHYSFS_ReadVec *tmp = vecs[x];
+    vecs[x] = vecs[y];
+    vecs[y] = tmp;
+} /* readvSwap */
 
-    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+PHYSFS_sint64 PHYSFS_readv(PHYSFS_File *handle, const PHYSFS_ReadVec *vecs,
+                           PHYSFS_uint32 count)
+{
+    FileHandle *fh = (FileHandle *) handle;
+    PHYSFS_Io *io = fh->io;
+    const PHYSFS_ReadVec **sorted;
+    size_t allocsize;
+    PHYSFS_sint64 retval = 0;
+    PHYSFS_uint32 i;
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    len = strlen(_fname) + longest_root + 1;
-    allocated_fname = __PHYSFS_smallAlloc(len);
-    BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, NULL);
-    fname = allocated_fname + longest_root;
-    if (sanitizePlatformIndependentPath(_fname, fname))
+    BAIL_IF(!vecs && (count > 0), PHYSFS_ERR_INVALID_ARGUMENT, -1);
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, -1);
+    BAIL_IF_ERRPASS(count == 0, 0);
+
+    /* service in offset order: compressed entries then decompress in one
+       forward pass, and even raw files like the elevator going one way. */
+    allocsize = count * sizeof (*sorted);
+    sorted = (const PHYSFS_ReadVec **) __PHYSFS_smallAlloc(allocsize);
+    BAIL_IF(!sorted, PHYSFS_ERR_OUT_OF_MEMORY, -1);
+    for (i = 0; i < count; i++)
+        sorted[i] = &vecs[i];
+    __PHYSFS_sort((void *) sorted, count, readvCmp, readvSwap);
+
+    if (__PHYSFS_ioHasReadAt(io))
     {
-        DirHandle *i;
-        for (i = searchPath; i != NULL; i = i->next)
+        /* positioned reads leave the handle's buffer alone, but the io's
+           implicit position is undefined after readAt(); save/restore it. */
+        const PHYSFS_sint64 rawpos = io->tell(io);
+        if (rawpos < 0)
+            retval = -1;
+        for (i = 0; (retval >= 0) && (i < count); i++)
         {
-            char *arcfname = fname;
-            if (partOfMountPoint(i, arcfname))
+            const PHYSFS_ReadVec *v = sorted[i];
+            const PHYSFS_sint64 rc = io->readAt(io, v->buffer, v->len,
+                                                v->offset);
+            if (rc < 0)
             {
-                retval = i;
+                if (retval == 0)
+                    retval = -1;
+                break;  /* report already-read data, or failure. */
+            } /* if */
+            retval += rc;
+            if (((PHYSFS_uint64) rc) < v->len)
+                break;  /* hit EOF mid-segment. */
+        } /* for */
+        if ((rawpos >= 0) && (!io->seek(io, rawpos)) && (retval == 0))
+            retval = -1;
+    } /* if */
+
+    else
+    {
+        /* no positioned read on this io (compressed archive entries):
+           seek+read each segment through the normal buffered path, where
+           the offset ordering keeps the decompressor moving forward. */
+        const PHYSFS_sint64 origpos = PHYSFS_tell(handle);
+        if (origpos < 0)
+            retval = -1;
+        for (i = 0; (retval >= 0) && (i < count); i++)
+        {
+            const PHYSFS_ReadVec *v = sorted[i];
+            PHYSFS_sint64 rc;
+            if (!PHYSFS_seek(handle, v->offset))
+            {
+                if (retval == 0)
+                    retval = -1;
                 break;
             } /* if */
-            else if (verifyPath(i, &arcfname, 0))
+            rc = PHYSFS_readBytes(handle, v->buffer, v->len);
+            if (rc < 0)
             {
-                PHYSFS_Stat statbuf;
-                if (i->funcs->stat(i->opaque, arcfname, &statbuf))
-                {
-                    retval = i;
-                    break;
-                } /* if */
+                if (retval == 0)
+                    retval = -1;
+                break;
             } /* if */
+            retval += rc;
+            if (((PHYSFS_uint64) rc) < v->len)
+                break;  /* hit EOF mid-segment. */
         } /* for */
-    } /* if */
+        if ((origpos >= 0) && (!PHYSFS_seek(handle, origpos)) &&
+            (retval == 0))
+            retval = -1;
+    } /* else */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
-    __PHYSFS_smallFree(allocated_fname);
+    __PHYSFS_smallFree((void *) sorted);
     return retval;
-} /* getRealDirHandle */
-
-const char *PHYSFS_getRealDir(const char *fname)
-{
-    DirHandle *dh = getRealDirHandle(fname);
-    return dh ? dh->dirName : NULL;
-} /* PHYSFS_getRealDir */
+} /* PHYSFS_readv */
 
 
-static int locateInStringList(const char *str,
-                              char **list,
-                              PHYSFS_uint32 *pos)
+void *PHYSFS_loadFile(const char *fname, PHYSFS_uint64 *_len)
 {
-    PHYSFS_uint32 len = *pos;
-    PHYSFS_uint32 half_len;
-    PHYSFS_uint32 lo = 0;
-    PHYSFS_uint32 middle;
-    int cmp;
-
-    while (len > 0)
-    {
-        half_len = len >> 1;
-        middle = lo + half_len;
-        cmp = strcmp(list[middle], str);
-
-        if (cmp == 0)  /* it's in the list already. */
-            return 1;
-        else if (cmp > 0)
-            len = half_len;
-        else
-        {
-            lo = middle + 1;
-            len -= half_len + 1;
-        } /* else */
-    } /* while */
+    PHYSFS_File *handle;
+    PHYSFS_uint8 *buf = NULL;
+    PHYSFS_ErrorCode err;
+    PHYSFS_sint64 len;
+    PHYSFS_sint64 rc;
 
-    *pos = lo;
-    return 0;
-} /* locateInStringList */
+    if (_len != NULL)
+        *_len = 0;
+
+    handle = PHYSFS_openRead(fname);
+    BAIL_IF_ERRPASS(!handle, NULL);
+
+    len = PHYSFS_fileLength(handle);
+    GOTO_IF(len < 0, PHYSFS_ERR_IO, loadFileFailed);  /* unknown length. */
+    GOTO_IF(!__PHYSFS_ui64FitsAddressSpace(((PHYSFS_uint64) len) + 1),
+            PHYSFS_ERR_OUT_OF_MEMORY, loadFileFailed);
+
+    /* one allocation, one big read: the fresh handle has no buffer, so the
+       read goes straight through to the archiver, which decompresses (or
+       preads, or memcpys) directly into the destination. The extra byte
+       is a zero terminator for callers treating the file as text. */
+    buf = (PHYSFS_uint8 *) allocator.Malloc((size_t) (len + 1));
+    GOTO_IF(!buf, PHYSFS_ERR_OUT_OF_MEMORY, loadFileFailed);
+
+    rc = (len > 0) ? PHYSFS_readBytes(handle, buf, (PHYSFS_uint64) len) : 0;
+    GOTO_IF_ERRPASS(rc < 0, loadFileFailed);
+    GOTO_IF(rc != len, PHYSFS_ERR_IO, loadFileFailed);  /* short read?! */
+
+    buf[len] = '\0';
+    PHYSFS_close(handle);
+    if (_len != NULL)
+        *_len = (PHYSFS_uint64) len;
+    return buf;
+
+loadFileFailed:
+    err = currentErrorCode();
+    if (buf != NULL)
+        allocator.Free(buf);
+    PHYSFS_close(handle);
+    PHYSFS_setErrorCode(err);
+    return NULL;
+} /* PHYSFS_loadFile */
 
 
-static PHYSFS_EnumerateCallbackResult enumFilesCallback(void *data,
-                                        const char *origdir, const char *str)
+PHYSFS_sint64 PHYSFS_loadFileTo(const char *fname, void *buffer,
+                                PHYSFS_uint64 buflen)
 {
-    PHYSFS_uint32 pos;
-    void *ptr;
-    char *newstr;
-    EnumStringListCallbackData *pecd = (EnumStringListCallbackData *) data;
-
-    /*
-     * See if file is in the list already, and if not, insert it in there
-     *  alphabetically...
-     */
-    pos = pecd->size;
-    if (locateInStringList(str, pecd->list, &pos))
-        return PHYSFS_ENUM_OK;  /* already in the list, but keep going. */
-
-    ptr = allocator.Realloc(pecd->list, (pecd->size + 2) * sizeof (char *));
-    newstr = (char *) allocator.Malloc(strlen(str) + 1);
-    if (ptr != NULL)
-        pecd->list = (char **) ptr;
+    PHYSFS_File *handle;
+    PHYSFS_ErrorCode err;
+    PHYSFS_sint64 len;
+    PHYSFS_sint64 rc;
 
-    if ((ptr == NULL) || (newstr == NULL))
-    {
-        if (newstr)
-            allocator.Free(newstr);
+    BAIL_IF(!buffer, PHYSFS_ERR_INVALID_ARGUMENT, -1);
 
-        pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
-        return PHYSFS_ENUM_ERROR;  /* better luck next time. */
-    } /* if */
+    handle = PHYSFS_openRead(fname);
+    BAIL_IF_ERRPASS(!handle, -1);
 
-    strcpy(newstr, str);
+    len = PHYSFS_fileLength(handle);
+    GOTO_IF(len < 0, PHYSFS_ERR_IO, loadFileToFailed);
+    GOTO_IF(((PHYSFS_uint64) len) > buflen, PHYSFS_ERR_INVALID_ARGUMENT,
+            loadFileToFailed);  /* caller's buffer is too small. */
 
-    if (pos != pecd->size)
-    {
-        memmove(&pecd->list[pos+1], &pecd->list[pos],
-                 sizeof (char *) * ((pecd->size) - pos));
-    } /* if */
+    rc = (len > 0) ? PHYSFS_readBytes(handle, buffer, (PHYSFS_uint64) len) : 0;
+    GOTO_IF_ERRPASS(rc < 0, loadFileToFailed);
+    GOTO_IF(rc != len, PHYSFS_ERR_IO, loadFileToFailed);  /* short read?! */
 
-    pecd->list[pos] = newstr;
-    pecd->size++;
+    PHYSFS_close(handle);
+    return len;
 
-    return PHYSFS_ENUM_OK;
-} /* enumFilesCallback */
+loadFileToFailed:
+    err = currentErrorCode();
+    PHYSFS_close(handle);
+    PHYSFS_setErrorCode(err);
+    return -1;
+} /* PHYSFS_loadFileTo */
 
 
-char **PHYSFS_enumerateFiles(const char *path)
+void PHYSFS_freeLoadedFile(void *data)
 {
-    EnumStringListCallbackData ecd;
-    memset(&ecd, '\0', sizeof (ecd));
-    ecd.list = (char **) allocator.Malloc(sizeof (char *));
-    BAIL_IF(!ecd.list, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
-    if (!PHYSFS_enumerate(path, enumFilesCallback, &ecd))
-    {
-        const PHYSFS_ErrorCode errcode = currentErrorCode();
-        PHYSFS_uint32 i;
-        for (i = 0; i < ecd.size; i++)
-            allocator.Free(ecd.list[i]);
-        allocator.Free(ecd.list);
-        BAIL_IF(errcode == PHYSFS_ERR_APP_CALLBACK, ecd.errcode, NULL);
-        return NULL;
-    } /* if */
+    if (data != NULL)
+        allocator.Free(data);
+} /* PHYSFS_freeLoadedFile */
+
 
-    ecd.list[ecd.size] = NULL;
-    return ecd.list;
-} /* PHYSFS_enumerateFiles */
+/*
+ * How much PHYSFS_extractToNative() moves per step. Two of these are in
+ *  flight at once: a worker thread reads (and decompresses) into one
+ *  while the calling thread writes the other out.
+ */
+#define EXTRACT_BUFFER_SIZE (256 * 1024)
+
+typedef struct ExtractReadState
+{
+    PHYSFS_sint64 rc;
+    int fired;
+} ExtractReadState;
 
+static void extractReadComplete(PHYSFS_File *f, void *userdata,
+                                PHYSFS_sint64 rc)
+{
+    ExtractReadState *state = (ExtractReadState *) userdata;
+    state->rc = rc;
+    state->fired = 1;
+} /* extractReadComplete */
 
 /*
- * Broke out to seperate function so we can use stack allocation gratuitously.
+ * If both ends are plain native files (the source came from a dir
+ *  archiver), let the kernel move the bytes without us ever seeing them.
+ * Returns 1 if the copy was fully handled (with *written set), zero if
+ *  the platform can't kernel-copy this pair and the caller should stream
+ *  instead, -1 on failure.
  */
-static PHYSFS_EnumerateCallbackResult enumerateFromMountPoint(DirHandle *i,
-                                    const char *arcfname,
-                                    PHYSFS_EnumerateCallback callback,
-                                    const char *_fname, void *data)
+static int extractKernelCopy(FileHandle *fh, PHYSFS_Io *out,
+                             PHYSFS_sint64 *written)
 {
-    PHYSFS_EnumerateCallbackResult retval;
-    const size_t len = strlen(arcfname);
-    char *ptr = NULL;
-    char *end = NULL;
-    const size_t slen = strlen(i->mountPoint) + 1;
-    char *mountPoint = (char *) __PHYSFS_smallAlloc(slen);
+    PHYSFS_sint64 len;
+    void *src;
+    void *dst;
+    PHYSFS_uint64 pos = 0;
 
-    BAIL_IF(!mountPoint, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+    if (fh->io->destroy != nativeIo_destroy)
+        return 0;  /* source isn't a native file. */
 
-    strcpy(mountPoint, i->mountPoint);
-    ptr = mountPoint + ((len) ? len + 1 : 0);
-    end = strchr(ptr, '/');
-    assert(end);  /* should always find a terminating '/'. */
-    *end = '\0';
-    retval = callback(data, _fname, ptr);
-    __PHYSFS_smallFree(mountPoint);
+    len = fh->io->length(fh->io);
+    BAIL_IF_ERRPASS(len < 0, -1);
 
-    BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
-    return retval;
-} /* enumerateFromMountPoint */
+    src = ((NativeIoInfo *) fh->io->opaque)->shared->handle;
+    dst = ((NativeIoInfo *) out->opaque)->shared->handle;
 
+    while (pos < ((PHYSFS_uint64) len))
+    {
+        const PHYSFS_sint64 rc = __PHYSFS_platformCopyFileRange(src, pos,
+                                        dst, ((PHYSFS_uint64) len) - pos);
+        if ((rc == -1) && (pos == 0))
+            return 0;  /* OS can't; nothing written yet, safe to stream. */
+        BAIL_IF_ERRPASS(rc == -1, -1);
+        BAIL_IF(rc == 0, PHYSFS_ERR_IO, -1);  /* source truncated?! */
+        pos += (PHYSFS_uint64) rc;
+    } /* while */
 
-typedef struct SymlinkFilterData
-{
-    PHYSFS_EnumerateCallback callback;
-    void *callbackData;
-    DirHandle *dirhandle;
-    const char *arcfname;
-    PHYSFS_ErrorCode errcode;
-} SymlinkFilterData;
+    *written = len;
+    return 1;
+} /* extractKernelCopy */
 
-static PHYSFS_EnumerateCallbackResult enumCallbackFilterSymLinks(void *_data,
-                                    const char *origdir, const char *fname)
+PHYSFS_sint64 PHYSFS_extractToNative(const char *fname,
+                                     const char *nativePath)
 {
-    SymlinkFilterData *data = (SymlinkFilterData *) _data;
-    const DirHandle *dh = data->dirhandle;
-    const char *arcfname = data->arcfname;
-    PHYSFS_Stat statbuf;
-    const char *trimmedDir = (*arcfname == '/') ? (arcfname + 1) : arcfname;
-    const size_t slen = strlen(trimmedDir) + strlen(fname) + 2;
-    char *path = (char *) __PHYSFS_smallAlloc(slen);
-    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    PHYSFS_File *in = NULL;
+    PHYSFS_Io *out = NULL;
+    PHYSFS_uint8 *buf[2] = { NULL, NULL };
+    PHYSFS_sint64 retval = 0;
+    PHYSFS_ErrorCode err;
+    ExtractReadState state;
+    int pending = 0;
+    int cur = 0;
+    int rc;
 
-    if (path == NULL)
-    {
-        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
-        return PHYSFS_ENUM_ERROR;
-    } /* if */
+    BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, -1);
+    BAIL_IF(!nativePath, PHYSFS_ERR_INVALID_ARGUMENT, -1);
 
-    snprintf(path, slen, "%s%s%s", trimmedDir, *trimmedDir ? "/" : "", fname);
+    in = PHYSFS_openRead(fname);
+    BAIL_IF_ERRPASS(!in, -1);
 
-    if (!dh->funcs->stat(dh->opaque, path, &statbuf))
-    {
-        data->errcode = currentErrorCode();
-        retval = PHYSFS_ENUM_ERROR;
-    } /* if */
-    else
+    out = __PHYSFS_createNativeIo(nativePath, 'w');
+    GOTO_IF_ERRPASS(!out, extractFailed);
+
+    rc = extractKernelCopy((FileHandle *) in, out, &retval);
+    GOTO_IF_ERRPASS(rc == -1, extractFailed);
+    if (rc)
+        goto extractDone;
+
+    buf[0] = (PHYSFS_uint8 *) allocator.Malloc(EXTRACT_BUFFER_SIZE);
+    GOTO_IF(!buf[0], PHYSFS_ERR_OUT_OF_MEMORY, extractFailed);
+    buf[1] = (PHYSFS_uint8 *) allocator.Malloc(EXTRACT_BUFFER_SIZE);
+    GOTO_IF(!buf[1], PHYSFS_ERR_OUT_OF_MEMORY, extractFailed);
+
+    state.fired = 0;
+    GOTO_IF_ERRPASS(!PHYSFS_readBytesAsync(in, buf[cur], EXTRACT_BUFFER_SIZE,
+                                           extractReadComplete, &state),
+                    extractFailed);
+    pending = 1;
+
+    while (1)
     {
-        /* Pass it on to the application if it's not a symlink. */
-        if (statbuf.filetype != PHYSFS_FILETYPE_SYMLINK)
+        PHYSFS_sint64 br;
+        int eof;
+
+        PHYSFS_waitAsyncReads();
+        pending = 0;
+        assert(state.fired);
+        br = state.rc;
+        GOTO_IF_ERRPASS(br == -1, extractFailed);
+        eof = (((PHYSFS_uint64) br) < EXTRACT_BUFFER_SIZE);
+
+        /* kick off the next read before writing this block, so a worker
+           decompresses into one buffer while we write the other. */
+        if (!eof)
         {
-            retval = data->callback(data->callbackData, origdir, fname);
-            if (retval == PHYSFS_ENUM_ERROR)
-                data->errcode = PHYSFS_ERR_APP_CALLBACK;
+            state.fired = 0;
+            GOTO_IF_ERRPASS(!PHYSFS_readBytesAsync(in, buf[cur ^ 1],
+                                                   EXTRACT_BUFFER_SIZE,
+                                                   extractReadComplete,
+                                                   &state), extractFailed);
+            pending = 1;
         } /* if */
-    } /* else */
 
-    __PHYSFS_smallFree(path);
+        if (br > 0)
+        {
+            GOTO_IF_ERRPASS(out->write(out, buf[cur], br) != br,
+                            extractFailed);
+            retval += br;
+        } /* if */
 
-    return retval;
-} /* enumCallbackFilterSymLinks */
+        if (eof)
+            break;
+        cur ^= 1;
+    } /* while */
 
+extractDone:
+    GOTO_IF_ERRPASS(!out->flush(out), extractFailed);
+    out->destroy(out);
+    PHYSFS_close(in);
+    if (buf[0] != NULL) allocator.Free(buf[0]);
+    if (buf[1] != NULL) allocator.Free(buf[1]);
+    return retval;
 
-int PHYSFS_enumerate(const char *_fn, PHYSFS_EnumerateCallback cb, void *data)
-{
-    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
-    size_t len;
-    char *allocated_fname;
-    char *fname;
+extractFailed:
+    err = currentErrorCode();
+    if (pending)
+        PHYSFS_waitAsyncReads();  /* buffers belong to the read until then. */
+    if (out != NULL)
+    {
+        out->destroy(out);
+        __PHYSFS_platformDelete(nativePath);  /* no half-written files. */
+    } /* if */
+    PHYSFS_close(in);
+    if (buf[0] != NULL) allocator.Free(buf[0]);
+    if (buf[1] != NULL) allocator.Free(buf[1]);
+    PHYSFS_setErrorCode(err);
+    return -1;
+} /* PHYSFS_extractToNative */
 
-    BAIL_IF(!_fn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(!cb, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
+static PHYSFS_sint64 doBufferedWrite(PHYSFS_File *handle, const void *buffer,
+                                     const size_t len)
+{
+    FileHandle *fh = (FileHandle *) handle;
 
-    len = strlen(_fn) + longest_root + 1;
-    allocated_fname = (char *) __PHYSFS_smallAlloc(len);
-    BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-    fname = allocated_fname + longest_root;
-    if (!sanitizePlatformIndependentPath(_fn, fname))
-        retval = PHYSFS_ENUM_STOP;
-    else
+    /* whole thing fits in the buffer? */
+    if ((fh->buffill + len) < fh->bufsize)
     {
-        DirHandle *i;
-        SymlinkFilterData filterdata;
+        memcpy(fh->buffer + fh->buffill, buffer, len);
+        fh->buffill += len;
+        return (PHYSFS_sint64) len;
+    } /* if */
 
-        if (!allowSymLinks)
+    /* would overflow buffer. Flush and then write the new objects, too. */
+    if (fh->writeBehind)
+    {
+        /* hand the full buffer to a worker and keep going with a fresh one.
+           If the handoff can't be set up, just flush synchronously. */
+        if (queueWriteBehind(fh, NULL))
         {
-            memset(&filterdata, '\0', sizeof (filterdata));
-            filterdata.callback = cb;
-            filterdata.callbackData = data;
+            if (len < fh->bufsize)  /* fits in the fresh buffer? */
+            {
+                memcpy(fh->buffer, buffer, len);
+                fh->buffill = len;
+                return (PHYSFS_sint64) len;
+            } /* if */
+
+            /* too big to buffer; wait out the queue so bytes land in order,
+               then write this one directly. */
+            BAIL_IF_ERRPASS(!drainWriteBehindSync(fh), -1);
+            return fh->io->write(fh->io, buffer, len);
         } /* if */
+    } /* if */
 
-        for (i = searchPath; (retval == PHYSFS_ENUM_OK) && i; i = i->next)
-        {
-            char *arcfname = fname;
+    BAIL_IF_ERRPASS(!PHYSFS_flush(handle), -1);
+    return fh->io->write(fh->io, buffer, len);
+} /* doBufferedWrite */
 
-            if (partOfMountPoint(i, arcfname))
-                retval = enumerateFromMountPoint(i, arcfname, cb, _fn, data);
 
-            else if (verifyPath(i, &arcfname, 0))
-            {
-                PHYSFS_Stat statbuf;
-                if (!i->funcs->stat(i->opaque, arcfname, &statbuf))
-                {
-                    if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
-                        continue;  /* no such dir in this archive, skip it. */
-                } /* if */
+PHYSFS_sint64 PHYSFS_write(PHYSFS_File *handle, const void *buffer,
+                           PHYSFS_uint32 size, PHYSFS_uint32 count)
+{
+    const PHYSFS_uint64 len = ((PHYSFS_uint64) size) * ((PHYSFS_uint64) count);
+    const PHYSFS_sint64 retval = PHYSFS_writeBytes(handle, buffer, len);
+    return ( (retval <= 0) ? retval : (retval / ((PHYSFS_sint64) size)) );
+} /* PHYSFS_write */
 
-                if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
-                    continue;  /* not a directory in this archive, skip it. */
 
-                else if ((!allowSymLinks) && (i->funcs->info.supportsSymlinks))
-                {
-                    filterdata.dirhandle = i;
-                    filterdata.arcfname = arcfname;
-                    filterdata.errcode = PHYSFS_ERR_OK;
-                    retval = i->funcs->enumerate(i->opaque, arcfname,
-                                                 enumCallbackFilterSymLinks,
-                                                 _fn, &filterdata);
-                    if (retval == PHYSFS_ENUM_ERROR)
-                    {
-                        if (currentErrorCode() == PHYSFS_ERR_APP_CALLBACK)
-                            PHYSFS_setErrorCode(filterdata.errcode);
-                    } /* if */
-                } /* else if */
-                else
-                {
-                    retval = i->funcs->enumerate(i->opaque, arcfname,
-                                                 cb, _fn, data);
-                } /* else */
-            } /* else if */
-        } /* for */
+PHYSFS_sint64 PHYSFS_writeBytes(PHYSFS_File *handle, const void *buffer,
+                                PHYSFS_uint64 _len)
+{
+    const size_t len = (size_t) _len;
+    FileHandle *fh = (FileHandle *) handle;
 
-    } /* if */
+#ifdef PHYSFS_NO_64BIT_SUPPORT
+    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFF);
+#else
+    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFFFFFFFFFF);
+#endif
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+    if (!__PHYSFS_ui64FitsAddressSpace(_len))
+        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
 
-    __PHYSFS_smallFree(allocated_fname);
+    BAIL_IF(_len > maxlen, PHYSFS_ERR_INVALID_ARGUMENT, -1);
+    BAIL_IF(fh->forReading, PHYSFS_ERR_OPEN_FOR_READING, -1);
+    BAIL_IF_ERRPASS(len == 0, 0);
+    if (fh->buffer)
+        return doBufferedWrite(handle, buffer, len);
 
-    return (retval == PHYSFS_ENUM_ERROR) ? 0 : 1;
-} /* PHYSFS_enumerate */
+    return fh->io->write(fh->io, buffer, len);
+} /* PHYSFS_write */
 
 
-typedef struct
+int PHYSFS_eof(PHYSFS_File *handle)
 {
-    PHYSFS_EnumFilesCallback callback;
-    void *data;
-} LegacyEnumFilesCallbackData;
+    FileHandle *fh = (FileHandle *) handle;
 
-static PHYSFS_EnumerateCallbackResult enumFilesCallbackAlwaysSucceed(void *d,
-                                    const char *origdir, const char *fname)
+    if (!fh->forReading)  /* never EOF on files opened for write/append. */
+        return 0;
+
+    /* can't be eof if buffer isn't empty */
+    if (fh->bufpos == fh->buffill)
+    {
+        /* check the Io. */
+        PHYSFS_Io *io = fh->io;
+        const PHYSFS_sint64 pos = io->tell(io);
+        const PHYSFS_sint64 len = io->length(io);
+        if ((pos < 0) || (len < 0))
+            return 0;  /* beats me. */
+        return (pos >= len);
+    } /* if */
+
+    return 0;
+} /* PHYSFS_eof */
+
+
+PHYSFS_sint64 PHYSFS_tell(PHYSFS_File *handle)
 {
-    LegacyEnumFilesCallbackData *cbdata = (LegacyEnumFilesCallbackData *) d;
-    cbdata->callback(cbdata->data, origdir, fname);
-    return PHYSFS_ENUM_OK;
-} /* enumFilesCallbackAlwaysSucceed */
+    FileHandle *fh = (FileHandle *) handle;
+    PHYSFS_sint64 pos;
 
-void PHYSFS_enumerateFilesCallback(const char *fname,
-                                   PHYSFS_EnumFilesCallback callback,
-                                   void *data)
+    if ((!fh->forReading) && (fh->writeBehind))
+    {
+        /* while buffers are in flight, the io's position lags the app's
+           logical position; (wbTell) tracks where the queued data ends. */
+        __PHYSFS_platformGrabMutex(asyncLock);
+        if ((fh->wbqueue != NULL) || (fh->wbDraining))
+            pos = fh->wbTell;
+        else
+            pos = fh->io->tell(fh->io);
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        return pos + fh->buffill;
+    } /* if */
+
+    pos = fh->io->tell(fh->io);
+    return fh->forReading ? (pos - fh->buffill) + fh->bufpos :
+                            (pos + fh->buffill);
+} /* PHYSFS_tell */
+
+
+int PHYSFS_seek(PHYSFS_File *handle, PHYSFS_uint64 pos)
 {
-    LegacyEnumFilesCallbackData cbdata;
-    cbdata.callback = callback;
-    cbdata.data = data;
-    (void) PHYSFS_enumerate(fname, enumFilesCallbackAlwaysSucceed, &cbdata);
-} /* PHYSFS_enumerateFilesCallback */
+    FileHandle *fh = (FileHandle *) handle;
+    BAIL_IF_ERRPASS(!PHYSFS_flush(handle), 0);
+
+    if (fh->buffer && fh->forReading)
+    {
+        /* avoid throwing away our precious buffer if seeking within it. */
+        PHYSFS_sint64 offset = pos - PHYSFS_tell(handle);
+        if ( /* seeking within the already-buffered range? */
+             /* forward? */
+            ((offset >= 0) && (((size_t)offset) <= fh->buffill-fh->bufpos)) ||
+            /* backward? */
+            ((offset < 0) && (((size_t) -offset) <= fh->bufpos)) )
+        {
+            fh->bufpos = (size_t) (((PHYSFS_sint64) fh->bufpos) + offset);
+            return 1; /* successful seek */
+        } /* if */
+    } /* if */
 
+    /* we have to fall back to a 'raw' seek. */
+    fh->buffill = fh->bufpos = 0;
 
-int PHYSFS_exists(const char *fname)
-{
-    return (getRealDirHandle(fname) != NULL);
-} /* PHYSFS_exists */
+    /* random access: snap the readahead window back to the app-set size.
+       The allocation stays at its high-water mark (bounded by the cap) so
+       regrowth is cheap if the app goes back to streaming. */
+    fh->bufwindow = fh->bufsize;
+    fh->bufstreak = 0;
+
+    return fh->io->seek(fh->io, pos);
+} /* PHYSFS_seek */
 
 
-PHYSFS_sint64 PHYSFS_getLastModTime(const char *fname)
+PHYSFS_sint64 PHYSFS_fileLength(PHYSFS_File *handle)
 {
-    PHYSFS_Stat statbuf;
-    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), -1);
-    return statbuf.modtime;
-} /* PHYSFS_getLastModTime */
+    PHYSFS_Io *io = ((FileHandle *) handle)->io;
+    return io->length(io);
+} /* PHYSFS_filelength */
 
 
-int PHYSFS_isDirectory(const char *fname)
+const void *PHYSFS_mmap(PHYSFS_File *handle, PHYSFS_uint64 *len)
 {
-    PHYSFS_Stat statbuf;
-    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
-    return (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
-} /* PHYSFS_isDirectory */
+    FileHandle *fh = (FileHandle *) handle;
+    PHYSFS_Io *io = fh->io;
 
+    BAIL_IF(!len, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, NULL);
+    BAIL_IF(!__PHYSFS_ioHasMap(io), PHYSFS_ERR_UNSUPPORTED, NULL);
 
-int PHYSFS_isSymbolicLink(const char *fname)
-{
-    PHYSFS_Stat statbuf;
-    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
-    return (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
-} /* PHYSFS_isSymbolicLink */
+    return io->map(io, len);  /* unmapped when the handle is destroyed. */
+} /* PHYSFS_mmap */
 
 
-static PHYSFS_File *doOpenWrite(const char *_fname, const int appending)
+/* asyncLock must be held! */
+static void completeAsyncRead(AsyncReadRequest *req)
 {
-    FileHandle *fh = NULL;
-    DirHandle *h;
-    size_t len;
-    char *fname;
+    req->next = NULL;
+    if (asyncCompletedTail != NULL)
+        asyncCompletedTail->next = req;
+    else
+        asyncCompleted = req;
+    asyncCompletedTail = req;
+} /* completeAsyncRead */
 
-    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
+/*
+ * Prefetches read and discard in chunks of this size, so warming a huge
+ *  file never needs a request-sized allocation.
+ */
+#define PHYSFS_PREFETCH_CHUNK (64 * 1024)
 
-    h = writeDir;
-    BAIL_IF_MUTEX(!h, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
+/*
+ * Read and throw away (len) bytes from (fh) at its current position; (len)
+ *  of zero means read to end of file. The point is the side effects: the
+ *  pass drags the data through the OS page cache and, if a content cache is
+ *  enabled, leaves the decompressed bytes there for the next open.
+ */
+static PHYSFS_sint64 doPrefetchRead(FileHandle *fh, const PHYSFS_uint64 len)
+{
+    void *scratch = allocator.Malloc(PHYSFS_PREFETCH_CHUNK);
+    PHYSFS_sint64 retval = 0;
 
-    len = strlen(_fname) + dirHandleRootLen(h) + 1;
-    fname = (char *) __PHYSFS_smallAlloc(len);
-    BAIL_IF_MUTEX(!fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+    BAIL_IF(!scratch, PHYSFS_ERR_OUT_OF_MEMORY, -1);
 
-    if (sanitizePlatformIndependentPathWithRoot(h, _fname, fname))
+    while ((len == 0) || (((PHYSFS_uint64) retval) < len))
     {
-        PHYSFS_Io *io = NULL;
-        char *arcfname = fname;
-        if (verifyPath(h, &arcfname, 0))
+        PHYSFS_uint64 cpy = PHYSFS_PREFETCH_CHUNK;
+        PHYSFS_sint64 rc;
+        if ((len != 0) && ((len - ((PHYSFS_uint64) retval)) < cpy))
+            cpy = len - ((PHYSFS_uint64) retval);
+        rc = PHYSFS_readBytes((PHYSFS_File *) fh, scratch, cpy);
+        if (rc <= 0)
         {
-            const PHYSFS_Archiver *f = h->funcs;
-            if (appending)
-                io = f->openAppend(h->opaque, arcfname);
-            else
-                io = f->openWrite(h->opaque, arcfname);
-
-            if (io)
-            {
-                fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
-                if (fh == NULL)
-                {
-                    io->destroy(io);
-                    PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
-                } /* if */
-                else
-                {
-                    memset(fh, '\0', sizeof (FileHandle));
-                    fh->io = io;
-                    fh->dirHandle = h;
-                    fh->next = openWriteList;
-                    openWriteList = fh;
-                } /* else */
-            } /* if */
+            if (retval == 0)  /* report already-read data, or failure. */
+                retval = rc;
+            break;
         } /* if */
-    } /* if */
-
-    __PHYSFS_platformReleaseMutex(stateLock);
+        retval += rc;
+        if (((PHYSFS_uint64) rc) < cpy)
+            break;  /* hit EOF. */
+    } /* while */
 
-    __PHYSFS_smallFree(fname);
-    return ((PHYSFS_File *) fh);
-} /* doOpenWrite */
+    allocator.Free(scratch);
+    return retval;
+} /* doPrefetchRead */
 
 
-PHYSFS_File *PHYSFS_openWrite(const char *filename)
+/*
+ * Detach (fh)'s write buffer into the write-behind queue and replace it
+ *  with a fresh one, so the app can keep filling while a worker writes.
+ *  A (completion) request, if given, rides along on the detached buffer
+ *  and is completed once it (and everything queued before it) has hit the
+ *  archiver. Returns zero if the handoff couldn't be arranged; the caller
+ *  should fall back to a synchronous flush.
+ */
+static int queueWriteBehind(FileHandle *fh, AsyncReadRequest *completion)
 {
-    return doOpenWrite(filename, 0);
-} /* PHYSFS_openWrite */
+    WriteBehindBuf *wb;
+    PHYSFS_uint8 *fresh;
+    AsyncReadRequest *drainreq = NULL;
+    int inlineDrain = 0;
 
+    wb = (WriteBehindBuf *) allocator.Malloc(sizeof (WriteBehindBuf));
+    BAIL_IF(!wb, PHYSFS_ERR_OUT_OF_MEMORY, 0);
 
-PHYSFS_File *PHYSFS_openAppend(const char *filename)
-{
-    return doOpenWrite(filename, 1);
-} /* PHYSFS_openAppend */
+    fresh = (PHYSFS_uint8 *) allocator.Malloc(fh->bufsize);
+    if (fresh == NULL)
+    {
+        allocator.Free(wb);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
 
+    wb->buffer = fh->buffer;
+    wb->len = fh->buffill;
+    wb->completion = completion;
+    wb->next = NULL;
 
-PHYSFS_File *PHYSFS_openRead(const char *_fname)
-{
-    FileHandle *fh = NULL;
-    char *allocated_fname;
-    char *fname;
-    size_t len;
+    fh->buffer = fresh;
+    fh->buffill = fh->bufpos = 0;
 
-    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    __PHYSFS_platformGrabMutex(asyncLock);
+    startAsyncReadThreads();
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    /* while buffers are in flight, the io's position lags the app's;
+       track the logical end so PHYSFS_tell() stays honest. The io is
+       idle right now if nothing was queued, so it's safe to ask it. */
+    if ((fh->wbqueue == NULL) && (!fh->wbDraining))
+        fh->wbTell = fh->io->tell(fh->io);
+    fh->wbTell += (PHYSFS_sint64) wb->len;
 
-    BAIL_IF_MUTEX(!searchPath, PHYSFS_ERR_NOT_FOUND, stateLock, 0);
+    if (fh->wbqueueTail != NULL)
+        fh->wbqueueTail->next = wb;
+    else
+        fh->wbqueue = wb;
+    fh->wbqueueTail = wb;
 
-    len = strlen(_fname) + longest_root + 1;
-    allocated_fname = (char *) __PHYSFS_smallAlloc(len);
-    BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
-    fname = allocated_fname + longest_root;
+    if (completion != NULL)
+        asyncPending++;
 
-    if (sanitizePlatformIndependentPath(_fname, fname))
+    if (!fh->wbDraining)
     {
-        PHYSFS_Io *io = NULL;
-        DirHandle *i;
-
-        for (i = searchPath; i != NULL; i = i->next)
-        {
-            char *arcfname = fname;
-            if (verifyPath(i, &arcfname, 0))
-            {
-                io = i->funcs->openRead(i->opaque, arcfname);
-                if (io)
-                    break;
-            } /* if */
-        } /* for */
-
-        if (io)
+        fh->wbDraining = 1;
+        if (asyncThreadsFailed)
+            inlineDrain = 1;  /* no threads; write it out on this thread. */
+        else
         {
-            fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
-            if (fh == NULL)
-            {
-                io->destroy(io);
-                PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
-            } /* if */
+            const size_t reqlen = sizeof (AsyncReadRequest);
+            drainreq = (AsyncReadRequest *) allocator.Malloc(reqlen);
+            if (drainreq == NULL)
+                inlineDrain = 1;  /* nothing to hand a worker; do it here. */
             else
             {
-                memset(fh, '\0', sizeof (FileHandle));
-                fh->io = io;
-                fh->forReading = 1;
-                fh->dirHandle = i;
-                fh->next = openReadList;
-                openReadList = fh;
+                memset(drainreq, '\0', sizeof (*drainreq));
+                drainreq->file = fh;
+                drainreq->isFlush = 1;
+                drainreq->errcode = PHYSFS_ERR_OK;
+                asyncPending++;
+                if (asyncQueueTail != NULL)
+                    asyncQueueTail->next = drainreq;
+                else
+                    asyncQueue = drainreq;
+                asyncQueueTail = drainreq;
             } /* else */
-        } /* if */
+        } /* else */
     } /* if */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
-    __PHYSFS_smallFree(allocated_fname);
-    return ((PHYSFS_File *) fh);
-} /* PHYSFS_openRead */
+    __PHYSFS_platformReleaseMutex(asyncLock);
 
+    if (inlineDrain)
+        drainWriteBehind(fh);
+    else if (drainreq != NULL)
+        __PHYSFS_platformPostSemaphore(asyncWorkSem);
+
+    return 1;
+} /* queueWriteBehind */
 
-static int closeHandleInOpenList(FileHandle **list, FileHandle *handle)
-{
-    FileHandle *prev = NULL;
-    FileHandle *i;
 
-    for (i = *list; i != NULL; i = i->next)
+/*
+ * Write out everything in (fh)'s write-behind queue. Only one thread
+ *  drains a given handle at a time--(fh->wbDraining) gates entry--so the
+ *  io is never hit from two threads at once.
+ */
+static void drainWriteBehind(FileHandle *fh)
+{
+    __PHYSFS_platformGrabMutex(asyncLock);
+    while (1)
     {
-        if (i == handle)  /* handle is in this list? */
+        WriteBehindBuf *wb = fh->wbqueue;
+        PHYSFS_ErrorCode err;
+
+        if (wb == NULL)
         {
-            PHYSFS_Io *io = handle->io;
-            PHYSFS_uint8 *tmp = handle->buffer;
+            fh->wbDraining = 0;
+            if (fh->wbWaitSem != NULL)  /* wake any synchronous waiter. */
+                __PHYSFS_platformPostSemaphore(fh->wbWaitSem);
+            __PHYSFS_platformReleaseMutex(asyncLock);
+            return;
+        } /* if */
 
-            /* send our buffer to io... */
-            if (!handle->forReading)
-            {
-                if (!PHYSFS_flush((PHYSFS_File *) handle))
-                    return -1;
+        fh->wbqueue = wb->next;
+        if (fh->wbqueue == NULL)
+            fh->wbqueueTail = NULL;
+        err = fh->wbErrcode;
+        __PHYSFS_platformReleaseMutex(asyncLock);
 
-                /* ...then have io send it to the disk... */
-                else if (io->flush && !io->flush(io))
-                    return -1;
+        /* after a failure, stop writing: dribbling later buffers around a
+           hole would corrupt the file. The error stays sticky until the
+           next synchronous flush reports it. */
+        if ((err == PHYSFS_ERR_OK) && (wb->len > 0))
+        {
+            const PHYSFS_sint64 rc = fh->io->write(fh->io, wb->buffer,
+                                                   wb->len);
+            if ((rc < 0) || (((PHYSFS_uint64) rc) < ((PHYSFS_uint64) wb->len)))
+            {
+                err = PHYSFS_getLastErrorCode();
+                if (err == PHYSFS_ERR_OK)
+                    err = PHYSFS_ERR_OS_ERROR;  /* short write, no code. */
             } /* if */
+        } /* if */
 
-            /* ...then close the underlying file. */
-            io->destroy(io);
-
-            if (tmp != NULL)  /* free any associated buffer. */
-                allocator.Free(tmp);
+        allocator.Free(wb->buffer);
 
-            if (prev == NULL)
-                *list = handle->next;
-            else
-                prev->next = handle->next;
+        __PHYSFS_platformGrabMutex(asyncLock);
+        if ((err != PHYSFS_ERR_OK) && (fh->wbErrcode == PHYSFS_ERR_OK))
+            fh->wbErrcode = err;
 
-            allocator.Free(handle);
-            return 1;
+        if (wb->completion != NULL)
+        {
+            AsyncReadRequest *req = wb->completion;
+            req->result = (fh->wbErrcode == PHYSFS_ERR_OK) ? 1 : -1;
+            req->errcode = fh->wbErrcode;
+            completeAsyncRead(req);
+            if (asyncDoneSem != NULL)
+                __PHYSFS_platformPostSemaphore(asyncDoneSem);
         } /* if */
-        prev = i;
-    } /* for */
 
-    return 0;
-} /* closeHandleInOpenList */
+        allocator.Free(wb);
+    } /* while */
+} /* drainWriteBehind */
 
 
-int PHYSFS_close(PHYSFS_File *_handle)
+/*
+ * Block until (fh)'s write-behind queue is empty and no worker is writing
+ *  it out, then surface any background write error. App-thread side.
+ */
+static int drainWriteBehindSync(FileHandle *fh)
 {
-    FileHandle *handle = (FileHandle *) _handle;
-    int rc;
+    PHYSFS_ErrorCode err;
 
-    __PHYSFS_platformGrabMutex(stateLock);
-
-    /* -1 == close failure. 0 == not found. 1 == success. */
-    rc = closeHandleInOpenList(&openReadList, handle);
-    BAIL_IF_MUTEX_ERRPASS(rc == -1, stateLock, 0);
-    if (!rc)
+    __PHYSFS_platformGrabMutex(asyncLock);
+    while ((fh->wbqueue != NULL) || (fh->wbDraining))
     {
-        rc = closeHandleInOpenList(&openWriteList, handle);
-        BAIL_IF_MUTEX_ERRPASS(rc == -1, stateLock, 0);
-    } /* if */
-
-    __PHYSFS_platformReleaseMutex(stateLock);
-    BAIL_IF(!rc, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    return 1;
-} /* PHYSFS_close */
-
+        if (fh->wbWaitSem == NULL)
+            fh->wbWaitSem = __PHYSFS_platformCreateSemaphore();
 
-static PHYSFS_sint64 doBufferedRead(FileHandle *fh, void *_buffer, size_t len)
-{
-    PHYSFS_uint8 *buffer = (PHYSFS_uint8 *) _buffer;
-    PHYSFS_sint64 retval = 0;
+        __PHYSFS_platformReleaseMutex(asyncLock);
 
-    while (len > 0)
-    {
-        const size_t avail = fh->buffill - fh->bufpos;
-        if (avail > 0)  /* data available in the buffer. */
-        {
-            const size_t cpy = (len < avail) ? len : avail;
-            memcpy(buffer, fh->buffer + fh->bufpos, cpy);
-            assert(len >= cpy);
-            buffer += cpy;
-            len -= cpy;
-            fh->bufpos += cpy;
-            retval += cpy;
-        } /* if */
+        /* a stale post just makes us loop and recheck, which is harmless.
+           No semaphore at all (out of memory?) degrades to a spin. */
+        if (fh->wbWaitSem != NULL)
+            __PHYSFS_platformWaitSemaphore(fh->wbWaitSem);
 
-        else   /* buffer is empty, refill it. */
-        {
-            PHYSFS_Io *io = fh->io;
-            const PHYSFS_sint64 rc = io->read(io, fh->buffer, fh->bufsize);
-            fh->bufpos = 0;
-            if (rc > 0)
-                fh->buffill = (size_t) rc;
-            else
-            {
-                fh->buffill = 0;
-                if (retval == 0)  /* report already-read data, or failure. */
-                    retval = rc;
-                break;
-            } /* else */
-        } /* else */
+        __PHYSFS_platformGrabMutex(asyncLock);
     } /* while */
 
-    return retval;
-} /* doBufferedRead */
+    err = fh->wbErrcode;
+    fh->wbErrcode = PHYSFS_ERR_OK;
+    __PHYSFS_platformReleaseMutex(asyncLock);
 
+    BAIL_IF(err != PHYSFS_ERR_OK, err, 0);
+    return 1;
+} /* drainWriteBehindSync */
 
-PHYSFS_sint64 PHYSFS_read(PHYSFS_File *handle, void *buffer,
-                          PHYSFS_uint32 size, PHYSFS_uint32 count)
+
+static void asyncReadWorker(void *arg)
 {
-    const PHYSFS_uint64 len = ((PHYSFS_uint64) size) * ((PHYSFS_uint64) count);
-    const PHYSFS_sint64 retval = PHYSFS_readBytes(handle, buffer, len);
-    return ( (retval <= 0) ? retval : (retval / ((PHYSFS_sint64) size)) );
-} /* PHYSFS_read */
+    while (1)
+    {
+        AsyncReadRequest *req;
 
+        __PHYSFS_platformWaitSemaphore(asyncWorkSem);
 
-PHYSFS_sint64 PHYSFS_readBytes(PHYSFS_File *handle, void *buffer,
-                               PHYSFS_uint64 _len)
-{
-    const size_t len = (size_t) _len;
-    FileHandle *fh = (FileHandle *) handle;
+        __PHYSFS_platformGrabMutex(asyncLock);
+        if (asyncShutdown)
+        {
+            __PHYSFS_platformReleaseMutex(asyncLock);
+            return;
+        } /* if */
 
-#ifdef PHYSFS_NO_64BIT_SUPPORT
-    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFF);
-#else
-    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFFFFFFFFFF);
-#endif
+        req = asyncQueue;
+        if (req != NULL)
+        {
+            asyncQueue = req->next;
+            if (asyncQueue == NULL)
+                asyncQueueTail = NULL;
+        } /* if */
+        __PHYSFS_platformReleaseMutex(asyncLock);
 
-    if (!__PHYSFS_ui64FitsAddressSpace(_len))
-        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
+        if (req == NULL)
+            continue;  /* spurious wakeup; back to sleep. */
 
-    BAIL_IF(_len > maxlen, PHYSFS_ERR_INVALID_ARGUMENT, -1);
-    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, -1);
-    BAIL_IF_ERRPASS(len == 0, 0);
-    if (fh->buffer)
-        return doBufferedRead(fh, buffer, len);
+        if (req->isFlush)  /* a write-behind drain job. */
+        {
+            drainWriteBehind(req->file);
+            req->result = 1;
+        } /* if */
+        else if (req->callback == NULL)  /* a prefetch; we own the handle. */
+        {
+            req->result = doPrefetchRead(req->file, req->len);
+            PHYSFS_close((PHYSFS_File *) req->file);
+        } /* else if */
+        else
+        {
+            req->result = PHYSFS_readBytes((PHYSFS_File *) req->file,
+                                           req->buffer, req->len);
+        } /* else */
+        req->errcode = PHYSFS_getLastErrorCode();
 
-    return fh->io->read(fh->io, buffer, len);
-} /* PHYSFS_readBytes */
+        __PHYSFS_platformGrabMutex(asyncLock);
+        completeAsyncRead(req);
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        __PHYSFS_platformPostSemaphore(asyncDoneSem);
+    } /* while */
+} /* asyncReadWorker */
 
 
-static PHYSFS_sint64 doBufferedWrite(PHYSFS_File *handle, const void *buffer,
-                                     const size_t len)
+/* asyncLock must be held! */
+static void startAsyncReadThreads(void)
 {
-    FileHandle *fh = (FileHandle *) handle;
+    if ((asyncThreadCount > 0) || (asyncThreadsFailed))
+        return;  /* already running (or known to be impossible). */
 
-    /* whole thing fits in the buffer? */
-    if ((fh->buffill + len) < fh->bufsize)
+    asyncWorkSem = __PHYSFS_platformCreateSemaphore();
+    asyncDoneSem = asyncWorkSem ? __PHYSFS_platformCreateSemaphore() : NULL;
+    if (asyncDoneSem != NULL)
     {
-        memcpy(fh->buffer + fh->buffill, buffer, len);
-        fh->buffill += len;
-        return (PHYSFS_sint64) len;
+        int i;
+        for (i = 0; i < PHYSFS_ASYNC_READ_THREADS; i++)
+        {
+            void *t = __PHYSFS_platformCreateThread(asyncReadWorker, NULL);
+            if (t == NULL)
+                break;  /* take what we could get. */
+            asyncThreads[asyncThreadCount++] = t;
+        } /* for */
     } /* if */
 
-    /* would overflow buffer. Flush and then write the new objects, too. */
-    BAIL_IF_ERRPASS(!PHYSFS_flush(handle), -1);
-    return fh->io->write(fh->io, buffer, len);
-} /* doBufferedWrite */
+    if (asyncThreadCount == 0)  /* no threads? Reads will run inline. */
+    {
+        if (asyncDoneSem != NULL)
+            __PHYSFS_platformDestroySemaphore(asyncDoneSem);
+        if (asyncWorkSem != NULL)
+            __PHYSFS_platformDestroySemaphore(asyncWorkSem);
+        asyncWorkSem = asyncDoneSem = NULL;
+        asyncThreadsFailed = 1;
+    } /* if */
+} /* startAsyncReadThreads */
 
 
-PHYSFS_sint64 PHYSFS_write(PHYSFS_File *handle, const void *buffer,
-                           PHYSFS_uint32 size, PHYSFS_uint32 count)
+int PHYSFS_readBytesAsync(PHYSFS_File *handle, void *buffer, PHYSFS_uint64 len,
+                          PHYSFS_AsyncReadCallback callback, void *userdata)
 {
-    const PHYSFS_uint64 len = ((PHYSFS_uint64) size) * ((PHYSFS_uint64) count);
-    const PHYSFS_sint64 retval = PHYSFS_writeBytes(handle, buffer, len);
-    return ( (retval <= 0) ? retval : (retval / ((PHYSFS_sint64) size)) );
-} /* PHYSFS_write */
+    FileHandle *fh = (FileHandle *) handle;
+    AsyncReadRequest *req;
+
+    BAIL_IF(!callback, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, 0);
+
+    req = (AsyncReadRequest *) allocator.Malloc(sizeof (AsyncReadRequest));
+    BAIL_IF(!req, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    req->file = fh;
+    req->buffer = buffer;
+    req->len = len;
+    req->callback = callback;
+    req->userdata = userdata;
+    req->result = -1;
+    req->errcode = PHYSFS_ERR_OK;
+    req->isFlush = 0;
+    req->flushcb = NULL;
+    req->next = NULL;
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+    startAsyncReadThreads();
+    asyncPending++;
+
+    if (asyncThreadsFailed)
+    {
+        /* single-threaded platform: read now, deliver at the next poll, so
+           the app's control flow is the same either way. */
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        req->result = PHYSFS_readBytes(handle, buffer, len);
+        req->errcode = PHYSFS_getLastErrorCode();
+        __PHYSFS_platformGrabMutex(asyncLock);
+        completeAsyncRead(req);
+        __PHYSFS_platformReleaseMutex(asyncLock);
+    } /* if */
+    else
+    {
+        if (asyncQueueTail != NULL)
+            asyncQueueTail->next = req;
+        else
+            asyncQueue = req;
+        asyncQueueTail = req;
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        __PHYSFS_platformPostSemaphore(asyncWorkSem);
+    } /* else */
+
+    return 1;
+} /* PHYSFS_readBytesAsync */
 
 
-PHYSFS_sint64 PHYSFS_writeBytes(PHYSFS_File *handle, const void *buffer,
-                                PHYSFS_uint64 _len)
+int PHYSFS_prefetch(const char *fname, PHYSFS_uint64 offset, PHYSFS_uint64 len)
 {
-    const size_t len = (size_t) _len;
-    FileHandle *fh = (FileHandle *) handle;
+    PHYSFS_File *handle;
+    FileHandle *fh;
+    AsyncReadRequest *req;
 
-#ifdef PHYSFS_NO_64BIT_SUPPORT
-    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFF);
-#else
-    const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFFFFFFFFFF);
-#endif
+    handle = PHYSFS_openRead(fname);
+    BAIL_IF_ERRPASS(!handle, 0);
 
-    if (!__PHYSFS_ui64FitsAddressSpace(_len))
-        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
+    if ((offset > 0) && (!PHYSFS_seek(handle, offset)))
+    {
+        PHYSFS_close(handle);
+        return 0;  /* error already set by the seek. */
+    } /* if */
 
-    BAIL_IF(_len > maxlen, PHYSFS_ERR_INVALID_ARGUMENT, -1);
-    BAIL_IF(fh->forReading, PHYSFS_ERR_OPEN_FOR_READING, -1);
-    BAIL_IF_ERRPASS(len == 0, 0);
-    if (fh->buffer)
-        return doBufferedWrite(handle, buffer, len);
+    req = (AsyncReadRequest *) allocator.Malloc(sizeof (AsyncReadRequest));
+    if (req == NULL)
+    {
+        PHYSFS_close(handle);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
 
-    return fh->io->write(fh->io, buffer, len);
-} /* PHYSFS_write */
+    fh = (FileHandle *) handle;
+    req->file = fh;
+    req->buffer = NULL;
+    req->len = len;
+    req->callback = NULL;  /* NULL callback is what marks a prefetch. */
+    req->userdata = NULL;
+    req->result = -1;
+    req->errcode = PHYSFS_ERR_OK;
+    req->isFlush = 0;
+    req->flushcb = NULL;
+    req->next = NULL;
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+    startAsyncReadThreads();
+    asyncPending++;
+
+    if (asyncThreadsFailed)
+    {
+        /* single-threaded platform: there's nothing to warm ahead of, but
+           run the pass anyway so caches end up in the same state. */
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        req->result = doPrefetchRead(fh, len);
+        req->errcode = PHYSFS_getLastErrorCode();
+        PHYSFS_close(handle);
+        __PHYSFS_platformGrabMutex(asyncLock);
+        completeAsyncRead(req);
+        __PHYSFS_platformReleaseMutex(asyncLock);
+    } /* if */
+    else
+    {
+        if (asyncQueueTail != NULL)
+            asyncQueueTail->next = req;
+        else
+            asyncQueue = req;
+        asyncQueueTail = req;
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        __PHYSFS_platformPostSemaphore(asyncWorkSem);
+    } /* else */
+
+    return 1;
+} /* PHYSFS_prefetch */
 
 
-int PHYSFS_eof(PHYSFS_File *handle)
+int PHYSFS_pollAsyncReads(void)
 {
-    FileHandle *fh = (FileHandle *) handle;
+    int retval;
 
-    if (!fh->forReading)  /* never EOF on files opened for write/append. */
-        return 0;
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
 
-    /* can't be eof if buffer isn't empty */
-    if (fh->bufpos == fh->buffill)
+    __PHYSFS_platformGrabMutex(asyncLock);
+    while (asyncCompleted != NULL)
     {
-        /* check the Io. */
-        PHYSFS_Io *io = fh->io;
-        const PHYSFS_sint64 pos = io->tell(io);
-        const PHYSFS_sint64 len = io->length(io);
-        if ((pos < 0) || (len < 0))
-            return 0;  /* beats me. */
-        return (pos >= len);
-    } /* if */
-
-    return 0;
-} /* PHYSFS_eof */
+        AsyncReadRequest *req = asyncCompleted;
+        asyncCompleted = req->next;
+        if (asyncCompleted == NULL)
+            asyncCompletedTail = NULL;
+        asyncPending--;
+
+        /* drop the lock for the callback; it may queue more reads. */
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        PHYSFS_setErrorCode(req->errcode);
+        if (req->isFlush)  /* internal drain jobs have no callback. */
+        {
+            if (req->flushcb != NULL)
+                req->flushcb((PHYSFS_File *) req->file, req->userdata,
+                             (req->result > 0));
+        } /* if */
+        else if (req->callback != NULL)  /* prefetches complete silently. */
+            req->callback((PHYSFS_File *) req->file, req->userdata,
+                          req->result);
+        allocator.Free(req);
+        __PHYSFS_platformGrabMutex(asyncLock);
+    } /* while */
 
+    retval = asyncPending;
+    __PHYSFS_platformReleaseMutex(asyncLock);
 
-PHYSFS_sint64 PHYSFS_tell(PHYSFS_File *handle)
-{
-    FileHandle *fh = (FileHandle *) handle;
-    const PHYSFS_sint64 pos = fh->io->tell(fh->io);
-    const PHYSFS_sint64 retval = fh->forReading ?
-                                 (pos - fh->buffill) + fh->bufpos :
-                                 (pos + fh->buffill);
     return retval;
-} /* PHYSFS_tell */
+} /* PHYSFS_pollAsyncReads */
 
 
-int PHYSFS_seek(PHYSFS_File *handle, PHYSFS_uint64 pos)
+void PHYSFS_waitAsyncReads(void)
 {
-    FileHandle *fh = (FileHandle *) handle;
-    BAIL_IF_ERRPASS(!PHYSFS_flush(handle), 0);
+    if (!initialized)
+        return;
 
-    if (fh->buffer && fh->forReading)
+    /* a stale post just makes us loop and poll again, which is harmless. */
+    while (PHYSFS_pollAsyncReads() > 0)
+        __PHYSFS_platformWaitSemaphore(asyncDoneSem);
+} /* PHYSFS_waitAsyncReads */
+
+
+static void shutdownAsyncReads(void)
+{
+    if (asyncThreadCount > 0)
     {
-        /* avoid throwing away our precious buffer if seeking within it. */
-        PHYSFS_sint64 offset = pos - PHYSFS_tell(handle);
-        if ( /* seeking within the already-buffered range? */
-             /* forward? */
-            ((offset >= 0) && (((size_t)offset) <= fh->buffill-fh->bufpos)) ||
-            /* backward? */
-            ((offset < 0) && (((size_t) -offset) <= fh->bufpos)) )
-        {
-            fh->bufpos = (size_t) (((PHYSFS_sint64) fh->bufpos) + offset);
-            return 1; /* successful seek */
-        } /* if */
-    } /* if */
+        int i;
 
-    /* we have to fall back to a 'raw' seek. */
-    fh->buffill = fh->bufpos = 0;
-    return fh->io->seek(fh->io, pos);
-} /* PHYSFS_seek */
+        PHYSFS_waitAsyncReads();  /* drain the queues, run the callbacks. */
 
+        __PHYSFS_platformGrabMutex(asyncLock);
+        asyncShutdown = 1;
+        __PHYSFS_platformReleaseMutex(asyncLock);
 
-PHYSFS_sint64 PHYSFS_fileLength(PHYSFS_File *handle)
-{
-    PHYSFS_Io *io = ((FileHandle *) handle)->io;
-    return io->length(io);
-} /* PHYSFS_filelength */
+        for (i = 0; i < asyncThreadCount; i++)
+            __PHYSFS_platformPostSemaphore(asyncWorkSem);
+        for (i = 0; i < asyncThreadCount; i++)
+            __PHYSFS_platformJoinThread(asyncThreads[i]);
+
+        __PHYSFS_platformDestroySemaphore(asyncWorkSem);
+        __PHYSFS_platformDestroySemaphore(asyncDoneSem);
+    } /* if */
+    else if (initialized)
+    {
+        PHYSFS_pollAsyncReads();  /* inline-read completions, if any. */
+    } /* else if */
+
+    asyncWorkSem = asyncDoneSem = NULL;
+    asyncThreadCount = 0;
+    asyncThreadsFailed = 0;
+    asyncShutdown = 0;
+    asyncQueue = asyncQueueTail = NULL;
+    asyncCompleted = asyncCompletedTail = NULL;
+    asyncPending = 0;
+} /* shutdownAsyncReads */
 
 
 int PHYSFS_setBuffer(PHYSFS_File *handle, PHYSFS_uint64 _bufsize)
@@ -3053,6 +6612,8 @@ int PHYSFS_setBuffer(PHYSFS_File *handle, PHYSFS_uint64 _bufsize)
     } /* else */
 
     fh->bufsize = bufsize;
+    fh->bufwindow = fh->bufalloc = bufsize;
+    fh->bufstreak = 0;
     fh->buffill = fh->bufpos = 0;
     return 1;
 } /* PHYSFS_setBuffer */
@@ -3064,8 +6625,17 @@ int PHYSFS_flush(PHYSFS_File *handle)
     PHYSFS_Io *io;
     PHYSFS_sint64 rc;
 
-    if ((fh->forReading) || (fh->bufpos == fh->buffill))
-        return 1;  /* open for read or buffer empty are successful no-ops. */
+    if (fh->forReading)
+        return 1;  /* open for read is a successful no-op. */
+
+    /* queued write-behind buffers precede the current one; wait them out
+       first so everything lands in order (and surface any background
+       write error while we're at it). */
+    if (fh->writeBehind)
+        BAIL_IF_ERRPASS(!drainWriteBehindSync(fh), 0);
+
+    if (fh->bufpos == fh->buffill)
+        return 1;  /* buffer empty is a successful no-op. */
 
     /* dump buffer to disk. */
     io = fh->io;
@@ -3076,6 +6646,71 @@ int PHYSFS_flush(PHYSFS_File *handle)
 } /* PHYSFS_flush */
 
 
+int PHYSFS_setWriteBehind(PHYSFS_File *handle, int enable)
+{
+    FileHandle *fh = (FileHandle *) handle;
+
+    BAIL_IF(fh->forReading, PHYSFS_ERR_OPEN_FOR_READING, 0);
+
+    if (enable)
+    {
+        /* write-behind batches up whole buffers; there's nothing to
+           detach without one. */
+        BAIL_IF(!fh->buffer, PHYSFS_ERR_UNSUPPORTED, 0);
+        fh->writeBehind = 1;
+    } /* if */
+    else if (fh->writeBehind)
+    {
+        BAIL_IF_ERRPASS(!drainWriteBehindSync(fh), 0);
+        fh->writeBehind = 0;
+    } /* else if */
+
+    return 1;
+} /* PHYSFS_setWriteBehind */
+
+
+int PHYSFS_flushAsync(PHYSFS_File *handle, PHYSFS_AsyncFlushCallback callback,
+                      void *userdata)
+{
+    FileHandle *fh = (FileHandle *) handle;
+    AsyncReadRequest *req;
+
+    BAIL_IF(fh->forReading, PHYSFS_ERR_OPEN_FOR_READING, 0);
+
+    req = (AsyncReadRequest *) allocator.Malloc(sizeof (AsyncReadRequest));
+    BAIL_IF(!req, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    memset(req, '\0', sizeof (*req));
+    req->file = fh;
+    req->isFlush = 1;
+    req->flushcb = callback;
+    req->userdata = userdata;
+    req->errcode = PHYSFS_ERR_OK;
+
+    if (!fh->writeBehind)
+    {
+        /* no background queue to ride on: flush now, deliver at the next
+           poll, so the app's control flow is the same either way. */
+        const int rc = PHYSFS_flush(handle);
+        req->result = rc ? 1 : -1;
+        req->errcode = rc ? PHYSFS_ERR_OK : PHYSFS_getLastErrorCode();
+        __PHYSFS_platformGrabMutex(asyncLock);
+        asyncPending++;
+        completeAsyncRead(req);
+        if (asyncDoneSem != NULL)
+            __PHYSFS_platformPostSemaphore(asyncDoneSem);
+        __PHYSFS_platformReleaseMutex(asyncLock);
+    } /* if */
+
+    else if (!queueWriteBehind(fh, req))
+    {
+        allocator.Free(req);
+        return 0;  /* error already set by queueWriteBehind(). */
+    } /* else if */
+
+    return 1;
+} /* PHYSFS_flushAsync */
+
+
 int PHYSFS_stat(const char *_fname, PHYSFS_Stat *stat)
 {
     int retval = 0;
@@ -3086,53 +6721,16 @@ int PHYSFS_stat(const char *_fname, PHYSFS_Stat *stat)
     BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
     BAIL_IF(!stat, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    /* set some sane defaults... */
-    stat->filesize = -1;
-    stat->modtime = -1;
-    stat->createtime = -1;
-    stat->accesstime = -1;
-    stat->filetype = PHYSFS_FILETYPE_OTHER;
-    stat->readonly = 1;
-
-    __PHYSFS_platformGrabMutex(stateLock);
+    grabStateReadLock();
     len = strlen(_fname) + longest_root + 1;
     allocated_fname = (char *) __PHYSFS_smallAlloc(len);
-    BAIL_IF_MUTEX(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+    BAIL_IF_READLOCK(!allocated_fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
     fname = allocated_fname + longest_root;
 
     if (sanitizePlatformIndependentPath(_fname, fname))
-    {
-        if (*fname == '\0')
-        {
-            stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
-            stat->readonly = !writeDir; /* Writeable if we have a writeDir */
-            retval = 1;
-        } /* if */
-        else
-        {
-            DirHandle *i;
-            int exists = 0;
-            for (i = searchPath; ((i != NULL) && (!exists)); i = i->next)
-            {
-                char *arcfname = fname;
-                exists = partOfMountPoint(i, arcfname);
-                if (exists)
-                {
-                    stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
-                    stat->readonly = 1;
-                    retval = 1;
-                } /* if */
-                else if (verifyPath(i, &arcfname, 0))
-                {
-                    retval = i->funcs->stat(i->opaque, arcfname, stat);
-                    if ((retval) || (currentErrorCode() != PHYSFS_ERR_NOT_FOUND))
-                        exists = 1;
-                } /* else if */
-            } /* for */
-        } /* else */
-    } /* if */
+        retval = doStatLocked(fname, stat);
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+    releaseStateReadLock();
     __PHYSFS_smallFree(allocated_fname);
     return retval;
 } /* PHYSFS_stat */
@@ -3231,6 +6829,46 @@ static void setDefaultAllocator(void)
 } /* setDefaultAllocator */
 
 
+/*
+ * Entries are carved out of large arena slabs instead of being individually
+ *  malloc'd: a huge archive adds hundreds of thousands of entries, and one
+ *  allocation apiece fragments the heap for the life of the process. Slabs
+ *  chain through a pointer in their first bytes and are freed wholesale in
+ *  __PHYSFS_DirTreeDeinit(). As a bonus, entries added together (which is
+ *  how archivers load them) end up adjacent in memory, which is kinder to
+ *  the cache when walking hash buckets and sibling lists.
+ */
+#define DIRTREE_SLAB_SIZE (64 * 1024)
+
+typedef union
+{
+    void *next;          /* previous slab in the chain. */
+    PHYSFS_uint64 pad;   /* force 8-byte alignment of the entries. */
+} DirTreeSlabHeader;
+
+static void *dirTreeArenaAlloc(__PHYSFS_DirTree *dt, size_t len)
+{
+    void *retval;
+
+    len = (len + 7) & ~((size_t) 7);  /* keep entry structs aligned. */
+
+    if ((dt->slabs == NULL) || ((dt->slabUsed + len) > dt->slabSize))
+    {
+        const size_t payload = (len > DIRTREE_SLAB_SIZE) ? len : DIRTREE_SLAB_SIZE;
+        void *slab = allocator.Malloc(sizeof (DirTreeSlabHeader) + payload);
+        BAIL_IF(!slab, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        ((DirTreeSlabHeader *) slab)->next = dt->slabs;
+        dt->slabs = slab;
+        dt->slabUsed = 0;
+        dt->slabSize = payload;
+    } /* if */
+
+    retval = ((char *) dt->slabs) + sizeof (DirTreeSlabHeader) + dt->slabUsed;
+    dt->slabUsed += len;
+    return retval;
+} /* dirTreeArenaAlloc */
+
+
 int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen)
 {
     static char rootpath[2] = { '/', '\0' };
@@ -3240,31 +6878,82 @@ int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen)
 
     memset(dt, '\0', sizeof (*dt));
 
-    dt->root = (__PHYSFS_DirTreeEntry *) allocator.Malloc(entrylen);
+    dt->root = (__PHYSFS_DirTreeEntry *) dirTreeArenaAlloc(dt, entrylen);
     BAIL_IF(!dt->root, PHYSFS_ERR_OUT_OF_MEMORY, 0);
     memset(dt->root, '\0', entrylen);
     dt->root->name = rootpath;
     dt->root->isdir = 1;
-    dt->hashBuckets = 64;
-    if (!dt->hashBuckets)
-        dt->hashBuckets = 1;
+    dt->hashBuckets = 64;  /* must be a power of two. */
     dt->entrylen = entrylen;
 
-    alloclen = dt->hashBuckets * sizeof (__PHYSFS_DirTreeEntry *);
-    dt->hash = (__PHYSFS_DirTreeEntry **) allocator.Malloc(alloclen);
+    alloclen = dt->hashBuckets * sizeof (__PHYSFS_DirTreeHashSlot);
+    dt->hash = (__PHYSFS_DirTreeHashSlot *) allocator.Malloc(alloclen);
     BAIL_IF(!dt->hash, PHYSFS_ERR_OUT_OF_MEMORY, 0);
     memset(dt->hash, '\0', alloclen);
 
+    dt->sortLock = __PHYSFS_platformCreateMutex();
+    BAIL_IF_ERRPASS(!dt->sortLock, 0);
+
     return 1;
 } /* __PHYSFS_DirTreeInit */
 
 
-static inline PHYSFS_uint32 hashPathName(__PHYSFS_DirTree *dt, const char *name)
+static inline PHYSFS_uint32 hashPathName(const char *name)
 {
-    return __PHYSFS_hashString(name, strlen(name)) % dt->hashBuckets;
+    /* casefolded, so case-insensitive lookups share the probe chain. */
+    return __PHYSFS_hashStringCasefold(name);
 } /* hashPathName */
 
 
+/* slot in the probe sequence where (hashval) belongs; no duplicate check. */
+static void dirTreeHashInsert(__PHYSFS_DirTree *dt,
+                              const PHYSFS_uint32 hashval,
+                              __PHYSFS_DirTreeEntry *entry)
+{
+    const size_t mask = dt->hashBuckets - 1;
+    size_t idx = ((size_t) hashval) & mask;
+    while (dt->hash[idx].entry != NULL)
+        idx = (idx + 1) & mask;
+    dt->hash[idx].hash = hashval;
+    dt->hash[idx].entry = entry;
+    dt->hashCount++;
+} /* dirTreeHashInsert */
+
+
+static int dirTreeHashMaybeGrow(__PHYSFS_DirTree *dt)
+{
+    __PHYSFS_DirTreeHashSlot *oldhash = dt->hash;
+    const size_t oldBuckets = dt->hashBuckets;
+    size_t alloclen;
+    size_t i;
+
+    if ((dt->hashCount * 3) < (dt->hashBuckets * 2))
+        return 1;  /* still under a 2/3 load factor; we're fine. */
+
+    alloclen = (oldBuckets * 2) * sizeof (__PHYSFS_DirTreeHashSlot);
+    dt->hash = (__PHYSFS_DirTreeHashSlot *) allocator.Malloc(alloclen);
+    if (dt->hash == NULL)
+    {
+        dt->hash = oldhash;  /* keep limping along with the old table. */
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    memset(dt->hash, '\0', alloclen);
+    dt->hashBuckets = oldBuckets * 2;
+    dt->hashCount = 0;
+
+    /* stored hashes mean rehashing never touches the entries themselves. */
+    for (i = 0; i < oldBuckets; i++)
+    {
+        if (oldhash[i].entry != NULL)
+            dirTreeHashInsert(dt, oldhash[i].hash, oldhash[i].entry);
+    } /* for */
+
+    allocator.Free(oldhash);
+    return 1;
+} /* dirTreeHashMaybeGrow */
+
+
 /* Fill in missing parent directories. */
 static __PHYSFS_DirTreeEntry *addAncestors(__PHYSFS_DirTree *dt, char *name)
 {
@@ -3298,21 +6987,21 @@ void *__PHYSFS_DirTreeAdd(__PHYSFS_DirTree *dt, char *name, const int isdir)
     if (!retval)
     {
         const size_t alloclen = strlen(name) + 1 + dt->entrylen;
-        PHYSFS_uint32 hashval;
         __PHYSFS_DirTreeEntry *parent = addAncestors(dt, name);
         BAIL_IF_ERRPASS(!parent, NULL);
         assert(dt->entrylen >= sizeof (__PHYSFS_DirTreeEntry));
-        retval = (__PHYSFS_DirTreeEntry *) allocator.Malloc(alloclen);
-        BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        BAIL_IF_ERRPASS(!dirTreeHashMaybeGrow(dt), NULL);
+        retval = (__PHYSFS_DirTreeEntry *) dirTreeArenaAlloc(dt, alloclen);
+        BAIL_IF_ERRPASS(!retval, NULL);
         memset(retval, '\0', dt->entrylen);
         retval->name = ((char *) retval) + dt->entrylen;
         strcpy(retval->name, name);
-        hashval = hashPathName(dt, name);
-        retval->hashnext = dt->hash[hashval];
-        dt->hash[hashval] = retval;
+        dirTreeHashInsert(dt, hashPathName(name), retval);
         retval->sibling = parent->children;
         retval->isdir = isdir;
         parent->children = retval;
+        parent->childCount++;
+        parent->sorted = NULL;  /* stale now; rebuilt on next enumerate. */
     } /* if */
 
     return retval;
@@ -3322,33 +7011,112 @@ void *__PHYSFS_DirTreeAdd(__PHYSFS_DirTree *dt, char *name, const int isdir)
 /* Find the __PHYSFS_DirTreeEntry for a path in platform-independent notation. */
 void *__PHYSFS_DirTreeFind(__PHYSFS_DirTree *dt, const char *path)
 {
+    const size_t mask = dt->hashBuckets - 1;
     PHYSFS_uint32 hashval;
-    __PHYSFS_DirTreeEntry *prev = NULL;
-    __PHYSFS_DirTreeEntry *retval;
+    size_t idx;
+
+    __PHYSFS_STATS_INCR(__PHYSFS_stats.treeFinds);
 
     if (*path == '\0')
         return dt->root;
 
-    hashval = hashPathName(dt, path);
-    for (retval = dt->hash[hashval]; retval; retval = retval->hashnext)
+    hashval = hashPathName(path);
+    for (idx = ((size_t) hashval) & mask; dt->hash[idx].entry != NULL;
+         idx = (idx + 1) & mask)
     {
-        if (strcmp(retval->name, path) == 0)
-        {
-            if (prev != NULL)  /* move this to the front of the list */
-            {
-                prev->hashnext = retval->hashnext;
-                retval->hashnext = dt->hash[hashval];
-                dt->hash[hashval] = retval;
-            } /* if */
+        /* the stored hash rejects nearly all mismatches without a strcmp. */
+        if (dt->hash[idx].hash != hashval)
+            continue;
+        else if (strcmp(dt->hash[idx].entry->name, path) == 0)
+            return dt->hash[idx].entry;
+    } /* for */
 
-            return retval;
-        } /* if */
+    BAIL(PHYSFS_ERR_NOT_FOUND, NULL);
+} /* __PHYSFS_DirTreeFind */
+
+
+/* Same probe chain as __PHYSFS_DirTreeFind--the table is keyed by the
+   casefolded hash--but accept the first case-insensitive name match. */
+void *__PHYSFS_DirTreeFindIgnoreCase(__PHYSFS_DirTree *dt, const char *path)
+{
+    const size_t mask = dt->hashBuckets - 1;
+    PHYSFS_uint32 hashval;
+    size_t idx;
+
+    __PHYSFS_STATS_INCR(__PHYSFS_stats.treeFinds);
 
-        prev = retval;
+    if (*path == '\0')
+        return dt->root;
+
+    hashval = hashPathName(path);
+    for (idx = ((size_t) hashval) & mask; dt->hash[idx].entry != NULL;
+         idx = (idx + 1) & mask)
+    {
+        if (dt->hash[idx].hash != hashval)
+            continue;
+        else if (PHYSFS_utf8stricmp(dt->hash[idx].entry->name, path) == 0)
+            return dt->hash[idx].entry;
     } /* for */
 
     BAIL(PHYSFS_ERR_NOT_FOUND, NULL);
-} /* __PHYSFS_DirTreeFind */
+} /* __PHYSFS_DirTreeFindIgnoreCase */
+
+/*
+ * Enumeration walks a contiguous array of child pointers, sorted by name,
+ *  instead of chasing the sibling list: the walk is a linear scan of one
+ *  array, and listings come back in a deterministic order without the app
+ *  re-sorting them. The array is built on a directory's first enumerate
+ *  and cached on its entry; adding a child just drops the stale pointer
+ *  (the old array sits in the arena until deinit, like everything there,
+ *  and post-mount additions are rare enough not to care).
+ */
+static int dirTreeChildCmp(void *a, size_t x, size_t y)
+{
+    __PHYSFS_DirTreeEntry **kids = (__PHYSFS_DirTreeEntry **) a;
+    /* full paths, but each kid shares the dir prefix, so this orders by
+       the final component. */
+    return strcmp(kids[x]->name, kids[y]->name);
+} /* dirTreeChildCmp */
+
+static void dirTreeChildSwap(void *a, size_t x, size_t y)
+{
+    __PHYSFS_DirTreeEntry **kids = (__PHYSFS_DirTreeEntry **) a;
+    __PHYSFS_DirTreeEntry *tmp = kids[x];
+    kids[x] = kids[y];
+    kids[y] = tmp;
+} /* dirTreeChildSwap */
+
+static __PHYSFS_DirTreeEntry **dirTreeSortedChildren(__PHYSFS_DirTree *dt,
+                                                __PHYSFS_DirTreeEntry *entry)
+{
+    __PHYSFS_DirTreeEntry **kids;
+
+    /* enumerations run under the _shared_ state lock, so two of them can
+       race to build a directory's array: unguarded, both would bump the
+       arena and publish (sorted). Take the tree's lock and recheck; after
+       the first build this is an uncontended grab per enumerate. */
+    __PHYSFS_platformGrabMutex(dt->sortLock);
+    kids = entry->sorted;
+    if (kids == NULL)
+    {
+        kids = (__PHYSFS_DirTreeEntry **)
+               dirTreeArenaAlloc(dt, entry->childCount * sizeof (*kids));
+        if (kids != NULL)
+        {
+            __PHYSFS_DirTreeEntry *i;
+            size_t n = 0;
+            for (i = entry->children; i != NULL; i = i->sibling)
+                kids[n++] = i;
+            assert(n == entry->childCount);
+            __PHYSFS_sort(kids, n, dirTreeChildCmp, dirTreeChildSwap);
+            entry->sorted = kids;
+        } /* if */
+    } /* if */
+    __PHYSFS_platformReleaseMutex(dt->sortLock);
+
+    return kids;  /* NULL on failure; the arena already set the error. */
+} /* dirTreeSortedChildren */
+
 
 PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(void *opaque,
                               const char *dname, PHYSFS_EnumerateCallback cb,
@@ -3356,24 +7124,66 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(void *opaque,
 {
     PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
     __PHYSFS_DirTree *tree = (__PHYSFS_DirTree *) opaque;
-    const __PHYSFS_DirTreeEntry *entry = __PHYSFS_DirTreeFind(tree, dname);
+    __PHYSFS_DirTreeEntry *entry;
+    __PHYSFS_DirTreeEntry **kids;
+    size_t i;
+
+    entry = (__PHYSFS_DirTreeEntry *) __PHYSFS_DirTreeFind(tree, dname);
     BAIL_IF(!entry, PHYSFS_ERR_NOT_FOUND, PHYSFS_ENUM_ERROR);
 
-    entry = entry->children;
+    if (entry->childCount == 0)
+        return PHYSFS_ENUM_OK;
 
-    while (entry && (retval == PHYSFS_ENUM_OK))
+    kids = dirTreeSortedChildren(tree, entry);
+    BAIL_IF_ERRPASS(!kids, PHYSFS_ENUM_ERROR);
+
+    for (i = 0; (i < entry->childCount) && (retval == PHYSFS_ENUM_OK); i++)
     {
-        const char *name = entry->name;
+        const char *name = kids[i]->name;
         const char *ptr = strrchr(name, '/');
         retval = cb(callbackdata, origdir, ptr ? ptr + 1 : name);
         BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
-        entry = entry->sibling;
-    } /* while */
+    } /* for */
 
     return retval;
 } /* __PHYSFS_DirTreeEnumerate */
 
 
+PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerateWithStat(void *opaque,
+                 const char *dname, PHYSFS_EnumerateWithStatCallback cb,
+                 const char *origdir, void *callbackdata,
+                 int (*statfn)(void *opaque, __PHYSFS_DirTreeEntry *entry,
+                               PHYSFS_Stat *st))
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    __PHYSFS_DirTree *tree = (__PHYSFS_DirTree *) opaque;
+    __PHYSFS_DirTreeEntry *entry;
+    __PHYSFS_DirTreeEntry **kids;
+    size_t i;
+
+    entry = (__PHYSFS_DirTreeEntry *) __PHYSFS_DirTreeFind(tree, dname);
+    BAIL_IF(!entry, PHYSFS_ERR_NOT_FOUND, PHYSFS_ENUM_ERROR);
+
+    if (entry->childCount == 0)
+        return PHYSFS_ENUM_OK;
+
+    kids = dirTreeSortedChildren(tree, entry);
+    BAIL_IF_ERRPASS(!kids, PHYSFS_ENUM_ERROR);
+
+    for (i = 0; (i < entry->childCount) && (retval == PHYSFS_ENUM_OK); i++)
+    {
+        const char *name = kids[i]->name;
+        const char *ptr = strrchr(name, '/');
+        PHYSFS_Stat statbuf;
+        BAIL_IF_ERRPASS(!statfn(opaque, kids[i], &statbuf), PHYSFS_ENUM_ERROR);
+        retval = cb(callbackdata, origdir, ptr ? ptr + 1 : name, &statbuf);
+        BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
+    } /* for */
+
+    return retval;
+} /* __PHYSFS_DirTreeEnumerateWithStat */
+
+
 void __PHYSFS_DirTreeDeinit(__PHYSFS_DirTree *dt)
 {
     if (!dt)
@@ -3383,24 +7193,21 @@ void __PHYSFS_DirTreeDeinit(__PHYSFS_DirTree *dt)
     {
         assert(dt->root->sibling == NULL);
         assert(dt->hash || (dt->root->children == NULL));
-        allocator.Free(dt->root);
     } /* if */
 
-    if (dt->hash)
+    /* entries all live in the arena; drop it wholesale. */
+    while (dt->slabs != NULL)
     {
-        size_t i;
-        for (i = 0; i < dt->hashBuckets; i++)
-        {
-            __PHYSFS_DirTreeEntry *entry;
-            __PHYSFS_DirTreeEntry *next;
-            for (entry = dt->hash[i]; entry; entry = next)
-            {
-                next = entry->hashnext;
-                allocator.Free(entry);
-            } /* for */
-        } /* for */
+        void *next = ((DirTreeSlabHeader *) dt->slabs)->next;
+        allocator.Free(dt->slabs);
+        dt->slabs = next;
+    } /* while */
+
+    if (dt->hash)
         allocator.Free(dt->hash);
-    } /* if */
+
+    if (dt->sortLock)  /* may be NULL if init itself failed partway. */
+        __PHYSFS_platformDestroyMutex(dt->sortLock);
 } /* __PHYSFS_DirTreeDeinit */
 
 /* end of physfs.c ... */
@@ -1522,6 +1522,113 @@ PHYSFS_DECL int PHYSFS_setBuffer(PHYSFS_File *handle, PHYSFS_uint64 bufsize);
 PHYSFS_DECL int PHYSFS_flush(PHYSFS_File *handle);
 
 
+/**
+ * \fn int PHYSFS_borrowBuffer(PHYSFS_File *handle, const void **ptr, PHYSFS_uint64 *avail)
+ * \brief Peek at a buffered file's internal buffer without copying.
+ *
+ * PHYSFS_readBytes() always copies out of the internal buffer set up by
+ *  PHYSFS_setBuffer(), so parsers that read a few bytes at a time pay for
+ *  two copies of every field. This borrows the buffer instead: on return,
+ *  (*ptr) points directly at the next unread bytes and (*avail) says how
+ *  many are there. Parse what you need in place, then tell PhysicsFS how
+ *  much you actually used with PHYSFS_consumeBuffer(); unconsumed bytes
+ *  are returned by the next read as if never seen.
+ *
+ * If the buffer is empty, this refills it first, so (*avail) is only zero
+ *  at end-of-file. (*avail) may be less than the buffer size--it's however
+ *  much one refill produced--so loop if you need more: consume what's
+ *  there and borrow again.
+ *
+ * The returned pointer is only good until the next operation on this
+ *  handle: any read, seek, consume, PHYSFS_setBuffer() or close may move
+ *  or invalidate it. Don't hold onto it, and don't write through it.
+ *
+ * This only works on files opened for reading that have a buffer set;
+ *  bufferless handles fail with PHYSFS_ERR_UNSUPPORTED.
+ *
+ *   \param handle handle returned from PHYSFS_openRead().
+ *   \param ptr receives a pointer to the next unread buffered bytes.
+ *   \param avail receives the number of bytes readable at (*ptr); zero
+ *          here (with a successful return) means end-of-file.
+ *  \return nonzero on success, zero on error. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_consumeBuffer
+ * \sa PHYSFS_setBuffer
+ */
+PHYSFS_DECL int PHYSFS_borrowBuffer(PHYSFS_File *handle, const void **ptr,
+                                    PHYSFS_uint64 *avail);
+
+
+/**
+ * \fn int PHYSFS_consumeBuffer(PHYSFS_File *handle, PHYSFS_uint64 len)
+ * \brief Mark bytes borrowed with PHYSFS_borrowBuffer() as read.
+ *
+ * Advances the file position past (len) bytes of the internal buffer, as
+ *  if they had been returned by PHYSFS_readBytes(). (len) may not exceed
+ *  the (avail) reported by the matching PHYSFS_borrowBuffer() call;
+ *  consuming less than you borrowed is fine, and consuming zero is a
+ *  no-op.
+ *
+ *   \param handle handle returned from PHYSFS_openRead().
+ *   \param len number of borrowed bytes to mark as read.
+ *  \return nonzero on success, zero on error. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_borrowBuffer
+ */
+PHYSFS_DECL int PHYSFS_consumeBuffer(PHYSFS_File *handle, PHYSFS_uint64 len);
+
+
+/**
+ * \struct PHYSFS_ReadVec
+ * \brief One segment of a PHYSFS_readv() scatter read.
+ *
+ * \sa PHYSFS_readv
+ */
+typedef struct PHYSFS_ReadVec
+{
+    PHYSFS_uint64 offset;  /**< byte offset in the file to read from. */
+    PHYSFS_uint64 len;     /**< bytes to read into (buffer). */
+    void *buffer;          /**< destination; must hold at least (len). */
+} PHYSFS_ReadVec;
+
+
+/**
+ * \fn PHYSFS_sint64 PHYSFS_readv(PHYSFS_File *handle, const PHYSFS_ReadVec *vecs, PHYSFS_uint32 count)
+ * \brief Read several segments of a file in one submission.
+ *
+ * Loaders that pull an index block and then dozens of chunks at known
+ *  offsets pay a full seek+read round trip per chunk through
+ *  PHYSFS_readBytes(). This submits the whole batch at once: PhysicsFS
+ *  sorts the segments by offset internally and services them in one pass,
+ *  using positioned reads where the underlying i/o supports them (so plain
+ *  files skip the seek syscalls entirely) and a single forward
+ *  decompression sweep for compressed archive entries. The order of the
+ *  (vecs) array doesn't matter; each segment's data lands in its own
+ *  (buffer) regardless.
+ *
+ * Segments may overlap or duplicate offsets; each is read independently.
+ *  A segment that runs past end-of-file reads short, and the batch stops
+ *  there. The handle's file position is unchanged by this call, like a
+ *  POSIX pread().
+ *
+ *   \param handle handle returned from PHYSFS_openRead().
+ *   \param vecs array of segments to read.
+ *   \param count number of elements in (vecs).
+ *  \return total bytes read across all segments. If this is less than the
+ *          sum of the segment lengths, a segment read short (end-of-file)
+ *          or failed; -1 if the batch failed before any data was read. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_readBytes
+ * \sa PHYSFS_seek
+ */
+PHYSFS_DECL PHYSFS_sint64 PHYSFS_readv(PHYSFS_File *handle,
+                                       const PHYSFS_ReadVec *vecs,
+                                       PHYSFS_uint32 count);
+
+
 /* Byteorder stuff... */
 
 /**
@@ -2909,6 +3016,38 @@ typedef struct PHYSFS_Stat
 PHYSFS_DECL int PHYSFS_stat(const char *fname, PHYSFS_Stat *stat);
 
 
+/**
+ * \typedef PHYSFS_EnumerateWithStatCallback
+ * \brief Function signature for callbacks that enumerate with metadata.
+ *
+ * This is the callback for PHYSFS_enumerateWithStat(). It works exactly
+ *  like PHYSFS_EnumerateCallback, but each item arrives with its
+ *  PHYSFS_Stat metadata already filled in, so you don't have to make a
+ *  separate PHYSFS_stat() call per file.
+ *
+ * The (stat) pointer is only valid for the duration of the callback; copy
+ *  the structure if you need it afterwards.
+ *
+ *    \param data User-defined data pointer, passed through from the API
+ *                that eventually called the callback.
+ *    \param origdir A string containing the full path, in platform-independent
+ *                   notation, of the directory containing this file.
+ *    \param fname The filename that is being enumerated, without the full
+ *                 path; recreate it with $origdir/$fname.
+ *    \param stat This file's metadata; the same contents a PHYSFS_stat()
+ *                call on $origdir/$fname would report.
+ *   \return A value from PHYSFS_EnumerateCallbackResult.
+ *           All other values are (currently) undefined; don't use them.
+ *
+ * \sa PHYSFS_enumerateWithStat
+ * \sa PHYSFS_EnumerateCallbackResult
+ */
+typedef PHYSFS_EnumerateCallbackResult (*PHYSFS_EnumerateWithStatCallback)(
+                                       void *data, const char *origdir,
+                                       const char *fname,
+                                       const PHYSFS_Stat *stat);
+
+
 /**
  * \fn void PHYSFS_utf8FromUtf16(const PHYSFS_uint16 *src, char *dst, PHYSFS_uint64 len)
  * \brief Convert a UTF-16 string to a UTF-8 string.
@@ -3070,10 +3209,10 @@ typedef struct PHYSFS_Io
     /**
      * \brief Binary compatibility information.
      *
-     * This must be set to zero at this time. Future versions of this
-     *  struct will increment this field, so we know what a given
-     *  implementation supports. We'll presumably keep supporting older
-     *  versions as we offer new features, though.
+     * Set this to the version of this struct that you implement: zero
+     *  for the original layout, 1 if you also provide the readAt() and
+     *  map() methods. PhysicsFS keeps supporting older versions as we
+     *  offer new features, so zero is always safe here.
      */
     PHYSFS_uint32 version;
 
@@ -3222,6 +3361,60 @@ typedef struct PHYSFS_Io
      *   \param s The i/o instance to destroy.
      */
     void (*destroy)(struct PHYSFS_Io *io);
+
+    /**
+     * \brief Read data from a specific offset.
+     *
+     * Read (len) bytes from the interface, starting at byte (offset) from
+     *  the start of the stream, and store them in (buf). The stream's
+     *  current i/o position is ignored, and its value after this call is
+     *  undefined; code that mixes readAt() with read() must seek() before
+     *  trusting the i/o position again.
+     *
+     * Implementations should not touch any per-instance mutable state, so
+     *  that two threads can safely call this on the same instance at once;
+     *  POSIX pread() offers exactly this, where a seek-then-read pair does
+     *  not. PhysicsFS uses this, when available, to avoid issuing seek and
+     *  read as separate operations.
+     *
+     * This field was added in version 1 of this struct; it is only used if
+     *  (version) is at least 1. You don't have to implement this; set it
+     *  to NULL if not implemented and PhysicsFS will fall back to seek()
+     *  and read().
+     *
+     *   \param io The i/o instance to read from.
+     *   \param buf The buffer to store data into. It must be at least
+     *                 (len) bytes long and can't be NULL.
+     *   \param len The number of bytes to read from the interface.
+     *   \param offset The byte offset in the stream to start reading at.
+     *  \return number of bytes read from file, 0 on EOF, -1 if complete
+     *          failure.
+     */
+    PHYSFS_sint64 (*readAt)(struct PHYSFS_Io *io, void *buf,
+                            PHYSFS_uint64 len, PHYSFS_uint64 offset);
+
+    /**
+     * \brief Map the entire dataset into memory.
+     *
+     * Return a read-only pointer to the whole dataset, storing its size in
+     *  bytes to (len), without copying it into a buffer: a memory-mapped
+     *  file, a pointer into an existing memory buffer, etc. The pointer
+     *  must stay valid until this instance's destroy() method is called,
+     *  which is also where any mapping should be released. Calling this
+     *  more than once on an instance may return the same mapping. This
+     *  does not use or move the stream's i/o position.
+     *
+     * This field was added in version 1 of this struct; it is only used
+     *  if (version) is at least 1. You don't have to implement this; set
+     *  it to NULL if not implemented. It's also legal to return NULL from
+     *  a call at your discretion--not all datasets can be mapped--and
+     *  callers have to be prepared to fall back to read().
+     *
+     *   \param io The i/o instance to map.
+     *   \param len Where to store the dataset's size, in bytes.
+     *  \return pointer to the dataset, or NULL if mapping isn't possible.
+     */
+    const void *(*map)(struct PHYSFS_Io *io, PHYSFS_uint64 *len);
 } PHYSFS_Io;
 
 
@@ -3374,6 +3567,145 @@ PHYSFS_DECL int PHYSFS_mountHandle(PHYSFS_File *file, const char *newDir,
                                    const char *mountPoint, int appendToPath);
 
 
+/**
+ * \fn int PHYSFS_writeMountManifest(const char *dir, const char *file)
+ * \brief Serialize a mounted archive's directory to a mount manifest.
+ *
+ * \warning This is for .zip files only, at the moment. Other archive
+ *          formats either parse quickly enough already or would need
+ *          format-specific support that doesn't exist yet. This fails
+ *          with PHYSFS_ERR_UNSUPPORTED for anything that isn't a zip.
+ *
+ * Opening a large zip file means parsing its entire central directory,
+ *  which can be a noticeable chunk of startup time on slow media, paid
+ *  on every launch even though the archive never changes. This function
+ *  writes the already-parsed directory of a mounted archive to a compact
+ *  flat file--a "mount manifest"--that PHYSFS_mountManifest() can load
+ *  on the next run instead of parsing the archive again.
+ *
+ * (dir) is the directory name the archive was mounted with; the same
+ *  string you passed to PHYSFS_mount(). (file) is the path to write the
+ *  manifest to, in platform-dependent notation, _not_ a virtual path in
+ *  the PhysicsFS tree; it sits next to your archives, not inside them.
+ *
+ * The manifest records the archive's size and modification time, and
+ *  PHYSFS_mountManifest() refuses to use it if either has changed, so a
+ *  stale manifest degrades to a failed mount, never to wrong data. That
+ *  also means the archive must be a real file that can be stat'd: this
+ *  fails for archives mounted with PHYSFS_mountIo() and friends.
+ *
+ * Manifests are byte-order independent; one written on any platform
+ *  loads on every other.
+ *
+ *   \param dir directory name of a mounted archive, as given to
+ *              PHYSFS_mount().
+ *   \param file path of the manifest file to write, in
+ *               platform-dependent notation.
+ *  \return nonzero on success, zero on failure. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_mountManifest
+ */
+PHYSFS_DECL int PHYSFS_writeMountManifest(const char *dir, const char *file);
+
+
+/**
+ * \fn int PHYSFS_mountManifest(const char *newDir, const char *manifestFile, const char *mountPoint, int appendToPath)
+ * \brief Mount an archive using a previously written mount manifest.
+ *
+ * This operates like PHYSFS_mount(), but instead of parsing the archive's
+ *  directory, it loads the one PHYSFS_writeMountManifest() saved earlier.
+ *  On archives with many files this makes mounting nearly free: one small
+ *  sequential read instead of a central directory parse.
+ *
+ * The manifest records the size and modification time the archive had
+ *  when it was written. If the archive on disk no longer matches, this
+ *  fails with PHYSFS_ERR_CORRUPT and mounts nothing; fall back to a
+ *  regular PHYSFS_mount() and write a fresh manifest:
+ *
+ * \code
+ *  if (!PHYSFS_mountManifest("x.zip", "x.zip.manifest", NULL, 1))
+ *  {
+ *      PHYSFS_mount("x.zip", NULL, 1);
+ *      PHYSFS_writeMountManifest("x.zip", "x.zip.manifest");
+ *  }
+ * \endcode
+ *
+ * Both (newDir) and (manifestFile) are paths in platform-dependent
+ *  notation. Only .zip archives are supported, matching
+ *  PHYSFS_writeMountManifest().
+ *
+ *   \param newDir directory or archive to add to the path, in
+ *                 platform-dependent notation.
+ *   \param manifestFile path of the manifest file, in platform-dependent
+ *                       notation.
+ *   \param mountPoint Location in the interpolated tree that this archive
+ *                     will be "mounted", in platform-independent notation.
+ *                     NULL or "" is equivalent to "/".
+ *   \param appendToPath nonzero to append to search path, zero to prepend.
+ *  \return nonzero if added to path, zero on failure (stale manifest,
+ *          bogus archive, etc). Use PHYSFS_getLastErrorCode() to obtain
+ *          the specific error.
+ *
+ * \sa PHYSFS_writeMountManifest
+ * \sa PHYSFS_unmount
+ */
+PHYSFS_DECL int PHYSFS_mountManifest(const char *newDir,
+                                     const char *manifestFile,
+                                     const char *mountPoint,
+                                     int appendToPath);
+
+
+/**
+ * \struct PHYSFS_MountSpec
+ * \brief One archive or directory for PHYSFS_mountBatch() to mount.
+ *
+ * The fields mirror the arguments of PHYSFS_mount().
+ *
+ * \sa PHYSFS_mountBatch
+ */
+typedef struct PHYSFS_MountSpec
+{
+    const char *newDir;      /**< directory or archive, platform-dependent
+                                  notation. */
+    const char *mountPoint;  /**< mount location in the interpolated tree;
+                                  NULL or "" is equivalent to "/". */
+    int appendToPath;        /**< nonzero to append to the search path,
+                                  zero to prepend. */
+} PHYSFS_MountSpec;
+
+
+/**
+ * \fn int PHYSFS_mountBatch(const PHYSFS_MountSpec *specs, PHYSFS_uint32 count)
+ * \brief Mount several archives at once, parsing them in parallel.
+ *
+ * Mounting is mostly archive parsing, and each archive's parse is
+ *  independent i/o and CPU work, so a launcher adding dozens of DLC or mod
+ *  archives serially leaves most of the machine idle. This call opens all
+ *  (count) archives described by (specs) on a small worker pool and then
+ *  splices the results into the search path in spec order, so the final
+ *  search path is exactly what the equivalent sequence of PHYSFS_mount()
+ *  calls would have produced--only the wall-clock time changes.
+ *
+ * Archives already in the search path (or listed twice in one batch) are
+ *  successful no-ops, as with PHYSFS_mount(). Archives that fail to open
+ *  are skipped without disturbing the rest of the batch: everything that
+ *  could be mounted is mounted.
+ *
+ *   \param specs array of archives/directories to mount.
+ *   \param count number of elements in (specs).
+ *  \return number of specs successfully mounted (counting no-ops). If this
+ *          is less than (count), at least one mount failed; the error code
+ *          reports the first failure. Use PHYSFS_getLastErrorCode() to
+ *          obtain the specific error.
+ *
+ * \sa PHYSFS_mount
+ * \sa PHYSFS_unmount
+ */
+PHYSFS_DECL int PHYSFS_mountBatch(const PHYSFS_MountSpec *specs,
+                                  PHYSFS_uint32 count);
+
+
 /**
  * \enum PHYSFS_ErrorCode
  * \brief Values that represent specific causes of failure.
@@ -3629,14 +3961,21 @@ PHYSFS_DECL const char *PHYSFS_getPrefDir(const char *org, const char *app);
  *  PHYSFS_setErrorCode() before returning. PhysicsFS will pass these errors
  *  back to the application unmolested in most cases.
  *
- * Thread safety: PHYSFS_Archiver implementations are not guaranteed to be
- *  thread safe in themselves. PhysicsFS provides thread safety when it calls
- *  into a given archiver inside the library, but it does not promise that
- *  using the same PHYSFS_File from two threads at once is thread-safe; as
- *  such, your PHYSFS_Archiver can assume that locking is handled for you
- *  so long as the PHYSFS_Io you return from PHYSFS_open* doesn't change any
- *  of your Archiver state, as the PHYSFS_Io won't be as aggressively
- *  protected.
+ * Thread safety: since the library moved to a shared (reader/writer) state
+ *  lock, the read-only methods--openRead(), enumerate(), enumerateWithStat(),
+ *  stat() and correctCase()--may be called from several threads at once for
+ *  the same opaque archive handle. If those methods share mutable state (a
+ *  lazily-built cache, a seekable handle to the archive, etc), your archiver
+ *  must guard it itself; the bundled archivers do. openArchive() only ever
+ *  runs on a handle no other thread can see yet, and the mutating methods--
+ *  openWrite(), openAppend(), remove(), mkdir() and closeArchive()--only
+ *  run with the state lock held exclusively, so none of those ever overlap
+ *  each other or the read-only methods on the same handle.
+ *  PhysicsFS still does not promise that using the same PHYSFS_File from two
+ *  threads at once is thread-safe. Note that the PHYSFS_Io handed to
+ *  PHYSFS_mountIo() can have its duplicate() method called while other
+ *  threads are inside the archiver, so that method must be thread-safe too
+ *  (the Ios PhysicsFS creates itself already are).
  *
  * \sa PHYSFS_registerArchiver
  * \sa PHYSFS_deregisterArchiver
@@ -3647,10 +3986,14 @@ typedef struct PHYSFS_Archiver
     /**
      * \brief Binary compatibility information.
      *
-     * This must be set to zero at this time. Future versions of this
-     *  struct will increment this field, so we know what a given
-     *  implementation supports. We'll presumably keep supporting older
-     *  versions as we offer new features, though.
+     * This must be set to zero, one, or two at this time. Version one
+     *  appends the optional (enumerateWithStat) method to the end of this
+     *  struct, and version two appends (correctCase) after that;
+     *  implementations declaring an older version must not provide the
+     *  newer fields at all. Future versions of this struct will increment
+     *  this field further, so we know what a given implementation
+     *  supports. We'll presumably keep supporting older versions as we
+     *  offer new features, though.
      */
     PHYSFS_uint32 version;
 
@@ -3805,6 +4148,37 @@ typedef struct PHYSFS_Archiver
      *  there are still files open from this archive.
      */
     void (*closeArchive)(void *opaque);
+
+    /**
+     * \brief List all files in (dirname), with metadata. Optional.
+     *
+     * This field is only present if (version) is at least one!
+     *
+     * Same rules as (enumerate), but each item is reported along with the
+     *  PHYSFS_Stat data your (stat) method would produce for it, filled
+     *  from the directory entry you already have in hand instead of a
+     *  separate per-file lookup. May be NULL, in which case
+     *  PHYSFS_enumerateWithStat() falls back to calling (enumerate) and
+     *  (stat) for each item.
+     */
+    PHYSFS_EnumerateCallbackResult (*enumerateWithStat)(void *opaque,
+                     const char *dirname, PHYSFS_EnumerateWithStatCallback cb,
+                     const char *origdir, void *callbackdata);
+
+    /**
+     * \brief Resolve a path in this archive, ignoring case.
+     *
+     * This field is only present if (version) is at least two!
+     *
+     * Find the entry that matches (name) case-insensitively and return
+     *  its real name, or NULL (with the error state set) if there is no
+     *  such entry. The returned pointer must stay valid until the archive
+     *  is closed; returning a pointer to the entry's stored name is the
+     *  expected implementation. May be NULL, in which case
+     *  PHYSFS_openReadIgnoreCase() only finds exact matches in this
+     *  archive.
+     */
+    const char * (*correctCase)(void *opaque, const char *name);
 } PHYSFS_Archiver;
 
 /**
@@ -3909,6 +4283,725 @@ PHYSFS_DECL int PHYSFS_deregisterArchiver(const char *ext);
 PHYSFS_DECL int PHYSFS_setRoot(const char *archive, const char *subdir);
 
 
+/**
+ * \fn int PHYSFS_setNegativeCache(int enable)
+ * \brief Enable or disable caching of failed lookups.
+ *
+ * Apps that frequently probe for optional files (downloadable content,
+ *  localized variants, override files that usually don't exist) pay for a
+ *  full search path walk on every miss. With the negative cache enabled,
+ *  PhysicsFS remembers a bounded set of paths that recently failed to
+ *  resolve, so repeated lookups of absent files return immediately.
+ *
+ * The cache is invalidated whenever the interpolated file tree can change:
+ *  mounting and unmounting archives, changing the write dir or an archive's
+ *  root, or creating new files and directories through PhysicsFS. Files
+ *  created _outside_ of PhysicsFS (by another process, or by writing
+ *  directly to a mounted directory) may be reported as missing until the
+ *  cache is flushed by one of those events, which is why this is opt-in.
+ *
+ * This can be toggled at any time after PHYSFS_init(). Disabling the cache
+ *  discards its contents. It is off by default.
+ *
+ *    \param enable nonzero to enable the cache, zero to disable it.
+ *   \return nonzero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_exists
+ * \sa PHYSFS_stat
+ */
+PHYSFS_DECL int PHYSFS_setNegativeCache(int enable);
+
+/**
+ * \fn int PHYSFS_setCacheSize(PHYSFS_uint64 cachesize)
+ * \brief Set the byte budget for caching decompressed file contents.
+ *
+ * Small config and script files inside compressed archives often get
+ *  opened and fully decompressed dozens of times per session. With a
+ *  nonzero cache budget, PhysicsFS keeps the complete contents of
+ *  recently-opened files in memory, and repeat PHYSFS_openRead() calls
+ *  for the same file are served straight from that copy with zero
+ *  decompression or archive i/o.
+ *
+ * The cache is bounded by (cachesize) bytes; least-recently-opened
+ *  contents are evicted to make room for new ones. Files larger than a
+ *  quarter of the budget are never cached, so one big file can't flush
+ *  everything else out. Contents cached from an archive are dropped when
+ *  it is unmounted, and the whole cache is dropped when a file is created,
+ *  written, or deleted through PhysicsFS, since cached copies may go
+ *  stale. As with PHYSFS_setNegativeCache(), changes made to the physical
+ *  filesystem _outside_ of PhysicsFS are not detected, which is why this
+ *  is opt-in.
+ *
+ * This can be called at any time after PHYSFS_init(). Shrinking the
+ *  budget evicts immediately; a budget of zero disables the cache and
+ *  discards its contents. It is zero by default. Files already open keep
+ *  working either way.
+ *
+ *    \param cachesize cache budget in bytes, or zero to disable caching.
+ *   \return nonzero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_openRead
+ * \sa PHYSFS_setNegativeCache
+ */
+PHYSFS_DECL int PHYSFS_setCacheSize(PHYSFS_uint64 cachesize);
+
+/**
+ * \fn int PHYSFS_enumerateWithStat(const char *dir, PHYSFS_EnumerateWithStatCallback c, void *d)
+ * \brief Get a file listing of a search path's directory, with metadata.
+ *
+ * This works exactly like PHYSFS_enumerate(), but each enumerated item is
+ *  reported together with its PHYSFS_Stat metadata. If you were going to
+ *  call PHYSFS_stat() on every file anyway--asset scanners and loading
+ *  screens tend to--this saves a full search path walk and directory
+ *  lookup per file, since archivers fill in the metadata from the
+ *  directory entry they are already holding during enumeration.
+ *
+ * Items are not guaranteed to arrive in any order, and you may receive
+ *  duplicate filenames if multiple archives provide them, just like with
+ *  PHYSFS_enumerate(). The stat data matches what a PHYSFS_stat() call
+ *  against the archive that reported the item would return.
+ *
+ *    \param dir Directory, in platform-independent notation, to enumerate.
+ *    \param c Callback function to notify about search path elements.
+ *    \param d Application-defined data passed to callback. Can be NULL.
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error. The
+ *           same PHYSFS_ENUM_STOP / PHYSFS_ENUM_ERROR rules as
+ *           PHYSFS_enumerate() apply.
+ *
+ * \sa PHYSFS_EnumerateWithStatCallback
+ * \sa PHYSFS_enumerate
+ */
+PHYSFS_DECL int PHYSFS_enumerateWithStat(const char *dir,
+                                         PHYSFS_EnumerateWithStatCallback c,
+                                         void *d);
+
+/**
+ * \fn const void *PHYSFS_mmap(PHYSFS_File *handle, PHYSFS_uint64 *len)
+ * \brief Get a zero-copy, read-only view of an entire open file.
+ *
+ * If the data behind (handle) can be handed over without copying--a
+ *  memory-mapped file on disk, an uncompressed entry in an archive, a
+ *  buffer mounted with PHYSFS_mountMemory()--this returns a pointer to
+ *  all of it and stores the file's size in bytes to (len). The usual
+ *  double copy (the kernel into a PhysicsFS read buffer, then into your
+ *  own structures) never happens.
+ *
+ * The pointer is read-only and stays valid until (handle) is closed;
+ *  don't touch it after that. The file's i/o position is not used or
+ *  moved by this call, and you can keep using PHYSFS_readBytes() on the
+ *  handle independently. Calling this more than once on the same handle
+ *  may return the same pointer.
+ *
+ * Not every file can be mapped: compressed archive entries and
+ *  PHYSFS_Io implementations without mapping support will make this
+ *  return NULL, so be prepared to fall back to ordinary reads.
+ *
+ *   \param handle handle returned from PHYSFS_openRead().
+ *   \param len Where to store the file's size, in bytes.
+ *  \return pointer to the file's data, or NULL on failure (file not
+ *          mappable, handle not open for reading, etc). Specifics of the
+ *          error can be gleaned from PHYSFS_getLastErrorCode().
+ *
+ * \sa PHYSFS_openRead
+ * \sa PHYSFS_readBytes
+ */
+PHYSFS_DECL const void *PHYSFS_mmap(PHYSFS_File *handle, PHYSFS_uint64 *len);
+
+
+/**
+ * \typedef PHYSFS_AsyncReadCallback
+ * \brief Function signature for completion of an asynchronous read.
+ *
+ * These are used with PHYSFS_readBytesAsync(), and are called from
+ *  PHYSFS_pollAsyncReads() or PHYSFS_waitAsyncReads()--never from a
+ *  background thread--when the read they were queued with has finished.
+ *
+ * (result) is what PHYSFS_readBytes() would have returned for the same
+ *  read: the number of bytes read, which may be less than requested at
+ *  EOF, or -1 on complete failure. If it is less than the requested
+ *  length, PHYSFS_getLastErrorCode() reports why, as usual.
+ *
+ *    \param file the file handle the read was queued against.
+ *    \param userdata the pointer that was passed to PHYSFS_readBytesAsync().
+ *    \param result number of bytes read, or -1 on complete failure.
+ *
+ * \sa PHYSFS_readBytesAsync
+ */
+typedef void (*PHYSFS_AsyncReadCallback)(PHYSFS_File *file, void *userdata,
+                                         PHYSFS_sint64 result);
+
+/**
+ * \fn int PHYSFS_readBytesAsync(PHYSFS_File *handle, void *buffer, PHYSFS_uint64 len, PHYSFS_AsyncReadCallback callback, void *userdata)
+ * \brief Queue a read to be performed in the background.
+ *
+ * This works like PHYSFS_readBytes(), but returns immediately; the read
+ *  (including any decompression the archiver has to do) happens on an
+ *  internal worker thread while your app does other things. When it
+ *  finishes, (callback) fires with the result--but only from inside
+ *  PHYSFS_pollAsyncReads() or PHYSFS_waitAsyncReads(), on whatever thread
+ *  called those, so you never need to lock against a surprise callback.
+ *
+ * The file's i/o position advances as the read progresses, same as a
+ *  blocking read. Until the callback has fired, the handle and (buffer)
+ *  belong to the background read: don't read, seek, close, or otherwise
+ *  touch the handle, and don't free or inspect the buffer. Only one
+ *  asynchronous read may be pending on a given handle at a time; reads on
+ *  _different_ handles run in parallel.
+ *
+ * On platforms without threads, the read is performed immediately on the
+ *  calling thread; the callback is still deferred to the next poll/wait,
+ *  so your control flow is the same everywhere.
+ *
+ * PHYSFS_deinit() waits for any still-outstanding reads and runs their
+ *  callbacks before tearing anything down, but well-behaved apps should
+ *  drain the queue themselves first.
+ *
+ *    \param handle handle returned from PHYSFS_openRead().
+ *    \param buffer buffer of at least (len) bytes to store read data into.
+ *    \param len number of bytes being read from (handle).
+ *    \param callback function to call when the read completes.
+ *    \param userdata pointer passed through to (callback), untouched.
+ *   \return nonzero if the read was queued, zero on failure to queue
+ *           (bogus parameters, out of memory, etc). Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_readBytes
+ * \sa PHYSFS_pollAsyncReads
+ * \sa PHYSFS_waitAsyncReads
+ */
+PHYSFS_DECL int PHYSFS_readBytesAsync(PHYSFS_File *handle, void *buffer,
+                                      PHYSFS_uint64 len,
+                                      PHYSFS_AsyncReadCallback callback,
+                                      void *userdata);
+
+/**
+ * \fn int PHYSFS_pollAsyncReads(void)
+ * \brief Run callbacks for finished asynchronous reads, without blocking.
+ *
+ * Call this from your main loop (or wherever you want completion
+ *  callbacks to fire). Every read queued with PHYSFS_readBytesAsync()
+ *  that has since finished gets its callback called here, on the current
+ *  thread, in completion order. Reads still in flight are left alone and
+ *  this returns immediately; it never blocks.
+ *
+ *   \return number of asynchronous reads still pending (that is, zero
+ *           means everything queued so far has completed and had its
+ *           callback run).
+ *
+ * \sa PHYSFS_readBytesAsync
+ * \sa PHYSFS_waitAsyncReads
+ */
+PHYSFS_DECL int PHYSFS_pollAsyncReads(void);
+
+/**
+ * \fn void PHYSFS_waitAsyncReads(void)
+ * \brief Block until all queued asynchronous reads have completed.
+ *
+ * This runs completion callbacks exactly like PHYSFS_pollAsyncReads(),
+ *  but sleeps between completions instead of returning, and doesn't come
+ *  back to you until nothing is pending. Useful at loading-screen
+ *  boundaries where there's nothing to do but wait for the data.
+ *
+ * \sa PHYSFS_readBytesAsync
+ * \sa PHYSFS_pollAsyncReads
+ */
+PHYSFS_DECL void PHYSFS_waitAsyncReads(void);
+
+/**
+ * \fn int PHYSFS_prefetch(const char *fname, PHYSFS_uint64 offset, PHYSFS_uint64 len)
+ * \brief Warm a file's data in the background, ahead of its first read.
+ *
+ * If you know which files you'll need soon--say, at level-select time--this
+ *  lets you pay the cold-disk (and, for compressed archives, decompression)
+ *  cost on a background thread before the first PHYSFS_openRead(). The file
+ *  is opened, (len) bytes starting at (offset) are read and discarded on the
+ *  same worker pool that serves PHYSFS_readBytesAsync(), and the file is
+ *  closed again. That pass pulls the data through the operating system's
+ *  page cache and, if a content cache is enabled with PHYSFS_setCacheSize(),
+ *  leaves the decompressed bytes cached, so the later synchronous open hits
+ *  warm data.
+ *
+ * Pass zero for (len) to prefetch from (offset) to the end of the file.
+ *
+ * This is a hint: a prefetch that fails in the background (file shrank,
+ *  media ejected, etc.) is dropped silently, since the real read will
+ *  report the problem anyway. Only errors visible at queue time--file not
+ *  found, out of memory--are reported here. No callback fires on
+ *  completion, but pending prefetches count towards the totals reported by
+ *  PHYSFS_pollAsyncReads() and delay PHYSFS_waitAsyncReads() like any
+ *  other queued read.
+ *
+ *   \param fname file to warm, in platform-independent notation.
+ *   \param offset byte offset to start reading at.
+ *   \param len bytes to read, or zero to read to the end of the file.
+ *  \return nonzero if the prefetch was queued, zero on error (the file
+ *          couldn't be opened, etc.). Use PHYSFS_getLastErrorCode() to
+ *          obtain the specific error.
+ *
+ * \sa PHYSFS_readBytesAsync
+ * \sa PHYSFS_setCacheSize
+ * \sa PHYSFS_waitAsyncReads
+ */
+PHYSFS_DECL int PHYSFS_prefetch(const char *fname, PHYSFS_uint64 offset,
+                                PHYSFS_uint64 len);
+
+/**
+ * \struct PHYSFS_Stats
+ * \brief Performance counters, filled in by PHYSFS_getStats().
+ *
+ * All counters are totals since PHYSFS_init(). Counter updates are atomic
+ *  where the compiler offers it, but reading the set isn't a consistent
+ *  snapshot; treat the numbers as approximate under heavy threading.
+ *
+ * \sa PHYSFS_getStats
+ * \sa PHYSFS_getMountStats
+ */
+typedef struct PHYSFS_Stats
+{
+    PHYSFS_uint64 opens;            /**< PHYSFS_openRead() calls. */
+    PHYSFS_uint64 openFailures;     /**< ...of those, how many failed. */
+    PHYSFS_uint64 searchPathProbes; /**< mounts asked during open/stat. */
+    PHYSFS_uint64 bytesRead;        /**< bytes delivered by readBytes(). */
+    PHYSFS_uint64 bytesDecompressed; /**< bytes inflated from archives. */
+    PHYSFS_uint64 bufferHits;       /**< buffered reads served in-memory. */
+    PHYSFS_uint64 bufferMisses;     /**< buffer refills from the archive. */
+    PHYSFS_uint64 treeFinds;        /**< archive directory-tree lookups. */
+} PHYSFS_Stats;
+
+
+/**
+ * \fn int PHYSFS_getStats(PHYSFS_Stats *stats)
+ * \brief Retrieve process-wide performance counters.
+ *
+ * When load times regress in the field, these counters say where the work
+ *  went: how many opens ran, how many mounts each open had to probe, how
+ *  much data was read and decompressed, and how the PHYSFS_setBuffer()
+ *  buffers are behaving. Updates cost one atomic add on the hot paths;
+ *  building with PHYSFS_NO_STATS defined compiles them out entirely, in
+ *  which case this function fails with PHYSFS_ERR_UNSUPPORTED.
+ *
+ *   \param stats structure to fill in.
+ *  \return nonzero on success, zero on error. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_getMountStats
+ */
+PHYSFS_DECL int PHYSFS_getStats(PHYSFS_Stats *stats);
+
+
+/**
+ * \fn int PHYSFS_getMountStats(const char *dir, PHYSFS_Stats *stats)
+ * \brief Retrieve performance counters for one element of the search path.
+ *
+ * Like PHYSFS_getStats(), but scoped to the mount whose real name (as
+ *  passed to PHYSFS_mount()) is (dir). Only the counters that make sense
+ *  per-mount are filled in--opens, searchPathProbes and bytesRead--and the
+ *  rest are reported as zero. Counters start when the archive is mounted
+ *  and vanish with it on unmount.
+ *
+ *   \param dir a mount's real name, as in the search path.
+ *   \param stats structure to fill in.
+ *  \return nonzero on success, zero on error (not mounted, stats compiled
+ *          out, etc). Use PHYSFS_getLastErrorCode() to obtain the specific
+ *          error.
+ *
+ * \sa PHYSFS_getStats
+ * \sa PHYSFS_getSearchPath
+ */
+PHYSFS_DECL int PHYSFS_getMountStats(const char *dir, PHYSFS_Stats *stats);
+
+
+/**
+ * \typedef PHYSFS_TraceCallback
+ * \brief Hook for tracing individual PhysicsFS operations.
+ *
+ * Set with PHYSFS_setTraceHook(); called synchronously at the end of
+ *  traced operations, on whatever thread ran them. (op) is a static
+ *  string naming the operation ("mount", "openRead", ...), (detail) is
+ *  the path it worked on, and (result) is nonzero if it succeeded. Wrap
+ *  your own clock around the callback to attach timestamps or flag slow
+ *  operations; PhysicsFS itself has no portable high-resolution timer.
+ *
+ *    \param userdata the pointer passed to PHYSFS_setTraceHook().
+ *    \param op static string naming the operation.
+ *    \param detail the path the operation worked on.
+ *    \param result nonzero if the operation succeeded.
+ *
+ * \sa PHYSFS_setTraceHook
+ */
+typedef void (*PHYSFS_TraceCallback)(void *userdata, const char *op,
+                                     const char *detail, int result);
+
+/**
+ * \fn void PHYSFS_setTraceHook(PHYSFS_TraceCallback callback, void *userdata)
+ * \brief Install (or remove) a tracing hook.
+ *
+ * While a hook is installed it is called for every mount, unmount and
+ *  file open. Pass a NULL (callback) to remove the hook; with no hook
+ *  installed the cost is a single pointer test per traced operation.
+ *  The hook runs with internal locks held, so it must not call back into
+ *  PhysicsFS; stash what you need and get out.
+ *
+ *    \param callback function to call for traced operations, or NULL.
+ *    \param userdata passed through to (callback) untouched.
+ *
+ * \sa PHYSFS_TraceCallback
+ */
+PHYSFS_DECL void PHYSFS_setTraceHook(PHYSFS_TraceCallback callback,
+                                     void *userdata);
+
+
+/**
+ * \fn PHYSFS_File *PHYSFS_openReadIgnoreCase(const char *fname)
+ * \brief Open a file for reading, ignoring case in the file's path.
+ *
+ * Like PHYSFS_openRead(), but (fname) is matched case-insensitively
+ *  against the contents of each archive, resolved in a single hash
+ *  lookup per archive. This replaces the extras/ignorecase.c approach
+ *  of enumerating every directory component, which costs a full
+ *  directory scan per component per call.
+ *
+ * Case is only ignored inside the archives themselves; mount points in
+ *  the search path still match exactly. Archives whose archiver doesn't
+ *  support case correction (and platform directories mounted directly)
+ *  only match exactly, too. If an archive holds several entries whose
+ *  names differ only in case, which one you get is unspecified.
+ *
+ *   \param fname filename to open, in platform-independent notation.
+ *  \return A valid PhysicsFS filehandle on success, NULL on error. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_openRead
+ * \sa PHYSFS_close
+ */
+PHYSFS_DECL PHYSFS_File *PHYSFS_openReadIgnoreCase(const char *fname);
+
+
+/**
+ * \struct PHYSFS_Glob
+ * \brief An opaque, precompiled set of wildcard patterns.
+ *
+ * Built once with PHYSFS_globCompile() and reused across scans, so the
+ *  per-call cost is matching, not pattern parsing. A PHYSFS_Glob also
+ *  carries the state PHYSFS_globChanges() needs to report only what
+ *  changed between scans. Do not use one PHYSFS_Glob from two threads
+ *  at the same time.
+ *
+ * \sa PHYSFS_globCompile
+ * \sa PHYSFS_globMatch
+ * \sa PHYSFS_globChanges
+ * \sa PHYSFS_globFree
+ */
+typedef struct PHYSFS_Glob PHYSFS_Glob;
+
+/**
+ * \fn PHYSFS_Glob *PHYSFS_globCompile(const char * const *patterns, PHYSFS_uint32 count, int caseSensitive)
+ * \brief Compile a set of wildcard patterns for repeated matching.
+ *
+ * Pattern syntax: '?' matches any single character except '/', '*'
+ *  matches any run of characters not containing '/', and a run of two
+ *  or more stars matches any run of characters _including_ '/'. So
+ *  "*.png" matches images in the scanned directory itself, and
+ *  "**.png" matches them any number of levels down. Anything else
+ *  matches literally. With (caseSensitive) zero, ASCII letters are
+ *  compared case-insensitively, like extras/globbing.c did.
+ *
+ * Patterns that turn out to be pure literals, or a literal with one
+ *  leading or trailing '*', are matched with direct string compares
+ *  instead of the general matcher.
+ *
+ *   \param patterns array of (count) pattern strings.
+ *   \param count number of patterns; must be at least one.
+ *   \param caseSensitive zero to ignore ASCII case when matching.
+ *  \return an opaque glob handle, or NULL on error. Free it with
+ *          PHYSFS_globFree().
+ *
+ * \sa PHYSFS_globMatch
+ * \sa PHYSFS_globFree
+ */
+PHYSFS_DECL PHYSFS_Glob *PHYSFS_globCompile(const char * const *patterns,
+                                            PHYSFS_uint32 count,
+                                            int caseSensitive);
+
+/**
+ * \fn char **PHYSFS_globMatch(PHYSFS_Glob *glob, const char *dir, int recursive)
+ * \brief Find all files under (dir) that match a compiled glob.
+ *
+ * Walks (dir) in a single enumeration pass across the search path and
+ *  returns every entry whose name, relative to (dir), matches at least
+ *  one of the glob's patterns. With (recursive) nonzero, subdirectories
+ *  are walked too, and matched names keep their subdirectory components
+ *  ("models/tree.obj"). The result is a NULL-terminated array of
+ *  strings in the same format PHYSFS_enumerateFiles() returns; free it
+ *  with PHYSFS_freeList(). Order is unspecified.
+ *
+ *   \param glob a compiled pattern set from PHYSFS_globCompile().
+ *   \param dir directory, in platform-independent notation, to scan.
+ *   \param recursive nonzero to descend into subdirectories.
+ *  \return NULL-terminated array of matching names, or NULL on error.
+ *
+ * \sa PHYSFS_globCompile
+ * \sa PHYSFS_globChanges
+ * \sa PHYSFS_freeList
+ */
+PHYSFS_DECL char **PHYSFS_globMatch(PHYSFS_Glob *glob, const char *dir,
+                                    int recursive);
+
+/**
+ * \fn char **PHYSFS_globChanges(PHYSFS_Glob *glob, const char *dir, int recursive)
+ * \brief Like PHYSFS_globMatch(), but only report changes since last scan.
+ *
+ * Matches exactly as PHYSFS_globMatch() does, but only returns entries
+ *  that are new, or whose modification time changed, since the previous
+ *  PHYSFS_globChanges() call on this glob--so a hot-reload watcher can
+ *  poll cheaply and usually get back an empty list. The first call
+ *  reports everything. Files that _vanish_ between scans are not
+ *  reported; the remembered state just keeps growing until the glob is
+ *  freed.
+ *
+ *   \param glob a compiled pattern set from PHYSFS_globCompile().
+ *   \param dir directory, in platform-independent notation, to scan.
+ *   \param recursive nonzero to descend into subdirectories.
+ *  \return NULL-terminated array of changed names, or NULL on error.
+ *
+ * \sa PHYSFS_globMatch
+ * \sa PHYSFS_freeList
+ */
+PHYSFS_DECL char **PHYSFS_globChanges(PHYSFS_Glob *glob, const char *dir,
+                                      int recursive);
+
+/**
+ * \fn void PHYSFS_globFree(PHYSFS_Glob *glob)
+ * \brief Dispose of a compiled glob.
+ *
+ * Frees the pattern set and any change-tracking state. Does nothing if
+ *  (glob) is NULL.
+ *
+ *   \param glob a compiled pattern set from PHYSFS_globCompile().
+ *
+ * \sa PHYSFS_globCompile
+ */
+PHYSFS_DECL void PHYSFS_globFree(PHYSFS_Glob *glob);
+
+
+/**
+ * \typedef PHYSFS_AsyncFlushCallback
+ * \brief Function signature for completion of an asynchronous flush.
+ *
+ * These are used with PHYSFS_flushAsync(), and are called from
+ *  PHYSFS_pollAsyncReads() or PHYSFS_waitAsyncReads()--never from a
+ *  background thread--once everything written before the flush was queued
+ *  has been handed to the archiver.
+ *
+ *    \param file the file handle the flush was queued against.
+ *    \param userdata the pointer that was passed to PHYSFS_flushAsync().
+ *    \param result nonzero on success, zero if a write failed. On failure,
+ *                  PHYSFS_getLastErrorCode() reports why.
+ *
+ * \sa PHYSFS_flushAsync
+ */
+typedef void (*PHYSFS_AsyncFlushCallback)(PHYSFS_File *file, void *userdata,
+                                          int result);
+
+/**
+ * \fn int PHYSFS_setWriteBehind(PHYSFS_File *handle, int enable)
+ * \brief Let a write handle's buffer drain on a background thread.
+ *
+ * Normally a buffered write handle blocks whenever its buffer fills: the
+ *  whole buffer is pushed through the archiver before PHYSFS_writeBytes()
+ *  returns. With write-behind enabled, a full buffer is instead handed to
+ *  the worker pool that serves PHYSFS_readBytesAsync() and writing
+ *  continues immediately into a fresh buffer, so the archiver (and any
+ *  compression it does) runs while your app produces the next chunk.
+ *  Buffers are written out in order, in buffer-sized batches.
+ *
+ * The handle must already have a buffer from PHYSFS_setBuffer(); pick the
+ *  buffer size to taste, since it sets the batch size. Writes a background
+ *  thread couldn't complete are reported by the next synchronous flush:
+ *  PHYSFS_flush(), PHYSFS_seek(), PHYSFS_close() and disabling write-behind
+ *  all wait for the queue to drain first and fail with the background
+ *  error, so nothing is lost silently. PHYSFS_tell() accounts for
+ *  still-queued data and always reports the logical write position.
+ *
+ * On platforms without threads this is accepted but writes out each full
+ *  buffer on the calling thread, which is simply the normal behavior.
+ *
+ *    \param handle handle returned from PHYSFS_openWrite()/openAppend().
+ *    \param enable nonzero to enable write-behind, zero to disable. When
+ *                  disabling, this blocks until queued buffers are written.
+ *   \return nonzero on success, zero on error. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_setBuffer
+ * \sa PHYSFS_flushAsync
+ */
+PHYSFS_DECL int PHYSFS_setWriteBehind(PHYSFS_File *handle, int enable);
+
+/**
+ * \fn int PHYSFS_flushAsync(PHYSFS_File *handle, PHYSFS_AsyncFlushCallback callback, void *userdata)
+ * \brief Flush a write handle's buffered data without blocking.
+ *
+ * This queues everything buffered so far--the current buffer and any
+ *  write-behind backlog--to be written out in the background, and returns
+ *  immediately. When the last of it has been handed to the archiver,
+ *  (callback) fires from inside PHYSFS_pollAsyncReads() or
+ *  PHYSFS_waitAsyncReads(), like an asynchronous read's callback would.
+ *  (callback) may be NULL if you just want the data on its way.
+ *
+ * Writes made after this call are unaffected and simply begin filling the
+ *  buffer again; there's no need to wait for the callback before writing
+ *  more. Without write-behind enabled (or without threads), the flush
+ *  happens on the calling thread and the callback is deferred to the next
+ *  poll/wait, so your control flow is the same everywhere.
+ *
+ *    \param handle handle returned from PHYSFS_openWrite()/openAppend().
+ *    \param callback function to call when the flush completes. May be NULL.
+ *    \param userdata pointer passed through to (callback), untouched.
+ *   \return nonzero if the flush was queued (or performed), zero on failure
+ *           to queue. Use PHYSFS_getLastErrorCode() to obtain the specific
+ *           error.
+ *
+ * \sa PHYSFS_flush
+ * \sa PHYSFS_setWriteBehind
+ * \sa PHYSFS_pollAsyncReads
+ */
+PHYSFS_DECL int PHYSFS_flushAsync(PHYSFS_File *handle,
+                                  PHYSFS_AsyncFlushCallback callback,
+                                  void *userdata);
+
+/**
+ * \fn void *PHYSFS_loadFile(const char *fname, PHYSFS_uint64 *len)
+ * \brief Read an entire file into a single freshly-allocated buffer.
+ *
+ * This replaces the usual open/length/malloc/read-loop/close dance with
+ *  one call: the path is resolved once, exactly one buffer of the file's
+ *  size is allocated, and the data is read with a single pass through the
+ *  archiver--compressed archives decompress directly into the returned
+ *  buffer with no intermediate copy.
+ *
+ * The buffer is allocated through the PhysicsFS allocator and must be
+ *  released with PHYSFS_freeLoadedFile(). One extra zero byte is appended
+ *  past the end (not counted in *len), so text files can be handed
+ *  straight to C string functions.
+ *
+ *    \param fname filename to load, in platform-independent notation.
+ *    \param len if not NULL, receives the file's size in bytes.
+ *   \return pointer to the loaded data, or NULL on failure (file not
+ *           found, out of memory, i/o error...). Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_loadFileTo
+ * \sa PHYSFS_freeLoadedFile
+ */
+PHYSFS_DECL void *PHYSFS_loadFile(const char *fname, PHYSFS_uint64 *len);
+
+/**
+ * \fn PHYSFS_sint64 PHYSFS_loadFileTo(const char *fname, void *buffer, PHYSFS_uint64 buflen)
+ * \brief Read an entire file into a caller-provided buffer.
+ *
+ * The caller-allocated flavor of PHYSFS_loadFile(), for apps that manage
+ *  their own memory (arenas, pools, placement into a larger structure).
+ *  The whole file is read in one pass; if it doesn't fit in (buflen)
+ *  bytes, nothing is read and the call fails with
+ *  PHYSFS_ERR_INVALID_ARGUMENT, so a truncated load is never mistaken
+ *  for a complete one. No zero terminator is added.
+ *
+ *    \param fname filename to load, in platform-independent notation.
+ *    \param buffer buffer of at least the file's size in bytes.
+ *    \param buflen size of (buffer) in bytes.
+ *   \return number of bytes read (the file's size) on success, -1 on
+ *           failure. Use PHYSFS_getLastErrorCode() to obtain the specific
+ *           error.
+ *
+ * \sa PHYSFS_loadFile
+ */
+PHYSFS_DECL PHYSFS_sint64 PHYSFS_loadFileTo(const char *fname, void *buffer,
+                                            PHYSFS_uint64 buflen);
+
+/**
+ * \fn void PHYSFS_freeLoadedFile(void *data)
+ * \brief Release a buffer returned by PHYSFS_loadFile().
+ *
+ * Frees the data through the PhysicsFS allocator. Does nothing if (data)
+ *  is NULL.
+ *
+ *    \param data pointer returned by PHYSFS_loadFile().
+ *
+ * \sa PHYSFS_loadFile
+ */
+PHYSFS_DECL void PHYSFS_freeLoadedFile(void *data);
+
+/**
+ * \fn PHYSFS_sint64 PHYSFS_extractToNative(const char *fname, const char *nativePath)
+ * \brief Copy a file out of the virtual filesystem to a native file.
+ *
+ * This is the fast way to stage an asset on the real filesystem: where a
+ *  read/fwrite loop moves a small buffer at a time on one thread, this
+ *  streams large blocks and overlaps the reading (and any decompression
+ *  the archiver does) with the writing, using the same worker pool that
+ *  serves PHYSFS_readBytesAsync(). If the source is itself a plain native
+ *  file--a dir-archiver mount--and the operating system can copy between
+ *  two open files in the kernel, the data is never read into the process
+ *  at all.
+ *
+ * (nativePath) is a path in platform-dependent notation, like the
+ *  directories you pass to PHYSFS_mount(); it is created (or truncated)
+ *  like PHYSFS_openWrite() would, but does not go through the write dir.
+ *  On failure the partial output file is deleted.
+ *
+ * If other asynchronous reads are in flight, their completion callbacks
+ *  may fire from inside this call, as it waits on the same queue.
+ *
+ *    \param fname file to extract, in platform-independent notation.
+ *    \param nativePath destination, in platform-dependent notation.
+ *   \return number of bytes written on success, -1 on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_loadFile
+ * \sa PHYSFS_readBytesAsync
+ */
+PHYSFS_DECL PHYSFS_sint64 PHYSFS_extractToNative(const char *fname,
+                                                 const char *nativePath);
+
+/**
+ * \fn char **PHYSFS_enumerateFilesArena(const char *dir, void *arena, PHYSFS_uint64 arenaSize)
+ * \brief Get a directory listing without any heap allocation.
+ *
+ * The caller-allocated flavor of PHYSFS_enumerateFiles(): the result is
+ *  built entirely inside (arena), so nothing is allocated and there is
+ *  nothing to pass to PHYSFS_freeList(). Tools that rescan the same big
+ *  directory trees periodically can hand the same block to every call
+ *  and generate zero allocator traffic.
+ *
+ * The layout inside the arena is a NULL-terminated array of pointers
+ *  growing from the front and the name strings packed at the back, so
+ *  the return value is used exactly like PHYSFS_enumerateFiles()'s. The
+ *  names are in alphabetical order, with duplicates across the search
+ *  path removed. Everything points into (arena): the listing is only
+ *  valid until the arena is reused or freed.
+ *
+ * If the listing doesn't fit, the call fails with
+ *  PHYSFS_ERR_OUT_OF_MEMORY and the arena contents are undefined; call
+ *  again with a bigger block. Plan for a pointer plus the name's length
+ *  plus one byte per file, and a little slack.
+ *
+ *    \param dir directory in platform-independent notation to enumerate.
+ *    \param arena caller-provided scratch memory for the whole listing.
+ *    \param arenaSize size of (arena) in bytes.
+ *   \return pointer into (arena) to a NULL-terminated array of
+ *           NULL-terminated strings on success, NULL on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_enumerateFiles
+ * \sa PHYSFS_enumerate
+ */
+PHYSFS_DECL char **PHYSFS_enumerateFilesArena(const char *dir, void *arena,
+                                              PHYSFS_uint64 arenaSize);
+
+
 /* Everything above this line is part of the PhysicsFS 3.1 API. */
 
 
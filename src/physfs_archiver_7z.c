@@ -13,6 +13,20 @@
 
 #include "physfs_lzmasdk.h"
 
+/*
+ * Solid 7zip archives group files into "folder" blocks that compress as
+ *  one stream, so reading any one file means decompressing its whole
+ *  containing block. We keep recently-decompressed blocks in a cache
+ *  shared by every handle opened from the same archive; opening ten
+ *  files out of one solid block then costs one decompression instead of
+ *  ten. Blocks that no open handle references are evicted least-recently
+ *  -used once the cache grows past this byte budget; define it to
+ *  something else at build time to tune memory use.
+ */
+#ifndef PHYSFS_7Z_BLOCK_CACHE_SIZE
+#define PHYSFS_7Z_BLOCK_CACHE_SIZE (16 * 1024 * 1024)
+#endif
+
 typedef struct
 {
     ISeekInStream seekStream; /* lzma sdk i/o interface (lower level).  */
@@ -27,14 +41,37 @@ typedef struct
     PHYSFS_uint32 dbidx;          /* index into lzma sdk database   */
 } SZIPentry;
 
+/* One SZIPblock is kept for each cached decompressed folder block. */
+typedef struct SZIPblock
+{
+    UInt32 folderIndex;       /* which folder block this is.            */
+    Byte *data;               /* decompressed data.                     */
+    size_t size;              /* size of decompressed data, in bytes.   */
+    int refcount;             /* open handles reading from this block.  */
+    struct SZIPblock *next;   /* LRU list, most recently used first.    */
+} SZIPblock;
+
 /* One SZIPinfo is kept for each open 7zip archive. */
 typedef struct
 {
     __PHYSFS_DirTree tree;    /* manages directory tree.           */
     PHYSFS_Io *io;            /* physfs i/o interface for this archive. */
     CSzArEx db;               /* lzma sdk archive database object. */
+    SZIPblock *blockCache;    /* cached folder blocks, most recent first. */
+    size_t cacheUsed;         /* total bytes of cached blocks.     */
+    void *cacheLock;          /* protects blockCache and refcounts. */
 } SZIPinfo;
 
+/* One SZIPfileinfo is kept for each open file in a 7zip archive. */
+typedef struct
+{
+    SZIPinfo *archive;        /* archive this file came from.      */
+    SZIPblock *block;         /* shared decompressed folder block. */
+    size_t offset;            /* where this file starts in block.  */
+    size_t size;              /* size of this file, in bytes.      */
+    size_t position;          /* current tell() position.          */
+} SZIPfileinfo;
+
 
 static PHYSFS_ErrorCode szipErrorCode(const SRes rc)
 {
@@ -152,6 +189,242 @@ static void szipInitStream(SZIPLookToRead *stream, PHYSFS_Io *io)
 } /* szipInitStream */
 
 
+/* Free unreferenced cached blocks, oldest first, until we're in budget.
+   Caller must hold info->cacheLock. */
+static void szipEvictBlocks(SZIPinfo *info)
+{
+    ISzAlloc *alloc = &SZIP_SzAlloc;
+
+    while (info->cacheUsed > PHYSFS_7Z_BLOCK_CACHE_SIZE)
+    {
+        SZIPblock *block = NULL;
+        SZIPblock *blockprev = NULL;
+        SZIPblock *prev = NULL;
+        SZIPblock *i;
+
+        /* the last unreferenced block in the list is the LRU victim. */
+        for (i = info->blockCache; i != NULL; prev = i, i = i->next)
+        {
+            if (i->refcount == 0)
+            {
+                block = i;
+                blockprev = prev;
+            } /* if */
+        } /* for */
+
+        if (block == NULL)
+            break;  /* everything left is in use; we'll evict later. */
+
+        if (blockprev != NULL)
+            blockprev->next = block->next;
+        else
+            info->blockCache = block->next;
+
+        info->cacheUsed -= block->size;
+        alloc->Free(alloc, block->data);
+        allocator.Free(block);
+    } /* while */
+} /* szipEvictBlocks */
+
+
+/* Find a cached block, bump its refcount and move it to the front of the
+   LRU list. Caller must hold info->cacheLock. */
+static SZIPblock *szipFindBlock(SZIPinfo *info, const UInt32 folderIndex)
+{
+    SZIPblock *prev = NULL;
+    SZIPblock *i;
+
+    for (i = info->blockCache; i != NULL; prev = i, i = i->next)
+    {
+        if (i->folderIndex == folderIndex)
+        {
+            if (prev != NULL)  /* move to front. */
+            {
+                prev->next = i->next;
+                i->next = info->blockCache;
+                info->blockCache = i;
+            } /* if */
+            i->refcount++;
+            return i;
+        } /* if */
+    } /* for */
+
+    return NULL;
+} /* szipFindBlock */
+
+
+/* Decompress a folder block and add it to the cache with a refcount of
+   one. Caller must hold info->cacheLock; we hold it across the decode so
+   concurrent opens into the same block wait for one decompression
+   instead of each doing their own. */
+static SZIPblock *szipLoadBlock(SZIPinfo *info, const UInt32 folderIndex)
+{
+    ISzAlloc *alloc = &SZIP_SzAlloc;
+    SZIPLookToRead stream;
+    UInt32 blockIndex = 0xFFFFFFFF;
+    Byte *outBuffer = NULL;
+    size_t outBufferSize = 0;
+    size_t offset = 0;
+    size_t outSizeProcessed = 0;
+    SZIPblock *block;
+    PHYSFS_Io *io;
+    SRes rc;
+
+    io = info->io->duplicate(info->io);
+    BAIL_IF_ERRPASS(!io, NULL);
+
+    szipInitStream(&stream, io);
+
+    /* any file in the folder will do; this decodes the whole block. */
+    rc = SzArEx_Extract(&info->db, &stream.lookStream.s,
+                        info->db.FolderToFile[folderIndex],
+                        &blockIndex, &outBuffer, &outBufferSize, &offset,
+                        &outSizeProcessed, alloc, alloc);
+
+    io->destroy(io);
+
+    BAIL_IF(rc != SZ_OK, szipErrorCode(rc), NULL);
+    BAIL_IF(outBuffer == NULL, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    block = (SZIPblock *) allocator.Malloc(sizeof (SZIPblock));
+    if (block == NULL)
+    {
+        alloc->Free(alloc, outBuffer);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    } /* if */
+
+    block->folderIndex = folderIndex;
+    block->data = outBuffer;
+    block->size = outBufferSize;
+    block->refcount = 1;
+    block->next = info->blockCache;
+    info->blockCache = block;
+    info->cacheUsed += outBufferSize;
+
+    szipEvictBlocks(info);  /* in-use blocks survive this. */
+
+    return block;
+} /* szipLoadBlock */
+
+
+static void szipReleaseBlock(SZIPinfo *info, SZIPblock *block)
+{
+    __PHYSFS_platformGrabMutex(info->cacheLock);
+    block->refcount--;
+    szipEvictBlocks(info);
+    __PHYSFS_platformReleaseMutex(info->cacheLock);
+} /* szipReleaseBlock */
+
+
+/* An open file is just a window into its shared folder block, so reads
+   are memcpys and seeks are free. */
+
+static PHYSFS_sint64 SZIP_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
+{
+    SZIPfileinfo *finfo = (SZIPfileinfo *) io->opaque;
+    const PHYSFS_uint64 avail = (PHYSFS_uint64) (finfo->size-finfo->position);
+
+    if (avail < len)
+        len = avail;
+
+    if (len > 0)
+    {
+        memcpy(buf, finfo->block->data + finfo->offset + finfo->position,
+               (size_t) len);
+        finfo->position += (size_t) len;
+    } /* if */
+
+    return (PHYSFS_sint64) len;
+} /* SZIP_read */
+
+
+static PHYSFS_sint64 SZIP_write(PHYSFS_Io *io, const void *b, PHYSFS_uint64 l)
+{
+    BAIL(PHYSFS_ERR_READ_ONLY, -1);
+} /* SZIP_write */
+
+
+static int SZIP_seek(PHYSFS_Io *io, PHYSFS_uint64 offset)
+{
+    SZIPfileinfo *finfo = (SZIPfileinfo *) io->opaque;
+    BAIL_IF(offset > finfo->size, PHYSFS_ERR_PAST_EOF, 0);
+    finfo->position = (size_t) offset;
+    return 1;
+} /* SZIP_seek */
+
+
+static PHYSFS_sint64 SZIP_tell(PHYSFS_Io *io)
+{
+    return (PHYSFS_sint64) ((SZIPfileinfo *) io->opaque)->position;
+} /* SZIP_tell */
+
+
+static PHYSFS_sint64 SZIP_length(PHYSFS_Io *io)
+{
+    return (PHYSFS_sint64) ((SZIPfileinfo *) io->opaque)->size;
+} /* SZIP_length */
+
+
+static PHYSFS_Io *SZIP_duplicate(PHYSFS_Io *_io)
+{
+    SZIPfileinfo *origfinfo = (SZIPfileinfo *) _io->opaque;
+    PHYSFS_Io *retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
+    SZIPfileinfo *finfo = (SZIPfileinfo *) allocator.Malloc(sizeof (SZIPfileinfo));
+    GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, failed);
+    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, failed);
+
+    memcpy(finfo, origfinfo, sizeof (*finfo));
+    finfo->position = 0;
+
+    __PHYSFS_platformGrabMutex(finfo->archive->cacheLock);
+    finfo->block->refcount++;
+    __PHYSFS_platformReleaseMutex(finfo->archive->cacheLock);
+
+    memcpy(retval, _io, sizeof (PHYSFS_Io));
+    retval->opaque = finfo;
+    return retval;
+
+failed:
+    if (finfo != NULL) allocator.Free(finfo);
+    if (retval != NULL) allocator.Free(retval);
+    return NULL;
+} /* SZIP_duplicate */
+
+
+static int SZIP_flush(PHYSFS_Io *io) { return 1;  /* no write support. */ }
+
+static const void *SZIP_map(PHYSFS_Io *io, PHYSFS_uint64 *len)
+{
+    const SZIPfileinfo *finfo = (const SZIPfileinfo *) io->opaque;
+    *len = (PHYSFS_uint64) finfo->size;
+    return finfo->block->data + finfo->offset;  /* block outlives us. */
+} /* SZIP_map */
+
+static void SZIP_io_destroy(PHYSFS_Io *io)
+{
+    SZIPfileinfo *finfo = (SZIPfileinfo *) io->opaque;
+    szipReleaseBlock(finfo->archive, finfo->block);
+    allocator.Free(finfo);
+    allocator.Free(io);
+} /* SZIP_io_destroy */
+
+
+static const PHYSFS_Io SZIP_Io =
+{
+    CURRENT_PHYSFS_IO_API_VERSION, NULL,
+    SZIP_read,
+    SZIP_write,
+    SZIP_seek,
+    SZIP_tell,
+    SZIP_length,
+    SZIP_duplicate,
+    SZIP_flush,
+    SZIP_io_destroy,
+    NULL,  /* readAt */
+    SZIP_map
+};
+
+
 /* Do this in a separate function so we can smallAlloc without looping. */
 static int szipLoadEntry(SZIPinfo *info, const PHYSFS_uint32 idx)
 {
@@ -203,6 +476,20 @@ static void SZIP_closeArchive(void *opaque)
     SZIPinfo *info = (SZIPinfo *) opaque;
     if (info)
     {
+        ISzAlloc *alloc = &SZIP_SzAlloc;
+
+        /* no handles can be open at this point, so just free everything. */
+        while (info->blockCache != NULL)
+        {
+            SZIPblock *block = info->blockCache;
+            info->blockCache = block->next;
+            alloc->Free(alloc, block->data);
+            allocator.Free(block);
+        } /* while */
+
+        if (info->cacheLock)
+            __PHYSFS_platformDestroyMutex(info->cacheLock);
+
         if (info->io)
             info->io->destroy(info->io);
         SzArEx_Free(&info->db, &SZIP_SzAlloc);
@@ -236,6 +523,9 @@ static void *SZIP_openArchive(PHYSFS_Io *io, const char *name,
 
     SzArEx_Init(&info->db);
 
+    info->cacheLock = __PHYSFS_platformCreateMutex();
+    GOTO_IF_ERRPASS(!info->cacheLock, failed);
+
     info->io = io;
 
     szipInitStream(&stream, io);
@@ -256,63 +546,64 @@ failed:
 static PHYSFS_Io *SZIP_openRead(void *opaque, const char *path)
 {
     /* !!! FIXME: the current lzma sdk C API only allows you to decompress
-       !!! FIXME:  the entire file at once, which isn't ideal. Fix this in the
-       !!! FIXME:  SDK and then convert this all to a streaming interface. */
+       !!! FIXME:  a whole folder block at once; we soften the blow with the
+       !!! FIXME:  shared block cache, but a real streaming decoder would
+       !!! FIXME:  need changes in the SDK itself. */
 
     SZIPinfo *info = (SZIPinfo *) opaque;
     SZIPentry *entry = (SZIPentry *) __PHYSFS_DirTreeFind(&info->tree, path);
-    ISzAlloc *alloc = &SZIP_SzAlloc;
-    SZIPLookToRead stream;
     PHYSFS_Io *retval = NULL;
-    PHYSFS_Io *io = NULL;
-    UInt32 blockIndex = 0xFFFFFFFF;
-    Byte *outBuffer = NULL;
-    size_t outBufferSize = 0;
-    size_t offset = 0;
-    size_t outSizeProcessed = 0;
-    void *buf = NULL;
-    SRes rc;
+    SZIPfileinfo *finfo = NULL;
+    SZIPblock *block;
+    UInt32 folderIndex;
 
     BAIL_IF_ERRPASS(!entry, NULL);
     BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, NULL);
 
-    io = info->io->duplicate(info->io);
-    GOTO_IF_ERRPASS(!io, SZIP_openRead_failed);
+    folderIndex = info->db.FileToFolder[entry->dbidx];
+    if (folderIndex == (UInt32) -1)  /* empty file; has no folder block. */
+        return __PHYSFS_createMemoryIo(NULL, 0, NULL);
 
-    szipInitStream(&stream, io);
+    __PHYSFS_platformGrabMutex(info->cacheLock);
+    block = szipFindBlock(info, folderIndex);
+    if (block == NULL)
+        block = szipLoadBlock(info, folderIndex);
+    __PHYSFS_platformReleaseMutex(info->cacheLock);
+    BAIL_IF_ERRPASS(!block, NULL);
 
-    rc = SzArEx_Extract(&info->db, &stream.lookStream.s, entry->dbidx,
-                        &blockIndex, &outBuffer, &outBufferSize, &offset,
-                        &outSizeProcessed, alloc, alloc);
-    GOTO_IF(rc != SZ_OK, szipErrorCode(rc), SZIP_openRead_failed);
-    GOTO_IF(outBuffer == NULL, PHYSFS_ERR_OUT_OF_MEMORY, SZIP_openRead_failed);
-
-    io->destroy(io);
-    io = NULL;
+    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
+    GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, SZIP_openRead_failed);
 
-    buf = allocator.Malloc(outSizeProcessed ? outSizeProcessed : 1);
-    GOTO_IF(buf == NULL, PHYSFS_ERR_OUT_OF_MEMORY, SZIP_openRead_failed);
+    finfo = (SZIPfileinfo *) allocator.Malloc(sizeof (SZIPfileinfo));
+    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, SZIP_openRead_failed);
 
-    if (outSizeProcessed > 0)
-        memcpy(buf, outBuffer + offset, outSizeProcessed);
+    finfo->archive = info;
+    finfo->block = block;
+    finfo->offset = (size_t) (info->db.UnpackPositions[entry->dbidx] -
+                 info->db.UnpackPositions[info->db.FolderToFile[folderIndex]]);
+    finfo->size = (size_t) SzArEx_GetFileSize(&info->db, entry->dbidx);
+    finfo->position = 0;
 
-    alloc->Free(alloc, outBuffer);
-    outBuffer = NULL;
-
-    retval = __PHYSFS_createMemoryIo(buf, outSizeProcessed, allocator.Free);
-    GOTO_IF_ERRPASS(!retval, SZIP_openRead_failed);
+    /* SzArEx_Extract used to verify the file's CRC for us; keep doing so. */
+    if (SzBitWithVals_Check(&info->db.CRCs, entry->dbidx))
+    {
+        if (CrcCalc(block->data + finfo->offset, finfo->size) !=
+            info->db.CRCs.Vals[entry->dbidx])
+            GOTO(PHYSFS_ERR_CORRUPT, SZIP_openRead_failed);
+    } /* if */
 
+    memcpy(retval, &SZIP_Io, sizeof (PHYSFS_Io));
+    retval->opaque = finfo;
     return retval;
 
 SZIP_openRead_failed:
-    if (io != NULL)
-        io->destroy(io);
+    szipReleaseBlock(info, block);
 
-    if (buf)
-        allocator.Free(buf);
+    if (finfo != NULL)
+        allocator.Free(finfo);
 
-    if (outBuffer)
-        alloc->Free(alloc, outBuffer);
+    if (retval != NULL)
+        allocator.Free(retval);
 
     return NULL;
 } /* SZIP_openRead */
@@ -351,15 +642,10 @@ static inline PHYSFS_uint64 lzmasdkTimeToPhysfsTime(const CNtfsFileTime *t)
 } /* lzmasdkTimeToPhysfsTime */
 
 
-static int SZIP_stat(void *opaque, const char *path, PHYSFS_Stat *stat)
+static void szipFillStat(const SZIPinfo *info, const SZIPentry *entry,
+                         PHYSFS_Stat *stat)
 {
-    SZIPinfo *info = (SZIPinfo *) opaque;
-    SZIPentry *entry;
-    PHYSFS_uint32 idx;
-
-    entry = (SZIPentry *) __PHYSFS_DirTreeFind(&info->tree, path);
-    BAIL_IF_ERRPASS(!entry, 0);
-    idx = entry->dbidx;
+    const PHYSFS_uint32 idx = entry->dbidx;
 
     if (entry->tree.isdir)
     {
@@ -388,11 +674,50 @@ static int SZIP_stat(void *opaque, const char *path, PHYSFS_Stat *stat)
 
 	stat->accesstime = -1;
 	stat->readonly = 1;
+} /* szipFillStat */
+
+
+static int SZIP_stat(void *opaque, const char *path, PHYSFS_Stat *stat)
+{
+    SZIPinfo *info = (SZIPinfo *) opaque;
+    SZIPentry *entry;
+
+    entry = (SZIPentry *) __PHYSFS_DirTreeFind(&info->tree, path);
+    BAIL_IF_ERRPASS(!entry, 0);
+
+    szipFillStat(info, entry, stat);
 
     return 1;
 } /* SZIP_stat */
 
 
+static int szipEntryStat(void *opaque, __PHYSFS_DirTreeEntry *entry,
+                         PHYSFS_Stat *stat)
+{
+    szipFillStat((const SZIPinfo *) opaque, (const SZIPentry *) entry, stat);
+    return 1;
+} /* szipEntryStat */
+
+
+static PHYSFS_EnumerateCallbackResult SZIP_enumerateWithStat(void *opaque,
+                 const char *dname, PHYSFS_EnumerateWithStatCallback cb,
+                 const char *origdir, void *callbackdata)
+{
+    return __PHYSFS_DirTreeEnumerateWithStat(opaque, dname, cb, origdir,
+                                             callbackdata, szipEntryStat);
+} /* SZIP_enumerateWithStat */
+
+
+static const char *SZIP_correctCase(void *opaque, const char *name)
+{
+    SZIPinfo *info = (SZIPinfo *) opaque;
+    const __PHYSFS_DirTreeEntry *entry = (const __PHYSFS_DirTreeEntry *)
+                    __PHYSFS_DirTreeFindIgnoreCase(&info->tree, name);
+    BAIL_IF_ERRPASS(!entry, NULL);
+    return entry->name;
+} /* SZIP_correctCase */
+
+
 void SZIP_global_init(void)
 {
     /* this just needs to calculate some things, so it only ever
@@ -424,7 +749,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_7Z =
     SZIP_remove,
     SZIP_mkdir,
     SZIP_stat,
-    SZIP_closeArchive
+    SZIP_closeArchive,
+    SZIP_enumerateWithStat,
+    SZIP_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_7Z */
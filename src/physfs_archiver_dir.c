@@ -85,6 +85,20 @@ static PHYSFS_EnumerateCallbackResult DIR_enumerate(void *opaque,
 } /* DIR_enumerate */
 
 
+static PHYSFS_EnumerateCallbackResult DIR_enumerateWithStat(void *opaque,
+                 const char *dname, PHYSFS_EnumerateWithStatCallback cb,
+                 const char *origdir, void *callbackdata)
+{
+    char *d;
+    PHYSFS_EnumerateCallbackResult retval;
+    CVT_TO_DEPENDENT(d, opaque, dname);
+    BAIL_IF_ERRPASS(!d, PHYSFS_ENUM_ERROR);
+    retval = __PHYSFS_platformEnumerateStat(d, cb, origdir, callbackdata);
+    __PHYSFS_smallFree(d);
+    return retval;
+} /* DIR_enumerateWithStat */
+
+
 static PHYSFS_Io *doOpen(void *opaque, const char *name, const int mode)
 {
     PHYSFS_Io *io = NULL;
@@ -189,7 +203,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_DIR =
     DIR_remove,
     DIR_mkdir,
     DIR_stat,
-    DIR_closeArchive
+    DIR_closeArchive,
+    DIR_enumerateWithStat,  /* one pass; no per-entry native paths. */
+    NULL  /* correctCase: platform filesystems match exactly. */
 };
 
 /* end of physfs_archiver_dir.c ... */
@@ -60,14 +60,19 @@ static int hog1LoadEntries(PHYSFS_Io *io, void *arc)
     const PHYSFS_uint64 iolen = io->length(io);
     PHYSFS_uint32 pos = 3;
 
+    /* HOG1 has no directory table; headers are interleaved with file data,
+       so we can't slurp them in one read. One read per header, at least. */
     while (pos < iolen)
     {
         PHYSFS_uint32 size;
+        PHYSFS_uint8 header[17];
         char name[13];
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 13), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &size), 0);
+        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, header, 17), 0);
+        memcpy(name, header, 13);
         name[12] = '\0';  /* just in case. */
+        memcpy(&size, header + 13, 4);
+        size = PHYSFS_swapULE32(size);
         pos += 13 + 4;
 
         BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
@@ -84,26 +89,42 @@ static int hog2LoadEntries(PHYSFS_Io *io, void *arc)
 {
     PHYSFS_uint32 numfiles;
     PHYSFS_uint32 pos;
+    PHYSFS_uint8 *dir;
+    const PHYSFS_uint8 *entry;
     PHYSFS_uint32 i;
 
     BAIL_IF_ERRPASS(!readui32(io, &numfiles), 0);
     BAIL_IF_ERRPASS(!readui32(io, &pos), 0);
     BAIL_IF_ERRPASS(!io->seek(io, 68), 0);  /* skip to end of header. */
 
-    for (i = 0; i < numfiles; i++) {
+    if (numfiles == 0)
+        return 1;  /* nothing to do. */
+
+    /* one big read of the file table, parse the 48-byte entries from RAM. */
+    dir = (PHYSFS_uint8 *) UNPK_loadDirectory(io,
+                                              ((PHYSFS_uint64) numfiles) * 48);
+    BAIL_IF_ERRPASS(!dir, 0);
+
+    for (i = 0, entry = dir; i < numfiles; i++, entry += 48) {
         char name[37];
-        PHYSFS_uint32 reserved;
         PHYSFS_uint32 size;
         PHYSFS_uint32 mtime;
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 36), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &reserved), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &size), 0);
-        BAIL_IF_ERRPASS(!readui32(io, &mtime), 0);
+        memcpy(name, entry, 36);
         name[36] = '\0';  /* just in case */
-        BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, mtime, mtime, pos, size), 0);
+        /* 4 bytes at entry+36 are unknown/reserved (always zero?), skipped. */
+        memcpy(&size, entry + 40, 4);
+        size = PHYSFS_swapULE32(size);
+        memcpy(&mtime, entry + 44, 4);
+        mtime = PHYSFS_swapULE32(mtime);
+        if (!UNPK_addEntry(arc, name, 0, mtime, mtime, pos, size))
+        {
+            allocator.Free(dir);
+            return 0;
+        } /* if */
         pos += size;
     }
 
+    allocator.Free(dir);
     return 1;
 } /* hog2LoadEntries */
 
@@ -161,7 +182,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_HOG =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_enumerateWithStat,
+    UNPK_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_HOG */
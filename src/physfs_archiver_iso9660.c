@@ -129,16 +129,37 @@ static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
                               const char *base, const PHYSFS_uint64 dirstart,
                               const PHYSFS_uint64 dirend, void *unpkarc)
 {
+    const PHYSFS_uint64 dirlen = dirend - dirstart;
+    PHYSFS_uint8 *buf = NULL;
     PHYSFS_uint64 readpos = dirstart;
-
-    while (1)
+    int retval = 0;
+
+    BAIL_IF(dirend < dirstart, PHYSFS_ERR_CORRUPT, 0);
+    if (dirlen == 0)
+        return 1;  /* nothing in here. */
+
+    if (!__PHYSFS_ui64FitsAddressSpace(dirlen))
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    /* A directory's extent is contiguous 2048-byte logical blocks, so pull
+       the whole thing in with one large read and parse records from memory;
+       walking it with a dozen tiny reads per record is brutal on slow
+       (optical, remote) media. */
+    buf = (PHYSFS_uint8 *) allocator.Malloc((size_t) dirlen);
+    BAIL_IF(!buf, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    GOTO_IF_ERRPASS(!io->seek(io, dirstart), loadEntriesDone);
+    GOTO_IF_ERRPASS(!__PHYSFS_readAll(io, buf, (size_t) dirlen),
+                    loadEntriesDone);
+
+    while ((readpos - dirstart) < dirlen)
     {
+        const PHYSFS_uint64 rel = readpos - dirstart;
+        const PHYSFS_uint8 *record = buf + rel;
         PHYSFS_uint8 recordlen;
         PHYSFS_uint8 extattrlen;
         PHYSFS_uint32 extent;
         PHYSFS_uint32 datalen;
-        PHYSFS_uint8 ignore[4];
-        PHYSFS_uint8 year, month, day, hour, minute, second, offset;
+        PHYSFS_uint8 year, month, day, hour, minute, second;
         PHYSFS_uint8 flags;
         PHYSFS_uint8 fnamelen;
         PHYSFS_uint8 fname[256];
@@ -147,12 +168,10 @@ static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
         int isdir;
         int multiextent;
 
-        BAIL_IF_ERRPASS(!io->seek(io, readpos), 0);
-
         /* recordlen = 0 -> no more entries or fill entry */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &recordlen, 1), 0);
+        recordlen = record[0];
         if (recordlen > 0)
-            readpos += recordlen;  /* ready to seek to next record. */
+            readpos += recordlen;  /* ready to step to next record. */
         else
         {
             PHYSFS_uint64 nextpos;
@@ -165,38 +184,43 @@ static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
             nextpos = (((readpos - 1) / 2048) + 1) * 2048;
 
             /* whoops, can't make forward progress! */
-            BAIL_IF(nextpos == readpos, PHYSFS_ERR_CORRUPT, 0);
+            GOTO_IF(nextpos == readpos, PHYSFS_ERR_CORRUPT, loadEntriesDone);
 
             readpos = nextpos;
             continue;  /* start back at upper loop. */
         } /* else */
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &extattrlen, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &extent, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* extent be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &datalen, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* datalen be */
-
-        /* record timestamp */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &year, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &month, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &day, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &hour, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &minute, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &second, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &offset, 1), 0);
-
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &flags, 1), 0);
+        /* the fixed fields and the filename must fit in the extent. */
+        GOTO_IF((rel + 33) > dirlen, PHYSFS_ERR_CORRUPT, loadEntriesDone);
+        fnamelen = record[32];
+        GOTO_IF((rel + 33 + fnamelen) > dirlen, PHYSFS_ERR_CORRUPT,
+                loadEntriesDone);
+
+        /* magic that represents "." and ".."; these legitimately point at
+           this directory (or its parent), so skip them before the
+           self-reference check below gets a chance to cry corruption. */
+        if ((fnamelen == 1) && ((record[33] == 0) || (record[33] == 1)))
+            continue;
+
+        extattrlen = record[1];
+        memcpy(&extent, record + 2, 4);       /* (+6 is the bigendian copy) */
+        memcpy(&datalen, record + 10, 4);     /* (+14 is the bigendian copy) */
+
+        /* record timestamp (record[24] is the GMT offset; unused here). */
+        year = record[18];
+        month = record[19];
+        day = record[20];
+        hour = record[21];
+        minute = record[22];
+        second = record[23];
+
+        flags = record[25];
         isdir = (flags & (1 << 1)) != 0;
         multiextent = (flags & (1 << 7)) != 0;
-        BAIL_IF(multiextent, PHYSFS_ERR_UNSUPPORTED, 0);  /* !!! FIXME */
+        GOTO_IF(multiextent, PHYSFS_ERR_UNSUPPORTED, loadEntriesDone);  /* !!! FIXME */
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 1), 0); /* unit size */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 1), 0); /* interleave gap */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0); /* seqnum le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0); /* seqnum be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &fnamelen, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, fname, fnamelen), 0);
+        /* (+26 is unit size, +27 interleave gap, +28/+30 seqnum le/be) */
+        memcpy(fname, record + 33, fnamelen);
 
         t.tm_sec = second;
         t.tm_min = minute;
@@ -212,16 +236,19 @@ static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
         extent += extattrlen;  /* skip extended attribute record. */
 
         /* infinite loop, corrupt file? */
-        BAIL_IF((extent * 2048) == dirstart, PHYSFS_ERR_CORRUPT, 0);
+        GOTO_IF((extent * 2048) == dirstart, PHYSFS_ERR_CORRUPT,
+                loadEntriesDone);
 
         if (!iso9660AddEntry(io, joliet, isdir, base, fname, fnamelen,
                              timestamp, extent * 2048, datalen, unpkarc))
-        {
-            return 0;
-        } /* if */
+            goto loadEntriesDone;  /* error state already set. */
     } /* while */
 
-    return 1;
+    retval = 1;
+
+loadEntriesDone:
+    allocator.Free(buf);
+    return retval;
 } /* iso9660LoadEntries */
 
 
@@ -377,7 +404,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_ISO9660 =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_enumerateWithStat,
+    UNPK_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_ISO9660 */
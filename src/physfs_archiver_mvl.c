@@ -35,20 +35,35 @@
 static int mvlLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
 {
     PHYSFS_uint32 pos = 8 + (17 * count);   /* past sig+metadata. */
+    PHYSFS_uint8 *dir;
+    const PHYSFS_uint8 *entry;
     PHYSFS_uint32 i;
 
-    for (i = 0; i < count; i++)
+    if (count == 0)
+        return 1;  /* nothing to do. */
+
+    /* one big read of the directory, parse the 17-byte entries from RAM. */
+    dir = (PHYSFS_uint8 *) UNPK_loadDirectory(io, ((PHYSFS_uint64) count) * 17);
+    BAIL_IF_ERRPASS(!dir, 0);
+
+    for (i = 0, entry = dir; i < count; i++, entry += 17)
     {
         PHYSFS_uint32 size;
         char name[13];
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 13), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
+
+        memcpy(name, entry, 13);
         name[12] = '\0';  /* just in case. */
+        memcpy(&size, entry + 13, 4);
         size = PHYSFS_swapULE32(size);
-        BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
+        if (!UNPK_addEntry(arc, name, 0, -1, -1, pos, size))
+        {
+            allocator.Free(dir);
+            return 0;
+        } /* if */
         pos += size;
     } /* for */
 
+    allocator.Free(dir);
     return 1;
 } /* mvlLoadEntries */
 
@@ -101,7 +116,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_MVL =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_enumerateWithStat,
+    UNPK_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_MVL */
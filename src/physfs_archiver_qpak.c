@@ -38,20 +38,37 @@
 
 static int qpakLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
 {
+    PHYSFS_uint8 *dir;
+    const PHYSFS_uint8 *entry;
     PHYSFS_uint32 i;
-    for (i = 0; i < count; i++)
+
+    if (count == 0)
+        return 1;  /* nothing to do. */
+
+    /* one big read of the directory, parse the 64-byte entries from RAM. */
+    dir = (PHYSFS_uint8 *) UNPK_loadDirectory(io, ((PHYSFS_uint64) count) * 64);
+    BAIL_IF_ERRPASS(!dir, 0);
+
+    for (i = 0, entry = dir; i < count; i++, entry += 64)
     {
         PHYSFS_uint32 size;
         PHYSFS_uint32 pos;
-        char name[56];
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 56), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &pos, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
+        char name[57];
+
+        memcpy(name, entry, 56);
+        name[56] = '\0';  /* just in case. */
+        memcpy(&pos, entry + 56, 4);
+        memcpy(&size, entry + 60, 4);
         size = PHYSFS_swapULE32(size);
         pos = PHYSFS_swapULE32(pos);
-        BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
+        if (!UNPK_addEntry(arc, name, 0, -1, -1, pos, size))
+        {
+            allocator.Free(dir);
+            return 0;
+        } /* if */
     } /* for */
 
+    allocator.Free(dir);
     return 1;
 } /* qpakLoadEntries */
 
@@ -117,7 +134,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_QPAK =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_enumerateWithStat,
+    UNPK_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_QPAK */
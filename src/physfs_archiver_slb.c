@@ -22,21 +22,31 @@
 
 static int slbLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
 {
+    PHYSFS_uint8 *dir;
+    const PHYSFS_uint8 *entry;
     PHYSFS_uint32 i;
-    for (i = 0; i < count; i++)
+
+    /* one big read of the ToC, parse the 72-byte entries from RAM.
+       (count is never zero; SLB_openArchive rejects empty archives.) */
+    dir = (PHYSFS_uint8 *) UNPK_loadDirectory(io, ((PHYSFS_uint64) count) * 72);
+    BAIL_IF_ERRPASS(!dir, 0);
+
+    for (i = 0, entry = dir; i < count; i++, entry += 72)
     {
         PHYSFS_uint32 pos;
         PHYSFS_uint32 size;
         char name[64];
-        char backslash;
         char *ptr;
 
         /* don't include the '\' in the beginning */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &backslash, 1), 0);
-        BAIL_IF(backslash != '\\', PHYSFS_ERR_CORRUPT, 0);
+        if (entry[0] != '\\')
+        {
+            allocator.Free(dir);
+            BAIL(PHYSFS_ERR_CORRUPT, 0);
+        } /* if */
 
-        /* read the rest of the buffer, 63 bytes */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &name, 63), 0);
+        /* the rest of the buffer, 63 bytes, is the filename */
+        memcpy(name, entry + 1, 63);
         name[63] = '\0'; /* in case the name lacks the null terminator */
 
         /* convert backslashes */
@@ -46,15 +56,20 @@ static int slbLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
                 *ptr = '/';
         } /* for */
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &pos, 4), 0);
+        memcpy(&pos, entry + 64, 4);
         pos = PHYSFS_swapULE32(pos);
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
+        memcpy(&size, entry + 68, 4);
         size = PHYSFS_swapULE32(size);
 
-        BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
+        if (!UNPK_addEntry(arc, name, 0, -1, -1, pos, size))
+        {
+            allocator.Free(dir);
+            return 0;
+        } /* if */
     } /* for */
 
+    allocator.Free(dir);
     return 1;
 } /* slbLoadEntries */
 
@@ -127,7 +142,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_SLB =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_enumerateWithStat,
+    UNPK_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_SLB */
@@ -73,7 +73,12 @@ static PHYSFS_sint64 UNPK_read(PHYSFS_Io *io, void *buffer, PHYSFS_uint64 len)
     if (bytesLeft < len)
         len = bytesLeft;
 
-    rc = finfo->io->read(finfo->io, buffer, len);
+    if (__PHYSFS_ioHasReadAt(finfo->io))
+        rc = finfo->io->readAt(finfo->io, buffer, len,
+                               entry->startPos + finfo->curPos);
+    else
+        rc = finfo->io->read(finfo->io, buffer, len);
+
     if (rc > 0)
         finfo->curPos += (PHYSFS_uint32) rc;
 
@@ -100,7 +105,12 @@ static int UNPK_seek(PHYSFS_Io *io, PHYSFS_uint64 offset)
     int rc;
 
     BAIL_IF(offset >= entry->size, PHYSFS_ERR_PAST_EOF, 0);
-    rc = finfo->io->seek(finfo->io, entry->startPos + offset);
+
+    if (__PHYSFS_ioHasReadAt(finfo->io))
+        rc = 1;  /* no physical seek; reads specify their own position. */
+    else
+        rc = finfo->io->seek(finfo->io, entry->startPos + offset);
+
     if (rc)
         finfo->curPos = (PHYSFS_uint32) offset;
 
@@ -142,6 +152,24 @@ UNPK_duplicate_failed:
 
 static int UNPK_flush(PHYSFS_Io *io) { return 1;  /* no write support. */ }
 
+static const void *UNPK_map(PHYSFS_Io *io, PHYSFS_uint64 *len)
+{
+    UNPKfileinfo *finfo = (UNPKfileinfo *) io->opaque;
+    const UNPKentry *entry = finfo->entry;
+    const PHYSFS_uint8 *base;
+    PHYSFS_uint64 archivelen;
+
+    /* entries are raw bytes, so a map is a window into the archive's map. */
+    BAIL_IF(!__PHYSFS_ioHasMap(finfo->io), PHYSFS_ERR_UNSUPPORTED, NULL);
+    base = (const PHYSFS_uint8 *) finfo->io->map(finfo->io, &archivelen);
+    BAIL_IF_ERRPASS(!base, NULL);
+    BAIL_IF(entry->startPos + entry->size > archivelen,
+            PHYSFS_ERR_CORRUPT, NULL);
+
+    *len = entry->size;
+    return base + entry->startPos;
+} /* UNPK_map */
+
 static void UNPK_destroy(PHYSFS_Io *io)
 {
     UNPKfileinfo *finfo = (UNPKfileinfo *) io->opaque;
@@ -161,7 +189,9 @@ static const PHYSFS_Io UNPK_Io =
     UNPK_length,
     UNPK_duplicate,
     UNPK_flush,
-    UNPK_destroy
+    UNPK_destroy,
+    NULL,  /* readAt */
+    UNPK_map
 };
 
 
@@ -190,8 +220,11 @@ PHYSFS_Io *UNPK_openRead(void *opaque, const char *name)
     finfo->io = info->io->duplicate(info->io);
     GOTO_IF_ERRPASS(!finfo->io, UNPK_openRead_failed);
 
-    if (!finfo->io->seek(finfo->io, entry->startPos))
-        goto UNPK_openRead_failed;
+    if (!__PHYSFS_ioHasReadAt(finfo->io))
+    {
+        if (!finfo->io->seek(finfo->io, entry->startPos))
+            goto UNPK_openRead_failed;
+    } /* if */
 
     finfo->curPos = 0;
     finfo->entry = entry;
@@ -239,13 +272,8 @@ int UNPK_mkdir(void *opaque, const char *name)
 } /* UNPK_mkdir */
 
 
-int UNPK_stat(void *opaque, const char *path, PHYSFS_Stat *stat)
+static void unpkFillStat(const UNPKentry *entry, PHYSFS_Stat *stat)
 {
-    UNPKinfo *info = (UNPKinfo *) opaque;
-    const UNPKentry *entry = findEntry(info, path);
-
-    BAIL_IF_ERRPASS(!entry, 0);
-
     if (entry->tree.isdir)
     {
         stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
@@ -261,11 +289,49 @@ int UNPK_stat(void *opaque, const char *path, PHYSFS_Stat *stat)
     stat->createtime = entry->ctime;
     stat->accesstime = -1;
     stat->readonly = 1;
+} /* unpkFillStat */
+
+
+int UNPK_stat(void *opaque, const char *path, PHYSFS_Stat *stat)
+{
+    UNPKinfo *info = (UNPKinfo *) opaque;
+    const UNPKentry *entry = findEntry(info, path);
+
+    BAIL_IF_ERRPASS(!entry, 0);
+
+    unpkFillStat(entry, stat);
 
     return 1;
 } /* UNPK_stat */
 
 
+static int unpkEntryStat(void *opaque, __PHYSFS_DirTreeEntry *entry,
+                         PHYSFS_Stat *stat)
+{
+    unpkFillStat((const UNPKentry *) entry, stat);
+    return 1;
+} /* unpkEntryStat */
+
+
+PHYSFS_EnumerateCallbackResult UNPK_enumerateWithStat(void *opaque,
+                 const char *dname, PHYSFS_EnumerateWithStatCallback cb,
+                 const char *origdir, void *callbackdata)
+{
+    return __PHYSFS_DirTreeEnumerateWithStat(opaque, dname, cb, origdir,
+                                             callbackdata, unpkEntryStat);
+} /* UNPK_enumerateWithStat */
+
+
+const char *UNPK_correctCase(void *opaque, const char *name)
+{
+    UNPKinfo *info = (UNPKinfo *) opaque;
+    const __PHYSFS_DirTreeEntry *entry = (const __PHYSFS_DirTreeEntry *)
+                    __PHYSFS_DirTreeFindIgnoreCase(&info->tree, name);
+    BAIL_IF_ERRPASS(!entry, NULL);
+    return entry->name;
+} /* UNPK_correctCase */
+
+
 void *UNPK_addEntry(void *opaque, char *name, const int isdir,
                     const PHYSFS_sint64 ctime, const PHYSFS_sint64 mtime,
                     const PHYSFS_uint64 pos, const PHYSFS_uint64 len)
@@ -285,6 +351,31 @@ void *UNPK_addEntry(void *opaque, char *name, const int isdir,
 } /* UNPK_addEntry */
 
 
+void *UNPK_loadDirectory(PHYSFS_Io *io, const PHYSFS_uint64 len)
+{
+    /* Slurp an archive's entire directory table into one buffer, so loaders
+       can parse entries from memory instead of issuing a few tiny archive
+       reads per entry. Caller frees with allocator.Free(). */
+    void *buf;
+
+    /* a hostile entry count mustn't truncate in the cast below: the small
+       allocation would succeed and the caller would parse the full count
+       of entries out of it. */
+    BAIL_IF(!__PHYSFS_ui64FitsAddressSpace(len), PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    buf = allocator.Malloc((size_t) len);
+    BAIL_IF(!buf, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    if (!__PHYSFS_readAll(io, buf, len))
+    {
+        allocator.Free(buf);
+        return NULL;
+    } /* if */
+
+    return buf;
+} /* UNPK_loadDirectory */
+
+
 void *UNPK_openArchive(PHYSFS_Io *io)
 {
     UNPKinfo *info = (UNPKinfo *) allocator.Malloc(sizeof (UNPKinfo));
@@ -49,23 +49,38 @@
 
 static int wadLoadEntries(PHYSFS_Io *io, const PHYSFS_uint32 count, void *arc)
 {
+    PHYSFS_uint8 *dir;
+    const PHYSFS_uint8 *entry;
     PHYSFS_uint32 i;
-    for (i = 0; i < count; i++)
+
+    if (count == 0)
+        return 1;  /* nothing to do. */
+
+    /* one big read of the info table, parse the 16-byte entries from RAM. */
+    dir = (PHYSFS_uint8 *) UNPK_loadDirectory(io, ((PHYSFS_uint64) count) * 16);
+    BAIL_IF_ERRPASS(!dir, 0);
+
+    for (i = 0, entry = dir; i < count; i++, entry += 16)
     {
         PHYSFS_uint32 pos;
         PHYSFS_uint32 size;
         char name[9];
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &pos, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &size, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, name, 8), 0);
+        memcpy(&pos, entry, 4);
+        memcpy(&size, entry + 4, 4);
+        memcpy(name, entry + 8, 8);
 
         name[8] = '\0'; /* name might not be null-terminated in file. */
         size = PHYSFS_swapULE32(size);
         pos = PHYSFS_swapULE32(pos);
-        BAIL_IF_ERRPASS(!UNPK_addEntry(arc, name, 0, -1, -1, pos, size), 0);
+        if (!UNPK_addEntry(arc, name, 0, -1, -1, pos, size))
+        {
+            allocator.Free(dir);
+            return 0;
+        } /* if */
     } /* for */
 
+    allocator.Free(dir);
     return 1;
 } /* wadLoadEntries */
 
@@ -126,7 +141,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_WAD =
     UNPK_remove,
     UNPK_mkdir,
     UNPK_stat,
-    UNPK_closeArchive
+    UNPK_closeArchive,
+    UNPK_enumerateWithStat,
+    UNPK_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_WAD */
@@ -17,6 +17,10 @@
 
 #include "physfs_miniz.h"
 
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+#include <zstd.h>  /* external dependency; see PHYSFS_ARCHIVE_ZIP_ZSTD. */
+#endif
+
 /*
  * A buffer of ZIP_READBUFSIZE is allocated for each compressed file opened,
  *  and is freed when you close the file; compressed data is read into
@@ -31,6 +35,38 @@
  */
 #define ZIP_READBUFSIZE   (16 * 1024)
 
+/*
+ * Deflate streams can't be randomly accessed, so a backward seek into a
+ *  compressed entry means re-inflating from the start of the entry and
+ *  discarding everything up to the new position; for large entries that
+ *  gets painful fast. To bound the cost, we snapshot the inflater every
+ *  ZIP_CHECKPOINT_INTERVAL bytes of uncompressed output as the stream is
+ *  first read through (miniz keeps all of its state, sliding window
+ *  included, in one flat struct, so a snapshot is just a memcpy). A
+ *  backward seek can then resume from the nearest checkpoint at or
+ *  before the target instead of from position zero.
+ *
+ * Entries using "traditional" crypto never get checkpoints--the cipher
+ *  state runs ahead of the inflater's input, so a snapshot of the two
+ *  wouldn't line up--and just re-decode from the start as before.
+ */
+#define ZIP_CHECKPOINT_INTERVAL (2 * 1024 * 1024)
+
+/*
+ * A deflate stream has to be decoded front to back, so the decompression
+ *  itself can't be split across cores, but a big read doesn't have to run
+ *  the archive i/o and the inflater in lockstep on one thread either. When
+ *  a single read of an unencrypted deflated entry wants at least
+ *  ZIP_PIPELINE_THRESHOLD bytes, a second thread fetches compressed data
+ *  into a ring of ZIP_PIPEBUF_COUNT slots while the calling thread
+ *  inflates, hiding the archive i/o behind the decompressor. Smaller
+ *  reads, encrypted entries, and platforms without threads all take the
+ *  usual serial path.
+ */
+#define ZIP_PIPELINE_THRESHOLD (1024 * 1024)
+#define ZIP_PIPEBUF_SIZE (64 * 1024)
+#define ZIP_PIPEBUF_COUNT 4
+
 
 /*
  * Entries are "unresolved" until they are first opened. At that time,
@@ -75,27 +111,56 @@ typedef struct _ZIPentry
 /*
  * One ZIPinfo is kept for each open ZIP archive.
  */
-typedef struct
+typedef struct ZIPinfo
 {
     __PHYSFS_DirTree tree;    /* manages directory tree.                */
     PHYSFS_Io *io;            /* the i/o interface for this archive.    */
     int zip64;                /* non-zero if this is a Zip64 archive.   */
     int has_crypto;           /* non-zero if any entry uses encryption. */
+    struct ZIPfileinfo *pool; /* closed file states ready for reuse.    */
+    int poolCount;            /* number of states in (pool).            */
+    void *poolLock;           /* protects (pool); NULL disables reuse.  */
+    void *resolveLock;        /* serializes lazy entry resolution.      */
 } ZIPinfo;
 
 /*
- * One ZIPfileinfo is kept for each open file in a ZIP archive.
+ * A snapshot of the inflater, taken mid-stream so a later backward seek
+ *  can resume decoding from here instead of the start of the entry.
  */
 typedef struct
+{
+    PHYSFS_uint32 compressed_position;    /* compressed bytes consumed. */
+    PHYSFS_uint32 uncompressed_position;  /* uncompressed bytes output. */
+    inflate_state state;                  /* copy of the zlib state.    */
+} ZIPcheckpoint;
+
+/*
+ * One ZIPfileinfo is kept for each open file in a ZIP archive.
+ */
+typedef struct ZIPfileinfo
 {
     ZIPentry *entry;                      /* Info on file.              */
     PHYSFS_Io *io;                        /* physical file handle.      */
+    ZIPinfo *owner;                       /* archive this file is in.   */
+    struct ZIPfileinfo *pnext;            /* next in owner's reuse pool.*/
     PHYSFS_uint32 compressed_position;    /* offset in compressed data. */
     PHYSFS_uint32 uncompressed_position;  /* tell() position.           */
     PHYSFS_uint8 *buffer;                 /* decompression buffer.      */
     PHYSFS_uint32 crypto_keys[3];         /* for "traditional" crypto.  */
     PHYSFS_uint32 initial_crypto_keys[3]; /* for "traditional" crypto.  */
     z_stream stream;                      /* zlib stream state.         */
+    int stream_live;                      /* non-zero once inflateInit'd*/
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+    ZSTD_DStream *zstream;                /* zstd stream, or NULL.      */
+    size_t zin_pos;                       /* consumed bytes in (buffer).*/
+    size_t zin_size;                      /* valid bytes in (buffer).   */
+#endif
+    ZIPcheckpoint *checkpoints;           /* seek points, or NULL.      */
+    PHYSFS_uint32 num_checkpoints;        /* checkpoints taken so far.  */
+    PHYSFS_uint32 alloc_checkpoints;      /* size of checkpoints array. */
+    PHYSFS_uint32 crc_running;            /* crc-32 of data read so far.*/
+    int crc_checking;                     /* still verifiable? Cleared  */
+                                          /*  by the first random seek. */
 } ZIPfileinfo;
 
 
@@ -109,6 +174,8 @@ typedef struct
 
 /* compression methods... */
 #define COMPMETH_NONE 0
+#define COMPMETH_DEFLATE 8
+#define COMPMETH_ZSTD 93
 /* ...and others... */
 
 
@@ -155,7 +222,21 @@ static PHYSFS_uint8 zip_decrypt_byte(const PHYSFS_uint32 *keys)
 static PHYSFS_sint64 zip_read_decrypt(ZIPfileinfo *finfo, void *buf, PHYSFS_uint64 len)
 {
     PHYSFS_Io *io = finfo->io;
-    const PHYSFS_sint64 br = io->read(io, buf, len);
+    PHYSFS_sint64 br;
+
+    if (!zip_entry_is_tradional_crypto(finfo->entry) &&
+        __PHYSFS_ioHasReadAt(io))
+    {
+        /* whichever position this entry tracks is the count of archive
+           bytes already consumed, so it's also our next read offset. */
+        const ZIPentry *entry = finfo->entry;
+        const PHYSFS_uint32 pos =
+                    (entry->compression_method == COMPMETH_NONE) ?
+                    finfo->uncompressed_position : finfo->compressed_position;
+        br = io->readAt(io, buf, len, entry->offset + pos);
+    } /* if */
+    else
+        br = io->read(io, buf, len);
 
     /* Decompression the new data if necessary. */
     if (zip_entry_is_tradional_crypto(finfo->entry) && (br > 0))
@@ -264,6 +345,190 @@ static int zlib_err(const int rc)
     return rc;
 } /* zlib_err */
 
+
+/*
+ * Opening a compressed entry costs a ZIPfileinfo, a read buffer, and an
+ *  inflate state allocation, paid again on every open; apps that churn
+ *  through many small files spend more time in the allocator than in the
+ *  decompressor. Closed file states go onto a small per-archive freelist
+ *  and the next open resets one in place instead of reallocating.
+ */
+#define ZIP_FILEINFO_POOL_MAX 8
+
+static ZIPfileinfo *zip_alloc_fileinfo(ZIPinfo *info)
+{
+    ZIPfileinfo *finfo = NULL;
+
+    if (info->poolLock != NULL)
+    {
+        __PHYSFS_platformGrabMutex(info->poolLock);
+        finfo = info->pool;
+        if (finfo != NULL)
+        {
+            info->pool = finfo->pnext;
+            info->poolCount--;
+        } /* if */
+        __PHYSFS_platformReleaseMutex(info->poolLock);
+    } /* if */
+
+    if (finfo != NULL)
+    {
+        /* scrub everything but the recyclable allocations. */
+        PHYSFS_uint8 *buffer = finfo->buffer;
+        z_stream stream = finfo->stream;
+        const int stream_live = finfo->stream_live;
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+        ZSTD_DStream *zstream = finfo->zstream;
+#endif
+        memset(finfo, '\0', sizeof (*finfo));
+        finfo->buffer = buffer;
+        finfo->stream = stream;
+        finfo->stream_live = stream_live;
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+        finfo->zstream = zstream;
+#endif
+    } /* if */
+    else
+    {
+        finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
+        BAIL_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        memset(finfo, '\0', sizeof (*finfo));
+    } /* else */
+
+    finfo->owner = info;
+    return finfo;
+} /* zip_alloc_fileinfo */
+
+
+static void zip_free_fileinfo(ZIPfileinfo *finfo)
+{
+    if (finfo->stream_live)
+        inflateEnd(&finfo->stream);
+
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+    if (finfo->zstream != NULL)
+        ZSTD_freeDStream(finfo->zstream);
+#endif
+
+    if (finfo->checkpoints != NULL)
+        allocator.Free(finfo->checkpoints);
+
+    if (finfo->buffer != NULL)
+        allocator.Free(finfo->buffer);
+
+    allocator.Free(finfo);
+} /* zip_free_fileinfo */
+
+
+/* return a file state to the owner's pool, or free it if the pool is full. */
+static void zip_release_fileinfo(ZIPfileinfo *finfo)
+{
+    ZIPinfo *info = finfo->owner;
+
+    /* checkpoints describe one specific stream; never reusable. */
+    if (finfo->checkpoints != NULL)
+    {
+        allocator.Free(finfo->checkpoints);
+        finfo->checkpoints = NULL;
+        finfo->num_checkpoints = finfo->alloc_checkpoints = 0;
+    } /* if */
+
+    if ((info != NULL) && (info->poolLock != NULL))
+    {
+        __PHYSFS_platformGrabMutex(info->poolLock);
+        if (info->poolCount < ZIP_FILEINFO_POOL_MAX)
+        {
+            finfo->pnext = info->pool;
+            info->pool = finfo;
+            info->poolCount++;
+            finfo = NULL;
+        } /* if */
+        __PHYSFS_platformReleaseMutex(info->poolLock);
+    } /* if */
+
+    if (finfo != NULL)
+        zip_free_fileinfo(finfo);
+} /* zip_release_fileinfo */
+
+
+/* make sure an open-for-read file state can decompress: the buffer is
+   allocated and the inflate stream is fresh, reusing both if pooled. */
+static int zip_prep_inflate(ZIPfileinfo *finfo)
+{
+    if (finfo->buffer == NULL)
+    {
+        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
+        BAIL_IF(!finfo->buffer, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    if (finfo->stream_live)
+    {
+        /* inflateReset() leaves next_in/avail_in alone, so bytes the last
+           user of this state read but never inflated would leak into the
+           new stream; drop them. */
+        finfo->stream.next_in = NULL;
+        finfo->stream.avail_in = 0;
+        return (zlib_err(inflateReset(&finfo->stream)) == Z_OK);
+    } /* if */
+
+    initializeZStream(&finfo->stream);
+    if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
+        return 0;
+
+    finfo->stream_live = 1;
+    return 1;
+} /* zip_prep_inflate */
+
+
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+/* same idea for Zstandard entries: read buffer present, stream fresh. */
+static int zip_prep_zstd(ZIPfileinfo *finfo)
+{
+    if (finfo->buffer == NULL)
+    {
+        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
+        BAIL_IF(!finfo->buffer, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    if (finfo->zstream == NULL)
+    {
+        finfo->zstream = ZSTD_createDStream();
+        BAIL_IF(!finfo->zstream, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+    else
+    {
+        const size_t rc = ZSTD_DCtx_reset(finfo->zstream,
+                                          ZSTD_reset_session_only);
+        BAIL_IF(ZSTD_isError(rc), PHYSFS_ERR_IO, 0);
+    } /* else */
+
+    finfo->zin_pos = finfo->zin_size = 0;
+    return 1;
+} /* zip_prep_zstd */
+#endif
+
+
+/* ready an open file state for its entry's compression method; entries
+   compressed with a method we can't decode are rejected here. */
+static int zip_prep_decompress(ZIPfileinfo *finfo)
+{
+    switch (finfo->entry->compression_method)
+    {
+        case COMPMETH_NONE:
+            return 1;  /* nothing to set up. */
+        case COMPMETH_DEFLATE:
+            return zip_prep_inflate(finfo);
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+        case COMPMETH_ZSTD:
+            return zip_prep_zstd(finfo);
+#endif
+        default:
+            break;
+    } /* switch */
+
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+} /* zip_prep_decompress */
+
 /*
  * Read an unsigned 64-bit int and swap to native byte order.
  */
@@ -299,6 +564,236 @@ static int readui16(PHYSFS_Io *io, PHYSFS_uint16 *val)
 } /* readui16 */
 
 
+/*
+ * Snapshot the inflater so ZIP_seek() can resume from this point later.
+ *  Failure here is harmless; we just keep the current seek behavior.
+ */
+static void zip_take_checkpoint(ZIPfileinfo *finfo)
+{
+    ZIPcheckpoint *cp;
+
+    if (zip_entry_is_tradional_crypto(finfo->entry))
+        return;  /* cipher state would be out of step; don't bother. */
+
+    if (finfo->num_checkpoints >= finfo->alloc_checkpoints)
+    {
+        const PHYSFS_uint32 newalloc = finfo->alloc_checkpoints ?
+                                       (finfo->alloc_checkpoints * 2) : 8;
+        void *ptr = allocator.Realloc(finfo->checkpoints,
+                                      newalloc * sizeof (ZIPcheckpoint));
+        if (ptr == NULL)
+            return;  /* oh well; it's only an optimization. */
+        finfo->checkpoints = (ZIPcheckpoint *) ptr;
+        finfo->alloc_checkpoints = newalloc;
+    } /* if */
+
+    /* bytes still sitting in avail_in haven't hit the inflater yet. */
+    cp = &finfo->checkpoints[finfo->num_checkpoints++];
+    cp->compressed_position = finfo->compressed_position -
+                              finfo->stream.avail_in;
+    cp->uncompressed_position = finfo->uncompressed_position;
+    memcpy(&cp->state, finfo->stream.state, sizeof (inflate_state));
+} /* zip_take_checkpoint */
+
+
+/*
+ * Shared state for one pipelined read. The reader thread owns the archive
+ *  io and (remaining) for the pipeline's lifetime; (nfull) and (stop) are
+ *  guarded by (lock), with the semaphores only there to block on--both
+ *  sides recheck their condition after every wakeup.
+ */
+typedef struct
+{
+    ZIPfileinfo *finfo;           /* open file being read.               */
+    PHYSFS_uint8 *bufs;           /* ZIP_PIPEBUF_COUNT slots, contiguous.*/
+    PHYSFS_sint64 counts[ZIP_PIPEBUF_COUNT]; /* slot fill; <= 0 is final.*/
+    PHYSFS_uint64 remaining;      /* compressed bytes left to fetch.     */
+    PHYSFS_ErrorCode errcode;     /* reader-side i/o failure, if any.    */
+    int nfull;                    /* slots filled and not yet inflated.  */
+    int stop;                     /* consumer is done; reader bails out. */
+    void *lock;                   /* guards (nfull) and (stop).          */
+    void *freeSem;                /* posted when a slot drains.          */
+    void *fullSem;                /* posted when a slot fills.           */
+} ZIPpipeline;
+
+
+static void zip_pipeline_reader(void *arg)
+{
+    ZIPpipeline *pl = (ZIPpipeline *) arg;
+    ZIPfileinfo *finfo = pl->finfo;
+    int wslot = 0;
+
+    while (1)
+    {
+        PHYSFS_uint64 br;
+        PHYSFS_sint64 rc;
+
+        __PHYSFS_platformGrabMutex(pl->lock);
+        while ((pl->nfull == ZIP_PIPEBUF_COUNT) && (!pl->stop))
+        {
+            __PHYSFS_platformReleaseMutex(pl->lock);
+            __PHYSFS_platformWaitSemaphore(pl->freeSem);
+            __PHYSFS_platformGrabMutex(pl->lock);
+        } /* while */
+
+        if (pl->stop)
+        {
+            __PHYSFS_platformReleaseMutex(pl->lock);
+            return;
+        } /* if */
+        __PHYSFS_platformReleaseMutex(pl->lock);
+
+        br = pl->remaining;
+        if (br > ZIP_PIPEBUF_SIZE)
+            br = ZIP_PIPEBUF_SIZE;
+
+        rc = (br == 0) ? 0 :
+             zip_read_decrypt(finfo, pl->bufs + (wslot * ZIP_PIPEBUF_SIZE),
+                              br);
+
+        if (rc > 0)
+        {
+            finfo->compressed_position += (PHYSFS_uint32) rc;
+            pl->remaining -= (PHYSFS_uint64) rc;
+        } /* if */
+        else if (rc < 0)  /* error state is thread-local; carry it over. */
+            pl->errcode = PHYSFS_getLastErrorCode();
+
+        pl->counts[wslot] = rc;
+        __PHYSFS_platformGrabMutex(pl->lock);
+        pl->nfull++;
+        __PHYSFS_platformReleaseMutex(pl->lock);
+        __PHYSFS_platformPostSemaphore(pl->fullSem);
+
+        if (rc <= 0)
+            return;  /* out of compressed bytes, or the io failed. */
+
+        wslot = (wslot + 1) % ZIP_PIPEBUF_COUNT;
+    } /* while */
+} /* zip_pipeline_reader */
+
+
+/* Returns non-zero if it ran (with the read's result in *_retval), zero
+   if the caller should inflate serially instead. */
+static int zip_read_pipelined(ZIPfileinfo *finfo, void *buf,
+                              PHYSFS_sint64 maxread, PHYSFS_sint64 *_retval)
+{
+    ZIPentry *entry = finfo->entry;
+    ZIPpipeline pl;
+    void *thread = NULL;
+    PHYSFS_uint64 unconsumed;
+    int rslot = 0;
+    int rc = Z_OK;
+    int i;
+
+    memset(&pl, '\0', sizeof (pl));
+    pl.finfo = finfo;
+    pl.remaining = entry->compressed_size - finfo->compressed_position;
+    pl.errcode = PHYSFS_ERR_OK;
+
+    pl.bufs = (PHYSFS_uint8 *)
+              allocator.Malloc(ZIP_PIPEBUF_COUNT * ZIP_PIPEBUF_SIZE);
+    pl.lock = __PHYSFS_platformCreateMutex();
+    pl.freeSem = __PHYSFS_platformCreateSemaphore();
+    pl.fullSem = __PHYSFS_platformCreateSemaphore();
+    if ((pl.bufs != NULL) && (pl.lock != NULL) &&
+        (pl.freeSem != NULL) && (pl.fullSem != NULL))
+        thread = __PHYSFS_platformCreateThread(zip_pipeline_reader, &pl);
+
+    if (thread == NULL)  /* no threads here? Nothing consumed; go serial. */
+    {
+        if (pl.bufs != NULL) allocator.Free(pl.bufs);
+        if (pl.lock != NULL) __PHYSFS_platformDestroyMutex(pl.lock);
+        if (pl.freeSem != NULL) __PHYSFS_platformDestroySemaphore(pl.freeSem);
+        if (pl.fullSem != NULL) __PHYSFS_platformDestroySemaphore(pl.fullSem);
+        return 0;
+    } /* if */
+
+    finfo->stream.next_out = buf;
+    finfo->stream.avail_out = (uInt) maxread;
+
+    while (finfo->stream.avail_out > 0)
+    {
+        PHYSFS_sint64 count;
+
+        __PHYSFS_platformGrabMutex(pl.lock);
+        while (pl.nfull == 0)
+        {
+            __PHYSFS_platformReleaseMutex(pl.lock);
+            __PHYSFS_platformWaitSemaphore(pl.fullSem);
+            __PHYSFS_platformGrabMutex(pl.lock);
+        } /* while */
+        __PHYSFS_platformReleaseMutex(pl.lock);
+
+        count = pl.counts[rslot];
+        if (count <= 0)
+            break;  /* compressed stream dry, or the reader hit an error. */
+
+        finfo->stream.next_in = pl.bufs + (rslot * ZIP_PIPEBUF_SIZE);
+        finfo->stream.avail_in = (uInt) count;
+
+        while ((finfo->stream.avail_in > 0) && (finfo->stream.avail_out > 0))
+        {
+            rc = zlib_err(inflate(&finfo->stream, Z_SYNC_FLUSH));
+            if (rc != Z_OK)
+                break;
+        } /* while */
+
+        if ((rc != Z_OK) || (finfo->stream.avail_out == 0))
+            break;  /* leftover input, if any, gets unread below. */
+
+        __PHYSFS_platformGrabMutex(pl.lock);
+        pl.nfull--;
+        __PHYSFS_platformReleaseMutex(pl.lock);
+        __PHYSFS_platformPostSemaphore(pl.freeSem);
+        rslot = (rslot + 1) % ZIP_PIPEBUF_COUNT;
+    } /* while */
+
+    /* the reader may be blocked waiting for a free slot; wake it with the
+       stop flag raised, and wait it out before touching shared state. */
+    __PHYSFS_platformGrabMutex(pl.lock);
+    pl.stop = 1;
+    __PHYSFS_platformReleaseMutex(pl.lock);
+    __PHYSFS_platformPostSemaphore(pl.freeSem);
+    __PHYSFS_platformJoinThread(thread);
+
+    /* compressed bytes the reader fetched but the inflater never consumed
+       get "unread": back compressed_position off (and reseek stream-style
+       io), so the next read or checkpoint resumes exactly where decoding
+       stopped. Slot (rslot) may be partially consumed; later slots never
+       were. */
+    unconsumed = finfo->stream.avail_in;
+    for (i = 1; i < pl.nfull; i++)
+    {
+        const PHYSFS_sint64 c = pl.counts[(rslot + i) % ZIP_PIPEBUF_COUNT];
+        if (c > 0)
+            unconsumed += (PHYSFS_uint64) c;
+    } /* for */
+
+    if (unconsumed > 0)
+    {
+        finfo->compressed_position -= (PHYSFS_uint32) unconsumed;
+        if (!__PHYSFS_ioHasReadAt(finfo->io))
+            finfo->io->seek(finfo->io,
+                            entry->offset + finfo->compressed_position);
+    } /* if */
+
+    finfo->stream.next_in = NULL;  /* slot memory is about to go away. */
+    finfo->stream.avail_in = 0;
+
+    if (pl.errcode != PHYSFS_ERR_OK)
+        PHYSFS_setErrorCode(pl.errcode);
+
+    *_retval = maxread - ((PHYSFS_sint64) finfo->stream.avail_out);
+
+    allocator.Free(pl.bufs);
+    __PHYSFS_platformDestroyMutex(pl.lock);
+    __PHYSFS_platformDestroySemaphore(pl.freeSem);
+    __PHYSFS_platformDestroySemaphore(pl.fullSem);
+    return 1;
+} /* zip_read_pipelined */
+
+
 static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
 {
     ZIPfileinfo *finfo = (ZIPfileinfo *) _io->opaque;
@@ -315,47 +810,139 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
 
     if (entry->compression_method == COMPMETH_NONE)
         retval = zip_read_decrypt(finfo, buf, maxread);
-    else
+
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+    else if (entry->compression_method == COMPMETH_ZSTD)
     {
-        finfo->stream.next_out = buf;
-        finfo->stream.avail_out = (uInt) maxread;
+        ZSTD_outBuffer zout;
+        zout.dst = buf;
+        zout.size = (size_t) maxread;
+        zout.pos = 0;
 
-        while (retval < maxread)
+        while (zout.pos < zout.size)
         {
-            const PHYSFS_uint32 before = (PHYSFS_uint32) finfo->stream.total_out;
-            int rc;
+            ZSTD_inBuffer zin;
+            size_t rc;
 
-            if (finfo->stream.avail_in == 0)
+            if (finfo->zin_pos == finfo->zin_size)
             {
                 PHYSFS_sint64 br;
 
                 br = entry->compressed_size - finfo->compressed_position;
-                if (br > 0)
-                {
-                    if (br > ZIP_READBUFSIZE)
-                        br = ZIP_READBUFSIZE;
+                if (br <= 0)
+                    break;  /* out of compressed bytes; short read. */
 
-                    br = zip_read_decrypt(finfo, finfo->buffer, (PHYSFS_uint64) br);
-                    if (br <= 0)
-                        break;
+                if (br > ZIP_READBUFSIZE)
+                    br = ZIP_READBUFSIZE;
 
-                    finfo->compressed_position += (PHYSFS_uint32) br;
-                    finfo->stream.next_in = finfo->buffer;
-                    finfo->stream.avail_in = (unsigned int) br;
-                } /* if */
+                br = zip_read_decrypt(finfo, finfo->buffer, (PHYSFS_uint64) br);
+                if (br <= 0)
+                    break;
+
+                finfo->compressed_position += (PHYSFS_uint32) br;
+                finfo->zin_pos = 0;
+                finfo->zin_size = (size_t) br;
             } /* if */
 
-            rc = zlib_err(inflate(&finfo->stream, Z_SYNC_FLUSH));
-            retval += (finfo->stream.total_out - before);
+            zin.src = finfo->buffer;
+            zin.size = finfo->zin_size;
+            zin.pos = finfo->zin_pos;
+            rc = ZSTD_decompressStream(finfo->zstream, &zout, &zin);
+            finfo->zin_pos = zin.pos;
 
-            if (rc != Z_OK)
+            if (ZSTD_isError(rc))
+            {
+                PHYSFS_setErrorCode(PHYSFS_ERR_CORRUPT);
                 break;
+            } /* if */
         } /* while */
+
+        retval = (PHYSFS_sint64) zout.pos;
+    } /* else if */
+#endif
+
+    else
+    {
+        int pipelined = 0;
+
+        if ((maxread >= ZIP_PIPELINE_THRESHOLD) &&
+            (finfo->stream.avail_in == 0) &&
+            (!zip_entry_is_tradional_crypto(entry)))
+            pipelined = zip_read_pipelined(finfo, buf, maxread, &retval);
+
+        if (!pipelined)
+        {
+            finfo->stream.next_out = buf;
+            finfo->stream.avail_out = (uInt) maxread;
+
+            while (retval < maxread)
+            {
+                const PHYSFS_uint32 before =
+                                    (PHYSFS_uint32) finfo->stream.total_out;
+                int rc;
+
+                if (finfo->stream.avail_in == 0)
+                {
+                    PHYSFS_sint64 br;
+
+                    br = entry->compressed_size - finfo->compressed_position;
+                    if (br > 0)
+                    {
+                        if (br > ZIP_READBUFSIZE)
+                            br = ZIP_READBUFSIZE;
+
+                        br = zip_read_decrypt(finfo, finfo->buffer,
+                                              (PHYSFS_uint64) br);
+                        if (br <= 0)
+                            break;
+
+                        finfo->compressed_position += (PHYSFS_uint32) br;
+                        finfo->stream.next_in = finfo->buffer;
+                        finfo->stream.avail_in = (unsigned int) br;
+                    } /* if */
+                } /* if */
+
+                rc = zlib_err(inflate(&finfo->stream, Z_SYNC_FLUSH));
+                retval += (finfo->stream.total_out - before);
+
+                if (rc != Z_OK)
+                    break;
+            } /* while */
+        } /* if */
     } /* else */
 
     if (retval > 0)
+    {
         finfo->uncompressed_position += (PHYSFS_uint32) retval;
 
+        if (entry->compression_method != COMPMETH_NONE)
+            __PHYSFS_STATS_ADD(__PHYSFS_stats.bytesDecompressed,
+                               (PHYSFS_uint64) retval);
+
+        /* checkpoints snapshot the inflater's flat state; deflate only. */
+        if (entry->compression_method == COMPMETH_DEFLATE)
+        {
+            const PHYSFS_uint32 last = (finfo->num_checkpoints == 0) ? 0 :
+                finfo->checkpoints[finfo->num_checkpoints-1].uncompressed_position;
+            if (finfo->uncompressed_position >= last + ZIP_CHECKPOINT_INTERVAL)
+                zip_take_checkpoint(finfo);
+        } /* if */
+
+        /* as long as the file is read start to finish, verify the crc-32
+           stored in the central directory when the last byte goes by. */
+        if (finfo->crc_checking)
+        {
+            finfo->crc_running = __PHYSFS_crc32(finfo->crc_running, buf,
+                                                (size_t) retval);
+            if (finfo->uncompressed_position == entry->uncompressed_size)
+            {
+                finfo->crc_checking = 0;  /* done; don't recheck on seek. */
+                BAIL_IF(finfo->crc_running != entry->crc,
+                        PHYSFS_ERR_CORRUPT, -1);
+            } /* if */
+        } /* if */
+    } /* if */
+
     return retval;
 } /* ZIP_read */
 
@@ -379,12 +966,21 @@ static int ZIP_seek(PHYSFS_Io *_io, PHYSFS_uint64 offset)
     PHYSFS_Io *io = finfo->io;
     const int encrypted = zip_entry_is_tradional_crypto(entry);
 
+    /* positioned reads specify their own offsets, so don't seek for them. */
+    const int positioned = (!encrypted) && __PHYSFS_ioHasReadAt(io);
+
     BAIL_IF(offset > entry->uncompressed_size, PHYSFS_ERR_PAST_EOF, 0);
 
+    /* once the handle jumps around, the running crc no longer covers the
+       whole stream, so give up on verifying it. */
+    if (offset != finfo->uncompressed_position)
+        finfo->crc_checking = 0;
+
     if (!encrypted && (entry->compression_method == COMPMETH_NONE))
     {
         PHYSFS_sint64 newpos = offset + entry->offset;
-        BAIL_IF_ERRPASS(!io->seek(io, newpos), 0);
+        if (!positioned)
+            BAIL_IF_ERRPASS(!io->seek(io, newpos), 0);
         finfo->uncompressed_position = (PHYSFS_uint32) offset;
     } /* if */
 
@@ -398,21 +994,63 @@ static int ZIP_seek(PHYSFS_Io *_io, PHYSFS_uint64 offset)
          */
         if (offset < finfo->uncompressed_position)
         {
-            /* we do a copy so state is sane if inflateInit2() fails. */
-            z_stream str;
-            initializeZStream(&str);
-            if (zlib_err(inflateInit2(&str, -MAX_WBITS)) != Z_OK)
-                return 0;
+            const ZIPcheckpoint *cp = NULL;
+            PHYSFS_uint32 i;
 
-            if (!io->seek(io, entry->offset + (encrypted ? 12 : 0)))
-                return 0;
+            /* latest checkpoint at or before the target, if we have one. */
+            for (i = finfo->num_checkpoints; i > 0; i--)
+            {
+                if (finfo->checkpoints[i-1].uncompressed_position <= offset)
+                {
+                    cp = &finfo->checkpoints[i-1];
+                    break;
+                } /* if */
+            } /* for */
+
+            if (cp != NULL)  /* never set for encrypted entries. */
+            {
+                if (!positioned)
+                {
+                    if (!io->seek(io, entry->offset + cp->compressed_position))
+                        return 0;
+                } /* if */
 
-            inflateEnd(&finfo->stream);
-            memcpy(&finfo->stream, &str, sizeof (z_stream));
-            finfo->uncompressed_position = finfo->compressed_position = 0;
+                memcpy(finfo->stream.state, &cp->state,
+                       sizeof (inflate_state));
+                finfo->stream.avail_in = 0;  /* buffer is stale; refill. */
+                finfo->compressed_position = cp->compressed_position;
+                finfo->uncompressed_position = cp->uncompressed_position;
+            } /* if */
 
-            if (encrypted)
-                memcpy(finfo->crypto_keys, finfo->initial_crypto_keys, 12);
+            else
+            {
+                if (!positioned)
+                {
+                    if (!io->seek(io, entry->offset + (encrypted ? 12 : 0)))
+                        return 0;
+                } /* if */
+
+                /* reset the decompressor in place; no reallocation. */
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+                if (entry->compression_method == COMPMETH_ZSTD)
+                {
+                    if (ZSTD_isError(ZSTD_DCtx_reset(finfo->zstream,
+                                                     ZSTD_reset_session_only)))
+                        BAIL(PHYSFS_ERR_IO, 0);
+                    finfo->zin_pos = finfo->zin_size = 0;  /* stale. */
+                } /* if */
+                else
+#endif
+                {
+                    if (zlib_err(inflateReset(&finfo->stream)) != Z_OK)
+                        return 0;
+                    finfo->stream.avail_in = 0;  /* buffer is stale; refill. */
+                } /* else */
+                finfo->uncompressed_position = finfo->compressed_position = 0;
+
+                if (encrypted)
+                    memcpy(finfo->crypto_keys, finfo->initial_crypto_keys, 12);
+            } /* else */
         } /* if */
 
         while (finfo->uncompressed_position != offset)
@@ -446,23 +1084,19 @@ static PHYSFS_Io *ZIP_duplicate(PHYSFS_Io *io)
 {
     ZIPfileinfo *origfinfo = (ZIPfileinfo *) io->opaque;
     PHYSFS_Io *retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    ZIPfileinfo *finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
+    ZIPfileinfo *finfo = NULL;
     GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, failed);
-    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, failed);
-    memset(finfo, '\0', sizeof (*finfo));
+
+    finfo = zip_alloc_fileinfo(origfinfo->owner);
+    GOTO_IF_ERRPASS(!finfo, failed);
 
     finfo->entry = origfinfo->entry;
+    finfo->crc_checking = 1;
     finfo->io = zip_get_io(origfinfo->io, NULL, finfo->entry);
     GOTO_IF_ERRPASS(!finfo->io, failed);
 
-    initializeZStream(&finfo->stream);
-    if (finfo->entry->compression_method != COMPMETH_NONE)
-    {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
-        GOTO_IF(!finfo->buffer, PHYSFS_ERR_OUT_OF_MEMORY, failed);
-        if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
-            goto failed;
-    } /* if */
+    if (!zip_prep_decompress(finfo))
+        goto failed;
 
     memcpy(retval, io, sizeof (PHYSFS_Io));
     retval->opaque = finfo;
@@ -473,14 +1107,8 @@ failed:
     {
         if (finfo->io != NULL)
             finfo->io->destroy(finfo->io);
-
-        if (finfo->buffer != NULL)
-        {
-            allocator.Free(finfo->buffer);
-            inflateEnd(&finfo->stream);
-        } /* if */
-
-        allocator.Free(finfo);
+        finfo->io = NULL;
+        zip_release_fileinfo(finfo);
     } /* if */
 
     if (retval != NULL)
@@ -491,18 +1119,35 @@ failed:
 
 static int ZIP_flush(PHYSFS_Io *io) { return 1;  /* no write support. */ }
 
-static void ZIP_destroy(PHYSFS_Io *io)
+static const void *ZIP_map(PHYSFS_Io *io, PHYSFS_uint64 *len)
 {
     ZIPfileinfo *finfo = (ZIPfileinfo *) io->opaque;
-    finfo->io->destroy(finfo->io);
+    const ZIPentry *entry = finfo->entry;
+    const PHYSFS_uint8 *base;
+    PHYSFS_uint64 archivelen;
 
-    if (finfo->entry->compression_method != COMPMETH_NONE)
-        inflateEnd(&finfo->stream);
+    /* only uncompressed, unencrypted entries are raw contiguous bytes. */
+    BAIL_IF(entry->compression_method != COMPMETH_NONE,
+            PHYSFS_ERR_UNSUPPORTED, NULL);
+    BAIL_IF(zip_entry_is_tradional_crypto(entry),
+            PHYSFS_ERR_UNSUPPORTED, NULL);
+    BAIL_IF(!__PHYSFS_ioHasMap(finfo->io), PHYSFS_ERR_UNSUPPORTED, NULL);
 
-    if (finfo->buffer != NULL)
-        allocator.Free(finfo->buffer);
+    base = (const PHYSFS_uint8 *) finfo->io->map(finfo->io, &archivelen);
+    BAIL_IF_ERRPASS(!base, NULL);
+    BAIL_IF(entry->offset + entry->uncompressed_size > archivelen,
+            PHYSFS_ERR_CORRUPT, NULL);
 
-    allocator.Free(finfo);
+    *len = entry->uncompressed_size;
+    return base + entry->offset;
+} /* ZIP_map */
+
+static void ZIP_destroy(PHYSFS_Io *io)
+{
+    ZIPfileinfo *finfo = (ZIPfileinfo *) io->opaque;
+    finfo->io->destroy(finfo->io);
+    finfo->io = NULL;
+    zip_release_fileinfo(finfo);
     allocator.Free(io);
 } /* ZIP_destroy */
 
@@ -517,7 +1162,9 @@ static const PHYSFS_Io ZIP_Io =
     ZIP_length,
     ZIP_duplicate,
     ZIP_flush,
-    ZIP_destroy
+    ZIP_destroy,
+    NULL,  /* readAt */
+    ZIP_map
 };
 
 
@@ -766,6 +1413,24 @@ static int zip_resolve_symlink(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
     if (entry->compression_method == COMPMETH_NONE)
         rc = __PHYSFS_readAll(io, path, size);
 
+#if PHYSFS_SUPPORTS_ZIP_ZSTD
+    else if (entry->compression_method == COMPMETH_ZSTD)
+    {
+        const size_t complen = (size_t) entry->compressed_size;
+        PHYSFS_uint8 *compressed = (PHYSFS_uint8*) __PHYSFS_smallAlloc(complen);
+        if (compressed != NULL)
+        {
+            if (__PHYSFS_readAll(io, compressed, complen))
+            {
+                const size_t zrc = ZSTD_decompress(path, size,
+                                                   compressed, complen);
+                rc = ((!ZSTD_isError(zrc)) && (zrc == size));
+            } /* if */
+            __PHYSFS_smallFree(compressed);
+        } /* if */
+    } /* else if */
+#endif
+
     else  /* symlink target path is compressed... */
     {
         z_stream stream;
@@ -857,7 +1522,7 @@ static int zip_parse_local(PHYSFS_Io *io, ZIPentry *entry)
 } /* zip_parse_local */
 
 
-static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
+static int zip_resolve_locked(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
 {
     int retval = 1;
     const ZipResolveType resolve_type = entry->resolved;
@@ -905,6 +1570,22 @@ static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
             entry->resolved = ((retval) ? ZIP_RESOLVED : ZIP_BROKEN_FILE);
     } /* if */
 
+    return retval;
+} /* zip_resolve_locked */
+
+static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
+{
+    /*
+     * Open-for-read and stat may run concurrently for the same archive
+     *  since the library moved to a shared state lock, and resolution
+     *  mutates the entry (offset, resolved, symlink) and seeks the shared
+     *  archive io. One mutex covers the whole chain; it's recursive, so
+     *  symlink resolution re-entering through zip_follow_symlink is fine.
+     */
+    int retval;
+    __PHYSFS_platformGrabMutex(info->resolveLock);
+    retval = zip_resolve_locked(io, info, entry);
+    __PHYSFS_platformReleaseMutex(info->resolveLock);
     return retval;
 } /* zip_resolve */
 
@@ -1149,23 +1830,68 @@ static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
 static int zip_load_entries(ZIPinfo *info,
                             const PHYSFS_uint64 data_ofs,
                             const PHYSFS_uint64 central_ofs,
+                            const PHYSFS_uint64 central_size,
                             const PHYSFS_uint64 entry_count)
 {
     PHYSFS_Io *io = info->io;
     const int zip64 = info->zip64;
+    PHYSFS_Io *memio = NULL;
     PHYSFS_uint64 i;
+    int retval = 1;
+
+    /*
+     * Parsing an entry is a few dozen tiny reads and a seek, which gets
+     *  expensive against the actual i/o interface on archives with
+     *  hundreds of thousands of entries. Slurp the whole central directory
+     *  in one read and parse it out of memory instead; zip_load_entry only
+     *  works with positions relative to where the directory started, so it
+     *  doesn't notice the difference. If we can't get the memory, just
+     *  parse straight from the file like we used to.
+     */
+    if ((central_size > 0) && (__PHYSFS_ui64FitsAddressSpace(central_size)))
+    {
+        void *cdir = allocator.Malloc((size_t) central_size);
+        if (cdir != NULL)
+        {
+            if (!io->seek(io, central_ofs) ||
+                !__PHYSFS_readAll(io, cdir, (size_t) central_size))
+            {
+                allocator.Free(cdir);
+                return 0;  /* error was set elsewhere. */
+            } /* if */
 
-    BAIL_IF_ERRPASS(!io->seek(io, central_ofs), 0);
+            memio = __PHYSFS_createMemoryIo(cdir, central_size,
+                                            allocator.Free);
+            if (memio == NULL)
+                allocator.Free(cdir);
+        } /* if */
+    } /* if */
+
+    if (memio != NULL)
+        info->io = memio;
+    else if (!io->seek(io, central_ofs))
+        return 0;
 
     for (i = 0; i < entry_count; i++)
     {
         ZIPentry *entry = zip_load_entry(info, zip64, data_ofs);
-        BAIL_IF_ERRPASS(!entry, 0);
+        if (!entry)
+        {
+            retval = 0;
+            break;
+        } /* if */
+
         if (zip_entry_is_tradional_crypto(entry))
             info->has_crypto = 1;
     } /* for */
 
-    return 1;
+    if (memio != NULL)
+    {
+        info->io = io;
+        memio->destroy(memio);
+    } /* if */
+
+    return retval;
 } /* zip_load_entries */
 
 
@@ -1261,6 +1987,7 @@ static PHYSFS_sint64 zip64_find_end_of_central_dir(PHYSFS_Io *io,
 static int zip64_parse_end_of_central_dir(ZIPinfo *info,
                                           PHYSFS_uint64 *data_start,
                                           PHYSFS_uint64 *dir_ofs,
+                                          PHYSFS_uint64 *dir_size,
                                           PHYSFS_uint64 *entry_count,
                                           PHYSFS_sint64 pos)
 {
@@ -1336,7 +2063,7 @@ static int zip64_parse_end_of_central_dir(ZIPinfo *info,
     BAIL_IF(ui64 != *entry_count, PHYSFS_ERR_CORRUPT, 0);
 
     /* size of the central directory */
-    BAIL_IF_ERRPASS(!readui64(io, &ui64), 0);
+    BAIL_IF_ERRPASS(!readui64(io, dir_size), 0);
 
     /* offset of central directory */
     BAIL_IF_ERRPASS(!readui64(io, dir_ofs), 0);
@@ -1356,6 +2083,7 @@ static int zip64_parse_end_of_central_dir(ZIPinfo *info,
 static int zip_parse_end_of_central_dir(ZIPinfo *info,
                                         PHYSFS_uint64 *data_start,
                                         PHYSFS_uint64 *dir_ofs,
+                                        PHYSFS_uint64 *dir_size,
                                         PHYSFS_uint64 *entry_count)
 {
     PHYSFS_Io *io = info->io;
@@ -1379,7 +2107,7 @@ static int zip_parse_end_of_central_dir(ZIPinfo *info,
     /* Seek back to see if "Zip64 end of central directory locator" exists. */
     /* this record is 20 bytes before end-of-central-dir */
     rc = zip64_parse_end_of_central_dir(info, data_start, dir_ofs,
-                                        entry_count, pos - 20);
+                                        dir_size, entry_count, pos - 20);
 
     /* Error or success? Bounce out of here. Keep going if not zip64. */
     if ((rc == 0) || (rc == 1))
@@ -1409,6 +2137,7 @@ static int zip_parse_end_of_central_dir(ZIPinfo *info,
 
     /* size of the central directory */
     BAIL_IF_ERRPASS(!readui32(io, &ui32), 0);
+    *dir_size = (PHYSFS_uint64) ui32;
 
     /* offset of central directory */
     BAIL_IF_ERRPASS(!readui32(io, &offset32), 0);
@@ -1452,6 +2181,19 @@ static void ZIP_closeArchive(void *opaque)
     if (info->io)
         info->io->destroy(info->io);
 
+    while (info->pool != NULL)
+    {
+        ZIPfileinfo *next = info->pool->pnext;
+        zip_free_fileinfo(info->pool);
+        info->pool = next;
+    } /* while */
+
+    if (info->poolLock != NULL)
+        __PHYSFS_platformDestroyMutex(info->poolLock);
+
+    if (info->resolveLock != NULL)
+        __PHYSFS_platformDestroyMutex(info->resolveLock);
+
     __PHYSFS_DirTreeDeinit(&info->tree);
 
     allocator.Free(info);
@@ -1465,6 +2207,7 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
     ZIPentry *root = NULL;
     PHYSFS_uint64 dstart = 0;  /* data start */
     PHYSFS_uint64 cdir_ofs;  /* central dir offset */
+    PHYSFS_uint64 cdir_size = 0;  /* central dir size, in bytes */
     PHYSFS_uint64 count;
 
     assert(io != NULL);  /* shouldn't ever happen. */
@@ -1480,7 +2223,15 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
 
     info->io = io;
 
-    if (!zip_parse_end_of_central_dir(info, &dstart, &cdir_ofs, &count))
+    /* no mutex just means every open allocates, like it used to. */
+    info->poolLock = __PHYSFS_platformCreateMutex();
+
+    /* this one is not optional: concurrent opens race without it. */
+    info->resolveLock = __PHYSFS_platformCreateMutex();
+    GOTO_IF_ERRPASS(!info->resolveLock, ZIP_openarchive_failed);
+
+    if (!zip_parse_end_of_central_dir(info, &dstart, &cdir_ofs,
+                                      &cdir_size, &count))
         goto ZIP_openarchive_failed;
     else if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (ZIPentry)))
         goto ZIP_openarchive_failed;
@@ -1488,7 +2239,7 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
     root = (ZIPentry *) info->tree.root;
     root->resolved = ZIP_DIRECTORY;
 
-    if (!zip_load_entries(info, dstart, cdir_ofs, count))
+    if (!zip_load_entries(info, dstart, cdir_ofs, cdir_size, count))
         goto ZIP_openarchive_failed;
 
     assert(info->tree.root->sibling == NULL);
@@ -1501,6 +2252,293 @@ ZIP_openarchive_failed:
 } /* ZIP_openArchive */
 
 
+/*
+ * Mount manifests: the directory tree of an opened zip, flattened to a
+ *  file, so the next run can skip the central directory parse entirely.
+ *  The manifest records the archive's size and mtime; if either changed,
+ *  loading fails and the caller reparses the real thing.
+ */
+
+#define ZIP_MANIFEST_MAGIC "PHYSFSMF"
+#define ZIP_MANIFEST_VERSION 1
+
+static int writeAll(PHYSFS_Io *io, const void *buf, const PHYSFS_uint64 len)
+{
+    return (io->write(io, buf, len) == (PHYSFS_sint64) len);
+} /* writeAll */
+
+static int writeui64(PHYSFS_Io *io, const PHYSFS_uint64 val)
+{
+    const PHYSFS_uint64 v = PHYSFS_swapULE64(val);
+    return writeAll(io, &v, sizeof (v));
+} /* writeui64 */
+
+static int writeui32(PHYSFS_Io *io, const PHYSFS_uint32 val)
+{
+    const PHYSFS_uint32 v = PHYSFS_swapULE32(val);
+    return writeAll(io, &v, sizeof (v));
+} /* writeui32 */
+
+static int writeui16(PHYSFS_Io *io, const PHYSFS_uint16 val)
+{
+    const PHYSFS_uint16 v = PHYSFS_swapULE16(val);
+    return writeAll(io, &v, sizeof (v));
+} /* writeui16 */
+
+static int writeui8(PHYSFS_Io *io, const PHYSFS_uint8 val)
+{
+    return writeAll(io, &val, sizeof (val));
+} /* writeui8 */
+
+static int readui8(PHYSFS_Io *io, PHYSFS_uint8 *val)
+{
+    return __PHYSFS_readAll(io, val, sizeof (*val));
+} /* readui8 */
+
+
+static int zip_manifest_save_entry(PHYSFS_Io *mio, const ZIPentry *entry)
+{
+    const char *name = entry->tree.name;
+    const size_t namelen = strlen(name);
+    const char *target = entry->symlink ? entry->symlink->tree.name : NULL;
+    const size_t targetlen = target ? strlen(target) : 0;
+
+    BAIL_IF(namelen > 0xFFFF, PHYSFS_ERR_BAD_FILENAME, 0);
+    BAIL_IF(targetlen > 0xFFFF, PHYSFS_ERR_BAD_FILENAME, 0);
+
+    BAIL_IF_ERRPASS(!writeui16(mio, (PHYSFS_uint16) namelen), 0);
+    BAIL_IF_ERRPASS(!writeAll(mio, name, namelen), 0);
+    BAIL_IF_ERRPASS(!writeui8(mio, (PHYSFS_uint8) entry->tree.isdir), 0);
+
+    /* entries keep whatever resolve state they had: an already-resolved
+       offset points past the local file header, and reload must not parse
+       it again. Symlink targets go out by name and are fixed up on load. */
+    BAIL_IF_ERRPASS(!writeui8(mio, (PHYSFS_uint8) entry->resolved), 0);
+    BAIL_IF_ERRPASS(!writeui64(mio, entry->offset), 0);
+    BAIL_IF_ERRPASS(!writeui16(mio, entry->version), 0);
+    BAIL_IF_ERRPASS(!writeui16(mio, entry->version_needed), 0);
+    BAIL_IF_ERRPASS(!writeui16(mio, entry->general_bits), 0);
+    BAIL_IF_ERRPASS(!writeui16(mio, entry->compression_method), 0);
+    BAIL_IF_ERRPASS(!writeui32(mio, entry->crc), 0);
+    BAIL_IF_ERRPASS(!writeui64(mio, entry->compressed_size), 0);
+    BAIL_IF_ERRPASS(!writeui64(mio, entry->uncompressed_size), 0);
+    BAIL_IF_ERRPASS(!writeui64(mio, (PHYSFS_uint64) entry->last_mod_time), 0);
+    BAIL_IF_ERRPASS(!writeui32(mio, entry->dos_mod_time), 0);
+
+    BAIL_IF_ERRPASS(!writeui16(mio, (PHYSFS_uint16) targetlen), 0);
+    if (targetlen)
+        BAIL_IF_ERRPASS(!writeAll(mio, target, targetlen), 0);
+
+    return 1;
+} /* zip_manifest_save_entry */
+
+
+int __PHYSFS_zipSaveManifest(void *opaque, PHYSFS_Io *mio,
+                             const PHYSFS_sint64 size,
+                             const PHYSFS_sint64 mtime)
+{
+    ZIPinfo *info = (ZIPinfo *) opaque;
+    const __PHYSFS_DirTree *tree = &info->tree;
+    size_t b;
+
+    BAIL_IF_ERRPASS(!writeAll(mio, ZIP_MANIFEST_MAGIC, 8), 0);
+    BAIL_IF_ERRPASS(!writeui32(mio, ZIP_MANIFEST_VERSION), 0);
+    BAIL_IF_ERRPASS(!writeAll(mio, "ZIP\0", 4), 0);
+    BAIL_IF_ERRPASS(!writeui64(mio, (PHYSFS_uint64) size), 0);
+    BAIL_IF_ERRPASS(!writeui64(mio, (PHYSFS_uint64) mtime), 0);
+    BAIL_IF_ERRPASS(!writeui8(mio, (PHYSFS_uint8) info->zip64), 0);
+    BAIL_IF_ERRPASS(!writeui64(mio, (PHYSFS_uint64) tree->hashCount), 0);
+
+    /* every entry but the root is in the hash table; order is irrelevant,
+       since __PHYSFS_DirTreeAdd fills in missing parents either way. We
+       hold the resolve lock across the walk: this runs under the shared
+       state lock, and a concurrent open mid-resolve would hand us an
+       entry with the offset adjusted but (resolved) not yet final. */
+    __PHYSFS_platformGrabMutex(info->resolveLock);
+    for (b = 0; b < tree->hashBuckets; b++)
+    {
+        const ZIPentry *entry = (const ZIPentry *) tree->hash[b].entry;
+        if ((entry != NULL) && (!zip_manifest_save_entry(mio, entry)))
+        {
+            __PHYSFS_platformReleaseMutex(info->resolveLock);
+            return 0;
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(info->resolveLock);
+
+    return 1;
+} /* __PHYSFS_zipSaveManifest */
+
+
+/* symlink targets are stored by name; map them back to entries when the
+   whole tree is in place. */
+typedef struct ZIPmanifestFixup
+{
+    ZIPentry *entry;
+    char *target;
+    struct ZIPmanifestFixup *next;
+} ZIPmanifestFixup;
+
+static int zip_manifest_load_entry(ZIPinfo *info, PHYSFS_Io *mio,
+                                   ZIPmanifestFixup **fixups)
+{
+    ZIPentry *entry = NULL;
+    char *name = NULL;
+    PHYSFS_uint16 namelen = 0;
+    PHYSFS_uint16 targetlen = 0;
+    PHYSFS_uint64 ui64;
+    PHYSFS_uint8 isdir;
+    PHYSFS_uint8 resolved;
+    int rc = 0;
+
+    BAIL_IF_ERRPASS(!readui16(mio, &namelen), 0);
+    BAIL_IF(namelen == 0, PHYSFS_ERR_CORRUPT, 0);
+
+    name = (char *) __PHYSFS_smallAlloc(namelen + 1);
+    BAIL_IF(!name, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    GOTO_IF_ERRPASS(!__PHYSFS_readAll(mio, name, namelen), failed);
+    name[namelen] = '\0';
+
+    GOTO_IF_ERRPASS(!readui8(mio, &isdir), failed);
+    GOTO_IF_ERRPASS(!readui8(mio, &resolved), failed);
+    GOTO_IF(resolved > ZIP_BROKEN_SYMLINK, PHYSFS_ERR_CORRUPT, failed);
+
+    entry = (ZIPentry *) __PHYSFS_DirTreeAdd(&info->tree, name, isdir != 0);
+    GOTO_IF(!entry, PHYSFS_ERR_OUT_OF_MEMORY, failed);
+
+    entry->resolved = (ZipResolveType) resolved;
+    GOTO_IF_ERRPASS(!readui64(mio, &entry->offset), failed);
+    GOTO_IF_ERRPASS(!readui16(mio, &entry->version), failed);
+    GOTO_IF_ERRPASS(!readui16(mio, &entry->version_needed), failed);
+    GOTO_IF_ERRPASS(!readui16(mio, &entry->general_bits), failed);
+    GOTO_IF_ERRPASS(!readui16(mio, &entry->compression_method), failed);
+    GOTO_IF_ERRPASS(!readui32(mio, &entry->crc), failed);
+    GOTO_IF_ERRPASS(!readui64(mio, &entry->compressed_size), failed);
+    GOTO_IF_ERRPASS(!readui64(mio, &entry->uncompressed_size), failed);
+    GOTO_IF_ERRPASS(!readui64(mio, &ui64), failed);
+    entry->last_mod_time = (PHYSFS_sint64) ui64;
+    GOTO_IF_ERRPASS(!readui32(mio, &entry->dos_mod_time), failed);
+
+    if (zip_entry_is_tradional_crypto(entry))
+        info->has_crypto = 1;
+
+    GOTO_IF_ERRPASS(!readui16(mio, &targetlen), failed);
+    if (targetlen)
+    {
+        ZIPmanifestFixup *fixup;
+        fixup = (ZIPmanifestFixup *) allocator.Malloc(sizeof (*fixup) +
+                                                      targetlen + 1);
+        GOTO_IF(!fixup, PHYSFS_ERR_OUT_OF_MEMORY, failed);
+        fixup->target = ((char *) fixup) + sizeof (*fixup);
+        if (!__PHYSFS_readAll(mio, fixup->target, targetlen))
+        {
+            allocator.Free(fixup);
+            goto failed;
+        } /* if */
+        fixup->target[targetlen] = '\0';
+        fixup->entry = entry;
+        fixup->next = *fixups;
+        *fixups = fixup;
+    } /* if */
+
+    rc = 1;
+
+failed:
+    __PHYSFS_smallFree(name);
+    return rc;
+} /* zip_manifest_load_entry */
+
+
+void *__PHYSFS_zipLoadManifest(PHYSFS_Io *io, PHYSFS_Io *mio,
+                               const PHYSFS_sint64 size,
+                               const PHYSFS_sint64 mtime)
+{
+    ZIPinfo *info = NULL;
+    ZIPentry *root = NULL;
+    ZIPmanifestFixup *fixups = NULL;
+    char magic[12];
+    PHYSFS_uint32 ui32;
+    PHYSFS_uint64 ui64;
+    PHYSFS_uint64 count;
+    PHYSFS_uint8 ui8;
+    PHYSFS_uint64 i;
+
+    assert(io != NULL);
+    assert(mio != NULL);
+
+    BAIL_IF_ERRPASS(!__PHYSFS_readAll(mio, magic, 8), NULL);
+    BAIL_IF(memcmp(magic, ZIP_MANIFEST_MAGIC, 8) != 0,
+            PHYSFS_ERR_UNSUPPORTED, NULL);
+    BAIL_IF_ERRPASS(!readui32(mio, &ui32), NULL);
+    BAIL_IF(ui32 != ZIP_MANIFEST_VERSION, PHYSFS_ERR_UNSUPPORTED, NULL);
+    BAIL_IF_ERRPASS(!__PHYSFS_readAll(mio, magic, 4), NULL);
+    BAIL_IF(memcmp(magic, "ZIP\0", 4) != 0, PHYSFS_ERR_UNSUPPORTED, NULL);
+
+    /* archive changed since the manifest was written? It's useless now. */
+    BAIL_IF_ERRPASS(!readui64(mio, &ui64), NULL);
+    BAIL_IF(ui64 != (PHYSFS_uint64) size, PHYSFS_ERR_CORRUPT, NULL);
+    BAIL_IF_ERRPASS(!readui64(mio, &ui64), NULL);
+    BAIL_IF(ui64 != (PHYSFS_uint64) mtime, PHYSFS_ERR_CORRUPT, NULL);
+
+    info = (ZIPinfo *) allocator.Malloc(sizeof (ZIPinfo));
+    BAIL_IF(!info, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(info, '\0', sizeof (ZIPinfo));
+    info->io = io;
+
+    /* no mutex just means every open allocates, like it used to. */
+    info->poolLock = __PHYSFS_platformCreateMutex();
+
+    /* this one is not optional: concurrent opens race without it. */
+    info->resolveLock = __PHYSFS_platformCreateMutex();
+    if (!info->resolveLock)
+        goto zip_loadmanifest_failed;
+
+    if (!readui8(mio, &ui8))
+        goto zip_loadmanifest_failed;
+    info->zip64 = (int) ui8;
+
+    if (!readui64(mio, &count))
+        goto zip_loadmanifest_failed;
+    else if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (ZIPentry)))
+        goto zip_loadmanifest_failed;
+
+    root = (ZIPentry *) info->tree.root;
+    root->resolved = ZIP_DIRECTORY;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!zip_manifest_load_entry(info, mio, &fixups))
+            goto zip_loadmanifest_failed;
+    } /* for */
+
+    while (fixups != NULL)
+    {
+        ZIPmanifestFixup *next = fixups->next;
+        ZIPentry *target;
+        target = (ZIPentry *) __PHYSFS_DirTreeFind(&info->tree,
+                                                   fixups->target);
+        if (target != NULL)
+            fixups->entry->symlink = target;
+        allocator.Free(fixups);
+        fixups = next;
+        GOTO_IF(!target, PHYSFS_ERR_CORRUPT, zip_loadmanifest_failed);
+    } /* while */
+
+    return info;
+
+zip_loadmanifest_failed:
+    while (fixups != NULL)
+    {
+        ZIPmanifestFixup *next = fixups->next;
+        allocator.Free(fixups);
+        fixups = next;
+    } /* while */
+    info->io = NULL;  /* don't let ZIP_closeArchive destroy (io). */
+    ZIP_closeArchive(info);
+    return NULL;
+} /* __PHYSFS_zipLoadManifest */
+
+
 static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPinfo *inf, ZIPentry *entry)
 {
     int success;
@@ -1563,24 +2601,17 @@ static PHYSFS_Io *ZIP_openRead(void *opaque, const char *filename)
     retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
     GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
 
-    finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
-    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
-    memset(finfo, '\0', sizeof (ZIPfileinfo));
+    finfo = zip_alloc_fileinfo(info);
+    GOTO_IF_ERRPASS(!finfo, ZIP_openRead_failed);
 
     io = zip_get_io(info->io, info, entry);
     GOTO_IF_ERRPASS(!io, ZIP_openRead_failed);
     finfo->io = io;
     finfo->entry = ((entry->symlink != NULL) ? entry->symlink : entry);
-    initializeZStream(&finfo->stream);
+    finfo->crc_checking = 1;
 
-    if (finfo->entry->compression_method != COMPMETH_NONE)
-    {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
-        if (!finfo->buffer)
-            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
-        else if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
-            goto ZIP_openRead_failed;
-    } /* if */
+    if (!zip_prep_decompress(finfo))
+        goto ZIP_openRead_failed;
 
     if (!zip_entry_is_tradional_crypto(entry))
         GOTO_IF(password != NULL, PHYSFS_ERR_BAD_PASSWORD, ZIP_openRead_failed);
@@ -1604,14 +2635,8 @@ ZIP_openRead_failed:
     {
         if (finfo->io != NULL)
             finfo->io->destroy(finfo->io);
-
-        if (finfo->buffer != NULL)
-        {
-            allocator.Free(finfo->buffer);
-            inflateEnd(&finfo->stream);
-        } /* if */
-
-        allocator.Free(finfo);
+        finfo->io = NULL;
+        zip_release_fileinfo(finfo);  /* the state itself is still good. */
     } /* if */
 
     if (retval != NULL)
@@ -1645,15 +2670,9 @@ static int ZIP_mkdir(void *opaque, const char *name)
 } /* ZIP_mkdir */
 
 
-static int ZIP_stat(void *opaque, const char *filename, PHYSFS_Stat *stat)
+static int zip_fill_stat(ZIPinfo *info, ZIPentry *entry, PHYSFS_Stat *stat)
 {
-    ZIPinfo *info = (ZIPinfo *) opaque;
-    ZIPentry *entry = zip_find_entry(info, filename);
-
-    if (entry == NULL)
-        return 0;
-
-    else if (!zip_resolve(info->io, info, entry))
+    if (!zip_resolve(info->io, info, entry))
         return 0;
 
     else if (entry->resolved == ZIP_DIRECTORY)
@@ -1680,9 +2699,47 @@ static int ZIP_stat(void *opaque, const char *filename, PHYSFS_Stat *stat)
     stat->readonly = 1; /* .zip files are always read only */
 
     return 1;
+} /* zip_fill_stat */
+
+
+static int ZIP_stat(void *opaque, const char *filename, PHYSFS_Stat *stat)
+{
+    ZIPinfo *info = (ZIPinfo *) opaque;
+    ZIPentry *entry = zip_find_entry(info, filename);
+
+    if (entry == NULL)
+        return 0;
+
+    return zip_fill_stat(info, entry, stat);
 } /* ZIP_stat */
 
 
+static int zip_entry_stat(void *opaque, __PHYSFS_DirTreeEntry *entry,
+                          PHYSFS_Stat *stat)
+{
+    return zip_fill_stat((ZIPinfo *) opaque, (ZIPentry *) entry, stat);
+} /* zip_entry_stat */
+
+
+static PHYSFS_EnumerateCallbackResult ZIP_enumerateWithStat(void *opaque,
+                 const char *dname, PHYSFS_EnumerateWithStatCallback cb,
+                 const char *origdir, void *callbackdata)
+{
+    return __PHYSFS_DirTreeEnumerateWithStat(opaque, dname, cb, origdir,
+                                             callbackdata, zip_entry_stat);
+} /* ZIP_enumerateWithStat */
+
+
+static const char *ZIP_correctCase(void *opaque, const char *name)
+{
+    ZIPinfo *info = (ZIPinfo *) opaque;
+    const __PHYSFS_DirTreeEntry *entry = (const __PHYSFS_DirTreeEntry *)
+                    __PHYSFS_DirTreeFindIgnoreCase(&info->tree, name);
+    BAIL_IF_ERRPASS(!entry, NULL);
+    return entry->name;
+} /* ZIP_correctCase */
+
+
 const PHYSFS_Archiver __PHYSFS_Archiver_ZIP =
 {
     CURRENT_PHYSFS_ARCHIVER_API_VERSION,
@@ -1701,7 +2758,9 @@ const PHYSFS_Archiver __PHYSFS_Archiver_ZIP =
     ZIP_remove,
     ZIP_mkdir,
     ZIP_stat,
-    ZIP_closeArchive
+    ZIP_closeArchive,
+    ZIP_enumerateWithStat,
+    ZIP_correctCase
 };
 
 #endif  /* defined PHYSFS_SUPPORTS_ZIP */
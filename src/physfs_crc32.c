@@ -0,0 +1,110 @@
+/*
+ * CRC-32 over bulk data (the zlib/ZIP polynomial, 0xEDB88320).
+ *
+ * The obvious one-byte-per-step table loop costs several cycles per byte,
+ *  which adds up when every read out of an archive gets checksummed. This
+ *  is a slice-by-8 implementation: eight bytes per iteration, resolved
+ *  against eight derived tables with no inter-byte dependency chain. On
+ *  ARM targets compiled with the CRC32 extension (-march=...+crc), the
+ *  dedicated instructions are used instead, since they implement this
+ *  exact polynomial. x86's crc32 instruction computes CRC-32C (a
+ *  different polynomial), so it's no help here and x86 takes the sliced
+ *  path.
+ *
+ * Call __PHYSFS_crc32Init() once before hashing anything; PHYSFS_init()
+ *  does this for the library.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define PHYSFS_ARM_CRC32 1
+#endif
+
+#ifndef PHYSFS_ARM_CRC32
+static PHYSFS_uint32 crc32Tables[8][256];
+#endif
+
+void __PHYSFS_crc32Init(void)
+{
+#ifndef PHYSFS_ARM_CRC32
+    PHYSFS_uint32 i;
+    int k;
+
+    if (crc32Tables[0][1] != 0)
+        return;  /* already done. */
+
+    for (i = 0; i < 256; i++)
+    {
+        PHYSFS_uint32 c = i;
+        for (k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        crc32Tables[0][i] = c;
+    } /* for */
+
+    for (k = 1; k < 8; k++)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            const PHYSFS_uint32 c = crc32Tables[k - 1][i];
+            crc32Tables[k][i] = (c >> 8) ^ crc32Tables[0][c & 0xFF];
+        } /* for */
+    } /* for */
+#endif
+} /* __PHYSFS_crc32Init */
+
+
+PHYSFS_uint32 __PHYSFS_crc32(PHYSFS_uint32 crc, const void *_buf, size_t len)
+{
+    const PHYSFS_uint8 *buf = (const PHYSFS_uint8 *) _buf;
+
+    crc = ~crc;
+
+#ifdef PHYSFS_ARM_CRC32
+    while (len >= 8)
+    {
+        PHYSFS_uint64 val;
+        memcpy(&val, buf, 8);  /* alignment-safe load; compiles away. */
+        crc = __crc32d(crc, val);
+        buf += 8;
+        len -= 8;
+    } /* while */
+
+    while (len--)
+        crc = __crc32b(crc, *(buf++));
+#else
+    while (len >= 8)
+    {
+        /* byte-assembled loads keep this correct on either endianness. */
+        const PHYSFS_uint32 one = (((PHYSFS_uint32) buf[0]) |
+                                   (((PHYSFS_uint32) buf[1]) << 8) |
+                                   (((PHYSFS_uint32) buf[2]) << 16) |
+                                   (((PHYSFS_uint32) buf[3]) << 24)) ^ crc;
+        const PHYSFS_uint32 two = (((PHYSFS_uint32) buf[4]) |
+                                   (((PHYSFS_uint32) buf[5]) << 8) |
+                                   (((PHYSFS_uint32) buf[6]) << 16) |
+                                   (((PHYSFS_uint32) buf[7]) << 24));
+        crc = crc32Tables[7][one & 0xFF] ^
+              crc32Tables[6][(one >> 8) & 0xFF] ^
+              crc32Tables[5][(one >> 16) & 0xFF] ^
+              crc32Tables[4][one >> 24] ^
+              crc32Tables[3][two & 0xFF] ^
+              crc32Tables[2][(two >> 8) & 0xFF] ^
+              crc32Tables[1][(two >> 16) & 0xFF] ^
+              crc32Tables[0][two >> 24];
+        buf += 8;
+        len -= 8;
+    } /* while */
+
+    while (len--)
+        crc = crc32Tables[0][(crc ^ *(buf++)) & 0xFF] ^ (crc >> 8);
+#endif
+
+    return ~crc;
+} /* __PHYSFS_crc32 */
+
+/* end of physfs_crc32.c ... */
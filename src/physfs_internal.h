@@ -107,15 +107,17 @@ const void *__PHYSFS_winrtCalcBaseDir(void);
 const void *__PHYSFS_winrtCalcPrefDir(void);
 #endif
 
-/* atomic operations. */
+/* atomic operations. These return the UPDATED value, on every compiler:
+   refcount drop-to-zero checks (`DECR(&x) == 0`) depend on it, and the
+   MSVC intrinsics already work that way. */
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #include <intrin.h>
 __PHYSFS_COMPILE_TIME_ASSERT(LongEqualsInt, sizeof (int) == sizeof (long));
 #define __PHYSFS_ATOMIC_INCR(ptrval) _InterlockedIncrement((long*)(ptrval))
 #define __PHYSFS_ATOMIC_DECR(ptrval) _InterlockedDecrement((long*)(ptrval))
 #elif defined(__clang__) || (defined(__GNUC__) && (((__GNUC__ * 10000) + (__GNUC_MINOR__ * 100)) >= 40100))
-#define __PHYSFS_ATOMIC_INCR(ptrval) __sync_fetch_and_add(ptrval, 1)
-#define __PHYSFS_ATOMIC_DECR(ptrval) __sync_fetch_and_add(ptrval, -1)
+#define __PHYSFS_ATOMIC_INCR(ptrval) __sync_add_and_fetch(ptrval, 1)
+#define __PHYSFS_ATOMIC_DECR(ptrval) __sync_sub_and_fetch(ptrval, 1)
 #else
 #define PHYSFS_NEED_ATOMIC_OP_FALLBACK 1
 int __PHYSFS_ATOMIC_INCR(int *ptrval);
@@ -202,16 +204,54 @@ void __PHYSFS_smallFree(void *ptr);
 #define PHYSFS_SUPPORTS_VDF PHYSFS_SUPPORTS_DEFAULT
 #endif
 
+/* Zstandard-compressed entries (method 93) in ZIP archives. Unlike the
+   rest, this is off by default: it pulls in an external libzstd instead
+   of vendored code, so builds have to opt in. */
+#ifndef PHYSFS_SUPPORTS_ZIP_ZSTD
+#define PHYSFS_SUPPORTS_ZIP_ZSTD 0
+#endif
+
 #if PHYSFS_SUPPORTS_7Z
 /* 7zip support needs a global init function called at startup (no deinit). */
 extern void SZIP_global_init(void);
 #endif
 
 /* The latest supported PHYSFS_Io::version value. */
-#define CURRENT_PHYSFS_IO_API_VERSION 0
+#define CURRENT_PHYSFS_IO_API_VERSION 1
+
+/* Does this PHYSFS_Io offer the optional readAt method? Check the version
+   first; older struct layouts don't even have the field. */
+#define __PHYSFS_ioHasReadAt(io) (((io)->version >= 1) && ((io)->readAt))
+
+/* Same, for the optional map method. */
+#define __PHYSFS_ioHasMap(io) (((io)->version >= 1) && ((io)->map))
+
+/*
+ * Performance counters behind PHYSFS_getStats(). One atomic add per event
+ *  on the hot paths; define PHYSFS_NO_STATS to compile every update (and
+ *  the counters themselves) away.
+ */
+#ifndef PHYSFS_NO_STATS
+extern PHYSFS_Stats __PHYSFS_stats;
+void __PHYSFS_statsAdd(PHYSFS_uint64 *counter, const PHYSFS_uint64 n);
+#define __PHYSFS_STATS_ADD(counter, n) __PHYSFS_statsAdd(&(counter), n)
+#define __PHYSFS_STATS_INCR(counter) __PHYSFS_statsAdd(&(counter), 1)
+#else
+#define __PHYSFS_STATS_ADD(counter, n) do {} while (0)
+#define __PHYSFS_STATS_INCR(counter) do {} while (0)
+#endif
 
 /* The latest supported PHYSFS_Archiver::version value. */
-#define CURRENT_PHYSFS_ARCHIVER_API_VERSION 0
+#define CURRENT_PHYSFS_ARCHIVER_API_VERSION 2
+
+/* Does this PHYSFS_Archiver offer the optional enumerateWithStat method?
+   Check the version first; older struct layouts don't even have the field. */
+#define __PHYSFS_archiverHasEnumerateWithStat(arc) \
+    (((arc)->version >= 1) && ((arc)->enumerateWithStat))
+
+/* Does this PHYSFS_Archiver offer the optional correctCase method? */
+#define __PHYSFS_archiverHasCorrectCase(arc) \
+    (((arc)->version >= 2) && ((arc)->correctCase))
 
 /* This byteorder stuff was lifted from SDL. https://www.libsdl.org/ */
 #define PHYSFS_LIL_ENDIAN  1234
@@ -314,6 +354,26 @@ char *__PHYSFS_strdup(const char *str);
  */
 PHYSFS_uint32 __PHYSFS_hashString(const char *str, size_t len);
 
+/*
+ * Like __PHYSFS_hashString, but mixes casefolded codepoints instead of
+ *  raw bytes: utf-8 strings that PHYSFS_utf8stricmp() considers equal
+ *  hash identically.
+ */
+PHYSFS_uint32 __PHYSFS_hashStringCasefold(const char *str);
+
+/*
+ * One-time setup for __PHYSFS_crc32(); PHYSFS_init() takes care of this.
+ */
+void __PHYSFS_crc32Init(void);
+
+/*
+ * CRC-32 (zlib/ZIP polynomial) of (len) bytes at (buf), continuing from
+ *  (crc). Pass zero as the initial value. Implemented with sliced tables
+ *  or hardware CRC instructions; use this instead of a bytewise loop for
+ *  anything that hashes bulk data.
+ */
+PHYSFS_uint32 __PHYSFS_crc32(PHYSFS_uint32 crc, const void *buf, size_t len);
+
 
 /*
  * The current allocator. Not valid before PHYSFS_init is called!
@@ -354,12 +414,17 @@ void *UNPK_openArchive(PHYSFS_Io *io);
 void *UNPK_addEntry(void *opaque, char *name, const int isdir,
                     const PHYSFS_sint64 ctime, const PHYSFS_sint64 mtime,
                     const PHYSFS_uint64 pos, const PHYSFS_uint64 len);
+void *UNPK_loadDirectory(PHYSFS_Io *io, const PHYSFS_uint64 len);
 PHYSFS_Io *UNPK_openRead(void *opaque, const char *name);
 PHYSFS_Io *UNPK_openWrite(void *opaque, const char *name);
 PHYSFS_Io *UNPK_openAppend(void *opaque, const char *name);
 int UNPK_remove(void *opaque, const char *name);
 int UNPK_mkdir(void *opaque, const char *name);
 int UNPK_stat(void *opaque, const char *fn, PHYSFS_Stat *st);
+const char *UNPK_correctCase(void *opaque, const char *name);
+PHYSFS_EnumerateCallbackResult UNPK_enumerateWithStat(void *opaque,
+                 const char *dname, PHYSFS_EnumerateWithStatCallback cb,
+                 const char *origdir, void *callbackdata);
 #define UNPK_enumerate __PHYSFS_DirTreeEnumerate
 
 
@@ -370,29 +435,87 @@ int UNPK_stat(void *opaque, const char *fn, PHYSFS_Stat *st);
 typedef struct __PHYSFS_DirTreeEntry
 {
     char *name;                              /* Full path in archive.        */
-    struct __PHYSFS_DirTreeEntry *hashnext;  /* next item in hash bucket.    */
     struct __PHYSFS_DirTreeEntry *children;  /* linked list of kids, if dir. */
     struct __PHYSFS_DirTreeEntry *sibling;   /* next item in same dir.       */
+    struct __PHYSFS_DirTreeEntry **sorted;   /* kids sorted by name. Built on
+                                                first enumerate; NULL until
+                                                then (or after a new kid).   */
+    size_t childCount;                       /* number of kids, if dir.      */
     int isdir;
 } __PHYSFS_DirTreeEntry;
 
+/*
+ * Lookup is an open-addressing hash table (linear probing, power-of-two
+ *  capacity, grown by load factor). The 32-bit string hash is stored next
+ *  to the entry pointer, so a probe usually rejects a slot without chasing
+ *  the pointer to strcmp a full path. The table is keyed by the CASEFOLDED
+ *  hash of the entry name, so entries differing only in case share a probe
+ *  chain; exact lookups still strcmp the real name, and case-insensitive
+ *  lookups ride the same chain with PHYSFS_utf8stricmp().
+ */
+typedef struct __PHYSFS_DirTreeHashSlot
+{
+    PHYSFS_uint32 hash;           /* casefolded hash of entry name.  */
+    __PHYSFS_DirTreeEntry *entry; /* NULL if this slot is empty.     */
+} __PHYSFS_DirTreeHashSlot;
+
 typedef struct __PHYSFS_DirTree
 {
     __PHYSFS_DirTreeEntry *root;    /* root of directory tree.             */
-    __PHYSFS_DirTreeEntry **hash;  /* all entries hashed for fast lookup. */
-    size_t hashBuckets;            /* number of buckets in hash.          */
+    __PHYSFS_DirTreeHashSlot *hash; /* all entries hashed for fast lookup. */
+    size_t hashBuckets;            /* capacity of hash; a power of two.    */
+    size_t hashCount;              /* number of occupied slots in hash.    */
     size_t entrylen;    /* size in bytes of entries (including subclass). */
+    void *slabs;        /* newest arena slab backing the entries.        */
+    size_t slabUsed;    /* bytes handed out from the newest slab.        */
+    size_t slabSize;    /* capacity of the newest slab, in bytes.        */
+    void *sortLock;     /* guards lazy sorted-children builds.           */
 } __PHYSFS_DirTree;
 
 
 int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen);
 void *__PHYSFS_DirTreeAdd(__PHYSFS_DirTree *dt, char *name, const int isdir);
 void *__PHYSFS_DirTreeFind(__PHYSFS_DirTree *dt, const char *path);
+
+/*
+ * Like __PHYSFS_DirTreeFind, but matches (path) case-insensitively, in a
+ *  single hash probe. If several entries differ only in case, which one
+ *  you get is unspecified.
+ */
+void *__PHYSFS_DirTreeFindIgnoreCase(__PHYSFS_DirTree *dt, const char *path);
 PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(void *opaque,
                               const char *dname, PHYSFS_EnumerateCallback cb,
                               const char *origdir, void *callbackdata);
+
+/*
+ * Like __PHYSFS_DirTreeEnumerate, but reports each entry's metadata too.
+ *  (statfn) fills (st) from an entry the tree already holds--no per-file
+ *  lookup--returning zero on failure like an archiver's stat method.
+ */
+PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerateWithStat(void *opaque,
+                 const char *dname, PHYSFS_EnumerateWithStatCallback cb,
+                 const char *origdir, void *callbackdata,
+                 int (*statfn)(void *opaque, __PHYSFS_DirTreeEntry *entry,
+                               PHYSFS_Stat *st));
 void __PHYSFS_DirTreeDeinit(__PHYSFS_DirTree *dt);
 
+#if PHYSFS_SUPPORTS_ZIP
+/*
+ * Mount manifest support (PHYSFS_writeMountManifest/PHYSFS_mountManifest).
+ *  __PHYSFS_zipSaveManifest serializes a mounted zip's directory tree to
+ *  (mio), recording (size) and (mtime) of the archive for validation.
+ *  __PHYSFS_zipLoadManifest builds the archiver opaque for (io) from a
+ *  manifest in (mio) instead of parsing the central directory, failing
+ *  if the recorded size/mtime don't match the ones supplied.
+ */
+int __PHYSFS_zipSaveManifest(void *opaque, PHYSFS_Io *mio,
+                             const PHYSFS_sint64 size,
+                             const PHYSFS_sint64 mtime);
+void *__PHYSFS_zipLoadManifest(PHYSFS_Io *io, PHYSFS_Io *mio,
+                               const PHYSFS_sint64 size,
+                               const PHYSFS_sint64 mtime);
+#endif
+
 
 
 /*--------------------------------------------------------------------------*/
@@ -501,6 +624,57 @@ void *__PHYSFS_platformOpenAppend(const char *filename);
  */
 PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buf, PHYSFS_uint64 len);
 
+/*
+ * Read data from a platform-specific file handle at a specific offset.
+ *  (opaque) should be cast to whatever data type your platform uses. Read a
+ *  maximum of (len) 8-bit bytes, starting at byte (pos) from the start of
+ *  the file, to the area pointed to by (buf). The file pointer is not used
+ *  and its position afterwards is undefined. Use a single positioned-read
+ *  system call (pread() and friends) where the platform has one, so that
+ *  two threads can safely use the same handle at once; fall back to a
+ *  seek-and-read pair where it doesn't. Return the number of bytes read,
+ *  (0) at end of file, or (-1) on catastrophic error, calling
+ *  PHYSFS_setErrorCode() to describe the problem. A partial read is
+ *  success; only return (-1) on total failure.
+ */
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, void *buf,
+                                      PHYSFS_uint64 len, PHYSFS_uint64 pos);
+
+/*
+ * Copy (len) bytes from platform file handle (src), starting at absolute
+ *  position (srcpos), to the current file position of (dst), without
+ *  bouncing the data through user space if the operating system has a
+ *  call for that (copy_file_range()/sendfile() and friends). (src)'s file
+ *  pointer must not move; (dst)'s advances by the amount copied. Return
+ *  the number of bytes copied--a short count is fine, the caller loops--
+ *  or (-1) with PHYSFS_setErrorCode() on failure. Platforms (or
+ *  filesystem pairs) that can't do this should report
+ *  PHYSFS_ERR_UNSUPPORTED and the caller will fall back to a read/write
+ *  loop.
+ */
+PHYSFS_sint64 __PHYSFS_platformCopyFileRange(void *src, PHYSFS_uint64 srcpos,
+                                             void *dst, PHYSFS_uint64 len);
+
+/*
+ * Map the first (len) bytes of a platform-specific file handle into the
+ *  process's address space, read-only. (opaque) should be cast to whatever
+ *  data type your platform uses. On success, store the mapped address to
+ *  (*addr) and return a non-NULL platform-specific value that will be
+ *  handed back to __PHYSFS_platformUnmapFile() later. On failure, call
+ *  PHYSFS_setErrorCode() and return NULL; platforms without memory
+ *  mapping should report PHYSFS_ERR_UNSUPPORTED.
+ */
+void *__PHYSFS_platformMapFile(void *opaque, PHYSFS_uint64 len,
+                               const void **addr);
+
+/*
+ * Release a mapping made with __PHYSFS_platformMapFile(). (maphandle),
+ *  (addr) and (len) are the value it returned and the arguments it filled
+ *  in. This must always succeed, so it returns void.
+ */
+void __PHYSFS_platformUnmapFile(void *maphandle, const void *addr,
+                                PHYSFS_uint64 len);
+
 /*
  * Write more data to a platform-specific file handle. (opaque) should be
  *  cast to whatever data type your platform uses. Write a maximum of (len)
@@ -647,6 +821,19 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
                                PHYSFS_EnumerateCallback callback,
                                const char *origdir, void *callbackdata);
 
+/*
+ * Like __PHYSFS_platformEnumerate(), but each entry arrives with its
+ *  PHYSFS_Stat filled in from whatever the directory walk already has in
+ *  hand (find-data on Windows and OS/2, a dirfd-relative stat elsewhere),
+ *  so a full tree scan never builds per-entry native paths or re-resolves
+ *  them from the filesystem root. Symlinks are reported as such, never
+ *  followed, matching a stat() through the dir archiver.
+ */
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateWithStatCallback callback,
+                               const char *origdir, void *callbackdata);
+
 /*
  * Make a directory in the actual filesystem. (path) is specified in
  *  platform-dependent notation. On error, return zero and set the error
@@ -715,6 +902,47 @@ int __PHYSFS_platformGrabMutex(void *mutex);
  */
 void __PHYSFS_platformReleaseMutex(void *mutex);
 
+/*
+ * Spawn a background thread that calls (fn) with (arg) and then exits.
+ *  Return an opaque thread handle to hand to __PHYSFS_platformJoinThread(),
+ *  or NULL on failure (including single-threaded platforms, which should
+ *  report PHYSFS_ERR_UNSUPPORTED); callers are expected to degrade to
+ *  doing the work on the calling thread in that case.
+ */
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg);
+
+/*
+ * Wait for a thread created by __PHYSFS_platformCreateThread() to exit,
+ *  and clean up any resources associated with it. (thread) is a value
+ *  previously returned by __PHYSFS_platformCreateThread().
+ */
+void __PHYSFS_platformJoinThread(void *thread);
+
+/*
+ * Create a counting semaphore with an initial count of zero, cast to a
+ *  (void *) for abstractness. Return (NULL) if you couldn't create one.
+ */
+void *__PHYSFS_platformCreateSemaphore(void);
+
+/*
+ * Destroy a semaphore made by __PHYSFS_platformCreateSemaphore(), and
+ *  clean up any resources associated with it.
+ */
+void __PHYSFS_platformDestroySemaphore(void *sem);
+
+/*
+ * Block until the semaphore's count is positive, then decrement it.
+ *  Spurious wakeups are permitted--callers always recheck their actual
+ *  condition in a loop--but missed posts are not.
+ */
+void __PHYSFS_platformWaitSemaphore(void *sem);
+
+/*
+ * Increment the semaphore's count, waking one waiter if any are blocked
+ *  in __PHYSFS_platformWaitSemaphore().
+ */
+void __PHYSFS_platformPostSemaphore(void *sem);
+
 #if PHYSFS_HAVE_PRAGMA_VISIBILITY
 #pragma GCC visibility pop
 #endif
@@ -651,6 +651,32 @@ static int mz_inflateEnd(mz_streamp pStream)
   return MZ_OK;
 }
 
+/* Reinitialize a live stream for a fresh deflate stream, keeping the
+   already-allocated inflate_state instead of freeing and reallocating it. */
+static int mz_inflateReset(mz_streamp pStream)
+{
+  inflate_state *pDecomp;
+  if ((!pStream) || (!pStream->state)) return MZ_STREAM_ERROR;
+
+  pStream->data_type = 0;
+  pStream->adler = 0;
+  pStream->msg = NULL;
+  pStream->total_in = 0;
+  pStream->total_out = 0;
+  pStream->reserved = 0;
+
+  pDecomp = (inflate_state*)pStream->state;
+  tinfl_init(&pDecomp->m_decomp);
+  pDecomp->m_dict_ofs = 0;
+  pDecomp->m_dict_avail = 0;
+  pDecomp->m_last_status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  pDecomp->m_first_call = 1;
+  pDecomp->m_has_flushed = 0;
+  /* m_window_bits is unchanged from the original mz_inflateInit2(). */
+
+  return MZ_OK;
+}
+
 /* make this a drop-in replacement for zlib... */
   #define voidpf void*
   #define uInt unsigned int
@@ -658,6 +684,7 @@ static int mz_inflateEnd(mz_streamp pStream)
   #define inflateInit2          mz_inflateInit2
   #define inflate               mz_inflate
   #define inflateEnd            mz_inflateEnd
+  #define inflateReset          mz_inflateReset
   #define Z_SYNC_FLUSH          MZ_SYNC_FLUSH
   #define Z_FINISH              MZ_FINISH
   #define Z_OK                  MZ_OK
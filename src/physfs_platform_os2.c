@@ -479,6 +479,101 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
 } /* __PHYSFS_platformEnumerate */
 
 
+PHYSFS_sint64 os2TimeToUnixTime(const FDATE *date, const FTIME *time);
+
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateWithStatCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    size_t utf8len = strlen(dirname);
+    char *utf8 = (char *) __PHYSFS_smallAlloc(utf8len + 5);
+    char *cpspec = NULL;
+    FILEFINDBUF3 fb;
+    HDIR hdir = HDIR_CREATE;
+    ULONG count = 1;
+    APIRET rc;
+
+    BAIL_IF(!utf8, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+
+    strcpy(utf8, dirname);
+    if (utf8[utf8len - 1] != '\\')
+        strcpy(utf8 + utf8len, "\\*.*");
+    else
+        strcpy(utf8 + utf8len, "*.*");
+
+    cpspec = cvtUtf8ToCodepage(utf8);
+    __PHYSFS_smallFree(utf8);
+    BAIL_IF_ERRPASS(!cpspec, PHYSFS_ENUM_ERROR);
+
+    rc = DosFindFirst((unsigned char *) cpspec, &hdir,
+                      FILE_DIRECTORY | FILE_ARCHIVED |
+                      FILE_READONLY | FILE_HIDDEN | FILE_SYSTEM,
+                      &fb, sizeof (fb), &count, FIL_STANDARD);
+    allocator.Free(cpspec);
+
+    BAIL_IF(rc != NO_ERROR, errcodeFromAPIRET(rc), PHYSFS_ENUM_ERROR);
+
+    while (count == 1)
+    {
+        if ((strcmp(fb.achName, ".") != 0) && (strcmp(fb.achName, "..") != 0))
+        {
+            utf8 = cvtCodepageToUtf8(fb.achName);
+            if (!utf8)
+                retval = PHYSFS_ENUM_ERROR;
+            else
+            {
+                /* the find buffer carries the whole stat; no extra query. */
+                PHYSFS_Stat st;
+
+                if (fb.attrFile & FILE_DIRECTORY)
+                {
+                    st.filetype = PHYSFS_FILETYPE_DIRECTORY;
+                    st.filesize = 0;
+                } /* if */
+                else
+                {
+                    st.filetype = PHYSFS_FILETYPE_REGULAR;
+                    st.filesize = fb.cbFile;
+                } /* else */
+
+                st.modtime = os2TimeToUnixTime(&fb.fdateLastWrite,
+                                               &fb.ftimeLastWrite);
+                if (st.modtime < 0)
+                    st.modtime = 0;
+
+                st.accesstime = os2TimeToUnixTime(&fb.fdateLastAccess,
+                                                  &fb.ftimeLastAccess);
+                if (st.accesstime < 0)
+                    st.accesstime = 0;
+
+                st.createtime = os2TimeToUnixTime(&fb.fdateCreation,
+                                                  &fb.ftimeCreation);
+                if (st.createtime < 0)
+                    st.createtime = 0;
+
+                st.readonly = ((fb.attrFile & FILE_READONLY) == FILE_READONLY);
+
+                retval = callback(callbackdata, origdir, utf8, &st);
+                allocator.Free(utf8);
+                if (retval == PHYSFS_ENUM_ERROR)
+                    PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
+            } /* else */
+        } /* if */
+
+        if (retval != PHYSFS_ENUM_OK)
+            break;
+
+        DosFindNext(hdir, &fb, sizeof (fb), &count);
+    } /* while */
+
+    DosFindClose(hdir);
+
+    return retval;
+} /* __PHYSFS_platformEnumerateStat */
+
+
 char *__PHYSFS_platformCurrentDir(void)
 {
     char *retval;
@@ -621,6 +716,37 @@ PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buf, PHYSFS_uint64 len)
 } /* __PHYSFS_platformRead */
 
 
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, void *buf,
+                                      PHYSFS_uint64 len, PHYSFS_uint64 pos)
+{
+    /* OS/2 has no positioned-read call, so this is just a seek-and-read
+       pair; callers still shouldn't trust the file pointer afterwards. */
+    BAIL_IF_ERRPASS(!__PHYSFS_platformSeek(opaque, pos), -1);
+    return __PHYSFS_platformRead(opaque, buf, len);
+} /* __PHYSFS_platformReadAt */
+
+
+PHYSFS_sint64 __PHYSFS_platformCopyFileRange(void *src, PHYSFS_uint64 srcpos,
+                                             void *dst, PHYSFS_uint64 len)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, -1);  /* no kernel-side copies here. */
+} /* __PHYSFS_platformCopyFileRange */
+
+
+void *__PHYSFS_platformMapFile(void *opaque, PHYSFS_uint64 len,
+                               const void **addr)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);  /* no memory-mapped files here. */
+} /* __PHYSFS_platformMapFile */
+
+
+void __PHYSFS_platformUnmapFile(void *maphandle, const void *addr,
+                                PHYSFS_uint64 len)
+{
+    /* never mapped anything, so nothing to do. */
+} /* __PHYSFS_platformUnmapFile */
+
+
 PHYSFS_sint64 __PHYSFS_platformWrite(void *opaque, const void *buf,
                                      PHYSFS_uint64 len)
 {
@@ -807,6 +933,131 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
     DosReleaseMutexSem((HMTX) mutex);
 } /* __PHYSFS_platformReleaseMutex */
 
+
+typedef struct
+{
+    void (*fn)(void *);
+    void *arg;
+} Os2ThreadEntryArgs;
+
+static void os2ThreadEntry(ULONG _args)
+{
+    Os2ThreadEntryArgs *args = (Os2ThreadEntryArgs *) _args;
+    void (*fn)(void *) = args->fn;
+    void *arg = args->arg;
+    allocator.Free(args);
+    fn(arg);
+} /* os2ThreadEntry */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    TID tid = 0;
+    APIRET rc;
+    Os2ThreadEntryArgs *args;
+
+    args = (Os2ThreadEntryArgs *) allocator.Malloc(sizeof (Os2ThreadEntryArgs));
+    BAIL_IF(!args, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    args->fn = fn;
+    args->arg = arg;
+
+    rc = DosCreateThread(&tid, os2ThreadEntry, (ULONG) args,
+                         CREATE_READY, 65536);
+    if (rc != NO_ERROR)
+    {
+        allocator.Free(args);
+        BAIL(errcodeFromAPIRET(rc), NULL);
+    } /* if */
+
+    return ((void *) tid);
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    TID tid = (TID) thread;
+    DosWaitThread(&tid, DCWW_WAIT);
+} /* __PHYSFS_platformJoinThread */
+
+
+/* OS/2 event sems are binary, so we track the count ourselves. */
+typedef struct
+{
+    HMTX mutex;
+    HEV event;
+    PHYSFS_uint32 count;
+} Os2Semaphore;
+
+void *__PHYSFS_platformCreateSemaphore(void)
+{
+    Os2Semaphore *sem;
+    APIRET rc;
+
+    sem = (Os2Semaphore *) allocator.Malloc(sizeof (Os2Semaphore));
+    BAIL_IF(!sem, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    rc = DosCreateMutexSem(NULL, &sem->mutex, 0, 0);
+    if (rc != NO_ERROR)
+    {
+        allocator.Free(sem);
+        BAIL(errcodeFromAPIRET(rc), NULL);
+    } /* if */
+
+    rc = DosCreateEventSem(NULL, &sem->event, 0, 0);
+    if (rc != NO_ERROR)
+    {
+        DosCloseMutexSem(sem->mutex);
+        allocator.Free(sem);
+        BAIL(errcodeFromAPIRET(rc), NULL);
+    } /* if */
+
+    sem->count = 0;
+    return sem;
+} /* __PHYSFS_platformCreateSemaphore */
+
+
+void __PHYSFS_platformDestroySemaphore(void *_sem)
+{
+    Os2Semaphore *sem = (Os2Semaphore *) _sem;
+    DosCloseEventSem(sem->event);
+    DosCloseMutexSem(sem->mutex);
+    allocator.Free(sem);
+} /* __PHYSFS_platformDestroySemaphore */
+
+
+void __PHYSFS_platformWaitSemaphore(void *_sem)
+{
+    Os2Semaphore *sem = (Os2Semaphore *) _sem;
+    ULONG postcount;
+
+    while (1)
+    {
+        DosRequestMutexSem(sem->mutex, SEM_INDEFINITE_WAIT);
+        if (sem->count > 0)
+        {
+            sem->count--;
+            DosReleaseMutexSem(sem->mutex);
+            return;
+        } /* if */
+
+        /* reset while holding the mutex, so a post between the release
+           and the wait still wakes us up. */
+        DosResetEventSem(sem->event, &postcount);
+        DosReleaseMutexSem(sem->mutex);
+        DosWaitEventSem(sem->event, SEM_INDEFINITE_WAIT);
+    } /* while */
+} /* __PHYSFS_platformWaitSemaphore */
+
+
+void __PHYSFS_platformPostSemaphore(void *_sem)
+{
+    Os2Semaphore *sem = (Os2Semaphore *) _sem;
+    DosRequestMutexSem(sem->mutex, SEM_INDEFINITE_WAIT);
+    sem->count++;
+    DosPostEventSem(sem->event);
+    DosReleaseMutexSem(sem->mutex);
+} /* __PHYSFS_platformPostSemaphore */
+
 #endif  /* PHYSFS_PLATFORM_OS2 */
 
 /* end of physfs_platform_os2.c ... */
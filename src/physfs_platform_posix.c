@@ -8,6 +8,10 @@
 
 /* !!! FIXME: check for EINTR? */
 
+#ifdef __linux__
+#define _GNU_SOURCE 1  /* for copy_file_range(). */
+#endif
+
 #define __PHYSICSFS_INTERNAL__
 #include "physfs_platforms.h"
 
@@ -17,12 +21,17 @@
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <pwd.h>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 
+#ifdef PHYSFS_PLATFORM_LINUX
+#include <sys/sendfile.h>
+#endif
+
 #include "physfs_internal.h"
 
 
@@ -149,6 +158,89 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
 } /* __PHYSFS_platformEnumerate */
 
 
+/* shared between the stat() and enumerate-with-stat paths; (readonly) is
+   left for the caller, since checking it needs a path or a dirfd. */
+static void statbufToPhysfsStat(const struct stat *statbuf, PHYSFS_Stat *st)
+{
+    if (S_ISREG(statbuf->st_mode))
+    {
+        st->filetype = PHYSFS_FILETYPE_REGULAR;
+        st->filesize = statbuf->st_size;
+    } /* if */
+
+    else if(S_ISDIR(statbuf->st_mode))
+    {
+        st->filetype = PHYSFS_FILETYPE_DIRECTORY;
+        st->filesize = 0;
+    } /* else if */
+
+    else if(S_ISLNK(statbuf->st_mode))
+    {
+        st->filetype = PHYSFS_FILETYPE_SYMLINK;
+        st->filesize = 0;
+    } /* else if */
+
+    else
+    {
+        st->filetype = PHYSFS_FILETYPE_OTHER;
+        st->filesize = statbuf->st_size;
+    } /* else */
+
+    st->modtime = statbuf->st_mtime;
+    st->createtime = statbuf->st_ctime;
+    st->accesstime = statbuf->st_atime;
+} /* statbufToPhysfsStat */
+
+
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateWithStatCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    DIR *dir;
+    struct dirent *ent;
+    int dfd;
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+
+    dir = opendir(dirname);
+    BAIL_IF(dir == NULL, errcodeFromErrno(), PHYSFS_ENUM_ERROR);
+    dfd = dirfd(dir);
+
+    while ((retval == PHYSFS_ENUM_OK) && ((ent = readdir(dir)) != NULL))
+    {
+        const char *name = ent->d_name;
+        struct stat statbuf;
+        PHYSFS_Stat st;
+
+        if (name[0] == '.')  /* ignore "." and ".." */
+        {
+            if ((name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0')))
+                continue;
+        } /* if */
+
+        /* resolve relative to the open directory: no native path to
+           build, and the kernel doesn't rewalk the whole tree per entry. */
+        if (fstatat(dfd, name, &statbuf, AT_SYMLINK_NOFOLLOW) == -1)
+        {
+            PHYSFS_setErrorCode(errcodeFromErrno());
+            retval = PHYSFS_ENUM_ERROR;
+            break;
+        } /* if */
+
+        statbufToPhysfsStat(&statbuf, &st);
+        st.readonly = (faccessat(dfd, name, W_OK, 0) == -1);
+
+        retval = callback(callbackdata, origdir, name, &st);
+        if (retval == PHYSFS_ENUM_ERROR)
+            PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
+    } /* while */
+
+    closedir(dir);
+
+    return retval;
+} /* __PHYSFS_platformEnumerateStat */
+
+
 int __PHYSFS_platformMkDir(const char *path)
 {
     const int rc = mkdir(path, S_IRWXU);
@@ -227,6 +319,75 @@ PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buffer,
 } /* __PHYSFS_platformRead */
 
 
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, void *buffer,
+                                      PHYSFS_uint64 len, PHYSFS_uint64 pos)
+{
+    const int fd = *((int *) opaque);
+    ssize_t rc = 0;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
+
+    rc = pread(fd, buffer, (size_t) len, (off_t) pos);
+    BAIL_IF(rc == -1, errcodeFromErrno(), -1);
+    assert(rc >= 0);
+    assert(rc <= len);
+    return (PHYSFS_sint64) rc;
+} /* __PHYSFS_platformReadAt */
+
+
+PHYSFS_sint64 __PHYSFS_platformCopyFileRange(void *src, PHYSFS_uint64 srcpos,
+                                             void *dst, PHYSFS_uint64 len)
+{
+#ifdef PHYSFS_PLATFORM_LINUX
+    const int infd = *((int *) src);
+    const int outfd = *((int *) dst);
+    off_t inpos = (off_t) srcpos;
+    ssize_t rc;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        len = 0x7FFFF000;  /* the kernel caps one transfer near here anyhow. */
+
+    rc = copy_file_range(infd, &inpos, outfd, NULL, (size_t) len, 0);
+    if ((rc == -1) && ((errno == EXDEV) || (errno == EINVAL) ||
+                       (errno == ENOSYS) || (errno == EOPNOTSUPP)))
+    {
+        /* cross-device copy, or a filesystem that can't: sendfile() to a
+           regular file has worked since Linux 2.6.33. */
+        rc = sendfile(outfd, infd, &inpos, (size_t) len);
+    } /* if */
+
+    BAIL_IF(rc == -1, errcodeFromErrno(), -1);
+    return (PHYSFS_sint64) rc;
+#else
+    BAIL(PHYSFS_ERR_UNSUPPORTED, -1);  /* caller takes the userspace path. */
+#endif
+} /* __PHYSFS_platformCopyFileRange */
+
+
+void *__PHYSFS_platformMapFile(void *opaque, PHYSFS_uint64 len,
+                               const void **addr)
+{
+    const int fd = *((int *) opaque);
+    void *ptr;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    ptr = mmap(NULL, (size_t) len, PROT_READ, MAP_PRIVATE, fd, 0);
+    BAIL_IF(ptr == MAP_FAILED, errcodeFromErrno(), NULL);
+    *addr = ptr;
+    return ptr;  /* the address doubles as the mapping handle here. */
+} /* __PHYSFS_platformMapFile */
+
+
+void __PHYSFS_platformUnmapFile(void *maphandle, const void *addr,
+                                PHYSFS_uint64 len)
+{
+    munmap((void *) addr, (size_t) len);
+} /* __PHYSFS_platformUnmapFile */
+
+
 PHYSFS_sint64 __PHYSFS_platformWrite(void *opaque, const void *buffer,
                                      PHYSFS_uint64 len)
 {
@@ -302,34 +463,7 @@ int __PHYSFS_platformStat(const char *fname, PHYSFS_Stat *st, const int follow)
     const int rc = follow ? stat(fname, &statbuf) : lstat(fname, &statbuf);
     BAIL_IF(rc == -1, errcodeFromErrno(), 0);
 
-    if (S_ISREG(statbuf.st_mode))
-    {
-        st->filetype = PHYSFS_FILETYPE_REGULAR;
-        st->filesize = statbuf.st_size;
-    } /* if */
-
-    else if(S_ISDIR(statbuf.st_mode))
-    {
-        st->filetype = PHYSFS_FILETYPE_DIRECTORY;
-        st->filesize = 0;
-    } /* else if */
-
-    else if(S_ISLNK(statbuf.st_mode))
-    {
-        st->filetype = PHYSFS_FILETYPE_SYMLINK;
-        st->filesize = 0;
-    } /* else if */
-
-    else
-    {
-        st->filetype = PHYSFS_FILETYPE_OTHER;
-        st->filesize = statbuf.st_size;
-    } /* else */
-
-    st->modtime = statbuf.st_mtime;
-    st->createtime = statbuf.st_ctime;
-    st->accesstime = statbuf.st_atime;
-
+    statbufToPhysfsStat(&statbuf, st);
     st->readonly = (access(fname, W_OK) == -1);
     return 1;
 } /* __PHYSFS_platformStat */
@@ -411,6 +545,125 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
     } /* if */
 } /* __PHYSFS_platformReleaseMutex */
 
+typedef struct
+{
+    void (*fn)(void *);
+    void *arg;
+} PthreadEntryArgs;
+
+static void *pthreadEntry(void *_args)
+{
+    PthreadEntryArgs *args = (PthreadEntryArgs *) _args;
+    void (*fn)(void *) = args->fn;
+    void *arg = args->arg;
+    allocator.Free(args);
+    fn(arg);
+    return NULL;
+} /* pthreadEntry */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    pthread_t *thread;
+    PthreadEntryArgs *args;
+    int rc;
+
+    thread = (pthread_t *) allocator.Malloc(sizeof (pthread_t));
+    BAIL_IF(!thread, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    args = (PthreadEntryArgs *) allocator.Malloc(sizeof (PthreadEntryArgs));
+    if (!args)
+    {
+        allocator.Free(thread);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    } /* if */
+
+    args->fn = fn;
+    args->arg = arg;
+
+    rc = pthread_create(thread, NULL, pthreadEntry, args);
+    if (rc != 0)
+    {
+        allocator.Free(args);
+        allocator.Free(thread);
+        BAIL(PHYSFS_ERR_OS_ERROR, NULL);
+    } /* if */
+
+    return ((void *) thread);
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    pthread_t *t = (pthread_t *) thread;
+    pthread_join(*t, NULL);
+    allocator.Free(t);
+} /* __PHYSFS_platformJoinThread */
+
+
+/* we build this on a condition variable instead of sem_t, since unnamed
+   POSIX semaphores never worked on Mac OS X. */
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    PHYSFS_uint32 count;
+} PthreadSemaphore;
+
+void *__PHYSFS_platformCreateSemaphore(void)
+{
+    PthreadSemaphore *s;
+
+    s = (PthreadSemaphore *) allocator.Malloc(sizeof (PthreadSemaphore));
+    BAIL_IF(!s, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    if (pthread_mutex_init(&s->mutex, NULL) != 0)
+    {
+        allocator.Free(s);
+        BAIL(PHYSFS_ERR_OS_ERROR, NULL);
+    } /* if */
+
+    if (pthread_cond_init(&s->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&s->mutex);
+        allocator.Free(s);
+        BAIL(PHYSFS_ERR_OS_ERROR, NULL);
+    } /* if */
+
+    s->count = 0;
+    return ((void *) s);
+} /* __PHYSFS_platformCreateSemaphore */
+
+
+void __PHYSFS_platformDestroySemaphore(void *sem)
+{
+    PthreadSemaphore *s = (PthreadSemaphore *) sem;
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    allocator.Free(s);
+} /* __PHYSFS_platformDestroySemaphore */
+
+
+void __PHYSFS_platformWaitSemaphore(void *sem)
+{
+    PthreadSemaphore *s = (PthreadSemaphore *) sem;
+    pthread_mutex_lock(&s->mutex);
+    while (s->count == 0)
+        pthread_cond_wait(&s->cond, &s->mutex);
+    s->count--;
+    pthread_mutex_unlock(&s->mutex);
+} /* __PHYSFS_platformWaitSemaphore */
+
+
+void __PHYSFS_platformPostSemaphore(void *sem)
+{
+    PthreadSemaphore *s = (PthreadSemaphore *) sem;
+    pthread_mutex_lock(&s->mutex);
+    s->count++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+} /* __PHYSFS_platformPostSemaphore */
+
 #endif  /* PHYSFS_PLATFORM_POSIX */
 
 /* end of physfs_platform_posix.c ... */
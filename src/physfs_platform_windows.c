@@ -57,17 +57,6 @@
 #define PHYSFS_IO_REPARSE_TAG_SYMLINK    0xA000000C
 
 
-#define UTF8_TO_UNICODE_STACK(w_assignto, str) { \
-    if (str == NULL) \
-        w_assignto = NULL; \
-    else { \
-        const size_t len = (PHYSFS_uint64) ((strlen(str) + 1) * 2); \
-        w_assignto = (WCHAR *) __PHYSFS_smallAlloc(len); \
-        if (w_assignto != NULL) \
-            PHYSFS_utf8ToUtf16(str, (PHYSFS_uint16 *) w_assignto, len); \
-    } \
-} \
-
 /* Note this counts WCHARs, not codepoints! */
 static PHYSFS_uint64 wStrLen(const WCHAR *wstr)
 {
@@ -95,6 +84,175 @@ static char *unicodeToUtf8Heap(const WCHAR *w_str)
 } /* unicodeToUtf8Heap */
 
 
+/*
+ * Every path-taking entry point here has to convert UTF-8 to UTF-16, and
+ *  stat-heavy workloads convert the same mount-prefix strings thousands of
+ *  times. So keep a tiny LRU of recent conversions: full paths for exact
+ *  repeats, plus directory prefixes so a fresh path in a known directory
+ *  only needs its filename part converted.
+ */
+#define WIN_PATHCACHE_ENTRIES 16
+
+typedef struct WinPathCacheEntry
+{
+    char *utf8;            /* cached path (or directory prefix), UTF-8. */
+    size_t utf8len;        /* strlen(utf8). */
+    WCHAR *wide;           /* converted form, null-terminated. */
+    PHYSFS_uint64 wchars;  /* WCHARs in (wide), not counting the null. */
+    PHYSFS_uint32 lastuse; /* LRU tick of last hit; zero means empty. */
+} WinPathCacheEntry;
+
+static WinPathCacheEntry winPathCache[WIN_PATHCACHE_ENTRIES];
+static PHYSFS_uint32 winPathCacheTick = 0;
+static CRITICAL_SECTION winPathCacheLock;
+static int winPathCacheReady = 0;
+
+static void winPathCacheStore(const char *str, const size_t utf8len,
+                              const WCHAR *wide, const PHYSFS_uint64 wchars)
+{
+    WinPathCacheEntry *victim = NULL;
+    char *utf8copy;
+    WCHAR *widecopy;
+    size_t i;
+
+    utf8copy = (char *) allocator.Malloc(utf8len + 1);
+    widecopy = (WCHAR *) allocator.Malloc((((size_t) wchars) + 1) *
+                                          sizeof (WCHAR));
+    if ((utf8copy == NULL) || (widecopy == NULL))
+    {
+        allocator.Free(utf8copy);
+        allocator.Free(widecopy);
+        return;  /* no memory? Fine, just don't cache this one. */
+    } /* if */
+
+    memcpy(utf8copy, str, utf8len);
+    utf8copy[utf8len] = '\0';
+    memcpy(widecopy, wide, ((size_t) wchars) * sizeof (WCHAR));
+    widecopy[wchars] = '\0';
+
+    EnterCriticalSection(&winPathCacheLock);
+    for (i = 0; i < WIN_PATHCACHE_ENTRIES; i++)
+    {
+        WinPathCacheEntry *e = &winPathCache[i];
+        if ((e->lastuse) && (e->utf8len == utf8len) &&
+            (memcmp(e->utf8, utf8copy, utf8len) == 0))
+        {
+            e->lastuse = ++winPathCacheTick;  /* already in here. */
+            LeaveCriticalSection(&winPathCacheLock);
+            allocator.Free(utf8copy);
+            allocator.Free(widecopy);
+            return;
+        } /* if */
+        if ((victim == NULL) || (e->lastuse < victim->lastuse))
+            victim = e;  /* empty entries (lastuse 0) get picked first. */
+    } /* for */
+
+    if (victim->lastuse)
+    {
+        allocator.Free(victim->utf8);
+        allocator.Free(victim->wide);
+    } /* if */
+
+    victim->utf8 = utf8copy;
+    victim->utf8len = utf8len;
+    victim->wide = widecopy;
+    victim->wchars = wchars;
+    victim->lastuse = ++winPathCacheTick;
+    LeaveCriticalSection(&winPathCacheLock);
+} /* winPathCacheStore */
+
+/*
+ * Convert a UTF-8 path into (buf), consulting the cache. (buflen) is in
+ *  bytes and must be at least (strlen(str) + 1) * 2, which always fits the
+ *  result: a UTF-8 sequence is at least as many bytes as the WCHARs it
+ *  decodes to. Called through UTF8_TO_UNICODE_STACK, which allocates in
+ *  the _caller's_ stack frame.
+ */
+static void winCachedUtf8ToUtf16(const char *str, WCHAR *buf,
+                                 const size_t buflen)
+{
+    const size_t utf8len = strlen(str);
+    PHYSFS_uint64 prefixchars = 0;
+    size_t prefixlen = 0;
+    const char *sep;
+    size_t i;
+    int hit = 0;  /* 0 == miss, 1 == directory prefix, 2 == full path. */
+
+    if (!winPathCacheReady)
+    {
+        PHYSFS_utf8ToUtf16(str, (PHYSFS_uint16 *) buf, buflen);
+        return;
+    } /* if */
+
+    sep = strrchr(str, '\\');
+    if (sep != NULL)
+        prefixlen = ((size_t) (sep - str)) + 1;  /* keep the separator. */
+
+    EnterCriticalSection(&winPathCacheLock);
+    for (i = 0; i < WIN_PATHCACHE_ENTRIES; i++)
+    {
+        WinPathCacheEntry *e = &winPathCache[i];
+        if (!e->lastuse)
+            continue;
+        else if ((e->utf8len == utf8len) &&
+                 (memcmp(e->utf8, str, utf8len) == 0))
+        {
+            memcpy(buf, e->wide, (((size_t) e->wchars) + 1) * sizeof (WCHAR));
+            e->lastuse = ++winPathCacheTick;
+            hit = 2;
+            break;
+        } /* else if */
+        else if ((!hit) && (prefixlen > 0) && (e->utf8len == prefixlen) &&
+                 (memcmp(e->utf8, str, prefixlen) == 0))
+        {
+            memcpy(buf, e->wide, ((size_t) e->wchars) * sizeof (WCHAR));
+            prefixchars = e->wchars;
+            e->lastuse = ++winPathCacheTick;
+            hit = 1;  /* keep looking; an exact match is better. */
+        } /* else if */
+    } /* for */
+    LeaveCriticalSection(&winPathCacheLock);
+
+    if (hit == 2)
+        return;
+    else if (hit == 1)
+    {
+        /* conversion is per-codepoint and the split is at an ASCII '\\',
+           so converting just the tail gives the same result. */
+        PHYSFS_utf8ToUtf16(str + prefixlen,
+                           ((PHYSFS_uint16 *) buf) + prefixchars,
+                           buflen - (((size_t) prefixchars) * 2));
+    } /* else if */
+    else
+        PHYSFS_utf8ToUtf16(str, (PHYSFS_uint16 *) buf, buflen);
+
+    winPathCacheStore(str, utf8len, buf, wStrLen(buf));
+
+    if ((prefixlen > 0) && (hit == 0))
+    {
+        /* remember the directory prefix too; the final L'\\' marks how
+           many WCHARs of the converted path belong to it. */
+        PHYSFS_uint64 wc = wStrLen(buf);
+        while ((wc > 0) && (buf[wc - 1] != '\\'))
+            wc--;
+        if (wc > 0)
+            winPathCacheStore(str, prefixlen, buf, wc);
+    } /* if */
+} /* winCachedUtf8ToUtf16 */
+
+#define UTF8_TO_UNICODE_STACK(w_assignto, str) { \
+    if (str == NULL) \
+        w_assignto = NULL; \
+    else { \
+        const size_t len = (PHYSFS_uint64) ((strlen(str) + 1) * 2); \
+        w_assignto = (WCHAR *) __PHYSFS_smallAlloc(len); \
+        if (w_assignto != NULL) \
+            winCachedUtf8ToUtf16(str, w_assignto, len); \
+    } \
+} \
+
+
+
 /* Some older APIs aren't in WinRT (only the "Ex" version, etc).
    Since non-WinRT might not have the "Ex" version, we tapdance to use
    the perfectly-fine-and-available-even-on-Win95 API on non-WinRT targets. */
@@ -615,12 +773,36 @@ done:
 
 int __PHYSFS_platformInit(void)
 {
+    /* no critical section? Conversions just run uncached. */
+    if (winInitializeCriticalSection(&winPathCacheLock))
+    {
+        memset(winPathCache, '\0', sizeof (winPathCache));
+        winPathCacheTick = 0;
+        winPathCacheReady = 1;
+    } /* if */
+
     return 1;  /* It's all good */
 } /* __PHYSFS_platformInit */
 
 
 void __PHYSFS_platformDeinit(void)
 {
+    if (winPathCacheReady)
+    {
+        size_t i;
+        for (i = 0; i < WIN_PATHCACHE_ENTRIES; i++)
+        {
+            if (winPathCache[i].lastuse)
+            {
+                allocator.Free(winPathCache[i].utf8);
+                allocator.Free(winPathCache[i].wide);
+            } /* if */
+        } /* for */
+        memset(winPathCache, '\0', sizeof (winPathCache));
+        winPathCacheReady = 0;
+        DeleteCriticalSection(&winPathCacheLock);
+    } /* if */
+
     deinitCDThread();
 } /* __PHYSFS_platformDeinit */
 
@@ -696,11 +878,118 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
 } /* __PHYSFS_platformEnumerate */
 
 
+static PHYSFS_sint64 FileTimeToPhysfsTime(const FILETIME *ft);
+
+/* the find-data already has everything a stat needs, so each entry costs
+   zero extra system calls here. */
+static void findDataToPhysfsStat(const WIN32_FIND_DATAW *entw, PHYSFS_Stat *st)
+{
+    const DWORD attr = entw->dwFileAttributes;
+
+    st->modtime = FileTimeToPhysfsTime(&entw->ftLastWriteTime);
+    st->accesstime = FileTimeToPhysfsTime(&entw->ftLastAccessTime);
+    st->createtime = FileTimeToPhysfsTime(&entw->ftCreationTime);
+
+    if ((attr & PHYSFS_FILE_ATTRIBUTE_REPARSE_POINT) &&
+        (entw->dwReserved0 == PHYSFS_IO_REPARSE_TAG_SYMLINK))
+    {
+        st->filetype = PHYSFS_FILETYPE_SYMLINK;
+        st->filesize = 0;
+    } /* if */
+
+    else if (attr & FILE_ATTRIBUTE_DIRECTORY)
+    {
+        st->filetype = PHYSFS_FILETYPE_DIRECTORY;
+        st->filesize = 0;
+    } /* else if */
+
+    else
+    {
+        const int other = (attr & (FILE_ATTRIBUTE_OFFLINE |
+                                   FILE_ATTRIBUTE_DEVICE)) != 0;
+        st->filetype = other ? PHYSFS_FILETYPE_OTHER : PHYSFS_FILETYPE_REGULAR;
+        st->filesize = (((PHYSFS_uint64) entw->nFileSizeHigh) << 32) |
+                       entw->nFileSizeLow;
+    } /* else */
+
+    st->readonly = ((attr & FILE_ATTRIBUTE_READONLY) != 0);
+} /* findDataToPhysfsStat */
+
+
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateWithStatCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    HANDLE dir = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW entw;
+    size_t len = strlen(dirname);
+    char *searchPath = NULL;
+    WCHAR *wSearchPath = NULL;
+
+    /* Allocate a new string for path, maybe '\\', "*", and NULL terminator */
+    searchPath = (char *) __PHYSFS_smallAlloc(len + 3);
+    BAIL_IF(!searchPath, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+
+    /* Copy current dirname */
+    strcpy(searchPath, dirname);
+
+    /* if there's no '\\' at the end of the path, stick one in there. */
+    if (searchPath[len - 1] != '\\')
+    {
+        searchPath[len++] = '\\';
+        searchPath[len] = '\0';
+    } /* if */
+
+    /* Append the "*" to the end of the string */
+    strcat(searchPath, "*");
+
+    UTF8_TO_UNICODE_STACK(wSearchPath, searchPath);
+    __PHYSFS_smallFree(searchPath);
+    BAIL_IF_ERRPASS(!wSearchPath, PHYSFS_ENUM_ERROR);
+
+    dir = winFindFirstFileW(wSearchPath, &entw);
+    __PHYSFS_smallFree(wSearchPath);
+    BAIL_IF(dir==INVALID_HANDLE_VALUE, errcodeFromWinApi(), PHYSFS_ENUM_ERROR);
+
+    do
+    {
+        const WCHAR *fn = entw.cFileName;
+        char *utf8;
+
+        if (fn[0] == '.')  /* ignore "." and ".." */
+        {
+            if ((fn[1] == '\0') || ((fn[1] == '.') && (fn[2] == '\0')))
+                continue;
+        } /* if */
+
+        utf8 = unicodeToUtf8Heap(fn);
+        if (utf8 == NULL)
+            retval = -1;
+        else
+        {
+            PHYSFS_Stat st;
+            findDataToPhysfsStat(&entw, &st);
+            retval = callback(callbackdata, origdir, utf8, &st);
+            allocator.Free(utf8);
+            if (retval == PHYSFS_ENUM_ERROR)
+                PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
+        } /* else */
+    } while ((retval == PHYSFS_ENUM_OK) && (FindNextFileW(dir, &entw) != 0));
+
+    FindClose(dir);
+
+    return retval;
+} /* __PHYSFS_platformEnumerateStat */
+
+
 int __PHYSFS_platformMkDir(const char *path)
 {
     WCHAR *wpath;
     DWORD rc;
     UTF8_TO_UNICODE_STACK(wpath, path);
+    BAIL_IF(!wpath, PHYSFS_ERR_OUT_OF_MEMORY, 0);
     rc = CreateDirectoryW(wpath, NULL);
     __PHYSFS_smallFree(wpath);
     BAIL_IF(rc == 0, errcodeFromWinApi(), 0);
@@ -780,6 +1069,92 @@ PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buf, PHYSFS_uint64 len)
 } /* __PHYSFS_platformRead */
 
 
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, void *buf,
+                                      PHYSFS_uint64 len, PHYSFS_uint64 pos)
+{
+    HANDLE h = (HANDLE) opaque;
+    PHYSFS_sint64 totalRead = 0;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
+
+    while (len > 0)
+    {
+        const DWORD thislen = (len > 0xFFFFFFFF) ? 0xFFFFFFFF : (DWORD) len;
+        OVERLAPPED overlapped;
+        DWORD numRead = 0;
+        memset(&overlapped, '\0', sizeof (overlapped));
+        overlapped.Offset = (DWORD) (pos & 0xFFFFFFFF);
+        overlapped.OffsetHigh = (DWORD) ((pos >> 32) & 0xFFFFFFFF);
+        if (!ReadFile(h, buf, thislen, &numRead, &overlapped))
+        {
+            if (GetLastError() == ERROR_HANDLE_EOF)
+                break;  /* this is just EOF, not a failure. */
+            BAIL(errcodeFromWinApi(), -1);
+        } /* if */
+        len -= (PHYSFS_uint64) numRead;
+        pos += (PHYSFS_uint64) numRead;
+        buf = ((PHYSFS_uint8 *) buf) + numRead;
+        totalRead += (PHYSFS_sint64) numRead;
+        if (numRead != thislen)
+            break;
+    } /* while */
+
+    return totalRead;
+} /* __PHYSFS_platformReadAt */
+
+
+PHYSFS_sint64 __PHYSFS_platformCopyFileRange(void *src, PHYSFS_uint64 srcpos,
+                                             void *dst, PHYSFS_uint64 len)
+{
+    /* Win32 has no handle-to-handle kernel copy (CopyFileEx works on
+       paths), so callers bounce the data through a buffer. */
+    BAIL(PHYSFS_ERR_UNSUPPORTED, -1);
+} /* __PHYSFS_platformCopyFileRange */
+
+
+void *__PHYSFS_platformMapFile(void *opaque, PHYSFS_uint64 len,
+                               const void **addr)
+{
+    HANDLE h = (HANDLE) opaque;
+    HANDLE mapping;
+    void *ptr;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    #ifdef PHYSFS_PLATFORM_WINRT
+    mapping = CreateFileMappingFromApp(h, NULL, PAGE_READONLY, 0, NULL);
+    #else
+    mapping = CreateFileMappingW(h, NULL, PAGE_READONLY, 0, 0, NULL);
+    #endif
+    BAIL_IF(mapping == NULL, errcodeFromWinApi(), NULL);
+
+    #ifdef PHYSFS_PLATFORM_WINRT
+    ptr = MapViewOfFileFromApp(mapping, FILE_MAP_READ, 0, (SIZE_T) len);
+    #else
+    ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, (SIZE_T) len);
+    #endif
+    if (ptr == NULL)
+    {
+        const PHYSFS_ErrorCode err = errcodeFromWinApi();
+        CloseHandle(mapping);
+        BAIL(err, NULL);
+    } /* if */
+
+    *addr = ptr;
+    return (void *) mapping;
+} /* __PHYSFS_platformMapFile */
+
+
+void __PHYSFS_platformUnmapFile(void *maphandle, const void *addr,
+                                PHYSFS_uint64 len)
+{
+    UnmapViewOfFile(addr);
+    CloseHandle((HANDLE) maphandle);
+} /* __PHYSFS_platformUnmapFile */
+
+
 PHYSFS_sint64 __PHYSFS_platformWrite(void *opaque, const void *buffer,
                                      PHYSFS_uint64 len)
 {
@@ -910,6 +1285,82 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
 } /* __PHYSFS_platformReleaseMutex */
 
 
+typedef struct
+{
+    void (*fn)(void *);
+    void *arg;
+} WinThreadEntryArgs;
+
+static DWORD WINAPI winThreadEntry(LPVOID _args)
+{
+    WinThreadEntryArgs *args = (WinThreadEntryArgs *) _args;
+    void (*fn)(void *) = args->fn;
+    void *arg = args->arg;
+    allocator.Free(args);
+    fn(arg);
+    return 0;
+} /* winThreadEntry */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    HANDLE thread;
+    WinThreadEntryArgs *args;
+
+    args = (WinThreadEntryArgs *) allocator.Malloc(sizeof (WinThreadEntryArgs));
+    BAIL_IF(!args, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    args->fn = fn;
+    args->arg = arg;
+
+    thread = CreateThread(NULL, 0, winThreadEntry, args, 0, NULL);
+    if (thread == NULL)
+    {
+        allocator.Free(args);
+        BAIL(errcodeFromWinApi(), NULL);
+    } /* if */
+
+    return ((void *) thread);
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    WaitForSingleObjectEx((HANDLE) thread, INFINITE, FALSE);
+    CloseHandle((HANDLE) thread);
+} /* __PHYSFS_platformJoinThread */
+
+
+void *__PHYSFS_platformCreateSemaphore(void)
+{
+    #ifdef PHYSFS_PLATFORM_WINRT
+    const HANDLE sem = CreateSemaphoreExW(NULL, 0, 0x7FFFFFFF, NULL, 0,
+                                          SEMAPHORE_ALL_ACCESS);
+    #else
+    const HANDLE sem = CreateSemaphoreW(NULL, 0, 0x7FFFFFFF, NULL);
+    #endif
+    BAIL_IF(sem == NULL, errcodeFromWinApi(), NULL);
+    return ((void *) sem);
+} /* __PHYSFS_platformCreateSemaphore */
+
+
+void __PHYSFS_platformDestroySemaphore(void *sem)
+{
+    CloseHandle((HANDLE) sem);
+} /* __PHYSFS_platformDestroySemaphore */
+
+
+void __PHYSFS_platformWaitSemaphore(void *sem)
+{
+    WaitForSingleObjectEx((HANDLE) sem, INFINITE, FALSE);
+} /* __PHYSFS_platformWaitSemaphore */
+
+
+void __PHYSFS_platformPostSemaphore(void *sem)
+{
+    ReleaseSemaphore((HANDLE) sem, 1, NULL);
+} /* __PHYSFS_platformPostSemaphore */
+
+
 static PHYSFS_sint64 FileTimeToPhysfsTime(const FILETIME *ft)
 {
     SYSTEMTIME st_utc;
@@ -548,9 +548,73 @@ int PHYSFS_caseFold(const PHYSFS_uint32 from, PHYSFS_uint32 *to)
 
 int PHYSFS_utf8stricmp(const char *str1, const char *str2)
 {
+    /*
+     * Virtually every string this sees is plain ASCII, where folding is a
+     *  single bit flip; compare those bytes directly instead of decoding
+     *  codepoints and probing the casefolding tables. UTF-8 never hides a
+     *  multibyte sequence behind an ASCII byte, so we only need to drop
+     *  into the full Unicode comparison when a high bit shows up, and the
+     *  pointers are already positioned for it to take over mid-string.
+     */
+    while (1)
+    {
+        const PHYSFS_uint8 ch1 = (PHYSFS_uint8) *str1;
+        const PHYSFS_uint8 ch2 = (PHYSFS_uint8) *str2;
+        PHYSFS_uint8 fold1, fold2;
+
+        if ((ch1 | ch2) & 0x80)
+            break;  /* non-ASCII input; do this the hard way. */
+
+        fold1 = ((ch1 >= 'A') && (ch1 <= 'Z')) ? (ch1 + ('a' - 'A')) : ch1;
+        fold2 = ((ch2 >= 'A') && (ch2 <= 'Z')) ? (ch2 + ('a' - 'A')) : ch2;
+
+        if (fold1 < fold2)
+            return -1;
+        else if (fold1 > fold2)
+            return 1;
+        else if (ch1 == 0)
+            return 0;  /* complete match. */
+
+        str1++;
+        str2++;
+    } /* while */
+
     UTFSTRICMP(8);
 } /* PHYSFS_utf8stricmp */
 
+PHYSFS_uint32 __PHYSFS_hashStringCasefold(const char *str)
+{
+    /* same xor-hash as __PHYSFS_hashString(), but mixing casefolded
+       codepoints instead of raw bytes, so strings PHYSFS_utf8stricmp()
+       considers equal hash identically. ASCII takes the same
+       one-bit-flip shortcut as stricmp. */
+    PHYSFS_uint32 hash = 5381;
+
+    while (1)
+    {
+        const PHYSFS_uint8 ch = (PHYSFS_uint8) *str;
+        PHYSFS_uint32 folded[3];
+        int count, i;
+
+        if (ch == 0)
+            break;
+        else if ((ch & 0x80) == 0)  /* plain ASCII. */
+        {
+            const PHYSFS_uint32 cp = ((ch >= 'A') && (ch <= 'Z')) ?
+                                     (ch + ('a' - 'A')) : ch;
+            hash = ((hash << 5) + hash) ^ cp;
+            str++;
+            continue;
+        } /* else if */
+
+        count = PHYSFS_caseFold(utf8codepoint(&str), folded);
+        for (i = 0; i < count; i++)
+            hash = ((hash << 5) + hash) ^ folded[i];
+    } /* while */
+
+    return hash;
+} /* __PHYSFS_hashStringCasefold */
+
 int PHYSFS_utf16stricmp(const PHYSFS_uint16 *str1, const PHYSFS_uint16 *str2)
 {
     UTFSTRICMP(16);
@@ -0,0 +1,969 @@
+/*
+ * PhysicsFS benchmark harness.
+ *
+ * Generates synthetic archives (directory tree, ZIP stored, ZIP deflated,
+ *  7zip, Build engine GRP) and measures mount time, file opens, sequential
+ *  and random reads, enumeration and stat calls against each of them, at
+ *  one or more thread counts. Results go to stdout as one machine-readable
+ *  CSV-style line per measurement:
+ *
+ *    PHYSFS_BENCH,archive=zip_deflate,bench=seq_read,threads=2,value=512.3,unit=MB/s
+ *
+ * Lines starting with '#' are commentary and can be ignored by parsers.
+ *
+ * Usage: physfs_bench [--files N] [--filesize N] [--threads 1,2,4]
+ *                     [--workdir path] [--archives dir,zip_store,...]
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "physfs.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#define benchMkdir(p) _mkdir(p)
+#else
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#define benchMkdir(p) mkdir(p, 0755)
+#endif
+
+#define BENCH_MOUNTPOINT "/bench"
+#define BENCH_MOUNT_ITERATIONS 8
+#define BENCH_MAX_THREADS 64
+#define BENCH_READ_CHUNK (64 * 1024)
+#define BENCH_RANDREAD_SIZE 4096
+
+static int optFiles = 512;
+static int optFileSize = 16384;
+static const char *optWorkDir = "physfs_bench_data";
+static int optThreads[BENCH_MAX_THREADS];
+static int optNumThreadCounts = 0;
+static const char *optArchives = "dir,zip_store,zip_deflate,7z,grp";
+
+/* virtual paths of every file in the currently-mounted archive. */
+static char **benchNames = NULL;
+
+/* ops per run; scaled so each measurement takes a useful amount of work. */
+static int opsOpen = 0;
+static int opsStat = 0;
+static int opsRandRead = 0;
+static int opsEnum = 0;
+
+
+/* timing and threading shims ... */
+
+static double benchNow(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return ((double) now.QuadPart) / ((double) freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((double) ts.tv_sec) + (((double) ts.tv_nsec) / 1000000000.0);
+#endif
+} /* benchNow */
+
+
+typedef struct
+{
+    int tid;
+    int nthreads;
+    int ops;                  /* this worker's share of the op count. */
+    unsigned int seed;
+    PHYSFS_uint64 bytes;      /* out: bytes moved, for MB/s numbers. */
+    int failed;               /* out: nonzero if any op failed. */
+} WorkerState;
+
+typedef void (*WorkerFn)(WorkerState *st);
+
+typedef struct
+{
+    WorkerFn fn;
+    WorkerState *st;
+} ThreadLaunch;
+
+#ifdef _WIN32
+static DWORD WINAPI threadEntry(LPVOID arg)
+{
+    ThreadLaunch *launch = (ThreadLaunch *) arg;
+    launch->fn(launch->st);
+    return 0;
+} /* threadEntry */
+#else
+static void *threadEntry(void *arg)
+{
+    ThreadLaunch *launch = (ThreadLaunch *) arg;
+    launch->fn(launch->st);
+    return NULL;
+} /* threadEntry */
+#endif
+
+/* run (fn) on (n) threads, one WorkerState each; returns elapsed seconds. */
+static double runWorkers(WorkerFn fn, WorkerState *states, const int n)
+{
+    ThreadLaunch launches[BENCH_MAX_THREADS];
+#ifdef _WIN32
+    HANDLE threads[BENCH_MAX_THREADS];
+#else
+    pthread_t threads[BENCH_MAX_THREADS];
+#endif
+    double start;
+    int i;
+
+    if (n == 1)  /* don't charge single-threaded runs for thread spawning. */
+    {
+        start = benchNow();
+        fn(&states[0]);
+        return benchNow() - start;
+    } /* if */
+
+    start = benchNow();
+    for (i = 0; i < n; i++)
+    {
+        launches[i].fn = fn;
+        launches[i].st = &states[i];
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, threadEntry, &launches[i], 0, NULL);
+#else
+        pthread_create(&threads[i], NULL, threadEntry, &launches[i]);
+#endif
+    } /* for */
+
+    for (i = 0; i < n; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    } /* for */
+
+    return benchNow() - start;
+} /* runWorkers */
+
+
+static unsigned int nextRand(unsigned int *seed)
+{
+    *seed = (*seed * 1103515245) + 12345;
+    return (*seed >> 16);
+} /* nextRand */
+
+
+/* growable byte buffer, used to build archive images in memory ... */
+
+typedef struct
+{
+    unsigned char *buf;
+    size_t len;
+    size_t alloc;
+} Blob;
+
+static void blobAppend(Blob *b, const void *data, const size_t len)
+{
+    if ((b->len + len) > b->alloc)
+    {
+        size_t newalloc = b->alloc ? b->alloc : 4096;
+        while (newalloc < (b->len + len))
+            newalloc *= 2;
+        b->buf = (unsigned char *) realloc(b->buf, newalloc);
+        if (!b->buf)
+        {
+            fprintf(stderr, "out of memory building archive\n");
+            exit(1);
+        } /* if */
+        b->alloc = newalloc;
+    } /* if */
+
+    memcpy(b->buf + b->len, data, len);
+    b->len += len;
+} /* blobAppend */
+
+static void blobU8(Blob *b, const unsigned int v)
+{
+    const unsigned char ch = (unsigned char) v;
+    blobAppend(b, &ch, 1);
+} /* blobU8 */
+
+static void blobU16(Blob *b, const unsigned int v)
+{
+    blobU8(b, v & 0xFF);
+    blobU8(b, (v >> 8) & 0xFF);
+} /* blobU16 */
+
+static void blobU32(Blob *b, const unsigned long v)
+{
+    blobU16(b, (unsigned int) (v & 0xFFFF));
+    blobU16(b, (unsigned int) ((v >> 16) & 0xFFFF));
+} /* blobU32 */
+
+static void blobU64(Blob *b, const PHYSFS_uint64 v)
+{
+    blobU32(b, (unsigned long) (v & 0xFFFFFFFF));
+    blobU32(b, (unsigned long) ((v >> 32) & 0xFFFFFFFF));
+} /* blobU64 */
+
+
+/* CRC-32, needed by the ZIP and 7z writers ... */
+
+static unsigned long crcTable[256];
+
+static void crcInit(void)
+{
+    unsigned long c;
+    int i, j;
+    for (i = 0; i < 256; i++)
+    {
+        c = (unsigned long) i;
+        for (j = 0; j < 8; j++)
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        crcTable[i] = c;
+    } /* for */
+} /* crcInit */
+
+static unsigned long crc32buf(const unsigned char *buf, size_t len)
+{
+    unsigned long c = 0xFFFFFFFF;
+    size_t i;
+    for (i = 0; i < len; i++)
+        c = crcTable[(c ^ buf[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFF;
+} /* crc32buf */
+
+
+/* deterministic file contents: file (idx) always holds the same bytes. */
+static void fillFileData(unsigned char *buf, const int idx, const int len)
+{
+    unsigned int seed = ((unsigned int) idx) * 2654435761u + 1;
+    int i;
+    for (i = 0; i < len; i++)
+        buf[i] = (unsigned char) nextRand(&seed);
+} /* fillFileData */
+
+
+/* synthetic archive writers ... */
+
+/* entry names as they appear inside the dir tree and ZIP archives. */
+static void nestedName(char *buf, const size_t buflen, const int idx)
+{
+    snprintf(buf, buflen, "sub%02d/f%05d.bin", idx / 64, idx);
+} /* nestedName */
+
+/* ...and the flat names used by formats without directory support. */
+static void flatName(char *buf, const size_t buflen, const int idx)
+{
+    snprintf(buf, buflen, "f%05d.bin", idx);
+} /* flatName */
+
+
+static void writeBlobToFile(const Blob *b, const char *path)
+{
+    FILE *out = fopen(path, "wb");
+    if ((!out) || (fwrite(b->buf, 1, b->len, out) != b->len) || (fclose(out) == EOF))
+    {
+        fprintf(stderr, "failed to write '%s'\n", path);
+        exit(1);
+    } /* if */
+} /* writeBlobToFile */
+
+
+static void generateDirTree(const char *base)
+{
+    unsigned char *data = (unsigned char *) malloc(optFileSize);
+    char path[512];
+    int i;
+
+    snprintf(path, sizeof (path), "%s/dir", base);
+    benchMkdir(path);
+    for (i = 0; i < ((optFiles + 63) / 64); i++)
+    {
+        snprintf(path, sizeof (path), "%s/dir/sub%02d", base, i);
+        benchMkdir(path);
+    } /* for */
+
+    for (i = 0; i < optFiles; i++)
+    {
+        char name[64];
+        FILE *out;
+        nestedName(name, sizeof (name), i);
+        snprintf(path, sizeof (path), "%s/dir/%s", base, name);
+        fillFileData(data, i, optFileSize);
+        out = fopen(path, "wb");
+        if ((!out) || (fwrite(data, 1, optFileSize, out) != (size_t) optFileSize) || (fclose(out) == EOF))
+        {
+            fprintf(stderr, "failed to write '%s'\n", path);
+            exit(1);
+        } /* if */
+    } /* for */
+
+    free(data);
+} /* generateDirTree */
+
+
+/*
+ * "Deflate" the buffer as a series of stored (uncompressed) deflate blocks.
+ *  This is a legal deflate stream that any inflater accepts, without this
+ *  harness needing a compressor: it exercises the whole decompression path
+ *  on read, just with ratio 1.0.
+ */
+static void deflateStored(Blob *out, const unsigned char *data, size_t len)
+{
+    while (len > 0)
+    {
+        const size_t chunk = (len > 65535) ? 65535 : len;
+        blobU8(out, (chunk == len) ? 1 : 0);  /* BFINAL, BTYPE=00 (stored) */
+        blobU16(out, (unsigned int) chunk);
+        blobU16(out, (unsigned int) (~chunk) & 0xFFFF);
+        blobAppend(out, data, chunk);
+        data += chunk;
+        len -= chunk;
+    } /* while */
+} /* deflateStored */
+
+
+static void generateZip(const char *base, const int deflated)
+{
+    unsigned char *data = (unsigned char *) malloc(optFileSize);
+    Blob out;
+    Blob cd;
+    char path[512];
+    int i;
+
+    memset(&out, '\0', sizeof (out));
+    memset(&cd, '\0', sizeof (cd));
+
+    for (i = 0; i < optFiles; i++)
+    {
+        char name[64];
+        const size_t localOffset = out.len;
+        const int method = deflated ? 8 : 0;
+        unsigned long crc;
+        size_t namelen;
+        Blob comp;
+
+        memset(&comp, '\0', sizeof (comp));
+        nestedName(name, sizeof (name), i);
+        namelen = strlen(name);
+        fillFileData(data, i, optFileSize);
+        crc = crc32buf(data, optFileSize);
+        if (deflated)
+            deflateStored(&comp, data, optFileSize);
+        else
+            blobAppend(&comp, data, optFileSize);
+
+        /* local file header. */
+        blobU32(&out, 0x04034B50);
+        blobU16(&out, 20);                  /* version needed to extract. */
+        blobU16(&out, 0);                   /* general purpose bits. */
+        blobU16(&out, method);
+        blobU16(&out, 0);                   /* mod time. */
+        blobU16(&out, 0x21);                /* mod date. */
+        blobU32(&out, crc);
+        blobU32(&out, (unsigned long) comp.len);
+        blobU32(&out, (unsigned long) optFileSize);
+        blobU16(&out, (unsigned int) namelen);
+        blobU16(&out, 0);                   /* extra field length. */
+        blobAppend(&out, name, namelen);
+        blobAppend(&out, comp.buf, comp.len);
+
+        /* central directory record. */
+        blobU32(&cd, 0x02014B50);
+        blobU16(&cd, 20);                   /* version made by. */
+        blobU16(&cd, 20);                   /* version needed. */
+        blobU16(&cd, 0);
+        blobU16(&cd, method);
+        blobU16(&cd, 0);
+        blobU16(&cd, 0x21);
+        blobU32(&cd, crc);
+        blobU32(&cd, (unsigned long) comp.len);
+        blobU32(&cd, (unsigned long) optFileSize);
+        blobU16(&cd, (unsigned int) namelen);
+        blobU16(&cd, 0);                    /* extra length. */
+        blobU16(&cd, 0);                    /* comment length. */
+        blobU16(&cd, 0);                    /* disk number. */
+        blobU16(&cd, 0);                    /* internal attributes. */
+        blobU32(&cd, 0);                    /* external attributes. */
+        blobU32(&cd, (unsigned long) localOffset);
+        blobAppend(&cd, name, namelen);
+
+        free(comp.buf);
+    } /* for */
+
+    /* end-of-central-directory record. */
+    {
+        const size_t cdOffset = out.len;
+        blobAppend(&out, cd.buf, cd.len);
+        blobU32(&out, 0x06054B50);
+        blobU16(&out, 0);
+        blobU16(&out, 0);
+        blobU16(&out, optFiles);
+        blobU16(&out, optFiles);
+        blobU32(&out, (unsigned long) cd.len);
+        blobU32(&out, (unsigned long) cdOffset);
+        blobU16(&out, 0);
+    }
+
+    snprintf(path, sizeof (path), "%s/bench_%s.zip", base,
+             deflated ? "deflate" : "store");
+    writeBlobToFile(&out, path);
+
+    free(cd.buf);
+    free(out.buf);
+    free(data);
+} /* generateZip */
+
+
+/* 7z's variable-width number encoding. */
+static void blob7zNum(Blob *b, const PHYSFS_uint64 v)
+{
+    if (v < 0x80)
+        blobU8(b, (unsigned int) v);
+    else
+    {
+        blobU8(b, 0xFF);  /* "all eight bytes follow" form; always legal. */
+        blobU64(b, v);
+    } /* else */
+} /* blob7zNum */
+
+/*
+ * Minimal 7z writer: one solid folder using the copy codec, holding every
+ *  file. A solid archive is the interesting case for PhysicsFS, since it
+ *  exercises the whole-block decode and block cache.
+ */
+static void generateSevenZip(const char *base)
+{
+    unsigned char *data = (unsigned char *) malloc(optFileSize);
+    unsigned long *crcs = (unsigned long *) malloc(optFiles * sizeof (unsigned long));
+    const PHYSFS_uint64 packSize = ((PHYSFS_uint64) optFiles) * optFileSize;
+    Blob out;
+    Blob hdr;
+    char path[512];
+    int i;
+
+    memset(&out, '\0', sizeof (out));
+    memset(&hdr, '\0', sizeof (hdr));
+
+    /* the header, which lands _after_ the packed data. */
+    blobU8(&hdr, 0x01);                     /* kHeader */
+    blobU8(&hdr, 0x04);                     /* kMainStreamsInfo */
+
+    blobU8(&hdr, 0x06);                     /* kPackInfo */
+    blob7zNum(&hdr, 0);                     /* pack position. */
+    blob7zNum(&hdr, 1);                     /* number of pack streams. */
+    blobU8(&hdr, 0x09);                     /* kSize */
+    blob7zNum(&hdr, packSize);
+    blobU8(&hdr, 0x00);                     /* kEnd */
+
+    blobU8(&hdr, 0x07);                     /* kUnPackInfo */
+    blobU8(&hdr, 0x0B);                     /* kFolder */
+    blob7zNum(&hdr, 1);                     /* number of folders. */
+    blobU8(&hdr, 0x00);                     /* not external. */
+    blob7zNum(&hdr, 1);                     /* coders in this folder. */
+    blobU8(&hdr, 0x01);                     /* coder flags: 1-byte id. */
+    blobU8(&hdr, 0x00);                     /* codec id: copy. */
+    blobU8(&hdr, 0x0C);                     /* kCodersUnPackSize */
+    blob7zNum(&hdr, packSize);
+    blobU8(&hdr, 0x00);                     /* kEnd */
+
+    blobU8(&hdr, 0x08);                     /* kSubStreamsInfo */
+    blobU8(&hdr, 0x0D);                     /* kNumUnPackStream */
+    blob7zNum(&hdr, optFiles);
+    blobU8(&hdr, 0x09);                     /* kSize (all but the last). */
+    for (i = 0; i < optFiles - 1; i++)
+        blob7zNum(&hdr, optFileSize);
+    blobU8(&hdr, 0x0A);                     /* kCRC */
+    blobU8(&hdr, 1);                        /* all defined. */
+    for (i = 0; i < optFiles; i++)
+    {
+        fillFileData(data, i, optFileSize);
+        crcs[i] = crc32buf(data, optFileSize);
+        blobU32(&hdr, crcs[i]);
+    } /* for */
+    blobU8(&hdr, 0x00);                     /* kEnd (substreams) */
+    blobU8(&hdr, 0x00);                     /* kEnd (streams info) */
+
+    blobU8(&hdr, 0x05);                     /* kFilesInfo */
+    blob7zNum(&hdr, optFiles);
+    {
+        char name[64];
+        size_t namesLen = 1;  /* the "not external" byte. */
+        for (i = 0; i < optFiles; i++)
+        {
+            flatName(name, sizeof (name), i);
+            namesLen += (strlen(name) + 1) * 2;  /* UTF-16 plus null. */
+        } /* for */
+
+        blobU8(&hdr, 0x11);                 /* kName */
+        blob7zNum(&hdr, namesLen);
+        blobU8(&hdr, 0x00);                 /* not external. */
+        for (i = 0; i < optFiles; i++)
+        {
+            const char *ch;
+            flatName(name, sizeof (name), i);
+            for (ch = name; *ch; ch++)
+                blobU16(&hdr, (unsigned int) *ch);  /* names are ASCII. */
+            blobU16(&hdr, 0);
+        } /* for */
+    }
+    blobU8(&hdr, 0x00);                     /* kEnd (files info) */
+    blobU8(&hdr, 0x00);                     /* kEnd (header) */
+
+    /* signature header. */
+    blobAppend(&out, "7z\xBC\xAF\x27\x1C", 6);
+    blobU8(&out, 0);                        /* major version. */
+    blobU8(&out, 4);                        /* minor version. */
+    {
+        Blob startHdr;
+        memset(&startHdr, '\0', sizeof (startHdr));
+        blobU64(&startHdr, packSize);       /* next header offset. */
+        blobU64(&startHdr, hdr.len);        /* next header size. */
+        blobU32(&startHdr, crc32buf(hdr.buf, hdr.len));
+        blobU32(&out, crc32buf(startHdr.buf, startHdr.len));
+        blobAppend(&out, startHdr.buf, startHdr.len);
+        free(startHdr.buf);
+    }
+
+    /* packed (copy codec: raw) data, then the header. */
+    for (i = 0; i < optFiles; i++)
+    {
+        fillFileData(data, i, optFileSize);
+        blobAppend(&out, data, optFileSize);
+    } /* for */
+    blobAppend(&out, hdr.buf, hdr.len);
+
+    snprintf(path, sizeof (path), "%s/bench.7z", base);
+    writeBlobToFile(&out, path);
+
+    free(hdr.buf);
+    free(out.buf);
+    free(crcs);
+    free(data);
+} /* generateSevenZip */
+
+
+static void generateGrp(const char *base)
+{
+    unsigned char *data = (unsigned char *) malloc(optFileSize);
+    Blob out;
+    char path[512];
+    int i;
+
+    memset(&out, '\0', sizeof (out));
+    blobAppend(&out, "KenSilverman", 12);
+    blobU32(&out, (unsigned long) optFiles);
+    for (i = 0; i < optFiles; i++)
+    {
+        char name[13];
+        memset(name, '\0', sizeof (name));
+        flatName(name, sizeof (name), i);  /* "f%05d.bin" fits in 12 bytes. */
+        blobAppend(&out, name, 12);
+        blobU32(&out, (unsigned long) optFileSize);
+    } /* for */
+
+    for (i = 0; i < optFiles; i++)
+    {
+        fillFileData(data, i, optFileSize);
+        blobAppend(&out, data, optFileSize);
+    } /* for */
+
+    snprintf(path, sizeof (path), "%s/bench.grp", base);
+    writeBlobToFile(&out, path);
+
+    free(out.buf);
+    free(data);
+} /* generateGrp */
+
+
+/* the benchmarks themselves ... */
+
+static void report(const char *archive, const char *bench, const int threads,
+                   const double value, const char *unit)
+{
+    printf("PHYSFS_BENCH,archive=%s,bench=%s,threads=%d,value=%.3f,unit=%s\n",
+           archive, bench, threads, value, unit);
+    fflush(stdout);
+} /* report */
+
+
+static void openWorker(WorkerState *st)
+{
+    int i;
+    for (i = 0; i < st->ops; i++)
+    {
+        const char *name = benchNames[nextRand(&st->seed) % optFiles];
+        PHYSFS_File *f = PHYSFS_openRead(name);
+        if (!f)
+            { st->failed = 1; return; }
+        PHYSFS_close(f);
+    } /* for */
+} /* openWorker */
+
+
+static void seqReadWorker(WorkerState *st)
+{
+    unsigned char buf[BENCH_READ_CHUNK];
+    int i;
+
+    /* files are partitioned between threads; each is read start to end. */
+    for (i = st->tid; i < optFiles; i += st->nthreads)
+    {
+        PHYSFS_File *f = PHYSFS_openRead(benchNames[i]);
+        PHYSFS_sint64 rc;
+        if (!f)
+            { st->failed = 1; return; }
+        while ((rc = PHYSFS_readBytes(f, buf, sizeof (buf))) > 0)
+            st->bytes += (PHYSFS_uint64) rc;
+        PHYSFS_close(f);
+    } /* for */
+} /* seqReadWorker */
+
+
+static void randReadWorker(WorkerState *st)
+{
+    unsigned char buf[BENCH_RANDREAD_SIZE];
+    PHYSFS_File *f = NULL;
+    int i;
+
+    for (i = 0; i < st->ops; i++)
+    {
+        PHYSFS_sint64 rc;
+        PHYSFS_uint64 pos;
+
+        if ((i % 256) == 0)  /* hop to another file now and then. */
+        {
+            if (f) PHYSFS_close(f);
+            f = PHYSFS_openRead(benchNames[nextRand(&st->seed) % optFiles]);
+            if (!f)
+                { st->failed = 1; return; }
+        } /* if */
+
+        pos = nextRand(&st->seed) % optFileSize;
+        if (pos + BENCH_RANDREAD_SIZE > (PHYSFS_uint64) optFileSize)
+            pos = 0;
+        if (!PHYSFS_seek(f, pos))
+            { st->failed = 1; break; }
+        rc = PHYSFS_readBytes(f, buf, BENCH_RANDREAD_SIZE);
+        if (rc <= 0)
+            { st->failed = 1; break; }
+        st->bytes += (PHYSFS_uint64) rc;
+    } /* for */
+
+    if (f) PHYSFS_close(f);
+} /* randReadWorker */
+
+
+static void enumWorker(WorkerState *st)
+{
+    int i;
+    for (i = 0; i < st->ops; i++)
+    {
+        char **rc = PHYSFS_enumerateFiles(BENCH_MOUNTPOINT);
+        if (!rc)
+            { st->failed = 1; return; }
+        PHYSFS_freeList(rc);
+    } /* for */
+} /* enumWorker */
+
+
+static void statWorker(WorkerState *st)
+{
+    int i;
+    for (i = 0; i < st->ops; i++)
+    {
+        PHYSFS_Stat statbuf;
+        const char *name = benchNames[nextRand(&st->seed) % optFiles];
+        if (!PHYSFS_stat(name, &statbuf))
+            { st->failed = 1; return; }
+    } /* for */
+} /* statWorker */
+
+
+/* returns total failures; fills elapsed. */
+static int timedRun(WorkerFn fn, const int nthreads, const int totalops,
+                    double *elapsed, PHYSFS_uint64 *bytes)
+{
+    WorkerState states[BENCH_MAX_THREADS];
+    int failures = 0;
+    int i;
+
+    memset(states, '\0', sizeof (states));
+    for (i = 0; i < nthreads; i++)
+    {
+        states[i].tid = i;
+        states[i].nthreads = nthreads;
+        states[i].ops = totalops / nthreads;
+        states[i].seed = 0xBEEF + (unsigned int) i;
+    } /* for */
+
+    *elapsed = runWorkers(fn, states, nthreads);
+
+    *bytes = 0;
+    for (i = 0; i < nthreads; i++)
+    {
+        *bytes += states[i].bytes;
+        failures += states[i].failed;
+    } /* for */
+
+    return failures;
+} /* timedRun */
+
+
+static void benchArchive(const char *tag, const char *realpath, const int flat)
+{
+    double elapsed;
+    PHYSFS_uint64 bytes;
+    char name[64];
+    int t, i;
+
+    /* mount time (mount + unmount loop; reports just the mounts). */
+    {
+        double total = 0.0;
+        for (i = 0; i < BENCH_MOUNT_ITERATIONS; i++)
+        {
+            const double start = benchNow();
+            if (!PHYSFS_mount(realpath, BENCH_MOUNTPOINT, 1))
+            {
+                fprintf(stderr, "# mount of '%s' failed: %s\n", realpath,
+                        PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+                return;
+            } /* if */
+            total += benchNow() - start;
+            if (i < BENCH_MOUNT_ITERATIONS - 1)
+                PHYSFS_unmount(realpath);
+        } /* for */
+        report(tag, "mount", 1, (total / BENCH_MOUNT_ITERATIONS) * 1000.0, "ms");
+    }
+
+    /* build the virtual path list for the workers. */
+    benchNames = (char **) malloc(optFiles * sizeof (char *));
+    for (i = 0; i < optFiles; i++)
+    {
+        char vpath[128];
+        if (flat)
+            flatName(name, sizeof (name), i);
+        else
+            nestedName(name, sizeof (name), i);
+        snprintf(vpath, sizeof (vpath), "%s/%s", BENCH_MOUNTPOINT, name);
+        benchNames[i] = strdup(vpath);
+    } /* for */
+
+    /* sanity check before measuring anything. */
+    {
+        PHYSFS_Stat statbuf;
+        if (!PHYSFS_stat(benchNames[0], &statbuf))
+        {
+            fprintf(stderr, "# '%s' missing from '%s'; skipping: %s\n",
+                    benchNames[0], realpath,
+                    PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            goto benchArchive_done;
+        } /* if */
+    }
+
+    for (t = 0; t < optNumThreadCounts; t++)
+    {
+        const int nthreads = optThreads[t];
+
+        if (timedRun(openWorker, nthreads, opsOpen, &elapsed, &bytes))
+            fprintf(stderr, "# open bench failed on %s\n", tag);
+        else
+            report(tag, "open", nthreads, opsOpen / elapsed, "ops/s");
+
+        if (timedRun(seqReadWorker, nthreads, optFiles, &elapsed, &bytes))
+            fprintf(stderr, "# seq_read bench failed on %s\n", tag);
+        else
+            report(tag, "seq_read", nthreads,
+                   (bytes / elapsed) / (1024.0 * 1024.0), "MB/s");
+
+        if (timedRun(randReadWorker, nthreads, opsRandRead, &elapsed, &bytes))
+            fprintf(stderr, "# rand_read bench failed on %s\n", tag);
+        else
+            report(tag, "rand_read", nthreads,
+                   (bytes / elapsed) / (1024.0 * 1024.0), "MB/s");
+
+        if (timedRun(enumWorker, nthreads, opsEnum, &elapsed, &bytes))
+            fprintf(stderr, "# enumerate bench failed on %s\n", tag);
+        else
+            report(tag, "enumerate", nthreads, opsEnum / elapsed, "ops/s");
+
+        if (timedRun(statWorker, nthreads, opsStat, &elapsed, &bytes))
+            fprintf(stderr, "# stat bench failed on %s\n", tag);
+        else
+            report(tag, "stat", nthreads, opsStat / elapsed, "ops/s");
+    } /* for */
+
+benchArchive_done:
+    for (i = 0; i < optFiles; i++)
+        free(benchNames[i]);
+    free(benchNames);
+    benchNames = NULL;
+    PHYSFS_unmount(realpath);
+} /* benchArchive */
+
+
+static int archiveRequested(const char *tag)
+{
+    const char *found = strstr(optArchives, tag);
+    if (!found)
+        return 0;
+    /* guard against "zip_store" matching inside "zip_storefoo", etc. */
+    if ((found != optArchives) && (found[-1] != ','))
+        return 0;
+    found += strlen(tag);
+    return ((*found == '\0') || (*found == ','));
+} /* archiveRequested */
+
+
+static int archiverSupported(const char *ext)
+{
+    const PHYSFS_ArchiveInfo **info;
+    for (info = PHYSFS_supportedArchiveTypes(); *info != NULL; info++)
+    {
+        if (PHYSFS_utf8stricmp((*info)->extension, ext) == 0)
+            return 1;
+    } /* for */
+    return 0;
+} /* archiverSupported */
+
+
+int main(int argc, char **argv)
+{
+    char path[512];
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--files") == 0) && (i + 1 < argc))
+            optFiles = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--filesize") == 0) && (i + 1 < argc))
+            optFileSize = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--workdir") == 0) && (i + 1 < argc))
+            optWorkDir = argv[++i];
+        else if ((strcmp(argv[i], "--archives") == 0) && (i + 1 < argc))
+            optArchives = argv[++i];
+        else if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc))
+        {
+            char *ptr = argv[++i];
+            while ((*ptr) && (optNumThreadCounts < BENCH_MAX_THREADS))
+            {
+                const int val = atoi(ptr);
+                if ((val >= 1) && (val <= BENCH_MAX_THREADS))
+                    optThreads[optNumThreadCounts++] = val;
+                ptr = strchr(ptr, ',');
+                if (!ptr)
+                    break;
+                ptr++;
+            } /* while */
+        } /* else if */
+        else
+        {
+            fprintf(stderr, "usage: %s [--files N] [--filesize N]"
+                    " [--threads 1,2,4] [--workdir path]"
+                    " [--archives dir,zip_store,zip_deflate,7z,grp]\n",
+                    argv[0]);
+            return 1;
+        } /* else */
+    } /* for */
+
+    if ((optFiles < 1) || (optFiles > 65000) || (optFileSize < BENCH_RANDREAD_SIZE))
+    {
+        fprintf(stderr, "bogus --files/--filesize values.\n");
+        return 1;
+    } /* if */
+
+    if (optNumThreadCounts == 0)
+    {
+        optThreads[0] = 1;
+        optThreads[1] = 2;
+        optThreads[2] = 4;
+        optNumThreadCounts = 3;
+    } /* if */
+
+    opsOpen = optFiles * 4;
+    opsStat = optFiles * 16;
+    opsRandRead = optFiles * 8;
+    opsEnum = 64;
+
+    if (!PHYSFS_init(argv[0]))
+    {
+        fprintf(stderr, "PHYSFS_init failed: %s\n",
+                PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        return 1;
+    } /* if */
+
+    crcInit();
+    benchMkdir(optWorkDir);
+
+    printf("# physfs_bench: files=%d filesize=%d workdir=%s\n",
+           optFiles, optFileSize, optWorkDir);
+
+    if (archiveRequested("dir"))
+    {
+        generateDirTree(optWorkDir);
+        snprintf(path, sizeof (path), "%s/dir", optWorkDir);
+        benchArchive("dir", path, 0);
+    } /* if */
+
+    if (archiveRequested("zip_store"))
+    {
+        if (!archiverSupported("zip"))
+            fprintf(stderr, "# ZIP support not compiled in; skipping.\n");
+        else
+        {
+            generateZip(optWorkDir, 0);
+            snprintf(path, sizeof (path), "%s/bench_store.zip", optWorkDir);
+            benchArchive("zip_store", path, 0);
+        } /* else */
+    } /* if */
+
+    if (archiveRequested("zip_deflate"))
+    {
+        if (!archiverSupported("zip"))
+            fprintf(stderr, "# ZIP support not compiled in; skipping.\n");
+        else
+        {
+            generateZip(optWorkDir, 1);
+            snprintf(path, sizeof (path), "%s/bench_deflate.zip", optWorkDir);
+            benchArchive("zip_deflate", path, 0);
+        } /* else */
+    } /* if */
+
+    if (archiveRequested("7z"))
+    {
+        if (!archiverSupported("7z"))
+            fprintf(stderr, "# 7z support not compiled in; skipping.\n");
+        else
+        {
+            generateSevenZip(optWorkDir);
+            snprintf(path, sizeof (path), "%s/bench.7z", optWorkDir);
+            benchArchive("7z", path, 1);
+        } /* else */
+    } /* if */
+
+    if (archiveRequested("grp"))
+    {
+        if (!archiverSupported("grp"))
+            fprintf(stderr, "# GRP support not compiled in; skipping.\n");
+        else
+        {
+            generateGrp(optWorkDir);
+            snprintf(path, sizeof (path), "%s/bench.grp", optWorkDir);
+            benchArchive("grp", path, 1);
+        } /* else */
+    } /* if */
+
+    PHYSFS_deinit();
+    return 0;
+} /* main */
+
+/* end of physfs_bench.c ... */